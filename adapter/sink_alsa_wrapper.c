@@ -56,7 +56,7 @@ sink_handle_t alsa_wrapper_open(int samplerate, int channels, int bits, void *pr
         alsa->format = SND_PCM_FORMAT_S16_LE;
         break;
     case 24:
-        alsa->format = SND_PCM_FORMAT_S24_LE;
+        alsa->format = SND_PCM_FORMAT_S24_3LE;
         break;
     case 32:
         alsa->format = SND_PCM_FORMAT_S32_LE;
@@ -184,3 +184,38 @@ void alsa_wrapper_close(sink_handle_t handle)
 
     OS_FREE(alsa);
 }
+
+int alsa_wrapper_formats(void *priv_data)
+{
+    static const struct {
+        snd_pcm_format_t format;
+        int mask;
+    } candidates[] = {
+        { SND_PCM_FORMAT_S16_LE,  SINK_FORMAT_S16LE },
+        { SND_PCM_FORMAT_S24_3LE, SINK_FORMAT_S24LE },
+        { SND_PCM_FORMAT_S32_LE,  SINK_FORMAT_S32LE },
+    };
+    snd_pcm_t *pcm = NULL;
+    snd_pcm_hw_params_t *hwparams = NULL;
+    int formats = 0;
+
+    // Probe without blocking, a busy device falls back to s16 and is reported by open
+    if (snd_pcm_open(&pcm, "default", SND_PCM_STREAM_PLAYBACK, SND_PCM_NONBLOCK) < 0) {
+        OS_LOGW(TAG, "snd_pcm_open failed, assume s16 only");
+        return SINK_FORMAT_S16LE;
+    }
+    snd_pcm_hw_params_alloca(&hwparams);
+    if (snd_pcm_hw_params_any(pcm, hwparams) < 0) {
+        OS_LOGW(TAG, "snd_pcm_hw_params_any failed, assume s16 only");
+        snd_pcm_close(pcm);
+        return SINK_FORMAT_S16LE;
+    }
+    for (int i = 0; i < sizeof(candidates)/sizeof(candidates[0]); i++) {
+        if (snd_pcm_hw_params_test_format(pcm, hwparams, candidates[i].format) == 0)
+            formats |= candidates[i].mask;
+    }
+    snd_pcm_close(pcm);
+
+    OS_LOGD(TAG, "Supported formats: 0x%x", formats);
+    return formats != 0 ? formats : SINK_FORMAT_S16LE;
+}
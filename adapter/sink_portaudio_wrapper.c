@@ -102,3 +102,37 @@ void portaudio_wrapper_close(sink_handle_t handle)
     Pa_Terminate();
     OS_FREE(portaudio);
 }
+
+int portaudio_wrapper_formats(void *priv_data)
+{
+    static const struct {
+        PaSampleFormat format;
+        int mask;
+    } candidates[] = {
+        { paInt16, SINK_FORMAT_S16LE },
+        { paInt24, SINK_FORMAT_S24LE },
+        { paInt32, SINK_FORMAT_S32LE },
+    };
+    int formats = 0;
+
+    if (Pa_Initialize() != paNoError)
+        return SINK_FORMAT_S16LE;
+    PaStreamParameters ouputParameters;
+    ouputParameters.device = Pa_GetDefaultOutputDevice();
+    const PaDeviceInfo *info =
+            ouputParameters.device != paNoDevice ? Pa_GetDeviceInfo(ouputParameters.device) : NULL;
+    if (info != NULL) {
+        ouputParameters.channelCount = info->maxOutputChannels < 2 ? 1 : 2;
+        ouputParameters.suggestedLatency = info->defaultLowOutputLatency;
+        ouputParameters.hostApiSpecificStreamInfo = NULL;
+        for (int i = 0; i < sizeof(candidates)/sizeof(candidates[0]); i++) {
+            ouputParameters.sampleFormat = candidates[i].format;
+            if (Pa_IsFormatSupported(NULL, &ouputParameters, info->defaultSampleRate) == paFormatIsSupported)
+                formats |= candidates[i].mask;
+        }
+    }
+    Pa_Terminate();
+
+    OS_LOGD(TAG, "Supported formats: 0x%x", formats);
+    return formats != 0 ? formats : SINK_FORMAT_S16LE;
+}
@@ -202,3 +202,8 @@ void wave_wrapper_close(sink_handle_t handle)
     fclose(priv->file);
     OS_FREE(priv);
 }
+
+int wave_wrapper_formats(void *priv_data)
+{
+    return SINK_FORMAT_S16LE | SINK_FORMAT_S24LE | SINK_FORMAT_S32LE;
+}
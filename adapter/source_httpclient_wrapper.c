@@ -30,6 +30,7 @@
 struct httpclient_priv {
     const char          *url;
     char                 header_buf[HTTPCLIENT_HEADER_BUFFER_SIZE];
+    char                 range_header[64]; // referenced by client till the request is sent
     httpclient_t         client;
     httpclient_data_t    client_data;
     long long            content_pos;
@@ -40,7 +41,8 @@ struct httpclient_priv {
     int                  retrycount;
 };
 
-static int httpclient_wrapper_connect(source_handle_t handle)
+// Connection is taken from the keep-alive pool if @pooled, e.g. the next segment of HLS
+static int httpclient_wrapper_connect(source_handle_t handle, bool pooled)
 {
     struct httpclient_priv *priv = (struct httpclient_priv *)handle;
     HTTPCLIENT_RESULT ret = HTTPCLIENT_OK;
@@ -55,7 +57,10 @@ static int httpclient_wrapper_connect(source_handle_t handle)
     priv->first_response = false;
 
 reconnect:
-    ret = httpclient_connect(&priv->client, (char *)priv->url);
+    if (pooled)
+        ret = httpclient_connect_pooled(&priv->client, (char *)priv->url);
+    else
+        ret = httpclient_connect(&priv->client, (char *)priv->url);
     if (ret != HTTPCLIENT_OK) {
         OS_LOGE(TAG, "httpclient_connect failed, ret=%d, retry=%d", ret, priv->retrycount);
         if (priv->retrycount++ < HTTPCLIENT_RETRY_COUNT) {
@@ -103,7 +108,7 @@ source_handle_t httpclient_wrapper_open(const char *url, long long content_pos,
     priv->url = OS_STRDUP(url);
     priv->content_pos = content_pos;
     OS_LOGD(TAG, "Connecting url:%s, content_pos:%d", url, (int)content_pos);
-    if (httpclient_wrapper_connect(priv) != HTTPCLIENT_OK) {
+    if (httpclient_wrapper_connect(priv, true) != HTTPCLIENT_OK) {
         OS_FREE(priv->url);
         OS_FREE(priv);
         return NULL;
@@ -128,13 +133,17 @@ contiune_read:
 
     if (!priv->first_request) {
         if (priv->content_pos > 0) {
-            char tmp_buf[64] = {0};
-            snprintf(tmp_buf, sizeof(tmp_buf), "Range: bytes=%ld-\r\n", (long)priv->content_pos);
-            OS_LOGV(TAG, "Set http range: %s", tmp_buf);
-            httpclient_set_custom_header(client, tmp_buf);
+            snprintf(priv->range_header, sizeof(priv->range_header),
+                     "Range: bytes=%ld-\r\n", (long)priv->content_pos);
+            OS_LOGV(TAG, "Set http range: %s", priv->range_header);
+            httpclient_set_custom_header(client, priv->range_header);
         }
 
         ret = httpclient_send_request(client, url, HTTPCLIENT_GET, client_data);
+        if (ret < 0 && client->reused) {
+            OS_LOGD(TAG, "Pooled connection closed by server, ret=%d, reconnect", ret);
+            goto reconnect;
+        }
         if (ret < 0) {
             OS_LOGE(TAG, "httpclient_send_request failed, ret=%d, retry=%d", ret, priv->retrycount);
             if (priv->retrycount++ >= HTTPCLIENT_RETRY_COUNT)
@@ -152,6 +161,10 @@ contiune_read:
     }
 
     ret = httpclient_recv_response(client, client_data);
+    if (ret < 0 && client->reused && !priv->first_response) {
+        OS_LOGD(TAG, "Pooled connection closed by server, ret=%d, reconnect", ret);
+        goto reconnect;
+    }
     if (ret < 0) {
         OS_LOGE(TAG, "httpclient_recv_response failed, ret=%d, retry=%d", ret, priv->retrycount);
         if (priv->retrycount++ >= HTTPCLIENT_RETRY_COUNT)
@@ -191,7 +204,7 @@ contiune_read:
 
 reconnect:
     httpclient_wrapper_disconnect(priv);
-    ret = httpclient_wrapper_connect(priv);
+    ret = httpclient_wrapper_connect(priv, false);
     if (ret != HTTPCLIENT_OK) {
         OS_LOGE(TAG, "httpclient reconnect failed, ret=%d", ret);
         return ret;
@@ -221,7 +234,7 @@ int httpclient_wrapper_seek(source_handle_t handle, long offset)
     priv->content_pos = offset;
     httpclient_wrapper_disconnect(priv);
     os_thread_sleep_msec(50);
-    return httpclient_wrapper_connect(priv);
+    return httpclient_wrapper_connect(priv, true);
 }
 
 void httpclient_wrapper_close(source_handle_t handle)
@@ -229,7 +242,8 @@ void httpclient_wrapper_close(source_handle_t handle)
     struct httpclient_priv *priv = (struct httpclient_priv *)handle;
 
     OS_LOGD(TAG, "Closing http client");
-    httpclient_close(&priv->client);
+    // keep the connection for the next request if the response is read completely
+    httpclient_release(&priv->client, &priv->client_data);
     OS_FREE(priv->url);
     OS_FREE(priv);
     OS_LOGV(TAG, "Closed http client");
@@ -94,6 +94,7 @@ static int basic_demo(const char *url)
         .open = alsa_wrapper_open,
         .write = alsa_wrapper_write,
         .close = alsa_wrapper_close,
+        .formats = alsa_wrapper_formats,
     };
 #elif defined(HAVE_PORT_AUDIO_ENABLED)
     struct sink_wrapper sink_ops = {
@@ -102,6 +103,7 @@ static int basic_demo(const char *url)
         .open = portaudio_wrapper_open,
         .write = portaudio_wrapper_write,
         .close = portaudio_wrapper_close,
+        .formats = portaudio_wrapper_formats,
     };
 #else
     struct sink_wrapper sink_ops = {
@@ -110,6 +112,7 @@ static int basic_demo(const char *url)
         .open = wave_wrapper_open,
         .write = wave_wrapper_write,
         .close = wave_wrapper_close,
+        .formats = wave_wrapper_formats,
     };
 #endif
     liteplayer_register_sink_wrapper(player, &sink_ops);
@@ -0,0 +1,221 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Decode the same file with N concurrent players into a null sink, in thread mode
+// (threads per player) and in executor mode (shared worker pool), and compare the
+// throughput in seconds of audio decoded per wall-clock second.
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osal/os_thread.h"
+#include "osal/os_time.h"
+#include "cutils/memory_helper.h"
+#include "cutils/log_helper.h"
+#include "cutils/executor.h"
+#include "liteplayer_main.h"
+#include "source_file_wrapper.h"
+
+#define TAG "executor_bench"
+
+#define MAX_STREAMS 64
+
+struct bench_stream {
+    liteplayer_handle_t player;
+    struct sink_wrapper sink_ops;
+    enum liteplayer_state state;
+    long long bytes;
+    int bytes_per_sec;
+};
+
+static os_mutex g_bench_lock;
+static os_cond g_bench_cond;
+
+static int bench_state_listener(enum liteplayer_state state, int errcode, void *priv)
+{
+    struct bench_stream *stream = (struct bench_stream *)priv;
+    if (state == LITEPLAYER_NEARLYCOMPLETED)
+        return 0;
+    if (state == LITEPLAYER_ERROR)
+        OS_LOGE(TAG, "-->LITEPLAYER_ERROR: %d", errcode);
+    os_mutex_lock(g_bench_lock);
+    stream->state = state;
+    os_cond_broadcast(g_bench_cond);
+    os_mutex_unlock(g_bench_lock);
+    return 0;
+}
+
+static const char *null_sink_name()
+{
+    return "null";
+}
+
+static sink_handle_t null_sink_open(int samplerate, int channels, int bits, void *priv_data)
+{
+    struct bench_stream *stream = (struct bench_stream *)priv_data;
+    stream->bytes_per_sec = samplerate * channels * bits / 8;
+    return (sink_handle_t)stream;
+}
+
+static int null_sink_write(sink_handle_t handle, char *buffer, int size)
+{
+    struct bench_stream *stream = (struct bench_stream *)handle;
+    stream->bytes += size;
+    return size;
+}
+
+static void null_sink_close(sink_handle_t handle)
+{
+}
+
+static struct source_wrapper g_file_ops = {
+    .async_mode = false,
+    .buffer_size = 16*1024,
+    .priv_data = NULL,
+    .url_protocol = file_wrapper_url_protocol,
+    .open = file_wrapper_open,
+    .read = file_wrapper_read,
+    .content_pos = file_wrapper_content_pos,
+    .content_len = file_wrapper_content_len,
+    .seek = file_wrapper_seek,
+    .close = file_wrapper_close,
+};
+
+static int bench_thread_count()
+{
+    int threads = -1;
+    FILE *fp = fopen("/proc/self/status", "r");
+    if (fp != NULL) {
+        char line[128];
+        while (fgets(line, sizeof(line), fp) != NULL) {
+            if (strncmp(line, "Threads:", 8) == 0) {
+                threads = atoi(line + 8);
+                break;
+            }
+        }
+        fclose(fp);
+    }
+    return threads;
+}
+
+static bool bench_wait_state(struct bench_stream *streams, int count, enum liteplayer_state state)
+{
+    bool ok = true;
+    os_mutex_lock(g_bench_lock);
+    for (int i = 0; i < count; i++) {
+        while (streams[i].state != state && streams[i].state != LITEPLAYER_ERROR)
+            os_cond_wait(g_bench_cond, g_bench_lock);
+        if (streams[i].state == LITEPLAYER_ERROR)
+            ok = false;
+    }
+    os_mutex_unlock(g_bench_lock);
+    return ok;
+}
+
+static int bench_run(const char *url, int count, executor_handle executor)
+{
+    struct bench_stream *streams = OS_CALLOC(count, sizeof(struct bench_stream));
+    if (streams == NULL)
+        return -1;
+
+    int ret = -1, threads = 0;
+    for (int i = 0; i < count; i++) {
+        struct bench_stream *stream = &streams[i];
+        stream->player = liteplayer_create();
+        if (stream->player == NULL)
+            goto bench_out;
+        stream->sink_ops.priv_data = stream;
+        stream->sink_ops.name = null_sink_name;
+        stream->sink_ops.open = null_sink_open;
+        stream->sink_ops.write = null_sink_write;
+        stream->sink_ops.close = null_sink_close;
+        liteplayer_register_sink_wrapper(stream->player, &stream->sink_ops);
+        liteplayer_register_source_wrapper(stream->player, &g_file_ops);
+        liteplayer_register_state_listener(stream->player, bench_state_listener, stream);
+        if (executor != NULL)
+            liteplayer_set_executor(stream->player, executor);
+        if (liteplayer_set_data_source(stream->player, url) != 0 ||
+            liteplayer_prepare(stream->player) != 0) {
+            OS_LOGE(TAG, "Failed to prepare player");
+            goto bench_out;
+        }
+    }
+
+    unsigned long long begin = os_monotonic_usec();
+    for (int i = 0; i < count; i++) {
+        if (liteplayer_start(streams[i].player) != 0)
+            goto bench_out;
+    }
+    threads = bench_thread_count();
+    if (!bench_wait_state(streams, count, LITEPLAYER_COMPLETED))
+        goto bench_out;
+    unsigned long long elapsed = os_monotonic_usec() - begin;
+
+    double audio_sec = 0;
+    for (int i = 0; i < count; i++) {
+        if (streams[i].bytes_per_sec > 0)
+            audio_sec += (double)streams[i].bytes / streams[i].bytes_per_sec;
+    }
+    printf("%-8s streams=%-3d threads=%-4d wall=%8.1fms audio=%8.1fs throughput=%8.1fx\n",
+           executor != NULL ? "executor" : "thread", count, threads,
+           elapsed / 1000.0, audio_sec, audio_sec * 1000000 / elapsed);
+    ret = 0;
+
+bench_out:
+    for (int i = 0; i < count; i++) {
+        if (streams[i].player == NULL)
+            continue;
+        liteplayer_stop(streams[i].player);
+        liteplayer_reset(streams[i].player);
+        liteplayer_destroy(streams[i].player);
+    }
+    OS_FREE(streams);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        OS_LOGW(TAG, "Usage: %s [url] [max_streams] [workers]", argv[0]);
+        return -1;
+    }
+
+    int max_streams = argc > 2 ? atoi(argv[2]) : 16;
+    unsigned int workers = argc > 3 ? (unsigned int)atoi(argv[3]) : 0;
+    if (max_streams <= 0 || max_streams > MAX_STREAMS)
+        max_streams = MAX_STREAMS;
+
+    g_bench_lock = os_mutex_create();
+    g_bench_cond = os_cond_create();
+    executor_handle executor = executor_create(NULL, workers);
+    if (g_bench_lock == NULL || g_bench_cond == NULL || executor == NULL) {
+        OS_LOGE(TAG, "Failed to create bench resources");
+        return -1;
+    }
+    printf("cpus=%u workers=%u\n", os_cpu_count(), executor_worker_count(executor));
+
+    int ret = 0;
+    for (int count = 1; count <= max_streams && ret == 0; count *= 2) {
+        ret = bench_run(argv[1], count, NULL);
+        if (ret == 0)
+            ret = bench_run(argv[1], count, executor);
+    }
+
+    executor_destroy(executor);
+    os_cond_destroy(g_bench_cond);
+    os_mutex_destroy(g_bench_lock);
+    return ret;
+}
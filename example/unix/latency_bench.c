@@ -0,0 +1,594 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measure the control path latencies of file, static and local http sources, over many
+// iterations, with a null sink that timestamps the writes and plays at @speed times
+// real-time, and print their distributions:
+//   ttfa:  liteplayer_set_data_source() to the first sink write, prepare and start included
+//   seek:  liteplayer_seek() while playing, to the first sink write after restarting
+//   stop:  time blocked in liteplayer_stop()
+//   reset: time blocked in liteplayer_reset()
+//   gap:   sink idle time at a track switch of listplayer, that loops a playlist of the
+//          file for @tracks tracks, taken as the largest idle intervals, one per switch
+// With -a, players allocate track-scoped memory from an arena of @arena bytes, and its
+// watermark after all iterations is printed, see liteplayer_set_arena_size().
+//
+// Usage: latency_bench [-n iterations] [-s speed] [-t tracks] [-a arena] [file]
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "osal/os_thread.h"
+#include "osal/os_time.h"
+#include "cutils/memory_helper.h"
+#include "cutils/log_helper.h"
+#include "liteplayer_main.h"
+#include "liteplayer_listplayer.h"
+#include "source_file_wrapper.h"
+#include "source_static_wrapper.h"
+#include "source_httpclient_wrapper.h"
+
+#define TAG "latency_bench"
+
+#define BENCH_SEEK_MS           ( 1000 )
+#define BENCH_PLAY_MS           ( 50 )   // played before seek, and after it before stop
+#define BENCH_TIMEOUT_MS        ( 5000 )
+
+struct bench_sink {
+    os_mutex lock;
+    os_cond cond;
+    enum liteplayer_state state;
+    int bytes_per_sec;
+    int speed;
+    bool armed;
+    unsigned long long armed_usec;
+    unsigned long long first_write_usec;  // first write since armed
+    unsigned long long last_end_usec;     // end of previous write
+    unsigned long long *idles;            // idle time before each write, for gaps
+    int idle_count;
+    int idle_max;
+};
+
+struct bench_samples {
+    const char *name;
+    unsigned long long *usec;
+    int count;
+};
+
+static struct bench_sink g_sink;
+
+static int bench_state_listener(enum liteplayer_state state, int errcode, void *priv)
+{
+    if (state == LITEPLAYER_NEARLYCOMPLETED)
+        return 0;
+    if (state == LITEPLAYER_ERROR)
+        OS_LOGE(TAG, "-->LITEPLAYER_ERROR: %d", errcode);
+    os_mutex_lock(g_sink.lock);
+    g_sink.state = state;
+    os_cond_broadcast(g_sink.cond);
+    os_mutex_unlock(g_sink.lock);
+    return 0;
+}
+
+static const char *null_sink_name()
+{
+    return "null";
+}
+
+static sink_handle_t null_sink_open(int samplerate, int channels, int bits, void *priv_data)
+{
+    struct bench_sink *sink = (struct bench_sink *)priv_data;
+    os_mutex_lock(sink->lock);
+    sink->bytes_per_sec = samplerate * channels * bits / 8;
+    os_mutex_unlock(sink->lock);
+    return (sink_handle_t)sink;
+}
+
+static int null_sink_write(sink_handle_t handle, char *buffer, int size)
+{
+    struct bench_sink *sink = (struct bench_sink *)handle;
+    unsigned long long now = os_monotonic_usec();
+    os_mutex_lock(sink->lock);
+    if (sink->armed && sink->first_write_usec == 0) {
+        sink->first_write_usec = now;
+        os_cond_broadcast(sink->cond);
+    }
+    if (sink->last_end_usec != 0 && sink->idle_count < sink->idle_max)
+        sink->idles[sink->idle_count++] = now - sink->last_end_usec;
+    long long play_usec = (long long)size * 1000000 / sink->bytes_per_sec / sink->speed;
+    os_mutex_unlock(sink->lock);
+
+    os_thread_sleep_usec(play_usec);
+
+    os_mutex_lock(sink->lock);
+    sink->last_end_usec = os_monotonic_usec();
+    os_mutex_unlock(sink->lock);
+    return size;
+}
+
+static void null_sink_close(sink_handle_t handle)
+{
+}
+
+static struct sink_wrapper g_sink_ops = {
+    .priv_data = &g_sink,
+    .name = null_sink_name,
+    .open = null_sink_open,
+    .write = null_sink_write,
+    .close = null_sink_close,
+};
+
+static struct source_wrapper g_file_ops = {
+    .async_mode = false,
+    .buffer_size = 16*1024,
+    .priv_data = NULL,
+    .url_protocol = file_wrapper_url_protocol,
+    .open = file_wrapper_open,
+    .read = file_wrapper_read,
+    .content_pos = file_wrapper_content_pos,
+    .content_len = file_wrapper_content_len,
+    .seek = file_wrapper_seek,
+    .close = file_wrapper_close,
+};
+
+static struct source_wrapper g_static_ops = {
+    .async_mode = false,
+    .buffer_size = 16*1024,
+    .priv_data = NULL,
+    .url_protocol = static_wrapper_url_protocol,
+    .open = static_wrapper_open,
+    .read = static_wrapper_read,
+    .content_pos = static_wrapper_content_pos,
+    .content_len = static_wrapper_content_len,
+    .seek = static_wrapper_seek,
+    .close = static_wrapper_close,
+};
+
+static struct source_wrapper g_http_ops = {
+    .async_mode = true,
+    .buffer_size = 256*1024,
+    .priv_data = NULL,
+    .url_protocol = httpclient_wrapper_url_protocol,
+    .open = httpclient_wrapper_open,
+    .read = httpclient_wrapper_read,
+    .content_pos = httpclient_wrapper_content_pos,
+    .content_len = httpclient_wrapper_content_len,
+    .seek = httpclient_wrapper_seek,
+    .close = httpclient_wrapper_close,
+};
+
+// Local http stand-in: serves the file in memory on loopback, with range requests,
+// one thread per connection, so the http source path is measured without network
+struct bench_http_server {
+    int listen_fd;
+    int port;
+    const char *content;
+    long content_len;
+};
+
+struct bench_http_conn {
+    struct bench_http_server *server;
+    int fd;
+};
+
+static void *bench_http_conn_thread(void *arg)
+{
+    struct bench_http_conn *conn = (struct bench_http_conn *)arg;
+    char request[1024];
+    int len = 0;
+    while (len < (int)sizeof(request) - 1) {
+        int ret = recv(conn->fd, request + len, sizeof(request) - 1 - len, 0);
+        if (ret <= 0)
+            goto conn_out;
+        len += ret;
+        request[len] = '\0';
+        if (strstr(request, "\r\n\r\n") != NULL)
+            break;
+    }
+
+    long offset = 0;
+    const char *range = strstr(request, "Range: bytes=");
+    if (range != NULL)
+        offset = atol(range + strlen("Range: bytes="));
+    if (offset > conn->server->content_len)
+        offset = conn->server->content_len;
+
+    char header[256];
+    len = snprintf(header, sizeof(header),
+                   "HTTP/1.1 %s\r\nContent-Type: audio/mpeg\r\nContent-Length: %ld\r\nConnection: close\r\n\r\n",
+                   range != NULL ? "206 Partial Content" : "200 OK", conn->server->content_len - offset);
+    if (send(conn->fd, header, len, MSG_NOSIGNAL) != len)
+        goto conn_out;
+    const char *data = conn->server->content + offset;
+    long remain = conn->server->content_len - offset;
+    while (remain > 0) {
+        int ret = send(conn->fd, data, remain > 16*1024 ? 16*1024 : remain, MSG_NOSIGNAL);
+        if (ret <= 0)
+            break;
+        data += ret;
+        remain -= ret;
+    }
+
+conn_out:
+    close(conn->fd);
+    OS_FREE(conn);
+    return NULL;
+}
+
+static void *bench_http_server_thread(void *arg)
+{
+    struct bench_http_server *server = (struct bench_http_server *)arg;
+    while (1) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0)
+            break;
+        struct bench_http_conn *conn = OS_CALLOC(1, sizeof(struct bench_http_conn));
+        if (conn == NULL) {
+            close(fd);
+            continue;
+        }
+        conn->server = server;
+        conn->fd = fd;
+        struct os_thread_attr attr = {
+            .name = "bench_http_conn",
+            .priority = OS_THREAD_PRIO_NORMAL,
+            .stacksize = 16*1024,
+            .joinable = false,
+        };
+        if (os_thread_create(&attr, bench_http_conn_thread, conn) == NULL) {
+            close(fd);
+            OS_FREE(conn);
+        }
+    }
+    return NULL;
+}
+
+static int bench_http_server_start(struct bench_http_server *server)
+{
+    server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server->listen_fd < 0)
+        return -1;
+    struct sockaddr_in addr;
+    memset(&addr, 0x0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t addr_len = sizeof(addr);
+    if (bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(server->listen_fd, 16) != 0 ||
+        getsockname(server->listen_fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        close(server->listen_fd);
+        return -1;
+    }
+    server->port = ntohs(addr.sin_port);
+
+    struct os_thread_attr attr = {
+        .name = "bench_http_server",
+        .priority = OS_THREAD_PRIO_NORMAL,
+        .stacksize = 16*1024,
+        .joinable = false,
+    };
+    if (os_thread_create(&attr, bench_http_server_thread, server) == NULL) {
+        close(server->listen_fd);
+        return -1;
+    }
+    return 0;
+}
+
+static void bench_sink_arm()
+{
+    os_mutex_lock(g_sink.lock);
+    g_sink.armed = true;
+    g_sink.armed_usec = os_monotonic_usec();
+    g_sink.first_write_usec = 0;
+    os_mutex_unlock(g_sink.lock);
+}
+
+// Latency from arming to the first write, 0 if no write in time or player failed
+static unsigned long long bench_sink_wait_write()
+{
+    unsigned long long latency = 0;
+    os_mutex_lock(g_sink.lock);
+    while (g_sink.first_write_usec == 0 && g_sink.state != LITEPLAYER_ERROR) {
+        if (os_cond_timedwait(g_sink.cond, g_sink.lock, BENCH_TIMEOUT_MS*1000) != 0)
+            break;
+    }
+    if (g_sink.first_write_usec != 0)
+        latency = g_sink.first_write_usec - g_sink.armed_usec;
+    g_sink.armed = false;
+    os_mutex_unlock(g_sink.lock);
+    return latency;
+}
+
+static bool bench_wait_state(enum liteplayer_state state)
+{
+    bool ok = true;
+    os_mutex_lock(g_sink.lock);
+    while (g_sink.state != state && g_sink.state != LITEPLAYER_ERROR) {
+        if (os_cond_timedwait(g_sink.cond, g_sink.lock, BENCH_TIMEOUT_MS*1000) != 0)
+            break;
+    }
+    ok = g_sink.state == state;
+    os_mutex_unlock(g_sink.lock);
+    return ok;
+}
+
+static void bench_samples_add(struct bench_samples *samples, unsigned long long usec)
+{
+    samples->usec[samples->count++] = usec;
+}
+
+static int bench_usec_compare(const void *a, const void *b)
+{
+    unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void bench_samples_print(const char *source, struct bench_samples *samples)
+{
+    if (samples->count == 0) {
+        printf("%-6s %-5s n=0\n", source, samples->name);
+        return;
+    }
+    unsigned long long *usec = samples->usec;
+    int n = samples->count;
+    qsort(usec, n, sizeof(unsigned long long), bench_usec_compare);
+    unsigned long long sum = 0;
+    for (int i = 0; i < n; i++)
+        sum += usec[i];
+    printf("%-6s %-5s n=%-4d min=%8.2fms p50=%8.2fms p90=%8.2fms p99=%8.2fms max=%8.2fms mean=%8.2fms\n",
+           source, samples->name, n, usec[0] / 1000.0, usec[n*50/100] / 1000.0,
+           usec[n*90/100] / 1000.0, usec[(n*99)/100] / 1000.0, usec[n-1] / 1000.0,
+           (double)sum / n / 1000.0);
+}
+
+static int g_arena_size;
+
+static int bench_player(const char *source, const char *url, int iterations)
+{
+    struct bench_samples ttfa = { "ttfa" }, seek = { "seek" }, stop = { "stop" }, reset = { "reset" };
+    struct bench_samples *all[] = { &ttfa, &seek, &stop, &reset };
+    for (int i = 0; i < sizeof(all)/sizeof(all[0]); i++) {
+        all[i]->usec = OS_CALLOC(iterations, sizeof(unsigned long long));
+        if (all[i]->usec == NULL)
+            return -1;
+    }
+
+    int ret = 0;
+    liteplayer_handle_t player = liteplayer_create();
+    if (player == NULL)
+        return -1;
+    liteplayer_register_sink_wrapper(player, &g_sink_ops);
+    liteplayer_register_source_wrapper(player, &g_file_ops);
+    liteplayer_register_source_wrapper(player, &g_static_ops);
+    liteplayer_register_source_wrapper(player, &g_http_ops);
+    liteplayer_register_state_listener(player, bench_state_listener, NULL);
+    if (liteplayer_set_arena_size(player, g_arena_size) != 0) {
+        liteplayer_destroy(player);
+        return -1;
+    }
+
+    for (int i = 0; i < iterations; i++) {
+        os_mutex_lock(g_sink.lock);
+        g_sink.state = LITEPLAYER_IDLE;
+        os_mutex_unlock(g_sink.lock);
+        bench_sink_arm();
+        if (liteplayer_set_data_source(player, url) != 0 ||
+            liteplayer_prepare(player) != 0 ||
+            liteplayer_start(player) != 0) {
+            OS_LOGE(TAG, "Failed to start %s", url);
+            ret = -1;
+            break;
+        }
+        unsigned long long latency = bench_sink_wait_write();
+        if (latency > 0)
+            bench_samples_add(&ttfa, latency);
+
+        os_thread_sleep_msec(BENCH_PLAY_MS);
+        bench_sink_arm();
+        // player is paused by seek, started again as listplayer does
+        if (liteplayer_seek(player, BENCH_SEEK_MS) == 0 && liteplayer_start(player) == 0) {
+            latency = bench_sink_wait_write();
+            if (latency > 0)
+                bench_samples_add(&seek, latency);
+        }
+
+        os_thread_sleep_msec(BENCH_PLAY_MS);
+        unsigned long long begin = os_monotonic_usec();
+        liteplayer_stop(player);
+        bench_samples_add(&stop, os_monotonic_usec() - begin);
+        begin = os_monotonic_usec();
+        liteplayer_reset(player);
+        bench_samples_add(&reset, os_monotonic_usec() - begin);
+    }
+    struct liteplayer_stats stats;
+    liteplayer_get_stats(player, &stats);
+    liteplayer_destroy(player);
+
+    for (int i = 0; i < sizeof(all)/sizeof(all[0]); i++) {
+        bench_samples_print(source, all[i]);
+        OS_FREE(all[i]->usec);
+    }
+    if (stats.arena_size > 0)
+        printf("%-6s arena size=%d watermark=%d fallbacks=%d\n",
+               source, stats.arena_size, stats.arena_watermark, stats.arena_fallbacks);
+    return ret;
+}
+
+static int bench_listplayer(const char *source, const char *url, int lists, int tracks)
+{
+    struct bench_samples gap = { "gap" };
+    gap.usec = OS_CALLOC(lists * (tracks - 1), sizeof(unsigned long long));
+    g_sink.idle_max = 64*1024;
+    g_sink.idles = OS_CALLOC(g_sink.idle_max, sizeof(unsigned long long));
+    if (gap.usec == NULL || g_sink.idles == NULL)
+        return -1;
+
+    const char *playlist = "latency_bench.playlist";
+    FILE *fp = fopen(playlist, "w");
+    if (fp == NULL)
+        return -1;
+    fprintf(fp, "%s\n", url);
+    fclose(fp);
+
+    int ret = 0;
+    struct listplayer_cfg cfg = DEFAULT_LISTPLAYER_CFG();
+    listplayer_handle_t player = listplayer_create(&cfg);
+    if (player == NULL)
+        return -1;
+    listplayer_register_sink_wrapper(player, &g_sink_ops);
+    listplayer_register_source_wrapper(player, &g_file_ops);
+    listplayer_register_source_wrapper(player, &g_static_ops);
+    listplayer_register_source_wrapper(player, &g_http_ops);
+    listplayer_register_state_listener(player, bench_state_listener, NULL);
+    if (listplayer_set_arena_size(player, g_arena_size) != 0) {
+        listplayer_destroy(player);
+        return -1;
+    }
+
+    for (int i = 0; i < lists; i++) {
+        os_mutex_lock(g_sink.lock);
+        g_sink.state = LITEPLAYER_IDLE;
+        g_sink.idle_count = 0;
+        g_sink.last_end_usec = 0;
+        os_mutex_unlock(g_sink.lock);
+
+        // playlist is looped endlessly, so stop it in the middle of the last track
+        int duration = 0;
+        if (listplayer_set_data_source(player, playlist) != 0 ||
+            listplayer_prepare_async(player) != 0 ||
+            !bench_wait_state(LITEPLAYER_PREPARED) ||
+            listplayer_get_duration(player, &duration) != 0 ||
+            listplayer_start(player) != 0) {
+            OS_LOGE(TAG, "Failed to play %s", playlist);
+            ret = -1;
+        } else {
+            os_thread_sleep_usec((unsigned long)((tracks - 0.5) * duration * 1000 / g_sink.speed));
+            if (g_sink.state == LITEPLAYER_ERROR)
+                ret = -1;
+        }
+        // stop and reset are posted to the looper, wait till they're done before next list
+        listplayer_stop(player);
+        listplayer_reset(player);
+        if (ret == 0 && !bench_wait_state(LITEPLAYER_IDLE))
+            ret = -1;
+        if (ret != 0)
+            break;
+
+        // a write takes ~4KB of audio, so idle time within a track is far below a switch
+        os_mutex_lock(g_sink.lock);
+        qsort(g_sink.idles, g_sink.idle_count, sizeof(unsigned long long), bench_usec_compare);
+        for (int j = 0; j < tracks - 1 && j < g_sink.idle_count; j++)
+            bench_samples_add(&gap, g_sink.idles[g_sink.idle_count - 1 - j]);
+        os_mutex_unlock(g_sink.lock);
+    }
+    listplayer_destroy(player);
+    unlink(playlist);
+
+    bench_samples_print(source, &gap);
+    OS_FREE(gap.usec);
+    OS_FREE(g_sink.idles);
+    g_sink.idle_max = 0;
+    return ret;
+}
+
+static char *bench_load_file(const char *path, long *len)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return NULL;
+    fseek(fp, 0, SEEK_END);
+    *len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *content = OS_MALLOC(*len);
+    if (content != NULL && fread(content, 1, *len, fp) != (size_t)*len) {
+        OS_FREE(content);
+        content = NULL;
+    }
+    fclose(fp);
+    return content;
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = 200, speed = 50, tracks = 8;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:t:a:")) != -1) {
+        switch (opt) {
+        case 'n': iterations = atoi(optarg); break;
+        case 's': speed = atoi(optarg); break;
+        case 't': tracks = atoi(optarg); break;
+        case 'a': g_arena_size = atoi(optarg); break;
+        default:
+            OS_LOGW(TAG, "Usage: %s [-n iterations] [-s speed] [-t tracks] [-a arena] [file]", argv[0]);
+            return -1;
+        }
+    }
+    const char *file = optind < argc ? argv[optind] : "test.mp3";
+    if (iterations <= 0 || speed <= 0 || tracks < 2 || g_arena_size < 0) {
+        OS_LOGE(TAG, "Invalid arguments");
+        return -1;
+    }
+
+    struct bench_http_server server;
+    memset(&server, 0x0, sizeof(server));
+    server.content = bench_load_file(file, &server.content_len);
+    if (server.content == NULL) {
+        OS_LOGE(TAG, "Failed to load %s", file);
+        return -1;
+    }
+    if (bench_http_server_start(&server) != 0) {
+        OS_LOGE(TAG, "Failed to start http server");
+        return -1;
+    }
+
+    g_sink.lock = os_mutex_create();
+    g_sink.cond = os_cond_create();
+    g_sink.speed = speed;
+    if (g_sink.lock == NULL || g_sink.cond == NULL) {
+        OS_LOGE(TAG, "Failed to create bench resources");
+        return -1;
+    }
+
+    const char *base = strrchr(file, '/');
+    base = base != NULL ? base + 1 : file;
+    char static_url[128], http_url[256];
+    snprintf(static_url, sizeof(static_url), "static://base=%p&length=0x%x",
+             server.content, (unsigned int)server.content_len);
+    snprintf(http_url, sizeof(http_url), "http://127.0.0.1:%d/%s", server.port, base);
+    const char *sources[][2] = {
+        { "file",   file },
+        { "static", static_url },
+        { "http",   http_url },
+    };
+
+    printf("file=%s iterations=%d speed=%dx tracks=%d\n", file, iterations, speed, tracks);
+    int ret = 0;
+    for (int i = 0; i < sizeof(sources)/sizeof(sources[0]) && ret == 0; i++) {
+        ret = bench_player(sources[i][0], sources[i][1], iterations);
+        if (ret == 0)
+            ret = bench_listplayer(sources[i][0], sources[i][1], (iterations + 9) / 10, tracks);
+    }
+
+    // http server threads are left to process exit
+    os_cond_destroy(g_sink.cond);
+    os_mutex_destroy(g_sink.lock);
+    return ret;
+}
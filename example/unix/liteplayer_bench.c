@@ -0,0 +1,1084 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Decode a corpus into a null sink, one player at a time, and report per file the decoded
+// frames per second, real-time factor, peak heap and a hash of the output pcm, which is
+// checked against the golden file so that codec changes are measured and bit-exact.
+// WAV, MP3, AAC and M4A files of several samplerates, channels and bitrates are generated,
+// HE-AAC included, the bundled samples and any files given in command line are added. If
+// built with LITEPLAYER_CONFIG_AAC_PLUS, every AAC file runs twice, with SBR decoded and
+// without, see liteplayer_set_aac_plus(), the former named with a "+sbr" suffix.
+//
+// Usage: liteplayer_bench [-g golden_file] [-u] [url...]
+//   -g: golden hashes, "bench_golden.txt" by default
+//   -u: update golden file with the hashes of this run instead of checking them
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "osal/os_thread.h"
+#include "osal/os_time.h"
+#include "osal/os_memory.h"
+#include "cutils/memory_helper.h"
+#include "cutils/log_helper.h"
+#include "liteplayer_main.h"
+#include "source_file_wrapper.h"
+
+#define TAG "liteplayer_bench"
+
+#define BENCH_GOLDEN_FILE   "bench_golden.txt"
+#define BENCH_MAX_ENTRIES   128
+#define BENCH_WAV_SECONDS   4
+#define BENCH_COMPRESSED_SECONDS 4
+
+struct bench_entry {
+    char name[64];
+    char url[256];
+    bool aac_plus;
+};
+
+struct bench_result {
+    enum liteplayer_state state;
+    int bytes_per_sec;
+    long long bytes;
+    unsigned long long hash;
+    int frames;
+    double frames_per_sec;
+    double realtime_factor;
+    double speed;
+    long long heap_peak;
+};
+
+struct bench_golden {
+    char name[64];
+    unsigned long long hash;
+};
+
+static os_mutex g_bench_lock;
+static os_cond g_bench_cond;
+
+// Heap accounting through the os_malloc hooks, every block carries its size in front
+#define BENCH_HEAP_HEADER   16
+
+static atomic_llong g_heap_used;
+static atomic_llong g_heap_peak;
+
+static void bench_heap_account(long long delta)
+{
+    long long used = atomic_fetch_add(&g_heap_used, delta) + delta;
+    long long peak = atomic_load(&g_heap_peak);
+    while (used > peak && !atomic_compare_exchange_weak(&g_heap_peak, &peak, used));
+}
+
+static void *bench_heap_malloc(unsigned int size)
+{
+    char *block = malloc(BENCH_HEAP_HEADER + size);
+    if (block == NULL)
+        return NULL;
+    *(unsigned int *)block = size;
+    bench_heap_account(size);
+    return block + BENCH_HEAP_HEADER;
+}
+
+static void *bench_heap_calloc(unsigned int n, unsigned int size)
+{
+    void *ptr = bench_heap_malloc(n * size);
+    if (ptr != NULL)
+        memset(ptr, 0x0, n * size);
+    return ptr;
+}
+
+static void bench_heap_free(void *ptr)
+{
+    if (ptr == NULL)
+        return;
+    char *block = (char *)ptr - BENCH_HEAP_HEADER;
+    bench_heap_account(-(long long)*(unsigned int *)block);
+    free(block);
+}
+
+static void *bench_heap_realloc(void *ptr, unsigned int size)
+{
+    if (ptr == NULL)
+        return bench_heap_malloc(size);
+    char *block = (char *)ptr - BENCH_HEAP_HEADER;
+    unsigned int old_size = *(unsigned int *)block;
+    block = realloc(block, BENCH_HEAP_HEADER + size);
+    if (block == NULL)
+        return NULL;
+    *(unsigned int *)block = size;
+    bench_heap_account((long long)size - old_size);
+    return block + BENCH_HEAP_HEADER;
+}
+
+static const struct os_memory_hooks g_bench_heap_hooks = {
+    .malloc = bench_heap_malloc,
+    .calloc = bench_heap_calloc,
+    .realloc = bench_heap_realloc,
+    .free = bench_heap_free,
+};
+
+static int bench_state_listener(enum liteplayer_state state, int errcode, void *priv)
+{
+    struct bench_result *result = (struct bench_result *)priv;
+    if (state == LITEPLAYER_NEARLYCOMPLETED)
+        return 0;
+    if (state == LITEPLAYER_ERROR)
+        OS_LOGE(TAG, "-->LITEPLAYER_ERROR: %d", errcode);
+    os_mutex_lock(g_bench_lock);
+    result->state = state;
+    os_cond_broadcast(g_bench_cond);
+    os_mutex_unlock(g_bench_lock);
+    return 0;
+}
+
+static const char *null_sink_name()
+{
+    return "null";
+}
+
+// Accept every output format so 24/32-bit sources run through their own pcm paths
+static int null_sink_formats(void *priv_data)
+{
+    return SINK_FORMAT_S16LE | SINK_FORMAT_S24LE | SINK_FORMAT_S32LE;
+}
+
+static sink_handle_t null_sink_open(int samplerate, int channels, int bits, void *priv_data)
+{
+    struct bench_result *result = (struct bench_result *)priv_data;
+    result->bytes_per_sec = samplerate * channels * bits / 8;
+    return (sink_handle_t)result;
+}
+
+// FNV-1a over the pcm stream, independent of how it is split into writes
+static int null_sink_write(sink_handle_t handle, char *buffer, int size)
+{
+    struct bench_result *result = (struct bench_result *)handle;
+    unsigned long long hash = result->hash;
+    for (int i = 0; i < size; i++) {
+        hash ^= (unsigned char)buffer[i];
+        hash *= 0x100000001b3ULL;
+    }
+    result->hash = hash;
+    result->bytes += size;
+    return size;
+}
+
+static void null_sink_close(sink_handle_t handle)
+{
+}
+
+static struct source_wrapper g_file_ops = {
+    .async_mode = false,
+    .buffer_size = 16*1024,
+    .priv_data = NULL,
+    .url_protocol = file_wrapper_url_protocol,
+    .open = file_wrapper_open,
+    .read = file_wrapper_read,
+    .content_pos = file_wrapper_content_pos,
+    .content_len = file_wrapper_content_len,
+    .seek = file_wrapper_seek,
+    .close = file_wrapper_close,
+};
+
+static void bench_put_le(FILE *fp, unsigned int val, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        fputc((val >> (8*i)) & 0xFF, fp);
+}
+
+// Integer synthesis only, so the corpus and its golden hashes are the same on all hosts:
+// a triangle wave per channel at different pitches plus a little noise
+static int bench_generate_wav(const char *path, int samplerate, int channels, int bits)
+{
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        OS_LOGE(TAG, "Failed to create %s", path);
+        return -1;
+    }
+
+    int frames = samplerate * BENCH_WAV_SECONDS;
+    int block_align = channels * bits / 8;
+    int data_size = frames * block_align;
+    fwrite("RIFF", 1, 4, fp);
+    bench_put_le(fp, 36 + data_size, 4);
+    fwrite("WAVEfmt ", 1, 8, fp);
+    bench_put_le(fp, 16, 4);
+    bench_put_le(fp, 1, 2);
+    bench_put_le(fp, channels, 2);
+    bench_put_le(fp, samplerate, 4);
+    bench_put_le(fp, samplerate * block_align, 4);
+    bench_put_le(fp, block_align, 2);
+    bench_put_le(fp, bits, 2);
+    fwrite("data", 1, 4, fp);
+    bench_put_le(fp, data_size, 4);
+
+    unsigned int seed = 0x12345678;
+    for (int i = 0; i < frames; i++) {
+        for (int ch = 0; ch < channels; ch++) {
+            int period = samplerate / (220 * (ch + 1));
+            int phase = i % period;
+            int tri = phase < period/2 ? phase*4*16384/period - 16384 : 3*16384 - phase*4*16384/period;
+            seed = seed * 1103515245 + 12345;
+            int sample = tri + (int)((seed >> 16) & 0x3FF) - 0x200; // 16-bit range
+            if (bits == 32)
+                bench_put_le(fp, (unsigned int)(sample * 65536 + (int)(seed & 0xFFFF)), 4);
+            else if (bits == 24)
+                bench_put_le(fp, (unsigned int)(sample * 256 + (int)((seed >> 8) & 0xFF)), 3);
+            else
+                bench_put_le(fp, (unsigned int)sample, 2);
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+// Compressed streams are synthesized here too, no encoder is needed to build the corpus.
+// Only the simplest tools of each format are coded, enough to run the full decode path:
+// huffman decoding, requantization, imdct and synthesis, and SBR for HE-AAC.
+struct bench_bits {
+    unsigned char *buf; // zeroed, NULL to count bits only
+    int size;
+    int pos;            // bits written
+};
+
+static void bench_put_bits(struct bench_bits *bits, unsigned int val, int n)
+{
+    for (int i = n - 1; i >= 0; i--, bits->pos++) {
+        if (((val >> i) & 0x1) && bits->pos < bits->size * 8)
+            bits->buf[bits->pos >> 3] |= 0x80 >> (bits->pos & 0x7);
+    }
+}
+
+static unsigned int bench_rand(unsigned int *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return (*seed >> 16) & 0x7FFF;
+}
+
+static void bench_put_be(FILE *fp, unsigned int val, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; i--)
+        fputc((val >> (8*i)) & 0xFF, fp);
+}
+
+// MP3 layer III frames of the count1 region only, coded by table B: a quadruple of 0/1 lines
+// is 4 inverted bits plus a sign bit per 1, so no huffman table is needed. A few harmonics
+// plus sparse noise, as many lines as the bitrate fits, the rest of the frame is ancillary.
+static int bench_generate_mp3(const char *path, int samplerate, int channels, int kbps)
+{
+    static const int base_rates[] = { 44100, 48000, 32000 };
+    static const int versions[] = { 3, 2, 0 }; // MPEG-1, MPEG-2 and MPEG-2.5, rates halved each
+    static const int mpeg1_kbps[] = { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 };
+    static const int mpeg2_kbps[] = { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 };
+
+    int version = -1, rate_index = -1, bitrate_index = -1;
+    for (int v = 0; v < 3 && rate_index < 0; v++) {
+        for (int i = 0; i < 3; i++) {
+            if (base_rates[i] >> v == samplerate) {
+                version = v;
+                rate_index = i;
+                break;
+            }
+        }
+    }
+    for (int i = 1; i < 15 && version >= 0; i++) {
+        if ((version == 0 ? mpeg1_kbps[i] : mpeg2_kbps[i]) == kbps)
+            bitrate_index = i;
+    }
+    if (bitrate_index < 0 || channels < 1 || channels > 2) {
+        OS_LOGE(TAG, "Unsupported mp3 %dHz %dch %dkbps", samplerate, channels, kbps);
+        return -1;
+    }
+
+    bool lsf = version > 0;
+    int granules = lsf ? 1 : 2;
+    int frame_coef = lsf ? 72000 : 144000; // frame bytes are frame_coef*kbps/samplerate
+    int side_bytes = lsf ? (channels == 1 ? 9 : 17) : (channels == 1 ? 17 : 32);
+    int frames = samplerate * BENCH_COMPRESSED_SECONDS / (576 * granules);
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        OS_LOGE(TAG, "Failed to create %s", path);
+        return -1;
+    }
+
+    unsigned char frame[1536];
+    unsigned int seed = 0x2468ace0 + samplerate + channels;
+    int remainder = 0;
+    for (int f = 0; f < frames; f++) {
+        int frame_bytes = frame_coef * kbps / samplerate;
+        remainder += frame_coef * kbps % samplerate;
+        int padding = remainder >= samplerate;
+        if (padding)
+            remainder -= samplerate;
+        frame_bytes += padding;
+        memset(frame, 0x0, frame_bytes);
+
+        struct bench_bits side = { frame, frame_bytes, 0 };
+        bench_put_bits(&side, 0x7FF, 11);
+        bench_put_bits(&side, versions[version], 2);
+        bench_put_bits(&side, 0x1, 2);                      // layer III
+        bench_put_bits(&side, 0x1, 1);                      // no crc
+        bench_put_bits(&side, bitrate_index, 4);
+        bench_put_bits(&side, rate_index, 2);
+        bench_put_bits(&side, padding, 1);
+        bench_put_bits(&side, 0x0, 1);                      // private
+        bench_put_bits(&side, channels == 1 ? 0x3 : 0x0, 2); // mono or stereo
+        bench_put_bits(&side, 0x0, 6);                      // mode extension, copyright, original, emphasis
+        bench_put_bits(&side, 0x0, lsf ? 8 : 9);            // main_data_begin, no bit reservoir
+        bench_put_bits(&side, 0x0, lsf ? channels : (channels == 1 ? 5 : 3)); // private bits
+        if (!lsf)
+            bench_put_bits(&side, 0x0, 4 * channels);       // scfsi
+
+        struct bench_bits main_data = { frame, frame_bytes, (4 + side_bytes) * 8 };
+        int budget = (frame_bytes - 4 - side_bytes) * 8 / (granules * channels);
+        if (budget > 4095)
+            budget = 4095;
+        for (int gr = 0; gr < granules; gr++) {
+            for (int ch = 0; ch < channels; ch++) {
+                int begin = main_data.pos;
+                int tone = 8 + ((f * granules + gr) / 16 + ch * 5) % 40;
+                for (int line = 0; line < 576; line += 4) {
+                    int quad = 0, signs = 0, nsigns = 0;
+                    for (int k = 0; k < 4; k++) {
+                        int l = line + k;
+                        bool harmonic = l % tone == 0 && l > 0 && l <= 3 * tone;
+                        if (harmonic || (bench_rand(&seed) & 0x1) == 0) {
+                            quad |= 0x8 >> k;
+                            signs = (signs << 1) | (bench_rand(&seed) & 0x1);
+                            nsigns++;
+                        }
+                    }
+                    if (main_data.pos - begin + 4 + nsigns > budget)
+                        break;
+                    bench_put_bits(&main_data, ~quad & 0xF, 4);
+                    bench_put_bits(&main_data, signs, nsigns);
+                }
+                bench_put_bits(&side, main_data.pos - begin, 12); // part2_3_length
+                bench_put_bits(&side, 0x0, 9);                    // big_values
+                bench_put_bits(&side, 176 + (f + ch) % 8, 8);     // global_gain
+                bench_put_bits(&side, 0x0, lsf ? 9 : 4);          // scalefac_compress, no scalefactors
+                bench_put_bits(&side, 0x0, 1 + 15 + 4 + 3);       // window_switching_flag, table_select, regions
+                if (!lsf)
+                    bench_put_bits(&side, 0x0, 1);                // preflag
+                bench_put_bits(&side, 0x0, 1);                    // scalefac_scale
+                bench_put_bits(&side, 0x1, 1);                    // count1table_select, table B
+            }
+        }
+        fwrite(frame, 1, frame_bytes, fp);
+    }
+    fclose(fp);
+    return 0;
+}
+
+// AAC samplerates by sampling_frequency_index, and their long window scalefactor bands
+static const int bench_aac_rates[] = {
+    96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000
+};
+static const int bench_aac_bands[] = { 41, 41, 47, 49, 49, 51, 47, 47, 43, 43, 43, 40 };
+
+// Spectral codebook 7 of ISO 14496-3, unsigned pairs of 0..7, codeword and length by 8*x+y
+static const unsigned short bench_aac_cb7[64][2] = {
+    { 0x000, 1 }, { 0x005, 3 }, { 0x037, 6 }, { 0x074, 7 }, { 0x0f2, 8 }, { 0x1eb, 9 }, { 0x3ed, 10 }, { 0x7f7, 11 },
+    { 0x004, 3 }, { 0x00c, 4 }, { 0x035, 6 }, { 0x071, 7 }, { 0x0ec, 8 }, { 0x0ee, 8 }, { 0x1ee, 9 }, { 0x1f5, 9 },
+    { 0x036, 6 }, { 0x034, 6 }, { 0x072, 7 }, { 0x0ea, 8 }, { 0x0f1, 8 }, { 0x1e9, 9 }, { 0x1f3, 9 }, { 0x3f5, 10 },
+    { 0x073, 7 }, { 0x070, 7 }, { 0x0eb, 8 }, { 0x0f0, 8 }, { 0x1f1, 9 }, { 0x1f0, 9 }, { 0x3ec, 10 }, { 0x3fa, 10 },
+    { 0x0f3, 8 }, { 0x0ed, 8 }, { 0x1e8, 9 }, { 0x1ef, 9 }, { 0x3ef, 10 }, { 0x3f1, 10 }, { 0x3f9, 10 }, { 0x7fb, 11 },
+    { 0x1ed, 9 }, { 0x0ef, 8 }, { 0x1ea, 9 }, { 0x1f2, 9 }, { 0x3f3, 10 }, { 0x3f8, 10 }, { 0x7f9, 11 }, { 0x7fc, 11 },
+    { 0x3ee, 10 }, { 0x1ec, 9 }, { 0x1f4, 9 }, { 0x3f4, 10 }, { 0x3f7, 10 }, { 0x7f8, 11 }, { 0xffd, 12 }, { 0xffe, 12 },
+    { 0x7f6, 11 }, { 0x3f0, 10 }, { 0x3f2, 10 }, { 0x3f6, 10 }, { 0x7fa, 11 }, { 0x7fd, 11 }, { 0xffc, 12 }, { 0xfff, 12 },
+};
+
+#define BENCH_AAC_MAX_FRAME     1536
+
+struct bench_aac {
+    int rate_index;     // of the AAC core
+    int channels;
+    bool sbr;
+    int sbr_bands;      // envelope bands of the SBR header below at high frequency resolution
+    int sbr_noise_bands;
+};
+
+// Spectrum of a channel: a few harmonics plus sparse noise up to @noise_lines
+static void bench_aac_spectrum(signed char *spec, int frame, int ch, int noise_lines)
+{
+    static const signed char harmonics[] = { 7, 5, 3, 2 };
+    unsigned int seed = 0x13579bdf + frame * 2 + ch;
+    memset(spec, 0x0, 1024);
+    for (int i = 0; i < noise_lines; i++) {
+        unsigned int r = bench_rand(&seed);
+        if ((r & 0x1) == 0)
+            spec[i] = (r & 0x2) ? -1 : 1;
+    }
+    int tone = 12 + (frame / 16 + ch * 7) % 48;
+    for (int h = 0; h < 4; h++)
+        spec[(h + 1) * tone] = (frame & 0x1) ? -harmonics[h] : harmonics[h];
+}
+
+// individual_channel_stream of a long window: one section of codebook 7 over all bands and
+// every scalefactor equal to global_gain, so the dpcm deltas are all the 1 bit codeword of 0
+static void bench_aac_ics(struct bench_bits *bits, int bands, const signed char *spec, int global_gain)
+{
+    bench_put_bits(bits, global_gain, 8);
+    bench_put_bits(bits, 0x0, 1 + 2 + 1);   // ics_reserved_bit, ONLY_LONG_SEQUENCE, window_shape
+    bench_put_bits(bits, bands, 6);         // max_sfb
+    bench_put_bits(bits, 0x0, 1);           // predictor_data_present
+    bench_put_bits(bits, 7, 4);             // sect_cb
+    int len = bands;
+    for (; len >= 31; len -= 31)
+        bench_put_bits(bits, 31, 5);
+    bench_put_bits(bits, len, 5);
+    bench_put_bits(bits, 0x0, bands);       // scalefactor deltas
+    bench_put_bits(bits, 0x0, 3);           // no pulse, tns and gain control data
+    for (int i = 0; i < 1024; i += 2) {
+        int x = abs(spec[i]), y = abs(spec[i + 1]);
+        bench_put_bits(bits, bench_aac_cb7[8*x + y][0], bench_aac_cb7[8*x + y][1]);
+        if (x != 0)
+            bench_put_bits(bits, spec[i] < 0, 1);
+        if (y != 0)
+            bench_put_bits(bits, spec[i + 1] < 0, 1);
+    }
+}
+
+// sbr_extension_data of the channel element, header in every frame, one FIXFIX envelope of
+// high frequency resolution per channel, envelope and noise floor coded in frequency direction
+static void bench_aac_sbr(struct bench_bits *bits, struct bench_aac *aac, int frame)
+{
+    int channels = aac->channels;
+    bench_put_bits(bits, 0x1, 1);           // bs_header_flag
+    bench_put_bits(bits, 0x0, 1);           // bs_amp_res
+    bench_put_bits(bits, 5, 4);             // bs_start_freq
+    bench_put_bits(bits, 9, 4);             // bs_stop_freq
+    bench_put_bits(bits, 0x0, 3 + 2 + 2);   // bs_xover_band, reserved, no extra header
+    bench_put_bits(bits, 0x0, channels);    // bs_data_extra, and bs_coupling of channel pair
+    for (int ch = 0; ch < channels; ch++)
+        bench_put_bits(bits, 0x1, 2 + 2 + 1); // FIXFIX, one envelope, bs_freq_res high
+    for (int ch = 0; ch < channels; ch++)
+        bench_put_bits(bits, 0x0, 2);       // bs_df_env, bs_df_noise
+    for (int ch = 0; ch < channels; ch++)
+        bench_put_bits(bits, 0x0, 2 * aac->sbr_noise_bands); // bs_invf_mode
+    for (int ch = 0; ch < channels; ch++) {
+        bench_put_bits(bits, 24 + (frame + ch) % 8, 7);
+        for (int i = 1; i < aac->sbr_bands; i++)
+            bench_put_bits(bits, i & 0x1 ? 0x1 : 0x0, 2); // deltas -1 and 0, a falling envelope
+    }
+    for (int ch = 0; ch < channels; ch++) {
+        bench_put_bits(bits, 12, 5);
+        bench_put_bits(bits, 0x0, aac->sbr_noise_bands - 1);
+    }
+    bench_put_bits(bits, 0x0, channels);    // bs_add_harmonic_flag
+    bench_put_bits(bits, 0x0, 1);           // bs_extended_data
+}
+
+// raw_data_block: SCE or CPE without common window, SBR in a FIL element, filled up to
+// @frame_bytes by FIL elements so that the stream is of constant bitrate, then END
+static int bench_aac_block(unsigned char *block, struct bench_aac *aac, int frame, int frame_bytes)
+{
+    static signed char spec[2][1024];
+    int bands = bench_aac_bands[aac->rate_index];
+    int global_gain = 160 + frame % 8;
+    int sbr_bits = 0;
+    if (aac->sbr) {
+        struct bench_bits count = { NULL, 0, 0 };
+        bench_aac_sbr(&count, aac, frame);
+        sbr_bits = count.pos;
+    }
+    int sbr_bytes = (4 + sbr_bits + 7) / 8;
+    int fixed_bits = 3 + 4 + (aac->channels == 2 ? 1 : 0) + 3;
+    if (aac->sbr)
+        fixed_bits += 3 + 4 + (sbr_bytes >= 15 ? 8 : 0) + 8 * sbr_bytes;
+
+    // as much noise as the bitrate fits
+    int noise_lines = 1024;
+    for (; noise_lines > 0; noise_lines -= 32) {
+        struct bench_bits count = { NULL, 0, fixed_bits };
+        for (int ch = 0; ch < aac->channels; ch++) {
+            bench_aac_spectrum(spec[ch], frame, ch, noise_lines);
+            bench_aac_ics(&count, bands, spec[ch], global_gain);
+        }
+        if (count.pos <= frame_bytes * 8)
+            break;
+    }
+
+    memset(block, 0x0, BENCH_AAC_MAX_FRAME);
+    struct bench_bits bits = { block, BENCH_AAC_MAX_FRAME, 0 };
+    bench_put_bits(&bits, aac->channels == 2 ? 0x1 : 0x0, 3); // ID_SCE or ID_CPE
+    bench_put_bits(&bits, 0x0, 4);          // element_instance_tag
+    if (aac->channels == 2)
+        bench_put_bits(&bits, 0x0, 1);      // common_window
+    for (int ch = 0; ch < aac->channels; ch++) {
+        bench_aac_spectrum(spec[ch], frame, ch, noise_lines);
+        bench_aac_ics(&bits, bands, spec[ch], global_gain);
+    }
+    if (aac->sbr) {
+        bench_put_bits(&bits, 0x6, 3);      // ID_FIL
+        if (sbr_bytes >= 15) {
+            bench_put_bits(&bits, 15, 4);
+            bench_put_bits(&bits, sbr_bytes - 14, 8);
+        } else {
+            bench_put_bits(&bits, sbr_bytes, 4);
+        }
+        int begin = bits.pos;
+        bench_put_bits(&bits, 0xD, 4);      // EXT_SBR_DATA
+        bench_aac_sbr(&bits, aac, frame);
+        bits.pos = begin + 8 * sbr_bytes;
+    }
+    for (;;) {
+        int fill_bytes = (frame_bytes * 8 - bits.pos - 3 - 15) / 8;
+        if (fill_bytes <= 0)
+            break;
+        if (fill_bytes > 14 + 255)
+            fill_bytes = 14 + 255;
+        bench_put_bits(&bits, 0x6, 3);      // ID_FIL, EXT_FILL payload of zeros
+        if (fill_bytes >= 15) {
+            bench_put_bits(&bits, 15, 4);
+            bench_put_bits(&bits, fill_bytes - 14, 8);
+        } else {
+            bench_put_bits(&bits, fill_bytes, 4);
+        }
+        bits.pos += 8 * fill_bytes;
+    }
+    bench_put_bits(&bits, 0x7, 3);          // ID_END
+    return (bits.pos + 7) / 8;
+}
+
+static long bench_box_begin(FILE *fp, const char *type)
+{
+    long offset = ftell(fp);
+    bench_put_be(fp, 0, 4);
+    fwrite(type, 1, 4, fp);
+    return offset;
+}
+
+static void bench_box_end(FILE *fp, long offset)
+{
+    long end = ftell(fp);
+    fseek(fp, offset, SEEK_SET);
+    bench_put_be(fp, (unsigned int)(end - offset), 4);
+    fseek(fp, end, SEEK_SET);
+}
+
+// M4A of the blocks, one chunk, AudioSpecificConfig signals SBR explicitly (hierarchical)
+static int bench_write_m4a(FILE *fp, struct bench_aac *aac, int samplerate, int kbps,
+                           unsigned char *blocks, int *sizes, int frames)
+{
+    int frame_length = aac->sbr ? 2048 : 1024;
+    unsigned char asc[4] = { 0 };
+    struct bench_bits asc_bits = { asc, sizeof(asc), 0 };
+    if (aac->sbr) {
+        int ext_index = 0;
+        while (bench_aac_rates[ext_index] != samplerate)
+            ext_index++;
+        bench_put_bits(&asc_bits, 5, 5);    // SBR
+        bench_put_bits(&asc_bits, aac->rate_index, 4);
+        bench_put_bits(&asc_bits, aac->channels, 4);
+        bench_put_bits(&asc_bits, ext_index, 4);
+        bench_put_bits(&asc_bits, 2, 5);    // AAC LC
+    } else {
+        bench_put_bits(&asc_bits, 2, 5);
+        bench_put_bits(&asc_bits, aac->rate_index, 4);
+        bench_put_bits(&asc_bits, aac->channels, 4);
+    }
+    bench_put_bits(&asc_bits, 0x0, 3);      // GASpecificConfig
+    int asc_size = (asc_bits.pos + 7) / 8;
+    unsigned int duration = frames * frame_length;
+
+    long ftyp = bench_box_begin(fp, "ftyp");
+    fwrite("M4A ", 1, 4, fp);
+    bench_put_be(fp, 0, 4);
+    fwrite("M4A mp42isom", 1, 12, fp);
+    bench_box_end(fp, ftyp);
+
+    long moov = bench_box_begin(fp, "moov");
+    long mvhd = bench_box_begin(fp, "mvhd");
+    bench_put_be(fp, 0, 4 + 4 + 4);         // version/flags, creation and modification time
+    bench_put_be(fp, samplerate, 4);
+    bench_put_be(fp, duration, 4);
+    bench_put_be(fp, 0x00010000, 4);        // rate
+    bench_put_be(fp, 0x0100, 2);            // volume
+    bench_put_be(fp, 0, 2 + 8 + 36 + 24);   // reserved, matrix, pre_defined
+    bench_put_be(fp, 2, 4);                 // next_track_ID
+    bench_box_end(fp, mvhd);
+
+    long trak = bench_box_begin(fp, "trak");
+    long tkhd = bench_box_begin(fp, "tkhd");
+    bench_put_be(fp, 0x7, 4);               // version/flags, enabled in movie
+    bench_put_be(fp, 0, 4 + 4);
+    bench_put_be(fp, 1, 4);                 // track_ID
+    bench_put_be(fp, 0, 4);
+    bench_put_be(fp, duration, 4);
+    bench_put_be(fp, 0, 8 + 2 + 2);         // reserved, layer, alternate_group
+    bench_put_be(fp, 0x0100, 2);            // volume
+    bench_put_be(fp, 0, 2 + 36 + 4 + 4);    // reserved, matrix, width, height
+    bench_box_end(fp, tkhd);
+
+    long mdia = bench_box_begin(fp, "mdia");
+    long mdhd = bench_box_begin(fp, "mdhd");
+    bench_put_be(fp, 0, 4 + 4 + 4);
+    bench_put_be(fp, samplerate, 4);
+    bench_put_be(fp, duration, 4);
+    bench_put_be(fp, 0x55c4, 2);            // language "und"
+    bench_put_be(fp, 0, 2);
+    bench_box_end(fp, mdhd);
+    long hdlr = bench_box_begin(fp, "hdlr");
+    bench_put_be(fp, 0, 4 + 4);
+    fwrite("soun", 1, 4, fp);
+    bench_put_be(fp, 0, 12 + 1);            // reserved, empty name
+    bench_box_end(fp, hdlr);
+
+    long minf = bench_box_begin(fp, "minf");
+    long smhd = bench_box_begin(fp, "smhd");
+    bench_put_be(fp, 0, 4 + 4);
+    bench_box_end(fp, smhd);
+    long dinf = bench_box_begin(fp, "dinf");
+    long dref = bench_box_begin(fp, "dref");
+    bench_put_be(fp, 0, 4);
+    bench_put_be(fp, 1, 4);
+    long url = bench_box_begin(fp, "url ");
+    bench_put_be(fp, 0x1, 4);               // media data in this file
+    bench_box_end(fp, url);
+    bench_box_end(fp, dref);
+    bench_box_end(fp, dinf);
+
+    long stbl = bench_box_begin(fp, "stbl");
+    long stsd = bench_box_begin(fp, "stsd");
+    bench_put_be(fp, 0, 4);
+    bench_put_be(fp, 1, 4);
+    long mp4a = bench_box_begin(fp, "mp4a");
+    bench_put_be(fp, 0, 6);
+    bench_put_be(fp, 1, 2);                 // data_reference_index
+    bench_put_be(fp, 0, 8);
+    bench_put_be(fp, aac->channels, 2);
+    bench_put_be(fp, 16, 2);
+    bench_put_be(fp, 0, 4);
+    bench_put_be(fp, samplerate << 16, 4);
+    long esds = bench_box_begin(fp, "esds");
+    bench_put_be(fp, 0, 4);
+    bench_put_be(fp, 0x03, 1);              // ES_Descriptor
+    bench_put_be(fp, 3 + 2 + 13 + 2 + asc_size + 3, 1);
+    bench_put_be(fp, 0, 2 + 1);             // ES_ID, flags
+    bench_put_be(fp, 0x04, 1);              // DecoderConfigDescriptor
+    bench_put_be(fp, 13 + 2 + asc_size, 1);
+    bench_put_be(fp, 0x40, 1);              // MPEG-4 audio
+    bench_put_be(fp, 0x15, 1);              // audio stream
+    bench_put_be(fp, BENCH_AAC_MAX_FRAME, 3);
+    bench_put_be(fp, kbps * 1000, 4);
+    bench_put_be(fp, kbps * 1000, 4);
+    bench_put_be(fp, 0x05, 1);              // DecoderSpecificInfo
+    bench_put_be(fp, asc_size, 1);
+    fwrite(asc, 1, asc_size, fp);
+    bench_put_be(fp, 0x06, 1);              // SLConfigDescriptor
+    bench_put_be(fp, 1, 1);
+    bench_put_be(fp, 0x02, 1);
+    bench_box_end(fp, esds);
+    bench_box_end(fp, mp4a);
+    bench_box_end(fp, stsd);
+
+    long stts = bench_box_begin(fp, "stts");
+    bench_put_be(fp, 0, 4);
+    bench_put_be(fp, 1, 4);
+    bench_put_be(fp, frames, 4);
+    bench_put_be(fp, frame_length, 4);
+    bench_box_end(fp, stts);
+    long stsc = bench_box_begin(fp, "stsc");
+    bench_put_be(fp, 0, 4);
+    bench_put_be(fp, 1, 4);
+    bench_put_be(fp, 1, 4);                 // first_chunk
+    bench_put_be(fp, frames, 4);            // samples_per_chunk
+    bench_put_be(fp, 1, 4);
+    bench_box_end(fp, stsc);
+    long stsz = bench_box_begin(fp, "stsz");
+    bench_put_be(fp, 0, 4 + 4);
+    bench_put_be(fp, frames, 4);
+    for (int i = 0; i < frames; i++)
+        bench_put_be(fp, sizes[i], 4);
+    bench_box_end(fp, stsz);
+    long stco = bench_box_begin(fp, "stco");
+    bench_put_be(fp, 0, 4);
+    bench_put_be(fp, 1, 4);
+    long chunk_offset = ftell(fp);
+    bench_put_be(fp, 0, 4);
+    bench_box_end(fp, stco);
+    bench_box_end(fp, stbl);
+    bench_box_end(fp, minf);
+    bench_box_end(fp, mdia);
+    bench_box_end(fp, trak);
+    bench_box_end(fp, moov);
+
+    long mdat = bench_box_begin(fp, "mdat");
+    long data = ftell(fp);
+    for (int i = 0; i < frames; i++)
+        fwrite(&blocks[i * BENCH_AAC_MAX_FRAME], 1, sizes[i], fp);
+    bench_box_end(fp, mdat);
+    fseek(fp, chunk_offset, SEEK_SET);
+    bench_put_be(fp, (unsigned int)data, 4);
+    fseek(fp, 0, SEEK_END);
+    return 0;
+}
+
+/*
+ * AAC-LC, or HE-AAC if @sbr, in ADTS with SBR signaled implicitly, or in M4A if @m4a.
+ * @samplerate is the output rate, the AAC core of HE-AAC runs at half of it. Band counts of
+ * the SBR header in bench_aac_sbr() are those of 14496-3 4.6.18.3 at these core rates.
+ */
+static int bench_generate_aac(const char *path, int samplerate, int channels, int kbps, bool sbr, bool m4a)
+{
+    struct bench_aac aac = {
+        .rate_index = -1,
+        .channels = channels,
+        .sbr = sbr,
+    };
+    int core_rate = sbr ? samplerate / 2 : samplerate;
+    for (int i = 0; i < sizeof(bench_aac_rates)/sizeof(bench_aac_rates[0]); i++) {
+        if (bench_aac_rates[i] == core_rate)
+            aac.rate_index = i;
+    }
+    if (sbr) {
+        static const int sbr_bands[][3] = { // core samplerate, envelope and noise floor bands
+            { 16000, 14, 3 }, { 22050, 16, 3 }, { 24000, 16, 4 },
+        };
+        int i = 0;
+        for (; i < sizeof(sbr_bands)/sizeof(sbr_bands[0]) && sbr_bands[i][0] != core_rate; i++);
+        if (i < sizeof(sbr_bands)/sizeof(sbr_bands[0])) {
+            aac.sbr_bands = sbr_bands[i][1];
+            aac.sbr_noise_bands = sbr_bands[i][2];
+        } else {
+            aac.rate_index = -1;
+        }
+    }
+    if (aac.rate_index < 0 || channels < 1 || channels > 2) {
+        OS_LOGE(TAG, "Unsupported aac %dHz %dch sbr=%d", samplerate, channels, sbr);
+        return -1;
+    }
+
+    int frames = core_rate * BENCH_COMPRESSED_SECONDS / 1024;
+    unsigned char *blocks = malloc(frames * BENCH_AAC_MAX_FRAME);
+    int *sizes = malloc(frames * sizeof(int));
+    FILE *fp = fopen(path, "wb");
+    if (blocks == NULL || sizes == NULL || fp == NULL) {
+        OS_LOGE(TAG, "Failed to create %s", path);
+        free(blocks);
+        free(sizes);
+        if (fp != NULL)
+            fclose(fp);
+        return -1;
+    }
+
+    int remainder = 0;
+    for (int f = 0; f < frames; f++) {
+        int frame_bytes = kbps * 1000 / 8 * 1024 / core_rate;
+        remainder += kbps * 1000 / 8 * 1024 % core_rate;
+        if (remainder >= core_rate) {
+            remainder -= core_rate;
+            frame_bytes++;
+        }
+        if (!m4a)
+            frame_bytes -= 7;
+        sizes[f] = bench_aac_block(&blocks[f * BENCH_AAC_MAX_FRAME], &aac, f, frame_bytes);
+    }
+
+    if (m4a) {
+        bench_write_m4a(fp, &aac, samplerate, kbps, blocks, sizes, frames);
+    } else {
+        for (int f = 0; f < frames; f++) {
+            unsigned char header[7] = { 0 };
+            struct bench_bits bits = { header, sizeof(header), 0 };
+            bench_put_bits(&bits, 0xFFF, 12);
+            bench_put_bits(&bits, 0x0, 1 + 2);      // MPEG-4, layer
+            bench_put_bits(&bits, 0x1, 1);          // protection_absent
+            bench_put_bits(&bits, 0x1, 2);          // profile LC
+            bench_put_bits(&bits, aac.rate_index, 4);
+            bench_put_bits(&bits, 0x0, 1);          // private
+            bench_put_bits(&bits, channels, 3);
+            bench_put_bits(&bits, 0x0, 4);          // original, home, copyright bits
+            bench_put_bits(&bits, 7 + sizes[f], 13);
+            bench_put_bits(&bits, 0x7FF, 11);       // buffer fullness, variable
+            bench_put_bits(&bits, 0x0, 2);          // one raw data block
+            fwrite(header, 1, sizeof(header), fp);
+            fwrite(&blocks[f * BENCH_AAC_MAX_FRAME], 1, sizes[f], fp);
+        }
+    }
+    fclose(fp);
+    free(blocks);
+    free(sizes);
+    return 0;
+}
+
+static int bench_load_golden(const char *path, struct bench_golden *golden, int max)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return 0;
+    int count = 0;
+    char line[256];
+    while (count < max && fgets(line, sizeof(line), fp) != NULL) {
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+        if (sscanf(line, "%63s %llx", golden[count].name, &golden[count].hash) == 2)
+            count++;
+    }
+    fclose(fp);
+    return count;
+}
+
+static int bench_save_golden(const char *path, struct bench_golden *golden, int count)
+{
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        OS_LOGE(TAG, "Failed to open %s", path);
+        return -1;
+    }
+    fprintf(fp, "# liteplayer_bench golden pcm hashes (FNV-1a 64), regenerate with -u\n");
+    for (int i = 0; i < count; i++)
+        fprintf(fp, "%s %016llx\n", golden[i].name, golden[i].hash);
+    fclose(fp);
+    return 0;
+}
+
+static int bench_run(struct bench_entry *entry, struct bench_result *result)
+{
+    memset(result, 0x0, sizeof(struct bench_result));
+    result->hash = 0xcbf29ce484222325ULL;
+
+    struct sink_wrapper sink_ops = {
+        .priv_data = result,
+        .name = null_sink_name,
+        .formats = null_sink_formats,
+        .open = null_sink_open,
+        .write = null_sink_write,
+        .close = null_sink_close,
+    };
+
+    long long heap_base = atomic_load(&g_heap_used);
+    atomic_store(&g_heap_peak, heap_base);
+
+    int ret = -1;
+    liteplayer_handle_t player = liteplayer_create();
+    if (player == NULL)
+        return -1;
+    liteplayer_register_sink_wrapper(player, &sink_ops);
+    liteplayer_register_source_wrapper(player, &g_file_ops);
+    liteplayer_register_state_listener(player, bench_state_listener, result);
+    liteplayer_set_aac_plus(player, entry->aac_plus);
+    if (liteplayer_set_data_source(player, entry->url) != 0 || liteplayer_prepare(player) != 0) {
+        OS_LOGE(TAG, "Failed to prepare %s", entry->url);
+        goto run_out;
+    }
+
+    unsigned long long begin = os_monotonic_usec();
+    if (liteplayer_start(player) != 0)
+        goto run_out;
+    os_mutex_lock(g_bench_lock);
+    while (result->state != LITEPLAYER_COMPLETED && result->state != LITEPLAYER_ERROR)
+        os_cond_wait(g_bench_cond, g_bench_lock);
+    os_mutex_unlock(g_bench_lock);
+    unsigned long long elapsed = os_monotonic_usec() - begin;
+    if (result->state == LITEPLAYER_ERROR)
+        goto run_out;
+
+    struct liteplayer_stats stats;
+    liteplayer_get_stats(player, &stats);
+    double audio_sec = result->bytes_per_sec > 0 ? (double)result->bytes / result->bytes_per_sec : 0;
+    result->frames = stats.decode_frames;
+    result->frames_per_sec = stats.decode_frames * 1000000.0 / elapsed;
+    result->realtime_factor = stats.realtime_factor;
+    result->speed = audio_sec * 1000000 / elapsed;
+    result->heap_peak = atomic_load(&g_heap_peak) - heap_base;
+    ret = 0;
+
+run_out:
+    liteplayer_stop(player);
+    liteplayer_reset(player);
+    liteplayer_destroy(player);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    // before anything is allocated, see os_memory_set_hooks()
+    os_memory_set_hooks(&g_bench_heap_hooks);
+
+    const char *golden_file = BENCH_GOLDEN_FILE;
+    bool update = false;
+    int argi = 1;
+    for (; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "-u") == 0) {
+            update = true;
+        } else if (strcmp(argv[argi], "-g") == 0 && argi + 1 < argc) {
+            golden_file = argv[++argi];
+        } else {
+            OS_LOGW(TAG, "Usage: %s [-g golden_file] [-u] [url...]", argv[0]);
+            return -1;
+        }
+    }
+
+    static struct bench_entry entries[BENCH_MAX_ENTRIES];
+    static struct bench_golden golden[BENCH_MAX_ENTRIES];
+    int count = 0;
+
+    static const int wav_samplerates[] = { 8000, 22050, 44100, 48000, 96000 };
+    for (int i = 0; i < sizeof(wav_samplerates)/sizeof(wav_samplerates[0]); i++) {
+        for (int channels = 1; channels <= 2; channels++) {
+            for (int bits = 16; bits <= 32; bits += 8) {
+                struct bench_entry *entry = &entries[count];
+                snprintf(entry->name, sizeof(entry->name), "wav-%d-%dch-%dbit",
+                         wav_samplerates[i], channels, bits);
+                snprintf(entry->url, sizeof(entry->url), "bench-%d-%dch-%dbit.wav",
+                         wav_samplerates[i], channels, bits);
+                if (bench_generate_wav(entry->url, wav_samplerates[i], channels, bits) != 0)
+                    return -1;
+                count++;
+            }
+        }
+    }
+
+    static const int mp3_cases[][3] = { // samplerate, channels, kbps
+        { 8000, 1, 16 }, { 16000, 1, 32 }, { 22050, 2, 64 }, { 32000, 1, 64 },
+        { 44100, 2, 128 }, { 44100, 2, 320 }, { 48000, 1, 96 }, { 48000, 2, 192 },
+    };
+    for (int i = 0; i < sizeof(mp3_cases)/sizeof(mp3_cases[0]); i++) {
+        struct bench_entry *entry = &entries[count];
+        snprintf(entry->name, sizeof(entry->name), "mp3-%d-%dch-%dk",
+                 mp3_cases[i][0], mp3_cases[i][1], mp3_cases[i][2]);
+        snprintf(entry->url, sizeof(entry->url), "bench-%d-%dch-%dk.mp3",
+                 mp3_cases[i][0], mp3_cases[i][1], mp3_cases[i][2]);
+        if (bench_generate_mp3(entry->url, mp3_cases[i][0], mp3_cases[i][1], mp3_cases[i][2]) != 0)
+            return -1;
+        count++;
+    }
+
+    // samplerate is the output one, half of it for the AAC core of HE-AAC
+    static const struct {
+        const char *type;
+        int samplerate;
+        int channels;
+        int kbps;
+        bool sbr;
+        bool m4a;
+    } aac_cases[] = {
+        { "aac",    8000,  1, 16,  false, false },
+        { "aac",    16000, 1, 32,  false, false },
+        { "aac",    22050, 2, 64,  false, false },
+        { "aac",    32000, 2, 96,  false, false },
+        { "aac",    44100, 2, 128, false, false },
+        { "aac",    48000, 1, 64,  false, false },
+        { "aac",    48000, 2, 256, false, false },
+        { "heaac",  32000, 1, 24,  true,  false },
+        { "heaac",  44100, 2, 48,  true,  false },
+        { "heaac",  48000, 2, 64,  true,  false },
+        { "m4a",    24000, 1, 32,  false, true },
+        { "m4a",    44100, 2, 128, false, true },
+        { "m4ahe",  44100, 2, 48,  true,  true },
+    };
+    for (int i = 0; i < sizeof(aac_cases)/sizeof(aac_cases[0]); i++) {
+        struct bench_entry *entry = &entries[count];
+        snprintf(entry->name, sizeof(entry->name), "%s-%d-%dch-%dk", aac_cases[i].type,
+                 aac_cases[i].samplerate, aac_cases[i].channels, aac_cases[i].kbps);
+        snprintf(entry->url, sizeof(entry->url), "bench-%s-%d-%dch-%dk.%s", aac_cases[i].type,
+                 aac_cases[i].samplerate, aac_cases[i].channels, aac_cases[i].kbps,
+                 aac_cases[i].m4a ? "m4a" : "aac");
+        if (bench_generate_aac(entry->url, aac_cases[i].samplerate, aac_cases[i].channels,
+                               aac_cases[i].kbps, aac_cases[i].sbr, aac_cases[i].m4a) != 0)
+            return -1;
+        count++;
+    }
+
+    static const char *samples[][2] = {
+        { "mp3-test",      "test.mp3" },
+        { "aac-adts-test", "test.aac" },
+        { "m4a-test",      "test.m4a" },
+    };
+    for (int i = 0; i < sizeof(samples)/sizeof(samples[0]); i++) {
+        snprintf(entries[count].name, sizeof(entries[count].name), "%s", samples[i][0]);
+        snprintf(entries[count].url, sizeof(entries[count].url), "%s", samples[i][1]);
+        count++;
+    }
+    for (; argi < argc && count < BENCH_MAX_ENTRIES; argi++, count++) {
+        const char *base = strrchr(argv[argi], '/');
+        snprintf(entries[count].name, sizeof(entries[count].name), "%s", base != NULL ? base + 1 : argv[argi]);
+        snprintf(entries[count].url, sizeof(entries[count].url), "%s", argv[argi]);
+    }
+
+    // SBR on and off in the same run, if this build decodes it
+    liteplayer_handle_t probe = liteplayer_create();
+    bool aac_plus = probe != NULL && liteplayer_set_aac_plus(probe, true) == 0;
+    if (probe != NULL)
+        liteplayer_destroy(probe);
+    for (int i = 0, n = count; aac_plus && i < n && count < BENCH_MAX_ENTRIES; i++) {
+        const char *ext = strrchr(entries[i].url, '.');
+        if (ext == NULL || (strcmp(ext, ".aac") != 0 && strcmp(ext, ".m4a") != 0))
+            continue;
+        entries[count] = entries[i];
+        entries[count].aac_plus = true;
+        strncat(entries[count].name, "+sbr", sizeof(entries[count].name) - strlen(entries[count].name) - 1);
+        count++;
+    }
+
+    int golden_count = bench_load_golden(golden_file, golden, BENCH_MAX_ENTRIES);
+
+    g_bench_lock = os_mutex_create();
+    g_bench_cond = os_cond_create();
+    if (g_bench_lock == NULL || g_bench_cond == NULL) {
+        OS_LOGE(TAG, "Failed to create bench resources");
+        return -1;
+    }
+
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        struct bench_result result;
+        if (bench_run(&entries[i], &result) != 0) {
+            printf("%-24s FAILED\n", entries[i].name);
+            failed++;
+            continue;
+        }
+        int j = 0;
+        for (; j < golden_count && strcmp(golden[j].name, entries[i].name) != 0; j++);
+        const char *verdict = "ok";
+        if (update) {
+            verdict = "updated";
+            if (j == golden_count && golden_count < BENCH_MAX_ENTRIES) {
+                char *name = golden[golden_count].name;
+                int len = snprintf(name, sizeof(golden[golden_count].name), "%s", entries[i].name);
+                if (len >= 0 && len < (int)sizeof(golden[golden_count].name))
+                    golden_count++;
+                else {
+                    verdict = "name-too-long";
+                    failed++;
+                }
+            }
+            if (j < golden_count)
+                golden[j].hash = result.hash;
+        } else if (j == golden_count) {
+            verdict = "no-golden";
+        } else if (golden[j].hash != result.hash) {
+            verdict = "MISMATCH";
+            failed++;
+        }
+        printf("%-24s frames=%-6d frames/s=%-9.0f rtf=%-8.5f speed=%-7.1fx heap=%-5lldKB hash=%016llx %s\n",
+               entries[i].name, result.frames, result.frames_per_sec, result.realtime_factor,
+               result.speed, (result.heap_peak + 1023) / 1024, result.hash, verdict);
+    }
+
+    // entries not run this time are kept, e.g. of another build configuration
+    if (update && bench_save_golden(golden_file, golden, golden_count) != 0)
+        failed++;
+    os_cond_destroy(g_bench_cond);
+    os_mutex_destroy(g_bench_lock);
+    printf("%d of %d passed\n", count - failed, count);
+    return failed == 0 ? 0 : -1;
+}
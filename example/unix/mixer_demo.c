@@ -0,0 +1,216 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Play music and a prompt with two players through one sink, music is ducked
+// while the prompt is playing. Both players are resampled to the mixer samplerate.
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osal/os_thread.h"
+#include "cutils/memory_helper.h"
+#include "cutils/log_helper.h"
+#include "liteplayer_main.h"
+#include "liteplayer_mixer.h"
+#include "source_httpclient_wrapper.h"
+#include "source_file_wrapper.h"
+#if defined(HAVE_LINUX_ALSA_ENABLED)
+#include "sink_alsa_wrapper.h"
+#elif defined(HAVE_PORT_AUDIO_ENABLED)
+#include "sink_portaudio_wrapper.h"
+#else
+#include "sink_wave_wrapper.h"
+#endif
+
+#define TAG "mixer_demo"
+
+#define MIXER_DEMO_DUCK_GAIN     ( 0.2f )
+#define MIXER_DEMO_DUCK_RAMP_MS  ( 300 )
+#define MIXER_DEMO_PROMPT_DELAY  ( 3000 )
+
+static int mixer_demo_state_listener(enum liteplayer_state state, int errcode, void *priv)
+{
+    enum liteplayer_state *player_state = (enum liteplayer_state *)priv;
+
+    if (state == LITEPLAYER_NEARLYCOMPLETED)
+        return 0;
+    if (state == LITEPLAYER_ERROR)
+        OS_LOGE(TAG, "-->LITEPLAYER_ERROR: %d", errcode);
+    *player_state = state;
+    return 0;
+}
+
+static struct source_wrapper g_file_ops = {
+    .async_mode = false,
+    .buffer_size = 2*1024,
+    .priv_data = NULL,
+    .url_protocol = file_wrapper_url_protocol,
+    .open = file_wrapper_open,
+    .read = file_wrapper_read,
+    .content_pos = file_wrapper_content_pos,
+    .content_len = file_wrapper_content_len,
+    .seek = file_wrapper_seek,
+    .close = file_wrapper_close,
+};
+
+static struct source_wrapper g_http_ops = {
+    .async_mode = true,
+    .buffer_size = 256*1024,
+    .priv_data = NULL,
+    .url_protocol = httpclient_wrapper_url_protocol,
+    .open = httpclient_wrapper_open,
+    .read = httpclient_wrapper_read,
+    .content_pos = httpclient_wrapper_content_pos,
+    .content_len = httpclient_wrapper_content_len,
+    .seek = httpclient_wrapper_seek,
+    .close = httpclient_wrapper_close,
+};
+
+static liteplayer_handle_t mixer_demo_player(mixer_input_handle_t input, int samplerate,
+                                             enum liteplayer_state *state)
+{
+    liteplayer_handle_t player = liteplayer_create();
+    if (player == NULL)
+        return NULL;
+    liteplayer_set_output_samplerate(player, samplerate);
+    liteplayer_register_state_listener(player, mixer_demo_state_listener, (void *)state);
+    liteplayer_register_sink_wrapper(player, mixer_input_get_sink_wrapper(input));
+    liteplayer_register_source_wrapper(player, &g_file_ops);
+    liteplayer_register_source_wrapper(player, &g_http_ops);
+    return player;
+}
+
+static int mixer_demo_prepare(liteplayer_handle_t player, const char *url, enum liteplayer_state *state)
+{
+    if (liteplayer_set_data_source(player, url) != 0 || liteplayer_prepare_async(player) != 0)
+        return -1;
+    while (*state != LITEPLAYER_PREPARED && *state != LITEPLAYER_ERROR) {
+        os_thread_sleep_msec(100);
+    }
+    return *state == LITEPLAYER_PREPARED ? 0 : -1;
+}
+
+static void mixer_demo_release(liteplayer_handle_t player, enum liteplayer_state *state)
+{
+    if (player == NULL)
+        return;
+    liteplayer_stop(player);
+    liteplayer_reset(player);
+    while (*state != LITEPLAYER_IDLE) {
+        os_thread_sleep_msec(100);
+    }
+    liteplayer_destroy(player);
+}
+
+static int mixer_demo(const char *music_url, const char *prompt_url, int samplerate)
+{
+    int ret = -1;
+    struct mixer_cfg cfg = DEFAULT_MIXER_CFG();
+    cfg.samplerate = samplerate;
+    mixer_handle_t mixer = mixer_create(&cfg);
+    if (mixer == NULL)
+        return ret;
+
+#if defined(HAVE_LINUX_ALSA_ENABLED)
+    struct sink_wrapper sink_ops = {
+        .priv_data = NULL,
+        .name = alsa_wrapper_name,
+        .open = alsa_wrapper_open,
+        .write = alsa_wrapper_write,
+        .close = alsa_wrapper_close,
+    };
+#elif defined(HAVE_PORT_AUDIO_ENABLED)
+    struct sink_wrapper sink_ops = {
+        .priv_data = NULL,
+        .name = portaudio_wrapper_name,
+        .open = portaudio_wrapper_open,
+        .write = portaudio_wrapper_write,
+        .close = portaudio_wrapper_close,
+    };
+#else
+    struct sink_wrapper sink_ops = {
+        .priv_data = NULL,
+        .name = wave_wrapper_name,
+        .open = wave_wrapper_open,
+        .write = wave_wrapper_write,
+        .close = wave_wrapper_close,
+    };
+#endif
+    mixer_register_sink_wrapper(mixer, &sink_ops);
+
+    mixer_input_handle_t music_input = mixer_input_create(mixer);
+    mixer_input_handle_t prompt_input = mixer_input_create(mixer);
+    enum liteplayer_state music_state = LITEPLAYER_IDLE;
+    enum liteplayer_state prompt_state = LITEPLAYER_IDLE;
+    liteplayer_handle_t music = NULL, prompt = NULL;
+    if (music_input == NULL || prompt_input == NULL)
+        goto test_done;
+
+    music = mixer_demo_player(music_input, samplerate, &music_state);
+    prompt = mixer_demo_player(prompt_input, samplerate, &prompt_state);
+    if (music == NULL || prompt == NULL)
+        goto test_done;
+
+    if (mixer_demo_prepare(music, music_url, &music_state) != 0 || liteplayer_start(music) != 0) {
+        OS_LOGE(TAG, "Failed to play music");
+        goto test_done;
+    }
+    os_thread_sleep_msec(MIXER_DEMO_PROMPT_DELAY);
+
+    if (mixer_demo_prepare(prompt, prompt_url, &prompt_state) != 0) {
+        OS_LOGE(TAG, "Failed to prepare prompt");
+        goto test_done;
+    }
+    OS_LOGI(TAG, "Ducking music");
+    mixer_input_set_gain(music_input, MIXER_DEMO_DUCK_GAIN, MIXER_DEMO_DUCK_RAMP_MS);
+    if (liteplayer_start(prompt) != 0) {
+        OS_LOGE(TAG, "Failed to start prompt");
+        goto test_done;
+    }
+    OS_MEMORY_DUMP();
+    while (prompt_state != LITEPLAYER_COMPLETED && prompt_state != LITEPLAYER_ERROR) {
+        os_thread_sleep_msec(100);
+    }
+    OS_LOGI(TAG, "Restoring music");
+    mixer_input_set_gain(music_input, 1.0f, MIXER_DEMO_DUCK_RAMP_MS);
+
+    while (music_state != LITEPLAYER_COMPLETED && music_state != LITEPLAYER_ERROR) {
+        os_thread_sleep_msec(100);
+    }
+    ret = 0;
+
+test_done:
+    mixer_demo_release(prompt, &prompt_state);
+    mixer_demo_release(music, &music_state);
+    mixer_input_destroy(prompt_input);
+    mixer_input_destroy(music_input);
+    mixer_destroy(mixer);
+
+    os_thread_sleep_msec(100);
+    OS_MEMORY_DUMP();
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        OS_LOGW(TAG, "Usage: %s [music_url] [prompt_url] [samplerate]", argv[0]);
+        return -1;
+    }
+
+    mixer_demo(argv[1], argv[2], argc > 3 ? atoi(argv[3]) : 48000);
+    return 0;
+}
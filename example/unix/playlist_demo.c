@@ -154,6 +154,7 @@ static void *playlist_demo_thread(void *arg)
         .open = alsa_wrapper_open,
         .write = alsa_wrapper_write,
         .close = alsa_wrapper_close,
+        .formats = alsa_wrapper_formats,
     };
 #elif defined(HAVE_PORT_AUDIO_ENABLED)
     struct sink_wrapper sink_ops = {
@@ -162,6 +163,7 @@ static void *playlist_demo_thread(void *arg)
         .open = portaudio_wrapper_open,
         .write = portaudio_wrapper_write,
         .close = portaudio_wrapper_close,
+        .formats = portaudio_wrapper_formats,
     };
 #else
     struct sink_wrapper sink_ops = {
@@ -170,6 +172,7 @@ static void *playlist_demo_thread(void *arg)
         .open = wave_wrapper_open,
         .write = wave_wrapper_write,
         .close = wave_wrapper_close,
+        .formats = wave_wrapper_formats,
     };
 #endif
     listplayer_register_sink_wrapper(demo->player_handle, &sink_ops);
@@ -0,0 +1,384 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Check the eq response of each filter at a few frequencies against the designed gain,
+// band changes and flat bands, then the dsp chain: stage order after inserting, moving,
+// bypassing and removing, filter history dropped by reset, and edits from another thread
+// while processing, with all stage handles closed at the end.
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+
+#include "osal/os_thread.h"
+#include "cutils/log_helper.h"
+#include "liteplayer_eq.h"
+#include "liteplayer_dsp.h"
+
+#define LOG_TAG "dsp_test"
+
+#define DSP_TEST_RATE           ( 48000 )
+#define DSP_TEST_FRAMES         ( 48000 ) // of each eq run, gain is measured on the second half
+#define DSP_TEST_CHUNK          ( 1000 )  // frames processed at a time
+#define DSP_TEST_EDITS          ( 2000 )
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static int g_pcm[DSP_TEST_FRAMES];
+
+// Gain in dB of a mono 32-bit sine at @freq run through @dsp
+static double eq_test_gain_db(struct dsp_wrapper *dsp, double freq)
+{
+    dsp_handle_t handle = dsp->open(DSP_TEST_RATE, 1, 32, dsp->priv_data);
+    if (handle == NULL)
+        return NAN;
+    double in_energy = 0.0, out_energy = 0.0;
+    for (int i = 0; i < DSP_TEST_FRAMES; i += DSP_TEST_CHUNK) {
+        for (int k = 0; k < DSP_TEST_CHUNK; k++) {
+            double x = 0.1 * sin(2 * M_PI * freq * (i + k) / DSP_TEST_RATE);
+            g_pcm[i + k] = (int)lrint(x * 2147483648.0);
+            if (i >= DSP_TEST_FRAMES / 2)
+                in_energy += x * x;
+        }
+        dsp->process(handle, (char *)&g_pcm[i], DSP_TEST_CHUNK * sizeof(int));
+        for (int k = 0; k < DSP_TEST_CHUNK && i >= DSP_TEST_FRAMES / 2; k++) {
+            double y = g_pcm[i + k] / 2147483648.0;
+            out_energy += y * y;
+        }
+    }
+    dsp->close(handle);
+    return 10 * log10(out_energy / in_energy);
+}
+
+struct eq_test_case {
+    struct eq_band band;
+    double freq;
+    double gain_db;
+    double tolerance_db;
+};
+
+static const struct eq_test_case g_eq_cases[] = {
+    { { EQ_FILTER_PEAKING,    1000,  6.0f, 1.0f   }, 1000,    6.0, 0.1 },
+    { { EQ_FILTER_PEAKING,    1000,  6.0f, 1.0f   }, 100,     0.0, 0.2 },
+    { { EQ_FILTER_PEAKING,    1000, -6.0f, 1.0f   }, 1000,   -6.0, 0.1 },
+    { { EQ_FILTER_LOW_SHELF,  200,   6.0f, 0.707f }, 40,      6.0, 0.3 },
+    { { EQ_FILTER_LOW_SHELF,  200,   6.0f, 0.707f }, 5000,    0.0, 0.1 },
+    { { EQ_FILTER_HIGH_SHELF, 4000, -6.0f, 0.707f }, 18000,  -6.0, 0.3 },
+    { { EQ_FILTER_HIGH_SHELF, 4000, -6.0f, 0.707f }, 200,     0.0, 0.1 },
+    { { EQ_FILTER_LOW_PASS,   1000,  0.0f, 0.707f }, 1000,   -3.0, 0.1 },
+    { { EQ_FILTER_LOW_PASS,   1000,  0.0f, 0.707f }, 100,     0.0, 0.1 },
+    { { EQ_FILTER_HIGH_PASS,  1000,  0.0f, 0.707f }, 1000,   -3.0, 0.1 },
+    { { EQ_FILTER_HIGH_PASS,  1000,  0.0f, 0.707f }, 10000,   0.0, 0.1 },
+};
+
+static int eq_test(void)
+{
+    for (int i = 0; i < sizeof(g_eq_cases)/sizeof(g_eq_cases[0]); i++) {
+        const struct eq_test_case *tc = &g_eq_cases[i];
+        eq_handle_t eq = eq_create(&tc->band, 1);
+        if (eq == NULL) {
+            OS_LOGE(LOG_TAG, "Failed to create eq of case[%d]", i);
+            return -1;
+        }
+        double gain_db = eq_test_gain_db(eq_get_dsp_wrapper(eq), tc->freq);
+        eq_destroy(eq);
+        if (!(fabs(gain_db - tc->gain_db) <= tc->tolerance_db)) {
+            OS_LOGE(LOG_TAG, "Case[%d] filter:%d at %.0fHz: gain %.2fdB, expected %.2fdB",
+                    i, tc->band.filter, tc->freq, gain_db, tc->gain_db);
+            return -1;
+        }
+    }
+
+    // two bands cascade, a changed band is picked up at the next buffer
+    struct eq_band bands[2] = {
+        { EQ_FILTER_PEAKING, 1000, 3.0f, 1.0f },
+        { EQ_FILTER_PEAKING, 1000, 3.0f, 1.0f },
+    };
+    eq_handle_t eq = eq_create(bands, 2);
+    if (eq == NULL)
+        return -1;
+    double cascaded = eq_test_gain_db(eq_get_dsp_wrapper(eq), 1000);
+    bands[1].gain_db = -9.0f;
+    eq_set_band(eq, 1, &bands[1]);
+    double changed = eq_test_gain_db(eq_get_dsp_wrapper(eq), 1000);
+    bool invalid = eq_set_band(eq, 2, &bands[1]) == 0;
+    eq_destroy(eq);
+    if (fabs(cascaded - 6.0) > 0.1 || fabs(changed + 6.0) > 0.1 || invalid) {
+        OS_LOGE(LOG_TAG, "Band update: cascaded %.2fdB, changed %.2fdB, out of range band %s",
+                cascaded, changed, invalid ? "accepted" : "rejected");
+        return -1;
+    }
+
+    // flat bands leave 16-bit pcm untouched, no dither added
+    struct eq_band flat = { EQ_FILTER_PEAKING, 1000, 0.0f, 1.0f };
+    eq = eq_create(&flat, 1);
+    if (eq == NULL)
+        return -1;
+    struct dsp_wrapper *dsp = eq_get_dsp_wrapper(eq);
+    dsp_handle_t handle = dsp->open(DSP_TEST_RATE, 2, 16, dsp->priv_data);
+    short pcm[2 * DSP_TEST_CHUNK], ref[2 * DSP_TEST_CHUNK];
+    for (int i = 0; i < 2 * DSP_TEST_CHUNK; i++)
+        pcm[i] = ref[i] = (short)(i * 37);
+    dsp->process(handle, (char *)pcm, sizeof(pcm));
+    dsp->close(handle);
+    eq_destroy(eq);
+    if (memcmp(pcm, ref, sizeof(pcm)) != 0) {
+        OS_LOGE(LOG_TAG, "Flat band changed pcm");
+        return -1;
+    }
+    return 0;
+}
+
+// Stages of integer arithmetic on 16-bit mono, so the order of stages shows in the output
+struct arith_stage {
+    struct dsp_wrapper wrapper;
+    int mul;
+    int add;
+    int opens;
+    int closes;
+};
+
+static const char *arith_name()
+{
+    return "arith";
+}
+
+static dsp_handle_t arith_open(int samplerate, int channels, int bits, void *priv_data)
+{
+    struct arith_stage *stage = (struct arith_stage *)priv_data;
+    if (bits != 16)
+        return NULL;
+    __atomic_fetch_add(&stage->opens, 1, __ATOMIC_RELAXED);
+    return stage;
+}
+
+static int arith_process(dsp_handle_t handle, char *buffer, int size)
+{
+    struct arith_stage *stage = (struct arith_stage *)handle;
+    short *pcm = (short *)buffer;
+    for (int i = 0; i < size / 2; i++)
+        pcm[i] = (short)(pcm[i] * stage->mul + stage->add);
+    return 0;
+}
+
+static void arith_close(dsp_handle_t handle)
+{
+    struct arith_stage *stage = (struct arith_stage *)handle;
+    __atomic_fetch_add(&stage->closes, 1, __ATOMIC_RELAXED);
+}
+
+static void arith_init(struct arith_stage *stage, int mul, int add)
+{
+    memset(stage, 0x0, sizeof(struct arith_stage));
+    stage->mul = mul;
+    stage->add = add;
+    stage->wrapper.priv_data = stage;
+    stage->wrapper.name = arith_name;
+    stage->wrapper.open = arith_open;
+    stage->wrapper.process = arith_process;
+    stage->wrapper.close = arith_close;
+}
+
+// Process a buffer of @in, returns the output if all samples agree, -1 otherwise
+static int chain_test_run(dsp_chain_handle_t chain, short in, int *stages)
+{
+    short pcm[64];
+    for (int i = 0; i < 64; i++)
+        pcm[i] = in;
+    *stages = dsp_chain_process(chain, (char *)pcm, sizeof(pcm));
+    for (int i = 1; i < 64; i++) {
+        if (pcm[i] != pcm[0])
+            return -1;
+    }
+    return pcm[0];
+}
+
+struct chain_test_editor {
+    dsp_chain_handle_t chain;
+    struct arith_stage *scale;
+    struct arith_stage *offset;
+    atomic_bool done;
+};
+
+static void *chain_test_edit_thread(void *arg)
+{
+    struct chain_test_editor *editor = (struct chain_test_editor *)arg;
+    for (int i = 0; i < DSP_TEST_EDITS && !atomic_load(&editor->done); i++) {
+        switch (i % 4) {
+        case 0:
+            dsp_chain_move(editor->chain, &editor->offset->wrapper, 0);
+            break;
+        case 1:
+            dsp_chain_bypass(editor->chain, &editor->scale->wrapper, true);
+            break;
+        case 2:
+            dsp_chain_remove(editor->chain, &editor->offset->wrapper);
+            dsp_chain_bypass(editor->chain, &editor->scale->wrapper, false);
+            break;
+        default:
+            dsp_chain_insert(editor->chain, -1, &editor->offset->wrapper);
+            break;
+        }
+    }
+    atomic_store(&editor->done, true);
+    return NULL;
+}
+
+static int chain_test(void)
+{
+    struct arith_stage scale, offset;
+    arith_init(&scale, 2, 0);
+    arith_init(&offset, 1, 100);
+    int ret = -1, stages = 0, out;
+
+    dsp_chain_handle_t chain = dsp_chain_create();
+    if (chain == NULL)
+        return -1;
+
+    // stages inserted before opening are opened with the chain
+    dsp_chain_insert(chain, -1, &scale.wrapper);
+    dsp_chain_insert(chain, -1, &offset.wrapper);
+    if (chain_test_run(chain, 10, &stages) != 10 || stages != 0 || scale.opens != 0) {
+        OS_LOGE(LOG_TAG, "Stages ran before the chain is opened");
+        goto test_out;
+    }
+    dsp_chain_open(chain, DSP_TEST_RATE, 1, 16);
+    if ((out = chain_test_run(chain, 10, &stages)) != 10*2 + 100 || stages != 2) {
+        OS_LOGE(LOG_TAG, "scale,offset: got %d with %d stages", out, stages);
+        goto test_out;
+    }
+    dsp_chain_move(chain, &offset.wrapper, 0);
+    if ((out = chain_test_run(chain, 10, &stages)) != (10 + 100)*2) {
+        OS_LOGE(LOG_TAG, "offset,scale: got %d", out);
+        goto test_out;
+    }
+    dsp_chain_bypass(chain, &offset.wrapper, true);
+    if ((out = chain_test_run(chain, 10, &stages)) != 10*2 || stages != 1) {
+        OS_LOGE(LOG_TAG, "bypassed offset: got %d with %d stages", out, stages);
+        goto test_out;
+    }
+    dsp_chain_bypass(chain, &offset.wrapper, false);
+    dsp_chain_remove(chain, &scale.wrapper);
+    if ((out = chain_test_run(chain, 10, &stages)) != 10 + 100 || scale.closes != 1) {
+        OS_LOGE(LOG_TAG, "removed scale: got %d, closed %d times", out, scale.closes);
+        goto test_out;
+    }
+    dsp_chain_insert(chain, 0, &scale.wrapper);
+    if ((out = chain_test_run(chain, 10, &stages)) != 10*2 + 100 || scale.opens != 2) {
+        OS_LOGE(LOG_TAG, "reinserted scale: got %d, opened %d times", out, scale.opens);
+        goto test_out;
+    }
+    if (dsp_chain_insert(chain, -1, &scale.wrapper) == 0 || dsp_chain_remove(chain, NULL) == 0) {
+        OS_LOGE(LOG_TAG, "Inserted a stage twice or removed a missing one");
+        goto test_out;
+    }
+    // the same format doesn't reopen, reset does
+    dsp_chain_open(chain, DSP_TEST_RATE, 1, 16);
+    dsp_chain_reset(chain);
+    if (scale.opens != 3 || scale.closes != 2 || offset.opens != 2 || offset.closes != 1) {
+        OS_LOGE(LOG_TAG, "Reset: scale opened/closed %d/%d, offset %d/%d",
+                scale.opens, scale.closes, offset.opens, offset.closes);
+        goto test_out;
+    }
+
+    // every buffer is processed by one consistent chain while another thread edits it
+    struct chain_test_editor editor = {
+        .chain = chain,
+        .scale = &scale,
+        .offset = &offset,
+        .done = false,
+    };
+    os_thread tid = os_thread_create(NULL, chain_test_edit_thread, &editor);
+    if (tid == NULL)
+        goto test_out;
+    int buffers = 0;
+    while (!atomic_load(&editor.done)) {
+        out = chain_test_run(chain, 10, &stages);
+        bool valid = (out == 10*2 + 100 && stages == 2) || (out == (10 + 100)*2 && stages == 2) ||
+                     (out == 10 + 100 && stages == 1) || (out == 10*2 && stages == 1) ||
+                     (out == 10 && stages == 0);
+        if (!valid) {
+            OS_LOGE(LOG_TAG, "Inconsistent buffer while editing: got %d with %d stages", out, stages);
+            atomic_store(&editor.done, true);
+            os_thread_join(tid, NULL);
+            goto test_out;
+        }
+        buffers++;
+    }
+    os_thread_join(tid, NULL);
+    OS_LOGI(LOG_TAG, "Processed %d buffers during %d edits", buffers, DSP_TEST_EDITS);
+    ret = 0;
+
+test_out:
+    dsp_chain_destroy(chain);
+    if (ret == 0 && (scale.opens != scale.closes || offset.opens != offset.closes)) {
+        OS_LOGE(LOG_TAG, "Stage handles leaked: scale opened/closed %d/%d, offset %d/%d",
+                scale.opens, scale.closes, offset.opens, offset.closes);
+        ret = -1;
+    }
+    return ret;
+}
+
+// History of an eq in a chain rings on after the input stops, unless the chain is reset
+static int reset_test(void)
+{
+    struct eq_band band = { EQ_FILTER_PEAKING, 100, 12.0f, 4.0f };
+    eq_handle_t eq = eq_create(&band, 1);
+    dsp_chain_handle_t chain = dsp_chain_create();
+    int ret = -1;
+    if (eq == NULL || chain == NULL)
+        goto test_out;
+    dsp_chain_insert(chain, -1, eq_get_dsp_wrapper(eq));
+    dsp_chain_open(chain, DSP_TEST_RATE, 1, 32);
+
+    int tails[2];
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < DSP_TEST_CHUNK; i++)
+            g_pcm[i] = (int)lrint(0.1 * sin(2 * M_PI * 100 * i / DSP_TEST_RATE) * 2147483648.0);
+        dsp_chain_process(chain, (char *)g_pcm, DSP_TEST_CHUNK * sizeof(int));
+        if (pass == 1)
+            dsp_chain_reset(chain);
+        memset(g_pcm, 0x0, DSP_TEST_CHUNK * sizeof(int));
+        dsp_chain_process(chain, (char *)g_pcm, DSP_TEST_CHUNK * sizeof(int));
+        tails[pass] = 0;
+        for (int i = 0; i < DSP_TEST_CHUNK; i++)
+            tails[pass] += g_pcm[i] != 0 ? 1 : 0;
+    }
+    if (tails[0] == 0 || tails[1] != 0) {
+        OS_LOGE(LOG_TAG, "Nonzero samples after input stopped: %d kept, %d reset", tails[0], tails[1]);
+        goto test_out;
+    }
+    ret = 0;
+
+test_out:
+    if (chain != NULL) {
+        dsp_chain_remove(chain, eq_get_dsp_wrapper(eq));
+        dsp_chain_destroy(chain);
+    }
+    eq_destroy(eq);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    if (eq_test() != 0 || chain_test() != 0 || reset_test() != 0)
+        return -1;
+    OS_LOGI(LOG_TAG, "All eq and dsp chain checks passed");
+    return 0;
+}
@@ -0,0 +1,432 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Gapless playback: the frames of test.mp3 are served from memory behind a crafted Info
+// frame with a LAME tag, and the extractors must read delay and padding of it and of the
+// iTunSMPB tag of test.m4a. Then two such tracks of different delay and padding are played
+// by linked players: the sink must be opened once and handed over, and the pcm written must
+// be the pcm of the untagged frames, trimmed of head and tail of each track, byte exact.
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osal/os_thread.h"
+#include "cutils/log_helper.h"
+#include "esp_adf/audio_common.h"
+#include "liteplayer_config.h"
+#include "liteplayer_main.h"
+#include "liteplayer_arena.h"
+#include "audio_extractor/mp3_extractor.h"
+#include "audio_extractor/m4a_extractor.h"
+
+#define LOG_TAG "gapless_test"
+
+#define GAPLESS_TEST_FILES      ( 4 )
+#define GAPLESS_TEST_PCM_SIZE   ( 1024*1024 )
+#define GAPLESS_TEST_TIMEOUT_MS ( 20000 )
+
+// test.mp3: MPEG-2 layer III, 16000Hz mono 32kbps, 144 bytes and 576 samples per frame
+#define GAPLESS_TEST_MP3_FRAME_SIZE    ( 144 )
+#define GAPLESS_TEST_MP3_FRAME_SAMPLES ( 576 )
+#define GAPLESS_TEST_MP3_DECODER_DELAY ( 529 )
+
+// test.m4a: iTunSMPB " 00000000 00000840 00000146 000000000004E67A ..."
+#define GAPLESS_TEST_M4A_DELAY   ( 0x840 )
+#define GAPLESS_TEST_M4A_PADDING ( 0x146 )
+#define GAPLESS_TEST_M4A_SAMPLES ( 0x4E67A )
+
+struct gapless_test_file {
+    const char *url;
+    char *data;
+    long size;
+};
+
+struct gapless_test_stream {
+    struct gapless_test_file *file;
+    long pos;
+};
+
+struct gapless_test_sink {
+    os_mutex lock;
+    char *pcm;
+    int size;
+    int opens;
+    int closes;
+};
+
+static struct gapless_test_file g_files[GAPLESS_TEST_FILES];
+static struct gapless_test_sink g_sink;
+
+static struct gapless_test_file *gapless_test_find(const char *url)
+{
+    for (int i = 0; i < GAPLESS_TEST_FILES; i++) {
+        if (g_files[i].url != NULL && strcmp(g_files[i].url, url) == 0)
+            return &g_files[i];
+    }
+    return NULL;
+}
+
+static const char *gapless_test_url_protocol()
+{
+    return "file";
+}
+
+static source_handle_t gapless_test_open(const char *url, long long content_pos, void *priv_data)
+{
+    struct gapless_test_file *file = gapless_test_find(url);
+    if (file == NULL || content_pos > file->size)
+        return NULL;
+    struct gapless_test_stream *stream = calloc(1, sizeof(struct gapless_test_stream));
+    if (stream == NULL)
+        return NULL;
+    stream->file = file;
+    stream->pos = (long)content_pos;
+    return stream;
+}
+
+static int gapless_test_read(source_handle_t handle, char *buffer, int size)
+{
+    struct gapless_test_stream *stream = (struct gapless_test_stream *)handle;
+    long left = stream->file->size - stream->pos;
+    if (size > left)
+        size = (int)left;
+    memcpy(buffer, stream->file->data + stream->pos, size);
+    stream->pos += size;
+    return size;
+}
+
+static long long gapless_test_content_pos(source_handle_t handle)
+{
+    return ((struct gapless_test_stream *)handle)->pos;
+}
+
+static long long gapless_test_content_len(source_handle_t handle)
+{
+    return ((struct gapless_test_stream *)handle)->file->size;
+}
+
+static int gapless_test_seek(source_handle_t handle, long offset)
+{
+    struct gapless_test_stream *stream = (struct gapless_test_stream *)handle;
+    if (offset < 0 || offset > stream->file->size)
+        return -1;
+    stream->pos = offset;
+    return 0;
+}
+
+static void gapless_test_close(source_handle_t handle)
+{
+    free(handle);
+}
+
+static const char *gapless_test_sink_name()
+{
+    return "gapless_test";
+}
+
+static sink_handle_t gapless_test_sink_open(int samplerate, int channels, int bits, void *priv_data)
+{
+    struct gapless_test_sink *sink = (struct gapless_test_sink *)priv_data;
+    os_mutex_lock(sink->lock);
+    sink->opens++;
+    os_mutex_unlock(sink->lock);
+    return (sink_handle_t)sink;
+}
+
+static int gapless_test_sink_write(sink_handle_t handle, char *buffer, int size)
+{
+    struct gapless_test_sink *sink = (struct gapless_test_sink *)handle;
+    os_mutex_lock(sink->lock);
+    if (sink->size + size <= GAPLESS_TEST_PCM_SIZE) {
+        memcpy(sink->pcm + sink->size, buffer, size);
+        sink->size += size;
+    }
+    os_mutex_unlock(sink->lock);
+    return size;
+}
+
+static void gapless_test_sink_close(sink_handle_t handle)
+{
+    struct gapless_test_sink *sink = (struct gapless_test_sink *)handle;
+    os_mutex_lock(sink->lock);
+    sink->closes++;
+    os_mutex_unlock(sink->lock);
+}
+
+static struct source_wrapper g_source_ops = {
+    .async_mode = true,
+    .buffer_size = 16*1024,
+    .priv_data = NULL,
+    .url_protocol = gapless_test_url_protocol,
+    .open = gapless_test_open,
+    .read = gapless_test_read,
+    .content_pos = gapless_test_content_pos,
+    .content_len = gapless_test_content_len,
+    .seek = gapless_test_seek,
+    .close = gapless_test_close,
+};
+
+static struct sink_wrapper g_sink_ops = {
+    .priv_data = &g_sink,
+    .name = gapless_test_sink_name,
+    .open = gapless_test_sink_open,
+    .write = gapless_test_sink_write,
+    .close = gapless_test_sink_close,
+    .formats = NULL,
+};
+
+static int gapless_test_fetch(char *buf, int wanted_size, long offset, void *fetch_priv)
+{
+    struct gapless_test_file *file = (struct gapless_test_file *)fetch_priv;
+    if (offset >= file->size)
+        return 0;
+    if (wanted_size > file->size - offset)
+        wanted_size = (int)(file->size - offset);
+    memcpy(buf, file->data + offset, wanted_size);
+    return wanted_size;
+}
+
+static int gapless_test_load(struct gapless_test_file *file, const char *url, const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        OS_LOGE(LOG_TAG, "Failed to open %s", path);
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    file->size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    file->data = malloc(file->size);
+    if (file->data == NULL || fread(file->data, 1, file->size, fp) != (size_t)file->size) {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    file->url = url;
+    return 0;
+}
+
+// Frames of @frames behind an Info frame, whose LAME tag records @delay and @padding
+static int gapless_test_tag(struct gapless_test_file *file, const char *url,
+                            struct gapless_test_file *frames, int delay, int padding)
+{
+    file->size = frames->size + GAPLESS_TEST_MP3_FRAME_SIZE;
+    file->data = calloc(1, file->size);
+    if (file->data == NULL)
+        return -1;
+    unsigned char *info = (unsigned char *)file->data;
+    int count = (int)(frames->size/GAPLESS_TEST_MP3_FRAME_SIZE);
+    memcpy(info, frames->data, 4);           // same header, side information left empty
+    memcpy(&info[13], "Info", 4);            // behind 9 bytes of mono MPEG-2 side information
+    info[20] = 0x01;                         // flags: frames
+    info[21] = (count >> 24) & 0xFF;
+    info[22] = (count >> 16) & 0xFF;
+    info[23] = (count >> 8) & 0xFF;
+    info[24] = count & 0xFF;
+    memcpy(&info[25], "LAME3.100", 9);
+    info[25 + 21] = (delay >> 4) & 0xFF;     // 12 bits of delay and 12 bits of padding
+    info[25 + 22] = ((delay & 0x0F) << 4) | ((padding >> 8) & 0x0F);
+    info[25 + 23] = padding & 0xFF;
+    memcpy(file->data + GAPLESS_TEST_MP3_FRAME_SIZE, frames->data, frames->size);
+    file->url = url;
+    return 0;
+}
+
+static int gapless_test_check(bool ok, const char *what)
+{
+    if (!ok)
+        OS_LOGE(LOG_TAG, "Check failed: %s", what);
+    return ok ? 0 : -1;
+}
+
+#define GAPLESS_TEST_CHECK(cond) do { if (gapless_test_check((cond), #cond) != 0) goto test_out; } while (0)
+
+static int gapless_test_extractors(struct gapless_test_file *tagged, int delay, int padding,
+                                   struct gapless_test_file *m4a)
+{
+    int ret = -1;
+    struct mp3_info mp3_info;
+    struct m4a_info m4a_info;
+    memset(&mp3_info, 0x0, sizeof(mp3_info));
+    memset(&m4a_info, 0x0, sizeof(m4a_info));
+
+    GAPLESS_TEST_CHECK(mp3_extractor(gapless_test_fetch, tagged, &mp3_info) == 0);
+    GAPLESS_TEST_CHECK(mp3_info.frame_start_offset == GAPLESS_TEST_MP3_FRAME_SIZE);
+    GAPLESS_TEST_CHECK(mp3_info.frame_samples == GAPLESS_TEST_MP3_FRAME_SAMPLES);
+    GAPLESS_TEST_CHECK(mp3_info.total_frames == (tagged->size/GAPLESS_TEST_MP3_FRAME_SIZE - 1));
+    GAPLESS_TEST_CHECK(mp3_info.encoder_delay == delay + GAPLESS_TEST_MP3_DECODER_DELAY);
+    GAPLESS_TEST_CHECK(mp3_info.encoder_padding == padding - GAPLESS_TEST_MP3_DECODER_DELAY);
+
+    GAPLESS_TEST_CHECK(m4a_extractor(gapless_test_fetch, m4a, &m4a_info) == 0);
+    GAPLESS_TEST_CHECK(m4a_info.encoder_delay == GAPLESS_TEST_M4A_DELAY);
+    GAPLESS_TEST_CHECK(m4a_info.encoder_padding == GAPLESS_TEST_M4A_PADDING);
+    GAPLESS_TEST_CHECK(m4a_info.valid_samples == GAPLESS_TEST_M4A_SAMPLES);
+    ret = 0;
+
+test_out:
+    media_arena_free(m4a_info.arena, m4a_info.stsz_samplesize);
+    media_arena_free(m4a_info.arena, m4a_info.stts_time2sample);
+    media_arena_free(m4a_info.arena, m4a_info.stsc_sample2chunk);
+    media_arena_free(m4a_info.arena, m4a_info.stco_chunk2offset);
+    return ret;
+}
+
+static int gapless_test_state_callback(enum liteplayer_state state, int errcode, void *priv)
+{
+    if (state == LITEPLAYER_COMPLETED || state == LITEPLAYER_ERROR)
+        *(enum liteplayer_state *)priv = state;
+    return 0;
+}
+
+static liteplayer_handle_t gapless_test_player(const char *url, enum liteplayer_state *state)
+{
+    liteplayer_handle_t player = liteplayer_create();
+    if (player == NULL)
+        return NULL;
+    liteplayer_register_source_wrapper(player, &g_source_ops);
+    liteplayer_register_sink_wrapper(player, &g_sink_ops);
+    liteplayer_register_state_listener(player, gapless_test_state_callback, state);
+    if (liteplayer_set_data_source(player, url) != ESP_OK || liteplayer_prepare(player) != ESP_OK) {
+        liteplayer_destroy(player);
+        return NULL;
+    }
+    return player;
+}
+
+static bool gapless_test_wait(volatile enum liteplayer_state *state)
+{
+    for (int i = 0; i < GAPLESS_TEST_TIMEOUT_MS/10 && *state != LITEPLAYER_COMPLETED; i++) {
+        if (*state == LITEPLAYER_ERROR)
+            return false;
+        os_thread_sleep_msec(10);
+    }
+    return *state == LITEPLAYER_COMPLETED;
+}
+
+static void gapless_test_release(liteplayer_handle_t player)
+{
+    if (player == NULL)
+        return;
+    liteplayer_reset(player);
+    liteplayer_destroy(player);
+}
+
+// Pcm of the untagged frames, the decoder delay isn't trimmed without a LAME tag
+static int gapless_test_reference(const char *url, char *pcm, int *size)
+{
+    int ret = -1;
+    enum liteplayer_state state = LITEPLAYER_IDLE;
+    g_sink.size = g_sink.opens = g_sink.closes = 0;
+    liteplayer_handle_t player = gapless_test_player(url, &state);
+    GAPLESS_TEST_CHECK(player != NULL);
+    GAPLESS_TEST_CHECK(liteplayer_start(player) == ESP_OK);
+    GAPLESS_TEST_CHECK(gapless_test_wait(&state));
+    memcpy(pcm, g_sink.pcm, g_sink.size);
+    *size = g_sink.size;
+    ret = 0;
+
+test_out:
+    gapless_test_release(player);
+    return ret;
+}
+
+// Play @first then @second through linked players, expect @expected once in a single sink
+static int gapless_test_handover(const char *first, const char *second, const char *expected, int size)
+{
+    int ret = -1;
+    enum liteplayer_state state1 = LITEPLAYER_IDLE, state2 = LITEPLAYER_IDLE;
+    liteplayer_handle_t player1 = NULL, player2 = NULL;
+    g_sink.size = g_sink.opens = g_sink.closes = 0;
+
+    player1 = gapless_test_player(first, &state1);
+    player2 = gapless_test_player(second, &state2);
+    GAPLESS_TEST_CHECK(player1 != NULL && player2 != NULL);
+    GAPLESS_TEST_CHECK(liteplayer_set_next_player(player1, player2) == ESP_OK);
+    GAPLESS_TEST_CHECK(liteplayer_start(player1) == ESP_OK);
+    GAPLESS_TEST_CHECK(liteplayer_start(player2) == ESP_OK);
+    GAPLESS_TEST_CHECK(gapless_test_wait(&state1));
+    GAPLESS_TEST_CHECK(gapless_test_wait(&state2));
+    gapless_test_release(player1);
+    gapless_test_release(player2);
+    player1 = player2 = NULL;
+
+    GAPLESS_TEST_CHECK(g_sink.opens == 1 && g_sink.closes == 1);
+    GAPLESS_TEST_CHECK(g_sink.size == size);
+    GAPLESS_TEST_CHECK(memcmp(g_sink.pcm, expected, size) == 0);
+    ret = 0;
+
+test_out:
+    if (ret != 0)
+        OS_LOGE(LOG_TAG, "Sink opened %d, closed %d, %d bytes written, %d expected",
+                g_sink.opens, g_sink.closes, g_sink.size, size);
+    gapless_test_release(player1);
+    gapless_test_release(player2);
+    return ret;
+}
+
+// Expected pcm of a track: @reference trimmed of delay and padding recorded by the LAME tag
+static int gapless_test_trim(char *out, const char *reference, int size, int delay, int padding)
+{
+    int head = (delay + GAPLESS_TEST_MP3_DECODER_DELAY)*2;
+    int tail = (padding - GAPLESS_TEST_MP3_DECODER_DELAY)*2;
+    memcpy(out, reference + head, size - head - tail);
+    return size - head - tail;
+}
+
+int main()
+{
+    const int delays[2] = { 576, 1105 };
+    const int paddings[2] = { 1200, 600 };
+    int ret = -1;
+    char *reference = malloc(GAPLESS_TEST_PCM_SIZE);
+    char *expected = malloc(GAPLESS_TEST_PCM_SIZE);
+    g_sink.pcm = malloc(GAPLESS_TEST_PCM_SIZE);
+    g_sink.lock = os_mutex_create();
+    if (reference == NULL || expected == NULL || g_sink.pcm == NULL || g_sink.lock == NULL)
+        goto test_out;
+
+    if (gapless_test_load(&g_files[0], "test.mp3", GAPLESS_TEST_DIR "/test.mp3") != 0 ||
+        gapless_test_load(&g_files[1], "test.m4a", GAPLESS_TEST_DIR "/test.m4a") != 0 ||
+        gapless_test_tag(&g_files[2], "first.mp3", &g_files[0], delays[0], paddings[0]) != 0 ||
+        gapless_test_tag(&g_files[3], "second.mp3", &g_files[0], delays[1], paddings[1]) != 0)
+        goto test_out;
+
+    for (int i = 0; i < 2; i++) {
+        if (gapless_test_extractors(&g_files[2 + i], delays[i], paddings[i], &g_files[1]) != 0)
+            goto test_out;
+    }
+
+    int size = 0;
+    GAPLESS_TEST_CHECK(gapless_test_reference("test.mp3", reference, &size) == 0);
+    GAPLESS_TEST_CHECK(size == (g_files[0].size/GAPLESS_TEST_MP3_FRAME_SIZE)*GAPLESS_TEST_MP3_FRAME_SAMPLES*2);
+    GAPLESS_TEST_CHECK(g_sink.opens == 1 && g_sink.closes == 1);
+
+    int expected_size = gapless_test_trim(expected, reference, size, delays[0], paddings[0]);
+    expected_size += gapless_test_trim(expected + expected_size, reference, size, delays[1], paddings[1]);
+    GAPLESS_TEST_CHECK(gapless_test_handover("first.mp3", "second.mp3", expected, expected_size) == 0);
+    ret = 0;
+
+test_out:
+    for (int i = 0; i < GAPLESS_TEST_FILES; i++)
+        free(g_files[i].data);
+    free(reference);
+    free(expected);
+    free(g_sink.pcm);
+    if (g_sink.lock != NULL)
+        os_mutex_destroy(g_sink.lock);
+    OS_LOGI(LOG_TAG, "Gapless test %s", ret == 0 ? "passed" : "failed");
+    return ret;
+}
@@ -0,0 +1,614 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Feed playlist fixtures served from memory through the m3u parser, with reads of a few
+// sizes so lines span chunks: media sequence tracking of a live playlist reloaded with
+// new, gone and restarted segments, vod and plain playlists, a master playlist resolved
+// to its first variant, and variant selection: codecs compatibility, hysteresis, switching
+// in place of the segments left and backoff of a variant failed to switch to. Then the
+// pieces: lines around and over the read chunk, the url arena compacted while segments are
+// queued, and uri resolution of urls longer than any fixed buffer.
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cutils/log_helper.h"
+#include "esp_adf/audio_common.h"
+#include "liteplayer_config.h"
+#include "liteplayer_m3u.h"
+
+#define LOG_TAG "m3u_test"
+
+#define M3U_TEST_FILES      ( 8 )
+#define M3U_TEST_TEXT_SIZE  ( 1024*64 )
+#define M3U_TEST_CHUNK_SIZE ( 1024*2 ) // DEFAULT_M3U_CHUNK_SIZE, lines over twice of it are truncated
+
+struct m3u_test_file {
+    char url[256];
+    char text[M3U_TEST_TEXT_SIZE];
+};
+
+struct m3u_test_server {
+    struct m3u_test_file files[M3U_TEST_FILES];
+    int read_size; // bytes returned by a read at most
+    int opens;
+};
+
+struct m3u_test_stream {
+    const char *text;
+    int pos;
+    int read_size;
+};
+
+static const int g_read_sizes[] = { 4096, 64, 7, 1 };
+
+static struct m3u_test_server g_server;
+
+static source_handle_t m3u_test_open(const char *url, long long content_pos, void *priv_data)
+{
+    struct m3u_test_server *server = (struct m3u_test_server *)priv_data;
+    for (int i = 0; i < M3U_TEST_FILES; i++) {
+        if (strcmp(server->files[i].url, url) != 0)
+            continue;
+        struct m3u_test_stream *stream = calloc(1, sizeof(struct m3u_test_stream));
+        if (stream == NULL)
+            return NULL;
+        stream->text = server->files[i].text;
+        stream->pos = (int)content_pos;
+        stream->read_size = server->read_size;
+        server->opens++;
+        return stream;
+    }
+    return NULL;
+}
+
+static int m3u_test_read(source_handle_t handle, char *buffer, int size)
+{
+    struct m3u_test_stream *stream = (struct m3u_test_stream *)handle;
+    int left = strlen(stream->text + stream->pos);
+    if (size > stream->read_size)
+        size = stream->read_size;
+    if (size > left)
+        size = left;
+    memcpy(buffer, stream->text + stream->pos, size);
+    stream->pos += size;
+    return size;
+}
+
+static void m3u_test_close(source_handle_t handle)
+{
+    free(handle);
+}
+
+static struct source_wrapper g_source_ops = {
+    .async_mode = false,
+    .buffer_size = 0,
+    .priv_data = &g_server,
+    .url_protocol = NULL,
+    .open = m3u_test_open,
+    .read = m3u_test_read,
+    .content_pos = NULL,
+    .content_len = NULL,
+    .seek = NULL,
+    .close = m3u_test_close,
+};
+
+// Serve @text at @url, in place of the text served at @url before, NULL to stop serving it
+static void m3u_test_serve(const char *url, const char *text)
+{
+    struct m3u_test_file *file = NULL;
+    for (int i = 0; i < M3U_TEST_FILES && file == NULL; i++) {
+        if (strcmp(g_server.files[i].url, url) == 0)
+            file = &g_server.files[i];
+    }
+    for (int i = 0; i < M3U_TEST_FILES && file == NULL; i++) {
+        if (g_server.files[i].url[0] == '\0')
+            file = &g_server.files[i];
+    }
+    if (file == NULL)
+        return;
+    if (text == NULL) {
+        memset(file, 0x0, sizeof(struct m3u_test_file));
+        return;
+    }
+    snprintf(file->url, sizeof(file->url), "%s", url);
+    snprintf(file->text, sizeof(file->text), "%s", text);
+}
+
+// Serve a media playlist at @url, segments named "@name<sequence>.ts" from @sequence on
+static void m3u_test_serve_media(const char *url, const char *name,
+                                 long long sequence, int count, bool endlist)
+{
+    static char text[M3U_TEST_TEXT_SIZE];
+    int len = snprintf(text, sizeof(text),
+                       "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:4\n#EXT-X-MEDIA-SEQUENCE:%lld\n",
+                       sequence);
+    for (int i = 0; i < count; i++)
+        len += snprintf(text + len, sizeof(text) - len, "#EXTINF:4.000,\n%s%lld.ts\n", name, sequence + i);
+    if (endlist)
+        snprintf(text + len, sizeof(text) - len, "#EXT-X-ENDLIST\n");
+    m3u_test_serve(url, text);
+}
+
+// Pop the segments queued, which must be @count ones named "@prefix<sequence>.ts" from @sequence on
+static int m3u_test_expect(struct m3u_playlist *playlist, const char *prefix, long long sequence, int count)
+{
+    char expected[256];
+    for (int i = 0; i < count; i++, sequence++) {
+        if (m3u_list_empty(&playlist->list)) {
+            OS_LOGE(LOG_TAG, "Segment %lld is missing", sequence);
+            return -1;
+        }
+        long long got = 0;
+        const char *url = m3u_list_front(&playlist->list, &got);
+        snprintf(expected, sizeof(expected), "%s%lld.ts", prefix, sequence);
+        if (got != sequence || strcmp(url, expected) != 0) {
+            OS_LOGE(LOG_TAG, "Segment [%lld]%s, expected [%lld]%s", got, url, sequence, expected);
+            return -1;
+        }
+        m3u_list_pop(&playlist->list);
+    }
+    if (!m3u_list_empty(&playlist->list)) {
+        OS_LOGE(LOG_TAG, "Segments left after %lld", sequence);
+        return -1;
+    }
+    return 0;
+}
+
+static int m3u_test_check(bool ok, const char *what)
+{
+    if (!ok)
+        OS_LOGE(LOG_TAG, "Check failed: %s", what);
+    return ok ? 0 : -1;
+}
+
+#define M3U_TEST_CHECK(cond) do { if (m3u_test_check((cond), #cond) != 0) goto test_out; } while (0)
+
+// Live playlist reloaded by sliding windows, queued segments are never queued again
+static int m3u_test_live(void)
+{
+    const char *url = "http://host/live/index.m3u8";
+    const char *prefix = "http://host/live/seg";
+    struct m3u_playlist playlist;
+    int ret = -1;
+
+    m3u_playlist_init(&playlist, &g_source_ops, url);
+    m3u_test_serve_media(url, "seg", 10, 3, false);
+    M3U_TEST_CHECK(m3u_playlist_resolve(&playlist) == 3);
+    M3U_TEST_CHECK(playlist.hls && !playlist.endlist && playlist.target_duration == 4);
+    M3U_TEST_CHECK(playlist.next_sequence == 13 && playlist.variant == -1);
+    M3U_TEST_CHECK(m3u_test_expect(&playlist, prefix, 10, 3) == 0);
+
+    // window slides by two, only the new ones are queued
+    m3u_test_serve_media(url, "seg", 11, 4, false);
+    M3U_TEST_CHECK(m3u_playlist_resolve(&playlist) == 2);
+    M3U_TEST_CHECK(playlist.next_sequence == 15);
+    M3U_TEST_CHECK(m3u_test_expect(&playlist, prefix, 13, 2) == 0);
+
+    // nothing new
+    M3U_TEST_CHECK(m3u_playlist_resolve(&playlist) == 0);
+    M3U_TEST_CHECK(playlist.next_sequence == 15);
+
+    // reloaded late, segments [15, 18) are gone, the rest is queued
+    m3u_test_serve_media(url, "seg", 18, 2, false);
+    M3U_TEST_CHECK(m3u_playlist_resolve(&playlist) == 2);
+    M3U_TEST_CHECK(playlist.next_sequence == 20);
+    M3U_TEST_CHECK(m3u_test_expect(&playlist, prefix, 18, 2) == 0);
+
+    // restarted by server, nothing is queued till the next reloading queues the whole playlist
+    m3u_test_serve_media(url, "seg", 2, 3, false);
+    M3U_TEST_CHECK(m3u_playlist_resolve(&playlist) == 0);
+    M3U_TEST_CHECK(playlist.next_sequence == 2);
+    M3U_TEST_CHECK(m3u_playlist_resolve(&playlist) == 3);
+    M3U_TEST_CHECK(m3u_test_expect(&playlist, prefix, 2, 3) == 0);
+
+    // ended
+    m3u_test_serve_media(url, "seg", 3, 3, true);
+    M3U_TEST_CHECK(m3u_playlist_resolve(&playlist) == 1);
+    M3U_TEST_CHECK(playlist.hls && playlist.endlist);
+    M3U_TEST_CHECK(m3u_test_expect(&playlist, prefix, 5, 1) == 0);
+
+    // gone, segments queued are kept
+    m3u_test_serve_media(url, "seg", 6, 2, false);
+    M3U_TEST_CHECK(m3u_playlist_resolve(&playlist) == 2);
+    m3u_test_serve(url, NULL);
+    M3U_TEST_CHECK(m3u_playlist_resolve(&playlist) == -1);
+    M3U_TEST_CHECK(playlist.next_sequence == 8);
+    M3U_TEST_CHECK(m3u_test_expect(&playlist, prefix, 6, 2) == 0);
+    ret = 0;
+
+test_out:
+    m3u_playlist_clear(&playlist);
+    return ret;
+}
+
+// Playlists other than hls are queued whole at each resolving, indexed from 0
+static int m3u_test_plain(void)
+{
+    const char *url = "http://host/music/list.m3u";
+    struct m3u_playlist playlist;
+    int ret = -1;
+
+    m3u_playlist_init(&playlist, &g_source_ops, url);
+    m3u_test_serve(url, "#EXTM3U\r\n#EXTINF:180,track 0\r\nhttp://host/music/track0.ts\r\n"
+                        "\r\n#EXTINF:180,track 1\r\nhttp://host/music/track1.ts");
+    M3U_TEST_CHECK(m3u_playlist_resolve(&playlist) == 2);
+    M3U_TEST_CHECK(!playlist.hls && playlist.next_sequence == -1);
+    M3U_TEST_CHECK(m3u_test_expect(&playlist, "http://host/music/track", 0, 2) == 0);
+    M3U_TEST_CHECK(m3u_playlist_resolve(&playlist) == 2);
+    M3U_TEST_CHECK(m3u_test_expect(&playlist, "http://host/music/track", 0, 2) == 0);
+
+    // not a playlist at all
+    m3u_test_serve(url, "<html>not found</html>\n");
+    M3U_TEST_CHECK(m3u_playlist_resolve(&playlist) == -1);
+    M3U_TEST_CHECK(m3u_list_empty(&playlist.list));
+    ret = 0;
+
+test_out:
+    m3u_test_serve(url, NULL);
+    m3u_playlist_clear(&playlist);
+    return ret;
+}
+
+// Master playlist is resolved to its first variant, which is reloaded as the media playlist
+static int m3u_test_master(void)
+{
+    const char *url = "http://host/master.m3u8";
+    struct m3u_playlist playlist;
+    int ret = -1;
+
+    m3u_playlist_init(&playlist, &g_source_ops, url);
+    m3u_test_serve(url, "#EXTM3U\n"
+                        "#EXT-X-STREAM-INF:BANDWIDTH=64000,CODECS=\"mp4a.40.5\"\n"
+                        "low/index.m3u8\n"
+                        "#EXT-X-STREAM-INF:CODECS=\"mp4a.40.2\",BANDWIDTH=128000\n"
+                        "/high/index.m3u8\n");
+    m3u_test_serve_media("http://host/low/index.m3u8", "seg", 100, 3, false);
+    M3U_TEST_CHECK(m3u_playlist_resolve(&playlist) == 3);
+    M3U_TEST_CHECK(playlist.variant_count == 2 && playlist.variant == 0);
+    M3U_TEST_CHECK(playlist.variants[0].bandwidth == 64000 && strcmp(playlist.variants[0].codecs, "mp4a.40.5") == 0);
+    M3U_TEST_CHECK(playlist.variants[1].bandwidth == 128000 && strcmp(playlist.variants[1].codecs, "mp4a.40.2") == 0);
+    M3U_TEST_CHECK(strcmp(playlist.variants[1].url, "http://host/high/index.m3u8") == 0);
+    M3U_TEST_CHECK(playlist.hls && playlist.next_sequence == 103);
+    M3U_TEST_CHECK(m3u_test_expect(&playlist, "http://host/low/seg", 100, 3) == 0);
+
+    // reloaded from the variant, not the master playlist
+    m3u_test_serve(url, NULL);
+    m3u_test_serve_media("http://host/low/index.m3u8", "seg", 101, 3, false);
+    M3U_TEST_CHECK(m3u_playlist_resolve(&playlist) == 1);
+    M3U_TEST_CHECK(m3u_test_expect(&playlist, "http://host/low/seg", 103, 1) == 0);
+    ret = 0;
+
+test_out:
+    m3u_playlist_clear(&playlist);
+    return ret;
+}
+
+// Variants selected by bandwidth, those of other codecs or failed to switch to are skipped
+static int m3u_test_variants(void)
+{
+    const char *url = "http://host/master.m3u8";
+    struct m3u_playlist playlist;
+    int ret = -1;
+
+    m3u_playlist_init(&playlist, &g_source_ops, url);
+    m3u_test_serve(url, "#EXTM3U\n"
+                        "#EXT-X-STREAM-INF:BANDWIDTH=64000,CODECS=\"mp4a.40.5\"\n"
+                        "v0/index.m3u8\n"
+                        "#EXT-X-STREAM-INF:BANDWIDTH=128000,CODECS=\"mp4a.40.5\"\n"
+                        "v1/index.m3u8\n"
+                        "#EXT-X-STREAM-INF:BANDWIDTH=256000,CODECS=\"mp4a.40.5\"\n"
+                        "v2/index.m3u8\n"
+                        "#EXT-X-STREAM-INF:BANDWIDTH=192000\n"
+                        "v3/index.m3u8\n"
+                        "#EXT-X-STREAM-INF:BANDWIDTH=96000,CODECS=\"mp4a.40.2\"\n"
+                        "v4/index.m3u8\n");
+    m3u_test_serve_media("http://host/v0/index.m3u8", "seg", 100, 10, true);
+    m3u_test_serve_media("http://host/v1/index.m3u8", "seg", 100, 10, true);
+    M3U_TEST_CHECK(m3u_playlist_resolve(&playlist) == 10);
+    M3U_TEST_CHECK(playlist.variant_count == 5 && playlist.variant == 0);
+
+    // measured for too few segments to switch up, the playing one is kept
+    M3U_TEST_CHECK(m3u_variant_select(&playlist, 1000000, 100) == 0);
+    playlist.variant_segments = DEFAULT_M3U_SWITCH_UP_SEGMENTS;
+    M3U_TEST_CHECK(m3u_variant_select(&playlist, 1000000, 100) == 2);
+    // mp4a.40.2 decodes to another samplerate, no CODECS may be anything
+    M3U_TEST_CHECK(m3u_variant_select(&playlist, 140000, 100) == 0);
+    M3U_TEST_CHECK(m3u_variant_select(&playlist, 275000, 100) == 1);
+    // no throughput measured yet
+    M3U_TEST_CHECK(m3u_variant_select(&playlist, 0, 100) == 0);
+
+    // v2 isn't served, the switch fails, segments left and the playing variant are kept
+    long long sequence = 0;
+    for (int i = 0; i < 3; i++)
+        m3u_list_pop(&playlist.list);
+    m3u_list_front(&playlist.list, &sequence);
+    M3U_TEST_CHECK(sequence == 103);
+    M3U_TEST_CHECK(m3u_variant_switch(&playlist, 2, sequence) == -1);
+    M3U_TEST_CHECK(playlist.variant == 0 && playlist.variant_segments == DEFAULT_M3U_SWITCH_UP_SEGMENTS);
+    M3U_TEST_CHECK(playlist.next_sequence == 110);
+    M3U_TEST_CHECK(playlist.variants[2].failures == 1);
+
+    // backed off for a while, the next best is switched to meanwhile
+    long long retry = 103 + DEFAULT_M3U_SWITCH_BACKOFF_SEGMENTS;
+    M3U_TEST_CHECK(m3u_variant_select(&playlist, 1000000, 103) == 1);
+    M3U_TEST_CHECK(m3u_variant_select(&playlist, 1000000, retry - 1) == 1);
+    M3U_TEST_CHECK(m3u_variant_select(&playlist, 1000000, retry) == 2);
+
+    // failed again, backed off twice as long
+    M3U_TEST_CHECK(m3u_variant_switch(&playlist, 2, retry) == -1);
+    retry += DEFAULT_M3U_SWITCH_BACKOFF_SEGMENTS*2;
+    M3U_TEST_CHECK(m3u_variant_select(&playlist, 1000000, retry - 1) == 1);
+    M3U_TEST_CHECK(m3u_variant_select(&playlist, 1000000, retry) == 2);
+    M3U_TEST_CHECK(m3u_test_expect(&playlist, "http://host/v0/seg", 103, 7) == 0);
+
+    // served at last, switched from @retry on
+    m3u_test_serve_media("http://host/v2/index.m3u8", "seg", 100, 20, true);
+    M3U_TEST_CHECK(m3u_variant_switch(&playlist, 2, retry) == (int)(120 - retry));
+    M3U_TEST_CHECK(playlist.variant == 2 && playlist.variant_segments == 0);
+    M3U_TEST_CHECK(playlist.variants[2].failures == 0 && playlist.next_sequence == 120);
+    M3U_TEST_CHECK(m3u_test_expect(&playlist, "http://host/v2/seg", retry, (int)(120 - retry)) == 0);
+
+    // the playing one isn't sustainable, switched down at once
+    M3U_TEST_CHECK(m3u_variant_select(&playlist, 200000, 120) == 1);
+    M3U_TEST_CHECK(m3u_variant_select(&playlist, 50000, 120) == 0);
+    ret = 0;
+
+test_out:
+    for (int i = 0; i < 3; i++) {
+        char variant[64];
+        snprintf(variant, sizeof(variant), "http://host/v%d/index.m3u8", i);
+        m3u_test_serve(variant, NULL);
+    }
+    m3u_test_serve(url, NULL);
+    m3u_playlist_clear(&playlist);
+    return ret;
+}
+
+// Fill @buf with @len characters of line @index, not a tag nor an absolute url
+static void m3u_test_line(char *buf, int index, int len)
+{
+    for (int i = 0; i < len; i++)
+        buf[i] = 'a' + (index + i) % 26;
+    buf[len] = '\0';
+}
+
+// Every line is got once, whole if shorter than two chunks, the head of two chunks if truncated
+static int m3u_test_reader(void)
+{
+    static const int lens[] = {
+        1, 100, 2046, 2047, 2048, 2049, 3000, 4095, 4096, 4097, 6000, 2047, 1, 5000, 10,
+    };
+    const char *url = "http://host/lines.m3u";
+    const char *breaks[] = { "\n", "\r\n", "\n\n" };
+    int count = (int)(sizeof(lens)/sizeof(lens[0]));
+    static char text[M3U_TEST_TEXT_SIZE];
+    static char expected[M3U_TEST_TEXT_SIZE];
+    struct m3u_reader *reader = NULL;
+    int ret = -1;
+
+    for (int b = 0; b < (int)(sizeof(breaks)/sizeof(breaks[0])); b++) {
+        int pos = 0;
+        for (int i = 0; i < count; i++) {
+            m3u_test_line(text + pos, i, lens[i]);
+            pos += lens[i];
+            if (i < count - 1) // the last line without line break
+                pos += snprintf(text + pos, sizeof(text) - pos, "%s", breaks[b]);
+        }
+        m3u_test_serve(url, text);
+        reader = m3u_reader_open(&g_source_ops, url);
+        M3U_TEST_CHECK(reader != NULL);
+        for (int i = 0; i < count; i++) {
+            char *line = m3u_reader_get_line(reader);
+            M3U_TEST_CHECK(line != NULL);
+            m3u_test_line(expected, i, lens[i]);
+            int len = strlen(line);
+            if (m3u_reader_truncated(reader)) {
+                if (lens[i] < M3U_TEST_CHUNK_SIZE*2 || len != M3U_TEST_CHUNK_SIZE*2 ||
+                    strncmp(line, expected, len) != 0) {
+                    OS_LOGE(LOG_TAG, "Line[%d] of %d bytes truncated to %d bytes", i, lens[i], len);
+                    goto test_out;
+                }
+            } else if (strcmp(line, expected) != 0) {
+                OS_LOGE(LOG_TAG, "Line[%d] of %d bytes got %d bytes", i, lens[i], len);
+                goto test_out;
+            }
+            // never fits the buffer
+            M3U_TEST_CHECK(lens[i] <= M3U_TEST_CHUNK_SIZE*2 || m3u_reader_truncated(reader));
+        }
+        M3U_TEST_CHECK(m3u_reader_get_line(reader) == NULL);
+        M3U_TEST_CHECK(!m3u_reader_failed(reader));
+        m3u_reader_close(reader);
+        reader = NULL;
+    }
+    ret = 0;
+
+test_out:
+    if (reader != NULL)
+        m3u_reader_close(reader);
+    m3u_test_serve(url, NULL);
+    return ret;
+}
+
+// Segment uris longer than a fixed buffer are kept whole, those over the reader are skipped and counted
+static int m3u_test_long_lines(void)
+{
+    const char *url = "http://host/long/index.m3u8";
+    static char text[M3U_TEST_TEXT_SIZE];
+    static char name[M3U_TEST_CHUNK_SIZE*4];
+    static char expected[M3U_TEST_TEXT_SIZE];
+    struct m3u_playlist playlist;
+    int ret = -1;
+
+    // 1: a long relative uri, 2: a uri over the reader, 3: after a long title, 4: plain
+    m3u_test_line(name, 1, 1500);
+    int pos = snprintf(text, sizeof(text), "#EXTM3U\n#EXT-X-TARGETDURATION:4\n#EXT-X-MEDIA-SEQUENCE:1\n"
+                       "#EXTINF:4.000,\n%s.ts\n", name);
+    m3u_test_line(name, 2, 5000);
+    pos += snprintf(text + pos, sizeof(text) - pos, "#EXTINF:4.000,\n%s.ts\n", name);
+    m3u_test_line(name, 3, 5000);
+    pos += snprintf(text + pos, sizeof(text) - pos, "#EXTINF:4.000,%s\nseg3.ts\n", name);
+    snprintf(text + pos, sizeof(text) - pos, "#EXTINF:4.000,\nseg4.ts\n#EXT-X-ENDLIST\n");
+    m3u_test_serve(url, text);
+
+    m3u_playlist_init(&playlist, &g_source_ops, url);
+    M3U_TEST_CHECK(m3u_playlist_resolve(&playlist) == 3);
+    M3U_TEST_CHECK(playlist.next_sequence == 5 && playlist.endlist);
+    long long sequence = 0;
+    m3u_test_line(name, 1, 1500);
+    snprintf(expected, sizeof(expected), "http://host/long/%s.ts", name);
+    M3U_TEST_CHECK(strcmp(m3u_list_front(&playlist.list, &sequence), expected) == 0 && sequence == 1);
+    m3u_list_pop(&playlist.list);
+    M3U_TEST_CHECK(m3u_test_expect(&playlist, "http://host/long/seg", 3, 2) == 0);
+    ret = 0;
+
+test_out:
+    m3u_test_serve(url, NULL);
+    m3u_playlist_clear(&playlist);
+    return ret;
+}
+
+// Segments queued as they are added never grow the arrays, queued urls are compacted away
+static int m3u_test_compact(void)
+{
+    struct m3u_list list;
+    char url[512];
+    long long added = 0, queued = 0;
+    int capacity = 0, strings_size = 0;
+    int ret = -1;
+
+    memset(&list, 0x0, sizeof(list));
+    for (int round = 0; round < 1000; round++) {
+        // a few segments ahead, of urls from a few bytes to a few hundred
+        while (added - queued < 12) {
+            snprintf(url, sizeof(url), "http://host/%0*lld.ts", (int)(added*37 % 400), added);
+            M3U_TEST_CHECK(m3u_list_insert(&list, url, added) == 0);
+            added++;
+        }
+        for (int i = 0; i < 3; i++, queued++) {
+            long long sequence = 0;
+            const char *front = m3u_list_front(&list, &sequence);
+            snprintf(url, sizeof(url), "http://host/%0*lld.ts", (int)(queued*37 % 400), queued);
+            if (sequence != queued || strcmp(front, url) != 0) {
+                OS_LOGE(LOG_TAG, "Segment [%lld]%.32s, expected [%lld]%.32s", sequence, front, queued, url);
+                goto test_out;
+            }
+            m3u_list_pop(&list);
+        }
+        if (round == 100) {
+            capacity = list.capacity;
+            strings_size = list.strings_size;
+        }
+    }
+    // sized by the segments ahead once settled
+    M3U_TEST_CHECK(list.capacity == capacity && list.strings_size == strings_size);
+    M3U_TEST_CHECK(list.capacity <= 16 && list.strings_size <= 1024*8);
+    ret = 0;
+
+test_out:
+    m3u_list_clear(&list);
+    return ret;
+}
+
+struct m3u_test_uri {
+    const char *base;
+    const char *line;
+    const char *expected; // NULL if not resolved
+};
+
+static const struct m3u_test_uri g_uris[] = {
+    { "http://host/a/b/index.m3u8",  "seg.ts",                 "http://host/a/b/seg.ts" },
+    { "http://host/a/b/index.m3u8",  "c/seg.ts?k=v",           "http://host/a/b/c/seg.ts?k=v" },
+    { "http://host/a/b/index.m3u8",  "/seg.ts",                "http://host/seg.ts" },
+    { "https://host:8080/a/x.m3u8",  "/b/seg.ts",              "https://host:8080/b/seg.ts" },
+    { "http://host/a/index.m3u8",    "//cdn/seg.ts",           "http://cdn/seg.ts" },
+    { "https://host/a/index.m3u8",   "//cdn/seg.ts",           "https://cdn/seg.ts" },
+    { "http://host/a/index.m3u8",    "https://cdn/seg.ts",     "https://cdn/seg.ts" },
+    { "index.m3u8",                  "seg.ts",                 NULL },
+    { "http://host",                 "/seg.ts",                NULL },
+};
+
+static int m3u_test_uris(void)
+{
+    static char base[M3U_TEST_TEXT_SIZE];
+    static char name[M3U_TEST_TEXT_SIZE];
+    static char line[M3U_TEST_TEXT_SIZE];
+    static char expected[M3U_TEST_TEXT_SIZE*2];
+    char *uri = NULL;
+    int ret = -1;
+
+    for (int i = 0; i < (int)(sizeof(g_uris)/sizeof(g_uris[0])); i++) {
+        const struct m3u_test_uri *tc = &g_uris[i];
+        uri = m3u_parser_resolve_uri(tc->base, tc->line);
+        if (tc->expected == NULL ? uri != NULL : uri == NULL || strcmp(uri, tc->expected) != 0) {
+            OS_LOGE(LOG_TAG, "Resolved %s in %s to %s, expected %s", tc->line, tc->base,
+                    uri != NULL ? uri : "(null)", tc->expected != NULL ? tc->expected : "(null)");
+            goto test_out;
+        }
+        audio_free(uri);
+        uri = NULL;
+    }
+
+    // long base and line of each kind, never truncated
+    int len = snprintf(base, sizeof(base), "https://host/");
+    m3u_test_line(base + len, 0, 3000);
+    strcat(base, "/index.m3u8");
+    m3u_test_line(name, 1, 3000);
+    const char *prefixes[] = { "", "/", "//", "http://host/" };
+    for (int i = 0; i < (int)(sizeof(prefixes)/sizeof(prefixes[0])); i++) {
+        snprintf(line, sizeof(line), "%s%s", prefixes[i], name);
+        if (i == 0)
+            snprintf(expected, sizeof(expected), "%.*s%s", (int)(strrchr(base, '/') + 1 - base), base, line);
+        else if (i == 1)
+            snprintf(expected, sizeof(expected), "https://host%s", line);
+        else if (i == 2)
+            snprintf(expected, sizeof(expected), "https:%s", line);
+        else
+            snprintf(expected, sizeof(expected), "%s", line);
+        uri = m3u_parser_resolve_uri(base, line);
+        M3U_TEST_CHECK(uri != NULL && strcmp(uri, expected) == 0);
+        audio_free(uri);
+        uri = NULL;
+    }
+    ret = 0;
+
+test_out:
+    if (uri != NULL)
+        audio_free(uri);
+    return ret;
+}
+
+int main()
+{
+    int (*tests[])(void) = {
+        m3u_test_live, m3u_test_plain, m3u_test_master, m3u_test_variants,
+        m3u_test_reader, m3u_test_long_lines,
+    };
+    if (m3u_test_compact() != 0 || m3u_test_uris() != 0)
+        return -1;
+    for (int r = 0; r < (int)(sizeof(g_read_sizes)/sizeof(g_read_sizes[0])); r++) {
+        memset(&g_server, 0x0, sizeof(g_server));
+        g_server.read_size = g_read_sizes[r];
+        for (int i = 0; i < (int)(sizeof(tests)/sizeof(tests[0])); i++) {
+            if (tests[i]() != 0) {
+                OS_LOGE(LOG_TAG, "Failed with reads of %d bytes", g_read_sizes[r]);
+                return -1;
+            }
+        }
+        OS_LOGI(LOG_TAG, "Succeed with reads of %d bytes, %d playlists opened", g_read_sizes[r], g_server.opens);
+    }
+    return 0;
+}
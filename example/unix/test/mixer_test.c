@@ -0,0 +1,198 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Mix a stereo input and a mono input with gain into a capture sink, check the mixed pcm,
+// including saturation and the non-simd tail of a period.
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osal/os_thread.h"
+#include "cutils/log_helper.h"
+#include "liteplayer_mixer.h"
+
+#define LOG_TAG "mixer_test"
+
+#define MIXER_TEST_RATE         ( 22050 )
+#define MIXER_TEST_PERIOD_MS    ( 200 )   // long period, so the mixer waits for both inputs
+#define MIXER_TEST_FRAMES       ( MIXER_TEST_RATE*MIXER_TEST_PERIOD_MS/1000 ) // 4410, odd tail for simd
+#define MIXER_TEST_PERIODS      ( 2 )
+
+struct capture_sink {
+    short pcm[MIXER_TEST_FRAMES*MIXER_TEST_PERIODS*2];
+    int bytes;
+    int opens;
+    int closes;
+};
+
+static struct capture_sink g_capture;
+
+static const char *capture_name()
+{
+    return "capture";
+}
+
+static sink_handle_t capture_open(int samplerate, int channels, int bits, void *priv_data)
+{
+    struct capture_sink *capture = (struct capture_sink *)priv_data;
+    if (samplerate != MIXER_TEST_RATE || channels != 2 || bits != 16) {
+        OS_LOGE(LOG_TAG, "Unexpected sink format: rate:%d, channels:%d, bits:%d", samplerate, channels, bits);
+        return NULL;
+    }
+    capture->opens++;
+    return capture;
+}
+
+static int capture_write(sink_handle_t handle, char *buffer, int size)
+{
+    struct capture_sink *capture = (struct capture_sink *)handle;
+    int room = (int)sizeof(capture->pcm) - capture->bytes;
+    if (size > room) {
+        OS_LOGE(LOG_TAG, "Sink overflow, %d bytes more than expected", size - room);
+        size = room;
+    }
+    memcpy((char *)capture->pcm + capture->bytes, buffer, size);
+    capture->bytes += size;
+    return size;
+}
+
+static void capture_close(sink_handle_t handle)
+{
+    struct capture_sink *capture = (struct capture_sink *)handle;
+    capture->closes++;
+}
+
+// expected mixed sample of @period, stereo input holds +-a, mono input holds b at half gain
+static void mixer_test_expect(int period, short *left, short *right)
+{
+    static const int a[MIXER_TEST_PERIODS] = { 1000, 30000 };
+    static const int b[MIXER_TEST_PERIODS] = { 500, 20000 };
+    int l = a[period] + b[period]/2, r = -a[period] + b[period]/2;
+    *left = l > 32767 ? 32767 : l;
+    *right = r < -32768 ? -32768 : r;
+}
+
+static int mixer_test_write(struct sink_wrapper *wrapper, sink_handle_t sink, short *pcm, int bytes)
+{
+    while (bytes > 0) {
+        int ret = wrapper->write(sink, (char *)pcm, bytes);
+        if (ret < 0)
+            return -1;
+        pcm += ret/sizeof(short);
+        bytes -= ret;
+    }
+    return 0;
+}
+
+int main()
+{
+    static short stereo[MIXER_TEST_FRAMES*MIXER_TEST_PERIODS*2];
+    static short mono[MIXER_TEST_FRAMES*MIXER_TEST_PERIODS];
+    struct mixer_cfg cfg = {
+        .samplerate = MIXER_TEST_RATE,
+        .channels = 2,
+        .period_ms = MIXER_TEST_PERIOD_MS,
+    };
+    struct sink_wrapper capture_ops = {
+        .priv_data = &g_capture,
+        .name = capture_name,
+        .open = capture_open,
+        .write = capture_write,
+        .close = capture_close,
+        .formats = NULL,
+    };
+    mixer_input_handle_t music = NULL, prompt = NULL;
+    struct sink_wrapper *music_ops = NULL, *prompt_ops = NULL;
+    sink_handle_t music_sink = NULL, prompt_sink = NULL;
+    int ret = -1;
+
+    for (int p = 0; p < MIXER_TEST_PERIODS; p++) {
+        for (int i = 0; i < MIXER_TEST_FRAMES; i++) {
+            int f = p*MIXER_TEST_FRAMES + i;
+            stereo[2*f] = p == 0 ? 1000 : 30000;
+            stereo[2*f + 1] = p == 0 ? -1000 : -30000;
+            mono[f] = p == 0 ? 500 : 20000;
+        }
+    }
+
+    mixer_handle_t mixer = mixer_create(&cfg);
+    if (mixer == NULL || mixer_register_sink_wrapper(mixer, &capture_ops) != 0) {
+        OS_LOGE(LOG_TAG, "Failed to create mixer");
+        goto test_out;
+    }
+    music = mixer_input_create(mixer);
+    prompt = mixer_input_create(mixer);
+    if (music == NULL || prompt == NULL || mixer_input_set_gain(prompt, 0.5f, 0) != 0) {
+        OS_LOGE(LOG_TAG, "Failed to create inputs");
+        goto test_out;
+    }
+
+    music_ops = mixer_input_get_sink_wrapper(music);
+    prompt_ops = mixer_input_get_sink_wrapper(prompt);
+    music_sink = music_ops->open(MIXER_TEST_RATE, 2, 16, music_ops->priv_data);
+    prompt_sink = prompt_ops->open(MIXER_TEST_RATE, 1, 16, prompt_ops->priv_data);
+    if (music_sink == NULL || prompt_sink == NULL) {
+        OS_LOGE(LOG_TAG, "Failed to open inputs");
+        goto test_out;
+    }
+    if (mixer_test_write(music_ops, music_sink, stereo, sizeof(stereo)) != 0 ||
+        mixer_test_write(prompt_ops, prompt_sink, mono, sizeof(mono)) != 0) {
+        OS_LOGE(LOG_TAG, "Failed to write inputs");
+        goto test_out;
+    }
+    // close waits until the buffered pcm is mixed
+    music_ops->close(music_sink);
+    music_sink = NULL;
+    prompt_ops->close(prompt_sink);
+    prompt_sink = NULL;
+    mixer_input_destroy(music);
+    music = NULL;
+    mixer_input_destroy(prompt);
+    prompt = NULL;
+    mixer_destroy(mixer); // joins mixer thread, real sink is closed
+    mixer = NULL;
+
+    if (g_capture.opens != 1 || g_capture.closes != 1) {
+        OS_LOGE(LOG_TAG, "Sink opened %d and closed %d times", g_capture.opens, g_capture.closes);
+        goto test_out;
+    }
+    if (g_capture.bytes != (int)sizeof(g_capture.pcm)) {
+        OS_LOGE(LOG_TAG, "Mixed %d bytes, expected %d", g_capture.bytes, (int)sizeof(g_capture.pcm));
+        goto test_out;
+    }
+    for (int f = 0; f < MIXER_TEST_FRAMES*MIXER_TEST_PERIODS; f++) {
+        short left, right;
+        mixer_test_expect(f/MIXER_TEST_FRAMES, &left, &right);
+        if (g_capture.pcm[2*f] != left || g_capture.pcm[2*f + 1] != right) {
+            OS_LOGE(LOG_TAG, "Frame[%d] mixed as (%d, %d), expected (%d, %d)",
+                    f, g_capture.pcm[2*f], g_capture.pcm[2*f + 1], left, right);
+            goto test_out;
+        }
+    }
+
+    OS_LOGI(LOG_TAG, "Succeed to mix %d frames", MIXER_TEST_FRAMES*MIXER_TEST_PERIODS);
+    ret = 0;
+
+test_out:
+    if (music_sink != NULL)
+        music_ops->close(music_sink);
+    if (prompt_sink != NULL)
+        prompt_ops->close(prompt_sink);
+    mixer_input_destroy(music);
+    mixer_input_destroy(prompt);
+    mixer_destroy(mixer);
+    return ret;
+}
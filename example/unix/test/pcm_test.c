@@ -0,0 +1,372 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Check every pcm kernel against a plain scalar reference for all lengths up to a few
+// vectors and some long odd ones, so both the simd body and the scalar tail are covered.
+// Outputs are allocated with guard bytes behind them to catch stores past the end.
+// The file is also built with -mssse3/-mavx2 where the compiler supports it, to cover
+// the wider kernels, and skips itself if the cpu doesn't support them.
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include "cutils/log_helper.h"
+#include "liteplayer_pcm.h"
+
+#define LOG_TAG "pcm_test"
+
+#define PCM_TEST_SHORT_MAX      ( 80 )    // every length up to this, more than 2 avx2 vectors of s16
+#define PCM_TEST_GUARD          ( 64 )    // bytes behind each output
+#define PCM_TEST_GUARD_BYTE     ( 0xA5 )
+
+static const int g_long_lengths[] = { 127, 1023, 4097 };
+
+static unsigned int g_seed = 0x2468ACE1;
+
+static unsigned int pcm_test_rand(void)
+{
+    g_seed = g_seed * 1103515245u + 12345u;
+    return (g_seed >> 8) ^ (g_seed << 16);
+}
+
+// random samples with the extremes sprinkled in
+static void pcm_test_fill_s16(short *buf, int samples)
+{
+    for (int i = 0; i < samples; i++) {
+        unsigned int r = pcm_test_rand();
+        buf[i] = (r & 0xF) == 0 ? SHRT_MIN : ((r & 0xF) == 1 ? SHRT_MAX : (short)(r >> 8));
+    }
+}
+
+static void pcm_test_fill_s32(int *buf, int samples)
+{
+    for (int i = 0; i < samples; i++) {
+        unsigned int r = pcm_test_rand();
+        buf[i] = (r & 0xF) == 0 ? INT_MIN : ((r & 0xF) == 1 ? INT_MAX : (int)(r * 2654435761u));
+    }
+}
+
+// full scale with some samples out of range, for the clipping
+static void pcm_test_fill_f32(float *buf, int samples)
+{
+    for (int i = 0; i < samples; i++)
+        buf[i] = ((int)(pcm_test_rand() & 0xFFFFF) - 0x80000) * (1.25f / 0x80000);
+}
+
+static void *pcm_test_alloc(int bytes)
+{
+    unsigned char *p = malloc(bytes + PCM_TEST_GUARD);
+    if (p != NULL)
+        memset(p, PCM_TEST_GUARD_BYTE, bytes + PCM_TEST_GUARD);
+    return p;
+}
+
+static bool pcm_test_guard_ok(const void *buf, int bytes)
+{
+    const unsigned char *p = (const unsigned char *)buf + bytes;
+    for (int i = 0; i < PCM_TEST_GUARD; i++) {
+        if (p[i] != PCM_TEST_GUARD_BYTE)
+            return false;
+    }
+    return true;
+}
+
+// reference kernels, one sample at a time
+
+static void ref_s16_to_s32(const short *in, int *out, int samples)
+{
+    for (int i = 0; i < samples; i++)
+        out[i] = in[i] * 65536;
+}
+
+static void ref_s32_to_s16(const int *in, short *out, int samples)
+{
+    for (int i = 0; i < samples; i++)
+        out[i] = (short)(in[i] >> 16);
+}
+
+static void ref_s24_to_s32(const unsigned char *in, int *out, int samples)
+{
+    for (int i = 0; i < samples; i++) {
+        int x = in[3*i] | (in[3*i + 1] << 8) | ((signed char)in[3*i + 2] * 65536);
+        out[i] = x * 256;
+    }
+}
+
+static void ref_s32_to_s24(const int *in, unsigned char *out, int samples)
+{
+    for (int i = 0; i < samples; i++) {
+        int x = in[i] >> 8;
+        out[3*i] = (unsigned char)(x & 0xFF);
+        out[3*i + 1] = (unsigned char)((x >> 8) & 0xFF);
+        out[3*i + 2] = (unsigned char)((x >> 16) & 0xFF);
+    }
+}
+
+static void ref_s16_to_f32(const short *in, float *out, int samples)
+{
+    for (int i = 0; i < samples; i++)
+        out[i] = (float)in[i] / 32768.0f;
+}
+
+static void ref_s32_to_f32(const int *in, float *out, int samples)
+{
+    for (int i = 0; i < samples; i++)
+        out[i] = (float)in[i] / 2147483648.0f;
+}
+
+static void ref_f32_to_s32(const float *in, int *out, int samples)
+{
+    for (int i = 0; i < samples; i++) {
+        float x = in[i] * 2147483648.0f;
+        out[i] = x <= -2147483648.0f ? INT_MIN : (x >= 2147483520.0f ? 2147483520 : (int)lrintf(x));
+    }
+}
+
+static void ref_f32_to_s16(const float *in, short *out, int samples)
+{
+    for (int i = 0; i < samples; i++) {
+        float x = in[i] * 32768.0f;
+        out[i] = x <= -32768.0f ? SHRT_MIN : (x >= 32767.0f ? SHRT_MAX : (short)lrintf(x));
+    }
+}
+
+static void ref_gain_s16(short *buf, int samples, int gain_q15)
+{
+    for (int i = 0; i < samples; i++)
+        buf[i] = (short)(((long long)buf[i] * gain_q15 + 16384) >> 15);
+}
+
+static void ref_downmix_s16(const short *in, short *out, int frames)
+{
+    for (int i = 0; i < frames; i++)
+        out[i] = (short)(((int)in[2*i] + in[2*i + 1]) >> 1);
+}
+
+static void ref_downmix_s32(const int *in, int *out, int frames)
+{
+    for (int i = 0; i < frames; i++)
+        out[i] = (int)(((long long)in[2*i] + in[2*i + 1]) >> 1);
+}
+
+static void ref_upmix_s16(const short *in, short *out, int frames)
+{
+    for (int i = 0; i < frames; i++)
+        out[2*i] = out[2*i + 1] = in[i];
+}
+
+static void ref_upmix_s32(const int *in, int *out, int frames)
+{
+    for (int i = 0; i < frames; i++)
+        out[2*i] = out[2*i + 1] = in[i];
+}
+
+// buffers shared by all kernels, large enough for stereo of the longest length in any format
+struct pcm_test_bufs {
+    short *s16;
+    int *s32;
+    unsigned char *s24;
+    float *f32;
+    void *out;
+    void *ref;
+};
+
+static int pcm_test_length(struct pcm_test_bufs *b, int n)
+{
+    int bytes;
+
+#define PCM_TEST_CHECK(name, out_bytes)                                                  \
+    do {                                                                                 \
+        bytes = (out_bytes);                                                             \
+        if (memcmp(b->out, b->ref, bytes) != 0 || !pcm_test_guard_ok(b->out, bytes)) {   \
+            OS_LOGE(LOG_TAG, "%s mismatch with %d samples", name, n);                   \
+            return -1;                                                                   \
+        }                                                                                \
+        memset(b->out, PCM_TEST_GUARD_BYTE, bytes + PCM_TEST_GUARD);                     \
+    } while (0)
+
+    pcm_test_fill_s16(b->s16, 2*n);
+    pcm_test_fill_s32(b->s32, 2*n);
+    pcm_test_fill_f32(b->f32, 2*n);
+    for (int i = 0; i < 3*n; i++)
+        b->s24[i] = (unsigned char)pcm_test_rand();
+
+    pcm_s16_to_s32(b->s16, b->out, n);
+    ref_s16_to_s32(b->s16, b->ref, n);
+    PCM_TEST_CHECK("pcm_s16_to_s32", n*4);
+
+    pcm_s32_to_s16(b->s32, b->out, n);
+    ref_s32_to_s16(b->s32, b->ref, n);
+    PCM_TEST_CHECK("pcm_s32_to_s16", n*2);
+
+    pcm_s24_to_s32(b->s24, b->out, n);
+    ref_s24_to_s32(b->s24, b->ref, n);
+    PCM_TEST_CHECK("pcm_s24_to_s32", n*4);
+
+    pcm_s32_to_s24(b->s32, b->out, n);
+    ref_s32_to_s24(b->s32, b->ref, n);
+    PCM_TEST_CHECK("pcm_s32_to_s24", n*3);
+
+    pcm_s16_to_f32(b->s16, b->out, n);
+    ref_s16_to_f32(b->s16, b->ref, n);
+    PCM_TEST_CHECK("pcm_s16_to_f32", n*4);
+
+    pcm_s32_to_f32(b->s32, b->out, n);
+    ref_s32_to_f32(b->s32, b->ref, n);
+    PCM_TEST_CHECK("pcm_s32_to_f32", n*4);
+
+    pcm_f32_to_s32(b->f32, b->out, n);
+    ref_f32_to_s32(b->f32, b->ref, n);
+    PCM_TEST_CHECK("pcm_f32_to_s32", n*4);
+
+    pcm_f32_to_s16(b->f32, b->out, n, NULL);
+    ref_f32_to_s16(b->f32, b->ref, n);
+    PCM_TEST_CHECK("pcm_f32_to_s16", n*2);
+
+    // tpdf dither moves a sample by at most 1 lsb
+    unsigned int dither_seed = 1;
+    pcm_f32_to_s16(b->f32, b->out, n, &dither_seed);
+    for (int i = 0; i < n; i++) {
+        int diff = ((short *)b->out)[i] - ((short *)b->ref)[i];
+        if (diff < -1 || diff > 1) {
+            OS_LOGE(LOG_TAG, "pcm_f32_to_s16 dither off by %d at %d of %d samples", diff, i, n);
+            return -1;
+        }
+    }
+    if (!pcm_test_guard_ok(b->out, n*2)) {
+        OS_LOGE(LOG_TAG, "pcm_f32_to_s16 dither wrote past %d samples", n);
+        return -1;
+    }
+    memset(b->out, PCM_TEST_GUARD_BYTE, n*2 + PCM_TEST_GUARD);
+
+    static const int gains[] = { 0, 1, 16384, 23170, 32767 };
+    for (int g = 0; g < sizeof(gains)/sizeof(gains[0]); g++) {
+        memcpy(b->out, b->s16, n*2);
+        memcpy(b->ref, b->s16, n*2);
+        pcm_gain_s16(b->out, n, gains[g]);
+        ref_gain_s16(b->ref, n, gains[g]);
+        PCM_TEST_CHECK("pcm_gain_s16", n*2);
+    }
+
+    memcpy(b->out, b->f32, n*4);
+    memcpy(b->ref, b->f32, n*4);
+    pcm_gain_f32(b->out, n, 0.7f);
+    for (int i = 0; i < n; i++)
+        ((float *)b->ref)[i] *= 0.7f;
+    PCM_TEST_CHECK("pcm_gain_f32", n*4);
+
+    // the simd ramp advances its gains per vector, so it may differ in the last bits
+    for (int channels = 1; channels <= 2; channels++) {
+        int frames = n / channels;
+        float gain = 0.25f, step = 0.5f / (frames + 1);
+        memcpy(b->out, b->f32, frames*channels*4);
+        pcm_ramp_f32(b->out, frames, channels, gain, step);
+        for (int i = 0; i < frames*channels; i++) {
+            float expected = b->f32[i] * (gain + step * (i / channels));
+            if (fabsf(((float *)b->out)[i] - expected) > 1e-4f) {
+                OS_LOGE(LOG_TAG, "pcm_ramp_f32 off at %d of %d frames x %d", i, frames, channels);
+                return -1;
+            }
+        }
+        if (!pcm_test_guard_ok(b->out, frames*channels*4)) {
+            OS_LOGE(LOG_TAG, "pcm_ramp_f32 wrote past %d frames x %d", frames, channels);
+            return -1;
+        }
+        memset(b->out, PCM_TEST_GUARD_BYTE, frames*channels*4 + PCM_TEST_GUARD);
+    }
+
+    pcm_downmix_s16(b->s16, b->out, n);
+    ref_downmix_s16(b->s16, b->ref, n);
+    PCM_TEST_CHECK("pcm_downmix_s16", n*2);
+
+    pcm_downmix_s32(b->s32, b->out, n);
+    ref_downmix_s32(b->s32, b->ref, n);
+    PCM_TEST_CHECK("pcm_downmix_s32", n*4);
+
+    pcm_upmix_s16(b->s16, b->out, n);
+    ref_upmix_s16(b->s16, b->ref, n);
+    PCM_TEST_CHECK("pcm_upmix_s16", n*4);
+
+    pcm_upmix_s32(b->s32, b->out, n);
+    ref_upmix_s32(b->s32, b->ref, n);
+    PCM_TEST_CHECK("pcm_upmix_s32", n*8);
+
+    // 24 bits goes through the blocks of the format helpers, compare with the s32 kernels
+    pcm_to_f32((const char *)b->s24, 24, b->out, n);
+    ref_s24_to_s32(b->s24, (int *)b->s32, n);
+    ref_s32_to_f32(b->s32, b->ref, n);
+    PCM_TEST_CHECK("pcm_to_f32", n*4);
+
+    pcm_from_f32(b->f32, b->out, 24, n, NULL);
+    ref_f32_to_s32(b->f32, b->s32, n);
+    ref_s32_to_s24(b->s32, b->ref, n);
+    PCM_TEST_CHECK("pcm_from_f32", n*3);
+
+#undef PCM_TEST_CHECK
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#if defined(__AVX2__)
+    if (!__builtin_cpu_supports("avx2")) {
+        OS_LOGI(LOG_TAG, "Skipped, avx2 isn't supported by the cpu");
+        return 0;
+    }
+#elif defined(__SSSE3__)
+    if (!__builtin_cpu_supports("ssse3")) {
+        OS_LOGI(LOG_TAG, "Skipped, ssse3 isn't supported by the cpu");
+        return 0;
+    }
+#endif
+#endif
+
+    int max = g_long_lengths[sizeof(g_long_lengths)/sizeof(g_long_lengths[0]) - 1];
+    struct pcm_test_bufs b = {
+        .s16 = pcm_test_alloc(2*max*sizeof(short)),
+        .s32 = pcm_test_alloc(2*max*sizeof(int)),
+        .s24 = pcm_test_alloc(3*max),
+        .f32 = pcm_test_alloc(2*max*sizeof(float)),
+        .out = pcm_test_alloc(2*max*sizeof(int)),
+        .ref = pcm_test_alloc(2*max*sizeof(int)),
+    };
+    int ret = -1;
+    if (b.s16 == NULL || b.s32 == NULL || b.s24 == NULL || b.f32 == NULL || b.out == NULL || b.ref == NULL)
+        goto test_out;
+
+    for (int n = 0; n <= PCM_TEST_SHORT_MAX; n++) {
+        if (pcm_test_length(&b, n) != 0)
+            goto test_out;
+    }
+    for (int i = 0; i < sizeof(g_long_lengths)/sizeof(g_long_lengths[0]); i++) {
+        if (pcm_test_length(&b, g_long_lengths[i]) != 0)
+            goto test_out;
+    }
+    ret = 0;
+    OS_LOGI(LOG_TAG, "All pcm kernels match the references");
+
+test_out:
+    free(b.s16);
+    free(b.s32);
+    free(b.s24);
+    free(b.f32);
+    free(b.out);
+    free(b.ref);
+    return ret;
+}
@@ -0,0 +1,375 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Download segments from a fake source of random latency and short reads, with opens and
+// reads failing in the middle of segments, by 1 to 4 workers: segments must be read in
+// order and byte exact, resumed where they failed, and a segment failing for good must be
+// dropped alone. Bytes downloaded ahead of the reader must stay in the cache size, and
+// segments behind the playing one in three quarters of it, also when the playing one is
+// the slow one.
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osal/os_thread.h"
+#include "osal/os_time.h"
+#include "cutils/log_helper.h"
+#include "esp_adf/audio_common.h"
+#include "liteplayer_config.h"
+#include "liteplayer_prefetch.h"
+
+#define LOG_TAG "prefetch_test"
+
+#define PREFETCH_TEST_SEGMENTS   ( 12 )
+#define PREFETCH_TEST_CACHE_SIZE ( 1024*64 )
+#define PREFETCH_TEST_READ_MAX   ( 1024*9 )
+#define PREFETCH_TEST_QUIET_MS   ( 5000 )
+#define PREFETCH_TEST_TIMEOUT_MS ( 20000 )
+
+struct prefetch_test_segment {
+    int size;
+    int fail_at;      // a read from here fails once, 0 if never
+    int open_fails;   // opens to fail
+    int downloaded;
+};
+
+struct prefetch_test_server {
+    os_mutex lock;
+    os_cond cond;       // signaled when a run is over
+    bool running;
+    struct prefetch_test_segment segs[PREFETCH_TEST_SEGMENTS];
+    int head;           // segment the reader is reading
+    bool slow_head;     // reads of the head segment are slow
+    int busy;           // opens and reads in progress
+    long long downloaded;
+    long long consumed;
+    long long peak_cached;
+    long long peak_behind;
+    int failures;       // injected failures of opens and reads
+    int errors;
+    unsigned int seed;
+};
+
+struct prefetch_test_stream {
+    int index;
+    int pos;
+};
+
+static struct prefetch_test_server g_server;
+
+static unsigned char prefetch_test_byte(int index, int pos)
+{
+    return (unsigned char)(index*37 + pos + (pos >> 8)*3);
+}
+
+// Called with lock held
+static int prefetch_test_rand(int range)
+{
+    g_server.seed = g_server.seed*1103515245 + 12345;
+    return (int)((g_server.seed >> 16) % range);
+}
+
+static void prefetch_test_error(const char *what, int index, int value)
+{
+    OS_LOGE(LOG_TAG, "Segment %d: %s, %d", index, what, value);
+    g_server.errors++;
+}
+
+static source_handle_t prefetch_test_open(const char *url, long long content_pos, void *priv_data)
+{
+    int index = -1;
+    if (sscanf(url, "seg%d", &index) != 1 || index < 0 || index >= PREFETCH_TEST_SEGMENTS)
+        return NULL;
+    struct prefetch_test_segment *seg = &g_server.segs[index];
+    struct prefetch_test_stream *stream = NULL;
+
+    os_mutex_lock(g_server.lock);
+    g_server.busy++;
+    int latency = prefetch_test_rand(3);
+    os_mutex_unlock(g_server.lock);
+    os_thread_sleep_msec(latency);
+    os_mutex_lock(g_server.lock);
+    if (seg->open_fails > 0) {
+        seg->open_fails--;
+        g_server.failures++;
+    } else {
+        // reconnected download goes on where it failed
+        if (content_pos != seg->downloaded)
+            prefetch_test_error("opened at wrong position", index, (int)content_pos);
+        stream = calloc(1, sizeof(struct prefetch_test_stream));
+        if (stream != NULL) {
+            stream->index = index;
+            stream->pos = (int)content_pos;
+        }
+    }
+    g_server.busy--;
+    os_mutex_unlock(g_server.lock);
+    return stream;
+}
+
+static int prefetch_test_read(source_handle_t handle, char *buffer, int size)
+{
+    struct prefetch_test_stream *stream = (struct prefetch_test_stream *)handle;
+    struct prefetch_test_segment *seg = &g_server.segs[stream->index];
+    int ret = -1;
+
+    os_mutex_lock(g_server.lock);
+    g_server.busy++;
+    int latency = (g_server.slow_head && stream->index == g_server.head) ? 4 : prefetch_test_rand(2);
+    os_mutex_unlock(g_server.lock);
+    os_thread_sleep_msec(latency);
+
+    os_mutex_lock(g_server.lock);
+    if (seg->fail_at > 0 && stream->pos >= seg->fail_at) {
+        seg->fail_at = 0;
+        g_server.failures++;
+        goto read_out;
+    }
+    ret = seg->size - stream->pos;
+    if (ret > size)
+        ret = size;
+    if (ret > 0)
+        ret = 1 + prefetch_test_rand(ret);
+    for (int i = 0; i < ret; i++)
+        buffer[i] = (char)prefetch_test_byte(stream->index, stream->pos + i);
+    stream->pos += ret;
+    seg->downloaded += ret;
+    g_server.downloaded += ret;
+
+    // reads have reserved their room in the cache, and the reader may just have drained some
+    long long cached = g_server.downloaded - g_server.consumed;
+    if (cached > PREFETCH_TEST_CACHE_SIZE + PREFETCH_TEST_READ_MAX)
+        prefetch_test_error("cache size exceeded", stream->index, (int)cached);
+    if (cached > g_server.peak_cached)
+        g_server.peak_cached = cached;
+    long long behind = 0;
+    for (int i = g_server.head + 1; i < PREFETCH_TEST_SEGMENTS; i++)
+        behind += g_server.segs[i].downloaded;
+    if (behind > PREFETCH_TEST_CACHE_SIZE - PREFETCH_TEST_CACHE_SIZE/4)
+        prefetch_test_error("quarter of playing segment taken", stream->index, (int)behind);
+    if (behind > g_server.peak_behind)
+        g_server.peak_behind = behind;
+
+read_out:
+    g_server.busy--;
+    os_mutex_unlock(g_server.lock);
+    return ret;
+}
+
+static void prefetch_test_close(source_handle_t handle)
+{
+    free(handle);
+}
+
+static struct source_wrapper g_source_ops = {
+    .async_mode = false,
+    .buffer_size = 0,
+    .priv_data = NULL,
+    .url_protocol = NULL,
+    .open = prefetch_test_open,
+    .read = prefetch_test_read,
+    .content_pos = NULL,
+    .content_len = NULL,
+    .seek = NULL,
+    .close = prefetch_test_close,
+};
+
+struct prefetch_test_case {
+    int workers;
+    bool slow_head;     // playing segment is slower than the ones behind
+    bool slow_reader;   // reader is slower than the downloads
+    int fail_for_good;  // segment never opened, -1 if none
+};
+
+// Queue segments as workers are vacant, as the m3u source does
+static int prefetch_test_queue(segment_prefetch_handle_t prefetch, int *next)
+{
+    char url[32];
+    while (*next < PREFETCH_TEST_SEGMENTS && segment_prefetch_vacancy(prefetch) > 0) {
+        snprintf(url, sizeof(url), "seg%d", *next);
+        if (segment_prefetch_queue(prefetch, url, 0) != 0)
+            return -1;
+        (*next)++;
+    }
+    return 0;
+}
+
+static int prefetch_test_read_segment(segment_prefetch_handle_t prefetch, int index, bool slow)
+{
+    static const int sizes[] = { 1, 700, 4096, PREFETCH_TEST_READ_MAX, 333 };
+    static char buffer[PREFETCH_TEST_READ_MAX];
+    int size = g_server.segs[index].size;
+    int pos = 0;
+
+    for (int k = 0; ; k++) {
+        int ret = segment_prefetch_read(prefetch, buffer, sizes[k % (sizeof(sizes)/sizeof(sizes[0]))]);
+        if (ret <= 0)
+            return ret == 0 && pos == size ? 0 : -1;
+        for (int i = 0; i < ret; i++) {
+            if ((unsigned char)buffer[i] != prefetch_test_byte(index, pos + i)) {
+                OS_LOGE(LOG_TAG, "Segment %d: wrong byte at %d", index, pos + i);
+                return -1;
+            }
+        }
+        pos += ret;
+        os_mutex_lock(g_server.lock);
+        g_server.consumed += ret;
+        if (pos == size)
+            g_server.head = index + 1;
+        os_mutex_unlock(g_server.lock);
+        if (slow && k % 4 == 0)
+            os_thread_sleep_msec(1);
+    }
+}
+
+// Abort the reader if a run is stuck, e.g. the playing segment is starved
+static void *prefetch_test_watchdog(void *arg)
+{
+    segment_prefetch_handle_t prefetch = (segment_prefetch_handle_t)arg;
+    unsigned long long deadline = os_monotonic_usec() + PREFETCH_TEST_TIMEOUT_MS*1000ULL;
+
+    os_mutex_lock(g_server.lock);
+    while (g_server.running) {
+        unsigned long long now = os_monotonic_usec();
+        if (now >= deadline) {
+            OS_LOGE(LOG_TAG, "Timeout, reading segment %d", g_server.head);
+            g_server.errors++;
+            segment_prefetch_abort(prefetch);
+            break;
+        }
+        os_cond_timedwait(g_server.cond, g_server.lock, (unsigned long)(deadline - now));
+    }
+    os_mutex_unlock(g_server.lock);
+    return NULL;
+}
+
+static int prefetch_test_run(const struct prefetch_test_case *tc)
+{
+    int ret = -1, next = 0, failed = 0;
+    struct os_thread_attr attr = {
+        .name = "prefetch_test_watchdog",
+        .priority = OS_THREAD_PRIO_NORMAL,
+        .stacksize = os_thread_default_stacksize(),
+        .joinable = true,
+    };
+
+    memset(g_server.segs, 0x0, sizeof(g_server.segs));
+    for (int i = 0; i < PREFETCH_TEST_SEGMENTS; i++)
+        g_server.segs[i].size = 20000 + (i*7919) % 50000;
+    g_server.segs[3].fail_at = g_server.segs[3].size/2;
+    g_server.segs[7].fail_at = 1;
+    g_server.segs[5].open_fails = 1;
+    if (tc->fail_for_good >= 0)
+        g_server.segs[tc->fail_for_good].open_fails = DEFAULT_M3U_PREFETCH_RETRY + 1;
+    g_server.head = 0;
+    g_server.slow_head = tc->slow_head;
+    g_server.downloaded = g_server.consumed = 0;
+    g_server.peak_cached = g_server.peak_behind = 0;
+    g_server.failures = g_server.errors = 0;
+    g_server.seed = tc->workers;
+
+    segment_prefetch_handle_t prefetch =
+        segment_prefetch_create(&g_source_ops, tc->workers, PREFETCH_TEST_CACHE_SIZE);
+    if (prefetch == NULL)
+        return -1;
+    g_server.running = true;
+    os_thread watchdog = os_thread_create(&attr, prefetch_test_watchdog, prefetch);
+    if (watchdog == NULL)
+        goto test_out;
+
+    for (int i = 0; i < PREFETCH_TEST_SEGMENTS; i++) {
+        if (prefetch_test_queue(prefetch, &next) != 0)
+            goto test_out;
+        if (prefetch_test_read_segment(prefetch, i, tc->slow_reader) != 0) {
+            if (i != tc->fail_for_good) {
+                OS_LOGE(LOG_TAG, "Failed to read segment %d", i);
+                goto test_out;
+            }
+            failed++;
+            os_mutex_lock(g_server.lock);
+            g_server.head = i + 1;
+            os_mutex_unlock(g_server.lock);
+        }
+    }
+    if (segment_prefetch_read(prefetch, NULL, 0) != -1 || failed != (tc->fail_for_good >= 0 ? 1 : 0))
+        goto test_out;
+
+    // every failure is reconnected, but the last one of the segment failing for good
+    int reconnects = segment_prefetch_reconnects(prefetch);
+    int expected = g_server.failures - failed;
+    if (reconnects != expected) {
+        OS_LOGE(LOG_TAG, "%d reconnects, %d expected", reconnects, expected);
+        goto test_out;
+    }
+    ret = 0;
+
+test_out:
+    os_mutex_lock(g_server.lock);
+    g_server.running = false;
+    os_cond_signal(g_server.cond);
+    os_mutex_unlock(g_server.lock);
+    if (watchdog != NULL)
+        os_thread_join(watchdog, NULL);
+    segment_prefetch_destroy(prefetch);
+    // workers outlive the handle, wait for their last open or read
+    for (int i = 0; i < PREFETCH_TEST_QUIET_MS; i++) {
+        os_mutex_lock(g_server.lock);
+        bool quiet = g_server.busy == 0;
+        os_mutex_unlock(g_server.lock);
+        if (quiet)
+            break;
+        os_thread_sleep_msec(1);
+    }
+    if (g_server.errors != 0)
+        ret = -1;
+    OS_LOGI(LOG_TAG, "%d workers%s%s: %s, %d failures, peak cached %lld, behind playing %lld",
+            tc->workers, tc->slow_head ? ", slow playing segment" : "",
+            tc->slow_reader ? ", slow reader" : "", ret == 0 ? "passed" : "failed",
+            g_server.failures, g_server.peak_cached, g_server.peak_behind);
+    return ret;
+}
+
+int main()
+{
+    static const struct prefetch_test_case cases[] = {
+        { 1, false, false, -1 },
+        { 2, false, false,  9 },
+        { 4, false, true,  -1 },
+        { 4, true,  false, -1 },
+    };
+    int ret = 0;
+
+    g_server.lock = os_mutex_create();
+    g_server.cond = os_cond_create();
+    if (g_server.lock == NULL || g_server.cond == NULL)
+        return -1;
+    for (int i = 0; i < (int)(sizeof(cases)/sizeof(cases[0])); i++) {
+        if (prefetch_test_run(&cases[i]) != 0) {
+            ret = -1;
+            continue;
+        }
+        // the cache is filled up to its size by a slow reader, and up to three quarters of
+        // it by segments behind a slow playing one
+        if (cases[i].slow_reader && g_server.peak_cached < PREFETCH_TEST_CACHE_SIZE/2)
+            ret = -1;
+        if (cases[i].slow_head && g_server.peak_behind < PREFETCH_TEST_CACHE_SIZE/2)
+            ret = -1;
+    }
+    os_cond_destroy(g_server.cond);
+    os_mutex_destroy(g_server.lock);
+    OS_LOGI(LOG_TAG, "Prefetch test %s", ret == 0 ? "passed" : "failed");
+    return ret;
+}
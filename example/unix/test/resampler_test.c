@@ -0,0 +1,151 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Resample dc pcm with common ratios, check the output length matches the ratio once the
+// tail is flushed, the output doesn't depend on how the input is split, the dc level is
+// kept, and the resampler restarts cleanly after flushing.
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cutils/log_helper.h"
+#include "liteplayer_resampler.h"
+
+#define LOG_TAG "resampler_test"
+
+#define RESAMPLER_TEST_FRAMES   ( 10007 ) // input frames of each run, prime so chunks don't align
+#define RESAMPLER_TEST_LEVEL    ( 10000 )
+#define RESAMPLER_TEST_MARGIN   ( 16 )    // input frames at both ends ringing from the edges, > half taps
+
+struct resampler_test_case {
+    int in_rate;
+    int out_rate;
+    int channels;
+};
+
+static const struct resampler_test_case g_cases[] = {
+    { 44100, 48000, 2 },
+    { 48000, 44100, 2 },
+    { 22050, 48000, 1 },
+    { 8000,  16000, 1 },
+    { 16000, 8000,  2 },
+    { 11025, 44100, 2 },
+};
+
+// feed the input in chunks of @chunk frames, then flush, returns frames output
+static int resampler_test_run(resampler_handle_t rs, const short *in, int channels, int chunk, short *out)
+{
+    int out_frames = 0;
+    for (int pos = 0; pos < RESAMPLER_TEST_FRAMES; pos += chunk) {
+        int frames = RESAMPLER_TEST_FRAMES - pos < chunk ? RESAMPLER_TEST_FRAMES - pos : chunk;
+        int ret = resampler_process(rs, in + pos*channels, frames, out + out_frames*channels);
+        if (ret < 0 || ret > resampler_get_output_frames(rs, frames))
+            return -1;
+        out_frames += ret;
+    }
+    int ret = resampler_flush(rs, out + out_frames*channels);
+    if (ret < 0 || ret > resampler_get_output_frames(rs, 0))
+        return -1;
+    return out_frames + ret;
+}
+
+static int resampler_test_case(const struct resampler_test_case *tc, short *in, short *out, short *ref)
+{
+    int channels = tc->channels;
+    // an output frame for each output period that starts before the end of input
+    int expected = (int)(((long long)RESAMPLER_TEST_FRAMES * tc->out_rate + tc->in_rate - 1) / tc->in_rate);
+    int margin = RESAMPLER_TEST_MARGIN * tc->out_rate / tc->in_rate + 1;
+    static const int chunks[] = { RESAMPLER_TEST_FRAMES, 1, 7, 480, 4096 };
+    int ret = -1;
+
+    resampler_handle_t rs = resampler_create(tc->in_rate, tc->out_rate, channels);
+    if (rs == NULL) {
+        OS_LOGE(LOG_TAG, "Failed to create resampler %d->%d", tc->in_rate, tc->out_rate);
+        return -1;
+    }
+
+    for (int i = 0; i < RESAMPLER_TEST_FRAMES * channels; i++)
+        in[i] = (i % channels) == 0 ? RESAMPLER_TEST_LEVEL : -RESAMPLER_TEST_LEVEL;
+
+    // the first run is the reference, the flush resets the resampler for the next ones
+    for (int c = 0; c < (int)(sizeof(chunks)/sizeof(chunks[0])); c++) {
+        short *dst = c == 0 ? ref : out;
+        int frames = resampler_test_run(rs, in, channels, chunks[c], dst);
+        if (frames != expected) {
+            OS_LOGE(LOG_TAG, "%d->%d, chunk %d: output %d frames, expected %d",
+                    tc->in_rate, tc->out_rate, chunks[c], frames, expected);
+            goto test_out;
+        }
+        if (c > 0 && memcmp(out, ref, frames * channels * sizeof(short)) != 0) {
+            OS_LOGE(LOG_TAG, "%d->%d, chunk %d: output differs from single run",
+                    tc->in_rate, tc->out_rate, chunks[c]);
+            goto test_out;
+        }
+    }
+
+    // dc passes the filter with unity gain, each phase is normalized
+    for (int i = margin; i < expected - margin; i++) {
+        for (int ch = 0; ch < channels; ch++) {
+            int level = ch == 0 ? RESAMPLER_TEST_LEVEL : -RESAMPLER_TEST_LEVEL;
+            int diff = ref[i*channels + ch] - level;
+            if (diff < -2 || diff > 2) {
+                OS_LOGE(LOG_TAG, "%d->%d: frame[%d] ch[%d] is %d, expected %d",
+                        tc->in_rate, tc->out_rate, i, ch, ref[i*channels + ch], level);
+                goto test_out;
+            }
+        }
+    }
+
+    // the flushed tail still carries the signal up to the output of the last input frame
+    int last = ref[(int)((long long)(RESAMPLER_TEST_FRAMES - 1) * tc->out_rate / tc->in_rate) * channels];
+    if (last < RESAMPLER_TEST_LEVEL/4) {
+        OS_LOGE(LOG_TAG, "%d->%d: last frame is %d, tail is lost", tc->in_rate, tc->out_rate, last);
+        goto test_out;
+    }
+
+    OS_LOGI(LOG_TAG, "Succeed to resample %d->%d, %dch: %d->%d frames",
+            tc->in_rate, tc->out_rate, channels, RESAMPLER_TEST_FRAMES, expected);
+    ret = 0;
+
+test_out:
+    resampler_destroy(rs);
+    return ret;
+}
+
+int main()
+{
+    int out_size = RESAMPLER_TEST_FRAMES * 4 * 2 + 1024;
+    short *in = malloc(RESAMPLER_TEST_FRAMES * 2 * sizeof(short));
+    short *out = malloc(out_size * sizeof(short));
+    short *ref = malloc(out_size * sizeof(short));
+    int ret = -1;
+
+    if (in == NULL || out == NULL || ref == NULL) {
+        OS_LOGE(LOG_TAG, "Failed to allocate buffers");
+        goto test_out;
+    }
+    for (int i = 0; i < (int)(sizeof(g_cases)/sizeof(g_cases[0])); i++) {
+        if (resampler_test_case(&g_cases[i], in, out, ref) != 0)
+            goto test_out;
+    }
+    ret = 0;
+
+test_out:
+    free(in);
+    free(out);
+    free(ref);
+    return ret;
+}
@@ -0,0 +1,119 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Record spans from many more threads than there are rings, some exit without releasing
+// theirs as application and executor threads do, one at a time and then in batches of a
+// full set of rings: every span must be in the dump and none dropped.
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osal/os_thread.h"
+#include "cutils/log_helper.h"
+#include "liteplayer_config.h"
+#include "liteplayer_trace_internal.h"
+
+#define LOG_TAG "trace_test"
+
+#define TRACE_TEST_ROUNDS   ( 4 )
+#define TRACE_TEST_DUMP_SIZE ( 1024*1024 )
+
+struct trace_test_dump {
+    char *text;
+    int len;
+};
+
+static void *trace_test_thread(void *arg)
+{
+    bool release = (bool)(long)arg;
+    LITEPLAYER_TRACE_BEGIN(ts);
+    LITEPLAYER_TRACE_END(ts, "trace_test_span");
+    if (release)
+        LITEPLAYER_TRACE_THREAD_EXIT();
+    return NULL;
+}
+
+static int trace_test_writer(const char *data, int len, void *priv)
+{
+    struct trace_test_dump *dump = (struct trace_test_dump *)priv;
+    if (dump->len + len >= TRACE_TEST_DUMP_SIZE)
+        return -1;
+    memcpy(dump->text + dump->len, data, len);
+    dump->len += len;
+    dump->text[dump->len] = '\0';
+    return 0;
+}
+
+static int trace_test_count(const char *text, const char *what)
+{
+    int count = 0;
+    for (const char *p = strstr(text, what); p != NULL; p = strstr(p + 1, what))
+        count++;
+    return count;
+}
+
+// Run @threads threads at a time, @batches times, and check all their spans are dumped
+static int trace_test_run(int threads, int batches)
+{
+    static os_thread tids[DEFAULT_TRACE_THREADS];
+    struct os_thread_attr attr = {
+        .name = "trace_test",
+        .priority = OS_THREAD_PRIO_NORMAL,
+        .stacksize = os_thread_default_stacksize(),
+        .joinable = true,
+    };
+
+    liteplayer_trace_start();
+    for (int b = 0; b < batches; b++) {
+        for (int i = 0; i < threads; i++) {
+            // every other thread leaves its ring to the thread exit
+            tids[i] = os_thread_create(&attr, trace_test_thread, (void *)(long)((b + i) % 2));
+            if (tids[i] == NULL) {
+                OS_LOGE(LOG_TAG, "Failed to create thread");
+                return -1;
+            }
+        }
+        for (int i = 0; i < threads; i++)
+            os_thread_join(tids[i], NULL);
+    }
+    liteplayer_trace_stop();
+
+    struct trace_test_dump dump = { malloc(TRACE_TEST_DUMP_SIZE), 0 };
+    if (dump.text == NULL)
+        return -1;
+    int ret = liteplayer_trace_dump(trace_test_writer, &dump);
+    int spans = trace_test_count(dump.text, "\"trace_test_span\"");
+    if (ret != 0 || spans != threads * batches || strstr(dump.text, "\"dropped\":0}") == NULL) {
+        OS_LOGE(LOG_TAG, "Threads %d x %d: %d spans dumped, ret=%d, %s",
+                threads, batches, spans, ret, strstr(dump.text, "\"dropped\""));
+        ret = -1;
+    }
+    free(dump.text);
+    return ret;
+}
+
+int main()
+{
+    int ret = 0;
+    for (int r = 0; r < TRACE_TEST_ROUNDS; r++) {
+        if (trace_test_run(1, 2 * DEFAULT_TRACE_THREADS) != 0)
+            ret = -1;
+        if (trace_test_run(DEFAULT_TRACE_THREADS, 3) != 0)
+            ret = -1;
+    }
+    OS_LOGI(LOG_TAG, "Trace test %s", ret == 0 ? "passed" : "failed");
+    return ret;
+}
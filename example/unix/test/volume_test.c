@@ -0,0 +1,428 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Software volume on a constant signal: unity gain must leave pcm untouched, a ramp must
+// start one step off the current gain and end on the target, a ramp restarted midway must
+// go on from where it is, and a fade out must signal the waiter only once it's processed.
+// Then a constant wav is played into a sink writing a few bytes at a time, directly and in
+// output latency mode, and every sample must be scaled exactly once.
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "osal/os_thread.h"
+#include "cutils/log_helper.h"
+#include "esp_adf/audio_common.h"
+#include "liteplayer_main.h"
+#include "liteplayer_volume.h"
+#include "audio_extractor/wav_extractor.h"
+
+#define LOG_TAG "volume_test"
+
+#define VOLUME_TEST_SAMPLERATE  ( 48000 )
+#define VOLUME_TEST_CHANNELS    ( 2 )
+#define VOLUME_TEST_RAMP_MS     ( 10 )
+#define VOLUME_TEST_RAMP_FRAMES ( VOLUME_TEST_SAMPLERATE*VOLUME_TEST_RAMP_MS/1000 )
+#define VOLUME_TEST_FRAMES      ( 1024 )
+#define VOLUME_TEST_VALUE       ( 16000 )
+
+// played wav: 1s of 16000Hz mono s16, the sink takes a few frames per write
+#define VOLUME_TEST_WAV_RATE    ( 16000 )
+#define VOLUME_TEST_WAV_SIZE    ( VOLUME_TEST_WAV_RATE*2 )
+#define VOLUME_TEST_SINK_WRITE  ( 98 )
+#define VOLUME_TEST_TIMEOUT_MS  ( 10000 )
+
+struct volume_test_waiter {
+    volume_handle_t volume;
+    volatile bool done;
+    volatile bool silent;
+};
+
+struct volume_test_stream {
+    long pos;
+};
+
+struct volume_test_sink {
+    os_mutex lock;
+    short *pcm;
+    int size;
+};
+
+static short g_pcm[VOLUME_TEST_FRAMES*VOLUME_TEST_CHANNELS];
+static char *g_wav;
+static long g_wav_size;
+static struct volume_test_sink g_sink;
+
+static int volume_test_check(bool ok, const char *what)
+{
+    if (!ok)
+        OS_LOGE(LOG_TAG, "Check failed: %s", what);
+    return ok ? 0 : -1;
+}
+
+#define VOLUME_TEST_CHECK(cond) do { if (volume_test_check((cond), #cond) != 0) goto test_out; } while (0)
+
+static void volume_test_fill(int frames)
+{
+    for (int i = 0; i < frames*VOLUME_TEST_CHANNELS; i++)
+        g_pcm[i] = VOLUME_TEST_VALUE;
+}
+
+// Fill @frames of the constant signal, and scale them
+static int volume_test_process(volume_handle_t volume, int frames)
+{
+    volume_test_fill(frames);
+    return volume_process(volume, (char *)g_pcm, frames*VOLUME_TEST_CHANNELS*sizeof(short));
+}
+
+// Steady s16 goes through the Q15 kernel, rounded to nearest
+static short volume_test_q15(float gain)
+{
+    int gain_q15 = (int)lrintf(gain*32768.0f);
+    if (gain_q15 > 32767)
+        gain_q15 = 32767;
+    return (short)((VOLUME_TEST_VALUE*gain_q15 + (1 << 14)) >> 15);
+}
+
+// @frames processed from gain @from: a ramp to @to over VOLUME_TEST_RAMP_FRAMES, then @to
+static bool volume_test_ramped(int frames, float from, float to)
+{
+    float step = (to - from)/VOLUME_TEST_RAMP_FRAMES;
+    for (int i = 0; i < frames; i++) {
+        short l = g_pcm[i*VOLUME_TEST_CHANNELS], r = g_pcm[i*VOLUME_TEST_CHANNELS + 1];
+        if (l != r) {
+            OS_LOGE(LOG_TAG, "Frame %d: channels %d and %d differ", i, l, r);
+            return false;
+        }
+        bool ok;
+        if (i < VOLUME_TEST_RAMP_FRAMES)
+            ok = fabsf(l - VOLUME_TEST_VALUE*(from + step*(i + 1))) <= 1.0f;
+        else
+            ok = l == volume_test_q15(to);
+        if (!ok) {
+            OS_LOGE(LOG_TAG, "Frame %d: %d, ramp from %.3f to %.3f", i, l, from, to);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void *volume_test_wait_thread(void *arg)
+{
+    struct volume_test_waiter *waiter = (struct volume_test_waiter *)arg;
+    waiter->silent = volume_wait_silent(waiter->volume, VOLUME_TEST_TIMEOUT_MS);
+    waiter->done = true;
+    return NULL;
+}
+
+static int volume_test_s16()
+{
+    int ret = -1;
+    int bytes = VOLUME_TEST_FRAMES*VOLUME_TEST_CHANNELS*sizeof(short);
+    int half = VOLUME_TEST_RAMP_FRAMES/2;
+    struct volume_test_waiter waiter = { NULL, false, false };
+    os_thread tid = NULL;
+    volume_handle_t volume = volume_create();
+    VOLUME_TEST_CHECK(volume != NULL);
+    volume_set_format(volume, VOLUME_TEST_SAMPLERATE, VOLUME_TEST_CHANNELS, 16);
+
+    // unity gain is bypassed
+    VOLUME_TEST_CHECK(volume_test_process(volume, VOLUME_TEST_FRAMES) == 0);
+    VOLUME_TEST_CHECK(volume_test_ramped(VOLUME_TEST_FRAMES, 1.0f, 1.0f));
+
+    // ramp down to 0.5, the last frame of the ramp is on the target
+    volume_set_gain(volume, 0.5f, VOLUME_TEST_RAMP_MS);
+    VOLUME_TEST_CHECK(volume_test_process(volume, VOLUME_TEST_FRAMES) == bytes);
+    VOLUME_TEST_CHECK(volume_test_ramped(VOLUME_TEST_FRAMES, 1.0f, 0.5f));
+    VOLUME_TEST_CHECK(g_pcm[(VOLUME_TEST_RAMP_FRAMES - 1)*VOLUME_TEST_CHANNELS] == VOLUME_TEST_VALUE/2);
+
+    // half way up to unity, then down to 0.25 from 0.75 without a jump
+    volume_set_gain(volume, 1.0f, VOLUME_TEST_RAMP_MS);
+    volume_test_process(volume, half);
+    VOLUME_TEST_CHECK(volume_test_ramped(half, 0.5f, 1.0f));
+    volume_set_gain(volume, 0.25f, VOLUME_TEST_RAMP_MS);
+    volume_test_process(volume, VOLUME_TEST_FRAMES);
+    VOLUME_TEST_CHECK(volume_test_ramped(VOLUME_TEST_FRAMES, 0.75f, 0.25f));
+
+    // the waiter of a fade out is signaled once the whole ramp is processed
+    volume_fade_out(volume, VOLUME_TEST_RAMP_MS);
+    VOLUME_TEST_CHECK(!volume_wait_silent(volume, 20));
+    waiter.volume = volume;
+    struct os_thread_attr attr = {
+        .name = "volume_test",
+        .priority = OS_THREAD_PRIO_NORMAL,
+        .stacksize = os_thread_default_stacksize(),
+        .joinable = true,
+    };
+    tid = os_thread_create(&attr, volume_test_wait_thread, &waiter);
+    VOLUME_TEST_CHECK(tid != NULL);
+    volume_test_process(volume, half);
+    VOLUME_TEST_CHECK(volume_test_ramped(half, 0.25f, 0.0f));
+    os_thread_sleep_msec(50);
+    VOLUME_TEST_CHECK(!waiter.done);
+    // a gain set while fading out doesn't cut the fade, it's deferred to the fade in
+    volume_set_gain(volume, 1.0f, 0);
+    volume_test_process(volume, VOLUME_TEST_RAMP_FRAMES - half);
+    VOLUME_TEST_CHECK(abs(g_pcm[0] - VOLUME_TEST_VALUE/8) <= VOLUME_TEST_VALUE/VOLUME_TEST_RAMP_FRAMES + 1);
+    VOLUME_TEST_CHECK(g_pcm[(VOLUME_TEST_RAMP_FRAMES - half - 1)*VOLUME_TEST_CHANNELS] == 0);
+    os_thread_join(tid, NULL);
+    tid = NULL;
+    VOLUME_TEST_CHECK(waiter.done && waiter.silent);
+
+    VOLUME_TEST_CHECK(volume_test_process(volume, VOLUME_TEST_FRAMES) == bytes);
+    VOLUME_TEST_CHECK(volume_test_ramped(VOLUME_TEST_FRAMES, 0.0f, 0.0f));
+    VOLUME_TEST_CHECK(volume_wait_silent(volume, 0));
+    volume_fade_in(volume, VOLUME_TEST_RAMP_MS);
+    volume_test_process(volume, VOLUME_TEST_FRAMES);
+    VOLUME_TEST_CHECK(volume_test_ramped(VOLUME_TEST_FRAMES, 0.0f, 1.0f));
+    // the ramp ends on unity exactly, which is bypassed again
+    VOLUME_TEST_CHECK(volume_test_process(volume, VOLUME_TEST_FRAMES) == 0);
+
+    // reset jumps to the gain
+    volume_set_gain(volume, 0.5f, VOLUME_TEST_RAMP_MS);
+    volume_reset(volume);
+    volume_test_process(volume, VOLUME_TEST_FRAMES);
+    VOLUME_TEST_CHECK(volume_test_ramped(VOLUME_TEST_FRAMES, 0.5f, 0.5f));
+    ret = 0;
+
+test_out:
+    if (tid != NULL)
+        os_thread_join(tid, NULL);
+    volume_destroy(volume);
+    return ret;
+}
+
+// 32 bits is scaled in float, a partial frame at the end isn't touched
+static int volume_test_s32()
+{
+    int ret = -1;
+    int pcm[2*VOLUME_TEST_CHANNELS + 1];
+    volume_handle_t volume = volume_create();
+    VOLUME_TEST_CHECK(volume != NULL);
+    volume_set_format(volume, VOLUME_TEST_SAMPLERATE, VOLUME_TEST_CHANNELS, 32);
+    volume_set_gain(volume, 0.5f, 0);
+    for (int i = 0; i < 2*VOLUME_TEST_CHANNELS + 1; i++)
+        pcm[i] = 1 << 30;
+    VOLUME_TEST_CHECK(volume_process(volume, (char *)pcm, sizeof(pcm)) == 2*VOLUME_TEST_CHANNELS*sizeof(int));
+    for (int i = 0; i < 2*VOLUME_TEST_CHANNELS; i++)
+        VOLUME_TEST_CHECK(abs(pcm[i] - (1 << 29)) <= 128);
+    VOLUME_TEST_CHECK(pcm[2*VOLUME_TEST_CHANNELS] == 1 << 30);
+    ret = 0;
+
+test_out:
+    volume_destroy(volume);
+    return ret;
+}
+
+static const char *volume_test_url_protocol()
+{
+    return "file";
+}
+
+static source_handle_t volume_test_open(const char *url, long long content_pos, void *priv_data)
+{
+    if (content_pos > g_wav_size)
+        return NULL;
+    struct volume_test_stream *stream = calloc(1, sizeof(struct volume_test_stream));
+    if (stream != NULL)
+        stream->pos = (long)content_pos;
+    return stream;
+}
+
+static int volume_test_read(source_handle_t handle, char *buffer, int size)
+{
+    struct volume_test_stream *stream = (struct volume_test_stream *)handle;
+    if (size > g_wav_size - stream->pos)
+        size = (int)(g_wav_size - stream->pos);
+    memcpy(buffer, g_wav + stream->pos, size);
+    stream->pos += size;
+    return size;
+}
+
+static long long volume_test_content_pos(source_handle_t handle)
+{
+    return ((struct volume_test_stream *)handle)->pos;
+}
+
+static long long volume_test_content_len(source_handle_t handle)
+{
+    return g_wav_size;
+}
+
+static int volume_test_seek(source_handle_t handle, long offset)
+{
+    if (offset < 0 || offset > g_wav_size)
+        return -1;
+    ((struct volume_test_stream *)handle)->pos = offset;
+    return 0;
+}
+
+static void volume_test_close(source_handle_t handle)
+{
+    free(handle);
+}
+
+static const char *volume_test_sink_name()
+{
+    return "volume_test";
+}
+
+static sink_handle_t volume_test_sink_open(int samplerate, int channels, int bits, void *priv_data)
+{
+    return (sink_handle_t)priv_data;
+}
+
+// Take a few frames at a time, the rest is to be written again
+static int volume_test_sink_write(sink_handle_t handle, char *buffer, int size)
+{
+    struct volume_test_sink *sink = (struct volume_test_sink *)handle;
+    if (size > VOLUME_TEST_SINK_WRITE)
+        size = VOLUME_TEST_SINK_WRITE;
+    os_mutex_lock(sink->lock);
+    if (sink->size + size <= VOLUME_TEST_WAV_SIZE) {
+        memcpy((char *)sink->pcm + sink->size, buffer, size);
+        sink->size += size;
+    }
+    os_mutex_unlock(sink->lock);
+    return size;
+}
+
+static void volume_test_sink_close(sink_handle_t handle)
+{
+}
+
+static struct source_wrapper g_source_ops = {
+    .async_mode = false,
+    .buffer_size = 4*1024,
+    .priv_data = NULL,
+    .url_protocol = volume_test_url_protocol,
+    .open = volume_test_open,
+    .read = volume_test_read,
+    .content_pos = volume_test_content_pos,
+    .content_len = volume_test_content_len,
+    .seek = volume_test_seek,
+    .close = volume_test_close,
+};
+
+static struct sink_wrapper g_sink_ops = {
+    .priv_data = &g_sink,
+    .name = volume_test_sink_name,
+    .open = volume_test_sink_open,
+    .write = volume_test_sink_write,
+    .close = volume_test_sink_close,
+    .formats = NULL,
+};
+
+// 16000Hz mono s16 wav of the constant signal
+static int volume_test_wav()
+{
+    g_wav_size = sizeof(wav_header_t) + VOLUME_TEST_WAV_SIZE;
+    g_wav = calloc(1, g_wav_size);
+    if (g_wav == NULL)
+        return -1;
+    wav_header_t *header = (wav_header_t *)g_wav;
+    memcpy(&header->riff.ChunkID, "RIFF", 4);
+    header->riff.ChunkSize = g_wav_size - 8;
+    memcpy(&header->riff.Format, "WAVE", 4);
+    memcpy(&header->fmt.ChunkID, "fmt ", 4);
+    header->fmt.ChunkSize = 16;
+    header->fmt.AudioFormat = WAV_FMT_PCM;
+    header->fmt.NumOfChannels = 1;
+    header->fmt.SampleRate = VOLUME_TEST_WAV_RATE;
+    header->fmt.ByteRate = VOLUME_TEST_WAV_RATE*2;
+    header->fmt.BlockAlign = 2;
+    header->fmt.BitsPerSample = 16;
+    memcpy(&header->data.ChunkID, "data", 4);
+    header->data.ChunkSize = VOLUME_TEST_WAV_SIZE;
+    short *pcm = (short *)(g_wav + sizeof(wav_header_t));
+    for (int i = 0; i < VOLUME_TEST_WAV_SIZE/2; i++)
+        pcm[i] = VOLUME_TEST_VALUE;
+    return 0;
+}
+
+static int volume_test_state_callback(enum liteplayer_state state, int errcode, void *priv)
+{
+    if (state == LITEPLAYER_COMPLETED || state == LITEPLAYER_ERROR)
+        *(enum liteplayer_state *)priv = state;
+    return 0;
+}
+
+// Play the wav at half gain, with @latency_ms of output latency
+static int volume_test_play(int latency_ms)
+{
+    int ret = -1;
+    volatile enum liteplayer_state state = LITEPLAYER_IDLE;
+    g_sink.size = 0;
+    liteplayer_handle_t player = liteplayer_create();
+    VOLUME_TEST_CHECK(player != NULL);
+    liteplayer_register_source_wrapper(player, &g_source_ops);
+    liteplayer_register_sink_wrapper(player, &g_sink_ops);
+    liteplayer_register_state_listener(player, volume_test_state_callback, (void *)&state);
+    VOLUME_TEST_CHECK(liteplayer_set_output_latency_ms(player, latency_ms) == ESP_OK);
+    VOLUME_TEST_CHECK(liteplayer_set_volume(player, 0.5f, 0) == ESP_OK);
+    VOLUME_TEST_CHECK(liteplayer_set_data_source(player, "volume.wav") == ESP_OK);
+    VOLUME_TEST_CHECK(liteplayer_prepare(player) == ESP_OK);
+    VOLUME_TEST_CHECK(liteplayer_start(player) == ESP_OK);
+    for (int i = 0; i < VOLUME_TEST_TIMEOUT_MS/10 && state != LITEPLAYER_COMPLETED; i++) {
+        if (state == LITEPLAYER_ERROR)
+            break;
+        os_thread_sleep_msec(10);
+    }
+    VOLUME_TEST_CHECK(state == LITEPLAYER_COMPLETED);
+
+    VOLUME_TEST_CHECK(g_sink.size == VOLUME_TEST_WAV_SIZE);
+    for (int i = 0; i < VOLUME_TEST_WAV_SIZE/2; i++) {
+        if (g_sink.pcm[i] != VOLUME_TEST_VALUE/2) {
+            OS_LOGE(LOG_TAG, "Latency %dms: sample %d is %d", latency_ms, i, g_sink.pcm[i]);
+            goto test_out;
+        }
+    }
+    ret = 0;
+
+test_out:
+    if (ret != 0)
+        OS_LOGE(LOG_TAG, "Latency %dms: %d bytes written, %d expected",
+                latency_ms, g_sink.size, VOLUME_TEST_WAV_SIZE);
+    if (player != NULL) {
+        liteplayer_reset(player);
+        liteplayer_destroy(player);
+    }
+    return ret;
+}
+
+int main()
+{
+    int ret = -1;
+    g_sink.pcm = malloc(VOLUME_TEST_WAV_SIZE);
+    g_sink.lock = os_mutex_create();
+    if (g_sink.pcm == NULL || g_sink.lock == NULL || volume_test_wav() != 0)
+        goto test_out;
+
+    VOLUME_TEST_CHECK(volume_test_s16() == 0);
+    VOLUME_TEST_CHECK(volume_test_s32() == 0);
+    VOLUME_TEST_CHECK(volume_test_play(0) == 0);
+    VOLUME_TEST_CHECK(volume_test_play(100) == 0);
+    ret = 0;
+
+test_out:
+    OS_LOGI(LOG_TAG, "Volume test %s", ret == 0 ? "passed" : "failed");
+    free(g_sink.pcm);
+    free(g_wav);
+    if (g_sink.lock != NULL)
+        os_mutex_destroy(g_sink.lock);
+    return ret;
+}
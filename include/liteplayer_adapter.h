@@ -23,6 +23,7 @@ extern "C" {
 
 typedef void *source_handle_t;
 typedef void *sink_handle_t;
+typedef void *dsp_handle_t;
 
 struct source_wrapper {
     bool            async_mode; // for network stream, it's better to set async mode
@@ -37,12 +38,27 @@ struct source_wrapper {
     void            (*close)(source_handle_t handle);
 };
 
+// Little-endian interleaved pcm formats that sink may support, bits to open sink with: 16, 24, 32
+#define SINK_FORMAT_S16LE   (1 << 0)
+#define SINK_FORMAT_S24LE   (1 << 1) // packed in 3 bytes
+#define SINK_FORMAT_S32LE   (1 << 2)
+
 struct sink_wrapper {
     void            *priv_data;
     const char *    (*name)(); // "alsa", "wave", "opensles", "audiotrack"
     sink_handle_t   (*open)(int samplerate, int channels, int bits, void *priv_data);
     int             (*write)(sink_handle_t handle, char *buffer, int size);//return actual written size
     void            (*close)(sink_handle_t handle);
+    int             (*formats)(void *priv_data); // optional, SINK_FORMAT_xxx mask queried before opening, s16 only if NULL
+};
+
+// Post-processing stage of decoded pcm, see liteplayer_insert_dsp()
+struct dsp_wrapper {
+    void            *priv_data;
+    const char *    (*name)(); // "eq", "limiter", "loudness"
+    dsp_handle_t    (*open)(int samplerate, int channels, int bits, void *priv_data); // NULL if format unsupported
+    int             (*process)(dsp_handle_t handle, char *buffer, int size); // in place, return 0 if succeed
+    void            (*close)(dsp_handle_t handle);
 };
 
 #ifdef __cplusplus
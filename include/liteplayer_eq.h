@@ -0,0 +1,65 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef _LITEPLAYER_EQ_H_
+#define _LITEPLAYER_EQ_H_
+
+#include "liteplayer_adapter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EQ_MAX_BANDS    ( 10 )
+
+enum eq_filter {
+    EQ_FILTER_PEAKING = 0,
+    EQ_FILTER_LOW_SHELF,
+    EQ_FILTER_HIGH_SHELF,
+    EQ_FILTER_LOW_PASS,
+    EQ_FILTER_HIGH_PASS,
+};
+
+struct eq_band {
+    enum eq_filter filter;
+    float freq;     // center or corner frequency in Hz
+    float gain_db;  // for peaking and shelves, 0 leaves the band out
+    float q;        // e.g. 0.707, for shelves 0.707 is the steepest slope without overshoot
+};
+
+typedef struct eq *eq_handle_t;
+
+/*
+ * Parametric equalizer, a reference post-processing stage, see liteplayer_insert_dsp().
+ * Bands are cascaded biquads (RBJ audio EQ cookbook) run in float, the channels of a
+ * frame are filtered in parallel simd lanes, 16-bit output is dithered.
+ * Bands can be changed while playing without blocking the processing thread, the filter
+ * history is kept, it's dropped when the player seeks.
+ */
+eq_handle_t eq_create(const struct eq_band *bands, int count);
+
+int eq_set_band(eq_handle_t handle, int index, const struct eq_band *band);
+
+// Stage to insert into players, one eq may be inserted into several players
+struct dsp_wrapper *eq_get_dsp_wrapper(eq_handle_t handle);
+
+// Must be removed from all players before destroyed
+void eq_destroy(eq_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _LITEPLAYER_EQ_H_
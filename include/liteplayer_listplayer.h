@@ -45,6 +45,37 @@ int listplayer_register_sink_wrapper(listplayer_handle_t handle, struct sink_wra
 
 int listplayer_register_state_listener(listplayer_handle_t handle, liteplayer_state_cb listener, void *listener_priv);
 
+// See liteplayer_set_output_latency_ms(), applied to both players
+int listplayer_set_output_latency_ms(listplayer_handle_t handle, int latency_ms);
+
+// See liteplayer_set_output_samplerate(), applied to both players, so that tracks of
+// different samplerates are still handed over without reopening the sink
+int listplayer_set_output_samplerate(listplayer_handle_t handle, int samplerate);
+
+// See liteplayer_set_output_channels(), applied to both players
+int listplayer_set_output_channels(listplayer_handle_t handle, int channels);
+
+// See liteplayer_set_aac_plus(), applied to both players
+int listplayer_set_aac_plus(listplayer_handle_t handle, bool enabled);
+
+// See liteplayer_set_hls_prefetch(), applied to both players
+int listplayer_set_hls_prefetch(listplayer_handle_t handle, int segments, int cache_size);
+
+// See liteplayer_set_arena_size(), each of both players has an arena of @size bytes
+int listplayer_set_arena_size(listplayer_handle_t handle, int size);
+
+// See liteplayer_set_volume(), applied to both players, can be called in any state
+int listplayer_set_volume(listplayer_handle_t handle, float gain, int ramp_ms);
+
+// See liteplayer_insert_dsp() and the like, applied to both players, can be called in any state
+int listplayer_insert_dsp(listplayer_handle_t handle, int index, struct dsp_wrapper *dsp);
+
+int listplayer_remove_dsp(listplayer_handle_t handle, struct dsp_wrapper *dsp);
+
+int listplayer_move_dsp(listplayer_handle_t handle, struct dsp_wrapper *dsp, int index);
+
+int listplayer_bypass_dsp(listplayer_handle_t handle, struct dsp_wrapper *dsp, bool bypass);
+
 int listplayer_set_data_source(listplayer_handle_t handle, const char *url);
 
 int listplayer_prepare_async(listplayer_handle_t handle);
@@ -38,6 +38,8 @@ typedef int (*liteplayer_state_cb)(enum liteplayer_state state, int errcode, voi
 
 typedef struct liteplayer *liteplayer_handle_t;
 
+struct executor;
+
 liteplayer_handle_t liteplayer_create();
 
 int liteplayer_register_source_wrapper(liteplayer_handle_t handle, struct source_wrapper *wrapper);
@@ -46,6 +48,101 @@ int liteplayer_register_sink_wrapper(liteplayer_handle_t handle, struct sink_wra
 
 int liteplayer_register_state_listener(liteplayer_handle_t handle, liteplayer_state_cb listener, void *listener_priv);
 
+/*
+ * Executor mode, for many concurrent players: instead of creating parser, source and decoder
+ * threads for each player, parsing and decoding run as short tasks on a shared worker pool
+ * (see cutils/executor.h). A sync source is read inline by the decoder task, an async source
+ * keeps its own thread and parser thread, so that a worker never waits for network.
+ * Pcm is always buffered for a sink thread, see liteplayer_set_output_latency_ms(), a decode
+ * task finding the ringbuf full is retried later instead of waiting for the sink.
+ * Must be called in IDLE state, pass NULL to go back to thread mode. The executor must outlive
+ * the player, and gapless handover to an executor mode player is not supported.
+ */
+int liteplayer_set_executor(liteplayer_handle_t handle, struct executor *executor);
+
+/*
+ * Output latency mode: decoder writes pcm into a ringbuf holding @latency_ms of audio, and
+ * a dedicated sink thread writes it to the sink, so that a slow sink doesn't stall decoding,
+ * and a costly frame doesn't starve the sink. Larger latency resists more underruns, at the
+ * cost of memory and of a longer prefill, playback starts after half of the ringbuf is filled.
+ * Buffered pcm is kept while paused and dropped on seeking or stopping.
+ * Must be called in IDLE state, 0 (default) writes the sink directly from the decoder, or
+ * buffers DEFAULT_MEDIA_EXECUTOR_SINK_LATENCY_MS in executor mode. Not applied to pcm reader.
+ */
+int liteplayer_set_output_latency_ms(liteplayer_handle_t handle, int latency_ms);
+
+/*
+ * Open the sink at @samplerate whatever the samplerate of the media is, decoded pcm is
+ * converted by a polyphase resampler, so that the sink isn't reopened when switching
+ * tracks of different samplerates, and the sink doesn't fall back to a nearby rate.
+ * Must be called in IDLE state, 0 (default) opens the sink at the samplerate of the media.
+ * Pcm is resampled in 16 bits, so the sink is opened with 16 bits, not applied to pcm reader.
+ */
+int liteplayer_set_output_samplerate(liteplayer_handle_t handle, int samplerate);
+
+/*
+ * Channel policy of the sink: 0 (default) opens it with the channels of the media, 1 mixes
+ * any layout down to mono, e.g. for a mono speaker, halving the pcm written to it, 2 mixes
+ * mono up to stereo, other layouts are left as decoded. The aac decoder outputs mono streams
+ * as mono unless 2 is set, it's stereo only if built with aac plus.
+ * Must be called in IDLE state, not applied to pcm reader.
+ */
+int liteplayer_set_output_channels(liteplayer_handle_t handle, int channels);
+
+/*
+ * SBR of HE-AAC streams, decoded at twice the samplerate of the AAC core, only available if
+ * built with LITEPLAYER_CONFIG_AAC_PLUS, enabled by default then. Disabled, HE-AAC plays its
+ * AAC core alone, at half the samplerate and with much less cpu, as if built without it.
+ * Must be called in IDLE state, fails to enable if not built with LITEPLAYER_CONFIG_AAC_PLUS.
+ */
+int liteplayer_set_aac_plus(liteplayer_handle_t handle, bool enabled);
+
+/*
+ * Segments of hls are downloaded in the background, @segments at the same time including
+ * the playing one, and fed to the decoder in order, so that a slow segment boundary or a
+ * reconnect is covered by the segments already downloaded. Downloaded bytes waiting to be
+ * fed are bounded by @cache_size, each segment takes a download thread.
+ * Must be called in IDLE state, 0 for the defaults: 2 segments and 256KB cache, 4 segments at most.
+ */
+int liteplayer_set_hls_prefetch(liteplayer_handle_t handle, int segments, int cache_size);
+
+/*
+ * Track arena: allocations living for one data source, e.g. source ringbuf, decoder and its
+ * scratch memory, m4a sample tables, are served from a buffer of @size bytes allocated once
+ * here, and reclaimed all at once by liteplayer_reset(), so that playing thousands of tracks
+ * doesn't fragment the heap. What doesn't fit in falls back to the heap, check arena_watermark
+ * of liteplayer_get_stats() after playing the largest tracks to size it, e.g. source ringbuf
+ * plus 64KB for mp3/aac, plus sample tables for m4a.
+ * Must be called in IDLE state, usually right after liteplayer_create(), 0 (default) disables it.
+ */
+int liteplayer_set_arena_size(liteplayer_handle_t handle, int size);
+
+/*
+ * Software volume, @gain is linear in [0.0, 1.0], 0.0 mutes. Pcm is scaled right before
+ * it's written to sink, or by the sink thread in output latency mode, the change is ramped
+ * within @ramp_ms to avoid clicks. Playing pcm is also faded out and in on pausing, resuming,
+ * seeking and stopping. Unity gain (default) leaves pcm untouched.
+ * Can be called in any state, the gain is kept across data sources. Not applied to pcm reader.
+ */
+int liteplayer_set_volume(liteplayer_handle_t handle, float gain, int ramp_ms);
+
+/*
+ * Post-processing chain: stages run in order, in place on the decoded pcm mixed to the output
+ * channels, before it's converted, resampled and scaled by the volume, e.g. eq_get_dsp_wrapper()
+ * of liteplayer_eq.h. A stage is opened with that format and reopened when it changes, a
+ * stage that doesn't support the format is skipped. @index is the position to insert the
+ * stage at, -1 appends it. Stages can be moved or bypassed while playing, without being
+ * reopened, bypassing keeps their state. At most DEFAULT_MEDIA_DSP_STAGES stages.
+ * Can be called in any state, the chain is kept across data sources. Not applied to pcm reader.
+ */
+int liteplayer_insert_dsp(liteplayer_handle_t handle, int index, struct dsp_wrapper *dsp);
+
+int liteplayer_remove_dsp(liteplayer_handle_t handle, struct dsp_wrapper *dsp);
+
+int liteplayer_move_dsp(liteplayer_handle_t handle, struct dsp_wrapper *dsp, int index);
+
+int liteplayer_bypass_dsp(liteplayer_handle_t handle, struct dsp_wrapper *dsp, bool bypass);
+
 int liteplayer_set_data_source(liteplayer_handle_t handle, const char *url);
 
 int liteplayer_prepare(liteplayer_handle_t handle);
@@ -64,10 +161,68 @@ int liteplayer_stop(liteplayer_handle_t handle);
 
 int liteplayer_reset(liteplayer_handle_t handle);
 
+/*
+ * Pull mode, an alternative to prepare/start: source, parser and decoder run inline
+ * on the thread that calls liteplayer_read_pcm(), no sink and no decoder task are used,
+ * so pcm is decoded as fast as the caller pulls it.
+ * Must be called in INITED state, the pcm format is returned once the first frame is decoded.
+ * Seek, stop and reset are supported, pause and resume are not.
+ */
+int liteplayer_open_pcm_reader(liteplayer_handle_t handle, int *samplerate, int *channels, int *bits);
+
+/*
+ * Decode and copy up to `frames` pcm frames into `buf`, a frame is channels*bits/8 bytes.
+ * Returns frames copied, 0 at the end of stream, or ESP_FAIL on error.
+ */
+int liteplayer_read_pcm(liteplayer_handle_t handle, char *buf, int frames);
+
+/*
+ * Gapless playback: when `handle` reaches the end of stream, its opened sink is handed over
+ * to `next` instead of being closed, and pcm of `next` is written into the same sink.
+ * `next` must be created with the same sink wrapper and linked before it's started, its
+ * decoder blocks at the first pcm until `handle` finishes, stops or gets unlinked.
+ * Pass NULL to unlink. Encoder delay and padding (LAME tag, iTunSMPB) are always trimmed
+ * unless seeking.
+ */
+int liteplayer_set_next_player(liteplayer_handle_t handle, liteplayer_handle_t next);
+
 int liteplayer_get_position(liteplayer_handle_t handle, int *msec);
 
 int liteplayer_get_duration(liteplayer_handle_t handle, int *msec);
 
+/*
+ * Runtime statistics of the current data source, cleared by liteplayer_set_data_source(),
+ * except the arena fields that cover all data sources since liteplayer_set_arena_size().
+ * Counters are updated lock-free by the source, decoder and sink threads, reading them
+ * doesn't stall playback, but fields may be sampled at slightly different moments.
+ */
+struct liteplayer_stats {
+    long long source_bytes;               // bytes read from source
+    int       source_reconnects;          // source reopened or seeked after the first open
+    int       hls_bandwidth;              // estimated download throughput of hls segments in bps,
+    int       hls_variant_switches;       // and variants switched to by it, zero if not hls
+    int       ringbuf_fill_min;           // bytes in source ringbuf when decoder reads it,
+    int       ringbuf_fill_avg;           // zero for a sync source, read by the decoder directly
+    int       ringbuf_fill_max;
+    long long ringbuf_read_blocked_usec;  // decoder waiting for data of source ringbuf
+    long long ringbuf_write_blocked_usec; // source waiting for space of source ringbuf,
+                                          // or decoder waiting for space of pcm ringbuf
+    int       decode_frames;
+    int       decode_usec_p50;            // decode time per frame, i/o excluded
+    int       decode_usec_p99;
+    float     realtime_factor;            // decode time / duration of decoded pcm
+    int       sink_writes;
+    int       sink_write_usec_avg;        // time blocked in sink write
+    int       sink_write_usec_max;
+    int       underruns;                  // decoder or sink thread starved of data
+    int       xruns;                      // sink write failed or accepted less pcm than given
+    int       arena_size;                 // see liteplayer_set_arena_size(), 0 if disabled
+    int       arena_watermark;            // peak bytes in use of the arena
+    int       arena_fallbacks;            // allocations served by heap as the arena was full
+};
+
+int liteplayer_get_stats(liteplayer_handle_t handle, struct liteplayer_stats *stats);
+
 void liteplayer_destroy(liteplayer_handle_t handle);
 
 #ifdef __cplusplus
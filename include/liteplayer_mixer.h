@@ -0,0 +1,73 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _LITEPLAYER_MIXER_H_
+#define _LITEPLAYER_MIXER_H_
+
+#include <stdbool.h>
+#include "liteplayer_adapter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DEFAULT_MIXER_CFG() {\
+    .samplerate = 48000,\
+    .channels = 2,\
+    .period_ms = 10,\
+}
+
+struct mixer_cfg {
+    int samplerate; // format of the real sink, pcm is s16le
+    int channels;   // 1 or 2
+    int period_ms;  // pcm mixed and written to the real sink each time
+};
+
+typedef struct mixer *mixer_handle_t;
+typedef struct mixer_input *mixer_input_handle_t;
+
+/*
+ * Software mixer, several players (liteplayer/listplayer/ttsplayer) share one real sink:
+ * each player registers the sink wrapper of a mixer input instead of the real sink, and
+ * the mixer thread sums all opened inputs into the real sink with saturation.
+ * The real sink is opened when the first input is opened, and closed when the last one
+ * is closed. Inputs are paced by the real sink, writing to an input blocks while the
+ * input buffer is full.
+ * Inputs must be s16le, mono or stereo, at the samplerate of the mixer, see
+ * liteplayer_set_output_samplerate() to resample players to the samplerate of the mixer.
+ */
+mixer_handle_t mixer_create(struct mixer_cfg *cfg);
+
+// Register the real sink, must be called before any input is opened
+int mixer_register_sink_wrapper(mixer_handle_t handle, struct sink_wrapper *wrapper);
+
+mixer_input_handle_t mixer_input_create(mixer_handle_t handle);
+
+// Sink wrapper of the input, to register to a player, only one player opens it at a time
+struct sink_wrapper *mixer_input_get_sink_wrapper(mixer_input_handle_t input);
+
+// Ramp gain of the input linearly to @gain (0.0 ~ 1.0) in @ramp_ms, e.g. to duck music under a prompt
+int mixer_input_set_gain(mixer_input_handle_t input, float gain, int ramp_ms);
+
+// Input must be closed by its player, i.e. the player is stopped or reset
+void mixer_input_destroy(mixer_input_handle_t input);
+
+// All inputs must be destroyed before
+void mixer_destroy(mixer_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _LITEPLAYER_MIXER_H_
@@ -0,0 +1,46 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _LITEPLAYER_TRACE_H_
+#define _LITEPLAYER_TRACE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Pipeline tracing: source read, ringbuf wait, decode, sink write, parser fetch and seek
+ * are recorded as spans of all players, into a lock-free ring per thread that keeps the
+ * latest events, and dumped as Chrome trace-event json (chrome://tracing, ui.perfetto.dev).
+ * Tracing code is only built with LITEPLAYER_CONFIG_TRACE defined, otherwise all functions
+ * return -1 and the pipeline has no trace code at all. When built, recording is off until
+ * liteplayer_trace_start() is called, an idle span costs one atomic load.
+ */
+
+// Called with pieces of json, returns 0 to continue
+typedef int (*liteplayer_trace_writer)(const char *data, int len, void *priv);
+
+// Start recording, events recorded before are dropped from the next dump
+int liteplayer_trace_start();
+
+int liteplayer_trace_stop();
+
+// Write events recorded since liteplayer_trace_start(), may be called while recording
+int liteplayer_trace_dump(liteplayer_trace_writer writer, void *priv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _LITEPLAYER_TRACE_H_
@@ -30,9 +30,14 @@ static esp_err_t aac_decoder_destroy(audio_element_handle_t self)
 {
     aac_decoder_handle_t decoder = (aac_decoder_handle_t)audio_element_getdata(self);
     OS_LOGV(TAG, "Destroy aac decoder");
-    if (decoder->handle != NULL)
+    if (decoder->codec_cache != NULL && *decoder->codec_cache == NULL) {
+        // give codec instance back, it's reset in place for next track
+        *decoder->codec_cache = decoder->handle;
+        decoder->handle = NULL;
+    } else if (decoder->handle != NULL) {
         aac_wrapper_deinit(decoder);
-    audio_free(decoder);
+    }
+    media_arena_free(decoder->arena, decoder);
     return ESP_OK;
 }
 
@@ -41,7 +46,7 @@ static esp_err_t aac_decoder_open(audio_element_handle_t self)
     esp_err_t err = ESP_OK;
     aac_decoder_handle_t decoder = (aac_decoder_handle_t)audio_element_getdata(self);
 
-    if (decoder->handle != NULL) {
+    if (decoder->opened) {
         OS_LOGD(TAG, "AAC decoder already opened");
         return ESP_OK;
     }
@@ -50,6 +55,8 @@ static esp_err_t aac_decoder_open(audio_element_handle_t self)
     if (aac_wrapper_init(decoder) != 0) {
         OS_LOGE(TAG, "Failed to init aac wrapper");
         err = ESP_FAIL;
+    } else {
+        decoder->opened = true;
     }
     return err;
 }
@@ -60,11 +67,10 @@ static esp_err_t aac_decoder_close(audio_element_handle_t self)
 
     if (audio_element_get_state(self) != AEL_STATE_PAUSED) {
         OS_LOGV(TAG, "Close aac decoder");
-        aac_wrapper_deinit(decoder);
+        decoder->opened = false;
 
         memset(&decoder->buf_in, 0x0, sizeof(decoder->buf_in));
         memset(&decoder->buf_out, 0x0, sizeof(decoder->buf_out));
-        decoder->handle = NULL;
         decoder->parsed_header = false;
 
         audio_element_info_t info = {0};
@@ -124,11 +130,9 @@ static esp_err_t aac_decoder_seek(audio_element_handle_t self, long long offset)
 {
     aac_decoder_handle_t decoder = (aac_decoder_handle_t)audio_element_getdata(self);
 
-    aac_wrapper_deinit(decoder);
-    if (aac_wrapper_init(decoder) != 0) {
-        OS_LOGE(TAG, "Failed to init aac wrapper");
-        return ESP_FAIL;
-    }
+    // reset codec in place, or it's reset when opening if it's closed
+    if (decoder->opened)
+        aac_wrapper_reset(decoder);
 
     memset(&decoder->buf_in, 0x0, sizeof(decoder->buf_in));
     memset(&decoder->buf_out, 0x0, sizeof(decoder->buf_out));
@@ -140,8 +144,9 @@ audio_element_handle_t aac_decoder_init(struct aac_decoder_cfg *config)
 {
     OS_LOGV(TAG, "Init aac decoder");
 
-    aac_decoder_handle_t decoder = audio_calloc(1, sizeof(struct aac_decoder));
+    aac_decoder_handle_t decoder = media_arena_calloc(config->arena, 1, sizeof(struct aac_decoder));
     AUDIO_MEM_CHECK(TAG, decoder, return NULL);
+    decoder->arena = config->arena;
 
     audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
     cfg.destroy = aac_decoder_destroy;
@@ -161,11 +166,18 @@ audio_element_handle_t aac_decoder_init(struct aac_decoder_cfg *config)
     decoder->aac_info = config->aac_info;
     decoder->el = el;
     audio_element_setdata(el, decoder);
+    decoder->channels = config->channels;
+    decoder->aac_plus = config->aac_plus;
+    decoder->codec_cache = config->codec_cache;
+    if (decoder->codec_cache != NULL) {
+        decoder->handle = *decoder->codec_cache;
+        *decoder->codec_cache = NULL;
+    }
 
     audio_element_set_input_timeout(el, AAC_DECODER_INPUT_TIMEOUT_MAX);
     return el;
 
 aac_init_error:
-    audio_free(decoder);
+    media_arena_free(decoder->arena, decoder);
     return NULL;
 }
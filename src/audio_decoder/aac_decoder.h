@@ -19,6 +19,7 @@
 
 #include "osal/os_thread.h"
 #include "esp_adf/audio_element.h"
+#include "liteplayer_arena.h"
 #include "audio_extractor/aac_extractor.h"
 
 #ifdef __cplusplus
@@ -49,6 +50,10 @@ struct aac_decoder_cfg {
     int   task_stack;     /*!< Task stack size */
     int   task_prio;      /*!< Task priority (based on freeRTOS priority) */
     struct aac_info *aac_info;
+    media_arena_handle_t arena; /*!< Optional, decoder and its scratch memory are allocated from it */
+    void **codec_cache;   /*!< Optional, codec instance is taken from it and given back when destroyed */
+    int   channels;       /*!< Optional, 2 upmixes mono streams to stereo, 0 or 1 leaves them mono */
+    bool  aac_plus;       /*!< Decode SBR of HE-AAC at twice the core samplerate, only if built with LITEPLAYER_CONFIG_AAC_PLUS */
 };
 
 #define AAC_DECODER_TASK_STACK          (4 * 1024)
@@ -57,10 +62,11 @@ struct aac_decoder_cfg {
 #define DEFAULT_AAC_DECODER_CONFIG() {\
     .task_stack     = AAC_DECODER_TASK_STACK,\
     .task_prio      = AAC_DECODER_TASK_PRIO,\
+    .aac_plus       = true,\
 }
 
 struct aac_buf_in {
-    char  data[AAC_DECODER_INPUT_BUFFER_SIZE];
+    char *data;          // acquired in place from input
     int   bytes_want;
     int   bytes_read;
     bool  eof;
@@ -78,6 +84,11 @@ struct aac_decoder {
     struct aac_buf_in       buf_in;
     struct aac_buf_out      buf_out;
     struct aac_info        *aac_info;
+    media_arena_handle_t    arena;
+    void                  **codec_cache;
+    int                     channels;
+    bool                    aac_plus;
+    bool                    opened;
     bool                    parsed_header;
     bool                    seek_mode;
 };
@@ -85,6 +96,7 @@ struct aac_decoder {
 typedef struct aac_decoder *aac_decoder_handle_t;
 
 int aac_wrapper_run(aac_decoder_handle_t decoder);
+void aac_wrapper_reset(aac_decoder_handle_t decoder);
 void aac_wrapper_deinit(aac_decoder_handle_t decoder);
 int aac_wrapper_init(aac_decoder_handle_t decoder);
 
@@ -97,6 +109,9 @@ int aac_wrapper_init(aac_decoder_handle_t decoder);
  */
 audio_element_handle_t aac_decoder_init(struct aac_decoder_cfg *config);
 
+// Free the codec instance given back to aac_decoder_cfg.codec_cache or m4a_decoder_cfg.codec_cache
+void aac_decoder_free_codec(void *codec);
+
 #ifdef __cplusplus
 }
 #endif
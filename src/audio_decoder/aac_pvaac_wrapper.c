@@ -30,18 +30,33 @@ struct pvaac_wrapper {
     void *pvaac_buffer;
 };
 
-static int aac_adts_read(aac_decoder_handle_t decoder)
+/*
+ * Channels of decoded pcm, known since the first frame. Stereo streams are always
+ * decoded to stereo, mono streams are left mono if desiredChannels is 1.
+ */
+static int pvaac_wrapper_channels(struct pvaac_wrapper *wrap)
 {
-    char *data = decoder->buf_in.data;
-    int remain = decoder->buf_in.bytes_read;
-    int want = AAC_DECODER_INPUT_BUFFER_SIZE - remain;
+    if (wrap->pvaac_config.desiredChannels == 1 && wrap->pvaac_config.encodedChannels == 1)
+        return 1;
+    return 2;
+}
 
-    if (remain != 0)
-        memmove(data, &data[want], remain);
+// Samples per channel of the decoded frame, SBR doubles the core frame length
+static int pvaac_wrapper_frame_length(struct pvaac_wrapper *wrap)
+{
+    if (wrap->pvaac_config.aacPlusUpsamplingFactor == 2)
+        return wrap->pvaac_config.frameLength * 2;
+    return wrap->pvaac_config.frameLength;
+}
 
-    int ret = audio_element_input(decoder->el, &data[remain], want);
+static int aac_adts_read(aac_decoder_handle_t decoder)
+{
+    // acquire a window that covers the largest adts frame, decode it in place
+    int ret = audio_element_input_acquire(decoder->el, &decoder->buf_in.data, AAC_DECODER_INPUT_BUFFER_SIZE);
     if (ret > 0) {
-        decoder->buf_in.bytes_read += ret;
+        if (ret < AAC_DECODER_INPUT_BUFFER_SIZE)
+            decoder->buf_in.eof = true;
+        decoder->buf_in.bytes_read = ret;
         return AEL_IO_OK;
     } else if (ret == AEL_IO_TIMEOUT) {
         return AEL_IO_TIMEOUT;
@@ -80,26 +95,25 @@ fill_data:
     wrap->pvaac_config.pOutputBuffer_plus = &(wrap->pvaac_config.pOutputBuffer[2048]);
     wrap->pvaac_config.repositionFlag = false;
     ret = PVMP4AudioDecodeFrame(&wrap->pvaac_config, wrap->pvaac_buffer);
-    if (ret == MP4AUDEC_INCOMPLETE_FRAME) {
-        if (decoder->buf_in.eof)
-            return AEL_IO_DONE;
-        else
-            goto fill_data;
+    audio_element_input_commit(decoder->el, wrap->pvaac_config.inputBufferUsedLength);
+    decoder->buf_in.bytes_read = 0;
+    if (ret == MP4AUDEC_INCOMPLETE_FRAME && decoder->buf_in.eof) {
+        return AEL_IO_DONE;
     } else if (ret != MP4AUDEC_SUCCESS) {
+        // the acquired window covers a whole frame unless at the end of stream
         OS_LOGE(TAG, "AACDecode error[%d]", ret);
         if(decode_fail_cnt++ >= 4)
             return AEL_PROCESS_FAIL;
         goto fill_data;
     }
 
-    decoder->buf_in.bytes_read -= wrap->pvaac_config.inputBufferUsedLength;
     decoder->buf_out.bytes_remain =
-        wrap->pvaac_config.frameLength * sizeof(short) * wrap->pvaac_config.desiredChannels;
+        pvaac_wrapper_frame_length(wrap) * sizeof(short) * pvaac_wrapper_channels(wrap);
 
     if (!decoder->parsed_header) {
         audio_element_info_t info = {0};
         info.samplerate = wrap->pvaac_config.samplingRate;
-        info.channels   = wrap->pvaac_config.desiredChannels;
+        info.channels   = pvaac_wrapper_channels(wrap);
         info.bits       = 16;
         audio_element_setinfo(decoder->el, &info);
         audio_element_report_info(decoder->el);
@@ -110,47 +124,93 @@ fill_data:
     return 0;
 }
 
-int aac_wrapper_init(aac_decoder_handle_t decoder)
+// Codec instance outlives the track if it's kept in cache, so don't take it from arena
+static struct pvaac_wrapper *pvaac_wrapper_create(media_arena_handle_t arena)
 {
-    struct pvaac_wrapper *wrap = audio_calloc(1, sizeof(struct pvaac_wrapper));
+    struct pvaac_wrapper *wrap = media_arena_calloc(arena, 1, sizeof(struct pvaac_wrapper));
     if (wrap == NULL) {
         OS_LOGE(TAG, "Failed to allocate memory for pvaac decoder");
-        return -1;
+        return NULL;
     }
 
-    wrap->pvaac_config.outputFormat = OUTPUTFORMAT_16PCM_INTERLEAVED;
-#if defined(LITEPLAYER_CONFIG_AAC_PLUS)
-    wrap->pvaac_config.aacPlusEnabled = 1;
-#endif
-    // The software decoder doesn't properly support mono output on
-    // AACplus files. Always output stereo.
-    wrap->pvaac_config.desiredChannels = 2;
-
     uint32_t memRequirements = PVMP4AudioDecoderGetMemRequirements();
-    wrap->pvaac_buffer = audio_malloc(memRequirements);
+    wrap->pvaac_buffer = media_arena_malloc(arena, memRequirements);
     if (wrap->pvaac_buffer == NULL) {
         OS_LOGE(TAG, "Failed to allocate memory for pvaac decoder");
-        audio_free(wrap);
-        return -1;
+        media_arena_free(arena, wrap);
+        return NULL;
     }
+    return wrap;
+}
+
+static void pvaac_wrapper_destroy(media_arena_handle_t arena, struct pvaac_wrapper *wrap)
+{
+    media_arena_free(arena, wrap->pvaac_buffer);
+    media_arena_free(arena, wrap);
+}
+
+// Init library on the existing memory, so the instance is reused by aac and m4a tracks
+static int pvaac_wrapper_init_library(struct pvaac_wrapper *wrap, int channels, bool aac_plus)
+{
+    memset(&wrap->pvaac_config, 0x0, sizeof(wrap->pvaac_config));
+    wrap->pvaac_config.outputFormat = OUTPUTFORMAT_16PCM_INTERLEAVED;
+    wrap->pvaac_config.desiredChannels = channels == 2 ? 2 : 1;
+#if defined(LITEPLAYER_CONFIG_AAC_PLUS)
+    if (aac_plus) {
+        wrap->pvaac_config.aacPlusEnabled = 1;
+        // The software decoder doesn't properly support mono output on
+        // AACplus files. Always output stereo.
+        wrap->pvaac_config.desiredChannels = 2;
+    }
+#else
+    (void)aac_plus;
+#endif
+
     if (PVMP4AudioDecoderInitLibrary(&wrap->pvaac_config, wrap->pvaac_buffer) != MP4AUDEC_SUCCESS) {
         OS_LOGE(TAG, "Failed to init library for pvaac decoder");
-        audio_free(wrap->pvaac_buffer);
-        audio_free(wrap);
         return -1;
     }
+    return 0;
+}
+
+int aac_wrapper_init(aac_decoder_handle_t decoder)
+{
+    struct pvaac_wrapper *wrap = (struct pvaac_wrapper *)decoder->handle;
+    if (wrap == NULL) {
+        wrap = pvaac_wrapper_create(decoder->codec_cache != NULL ? NULL : decoder->arena);
+        if (wrap == NULL)
+            return -1;
+        decoder->handle = (void *)wrap;
+    }
 
-    decoder->handle = (void *)wrap;
+    if (pvaac_wrapper_init_library(wrap, decoder->channels, decoder->aac_plus) != 0) {
+        aac_wrapper_deinit(decoder);
+        return -1;
+    }
     return 0;
 }
 
+void aac_wrapper_reset(aac_decoder_handle_t decoder)
+{
+    struct pvaac_wrapper *wrap = (struct pvaac_wrapper *)decoder->handle;
+    if (wrap == NULL) return;
+
+    PVMP4AudioDecoderResetBuffer(wrap->pvaac_buffer);
+}
+
 void aac_wrapper_deinit(aac_decoder_handle_t decoder)
 {
     struct pvaac_wrapper *wrap = (struct pvaac_wrapper *)decoder->handle;
     if (wrap == NULL) return;
 
-    audio_free(wrap->pvaac_buffer);
-    audio_free(wrap);
+    pvaac_wrapper_destroy(decoder->arena, wrap);
+    decoder->handle = NULL;
+}
+
+void aac_decoder_free_codec(void *codec)
+{
+    if (codec != NULL)
+        pvaac_wrapper_destroy(NULL, (struct pvaac_wrapper *)codec);
 }
 
 static int m4a_mdat_read(m4a_decoder_handle_t decoder)
@@ -167,7 +227,7 @@ static int m4a_mdat_read(m4a_decoder_handle_t decoder)
     in->bytes_want = decoder->m4a_info->stsz_samplesize[stsz_current];
     in->bytes_read = 0;
 
-    ret = audio_element_input_chunk(decoder->el, in->data, in->bytes_want);
+    ret = audio_element_input_acquire(decoder->el, &in->data, in->bytes_want);
     if (ret == in->bytes_want) {
         in->bytes_read += ret;
         goto read_done;
@@ -211,18 +271,20 @@ int m4a_wrapper_run(m4a_decoder_handle_t decoder)
     wrap->pvaac_config.pOutputBuffer_plus = &(wrap->pvaac_config.pOutputBuffer[2048]);
     wrap->pvaac_config.repositionFlag = false;
     ret = PVMP4AudioDecodeFrame(&wrap->pvaac_config, wrap->pvaac_buffer);
+    audio_element_input_commit(decoder->el, decoder->buf_in.bytes_read);
+    decoder->buf_in.bytes_read = 0;
     if (ret != MP4AUDEC_SUCCESS) {
         OS_LOGE(TAG, "AACDecode error[%d]", ret);
         return AEL_PROCESS_FAIL;
     }
 
     decoder->buf_out.bytes_remain =
-        wrap->pvaac_config.frameLength * sizeof(short) * wrap->pvaac_config.desiredChannels;
+        pvaac_wrapper_frame_length(wrap) * sizeof(short) * pvaac_wrapper_channels(wrap);
 
     if (!decoder->parsed_header) {
         audio_element_info_t info = {0};
         info.samplerate = wrap->pvaac_config.samplingRate;
-        info.channels   = wrap->pvaac_config.desiredChannels;
+        info.channels   = pvaac_wrapper_channels(wrap);
         info.bits       = 16;
         audio_element_setinfo(decoder->el, &info);
         audio_element_report_info(decoder->el);
@@ -235,31 +297,16 @@ int m4a_wrapper_run(m4a_decoder_handle_t decoder)
 
 int m4a_wrapper_init(m4a_decoder_handle_t decoder)
 {
-    struct pvaac_wrapper *wrap = audio_calloc(1, sizeof(struct pvaac_wrapper));
+    struct pvaac_wrapper *wrap = (struct pvaac_wrapper *)decoder->handle;
     if (wrap == NULL) {
-        OS_LOGE(TAG, "Failed to allocate memory for pvaac decoder");
-        return -1;
+        wrap = pvaac_wrapper_create(decoder->codec_cache != NULL ? NULL : decoder->arena);
+        if (wrap == NULL)
+            return -1;
+        decoder->handle = (void *)wrap;
     }
 
-    wrap->pvaac_config.outputFormat = OUTPUTFORMAT_16PCM_INTERLEAVED;
-#if defined(LITEPLAYER_CONFIG_AAC_PLUS)
-    wrap->pvaac_config.aacPlusEnabled = 1;
-#endif
-    // The software decoder doesn't properly support mono output on
-    // AACplus files. Always output stereo.
-    wrap->pvaac_config.desiredChannels = 2;
-
-    uint32_t memRequirements = PVMP4AudioDecoderGetMemRequirements();
-    wrap->pvaac_buffer = audio_malloc(memRequirements);
-    if (wrap->pvaac_buffer == NULL) {
-        OS_LOGE(TAG, "Failed to allocate memory for pvaac decoder");
-        audio_free(wrap);
-        return -1;
-    }
-    if (PVMP4AudioDecoderInitLibrary(&wrap->pvaac_config, wrap->pvaac_buffer) != MP4AUDEC_SUCCESS) {
-        OS_LOGE(TAG, "Failed to init library for pvaac decoder");
-        audio_free(wrap->pvaac_buffer);
-        audio_free(wrap);
+    if (pvaac_wrapper_init_library(wrap, decoder->channels, decoder->aac_plus) != 0) {
+        m4a_wrapper_deinit(decoder);
         return -1;
     }
     wrap->pvaac_config.pInputBuffer = decoder->m4a_info->asc.buf;
@@ -267,20 +314,25 @@ int m4a_wrapper_init(m4a_decoder_handle_t decoder)
     wrap->pvaac_config.inputBufferMaxLength = 0;
     if (PVMP4AudioDecoderConfig(&wrap->pvaac_config, wrap->pvaac_buffer) != MP4AUDEC_SUCCESS) {
         OS_LOGE(TAG, "Failed to decode asc config");
-        audio_free(wrap->pvaac_buffer);
-        audio_free(wrap);
+        m4a_wrapper_deinit(decoder);
         return -1;
     }
-
-    decoder->handle = (void *)wrap;
     return 0;
 }
 
+void m4a_wrapper_reset(m4a_decoder_handle_t decoder)
+{
+    struct pvaac_wrapper *wrap = (struct pvaac_wrapper *)decoder->handle;
+    if (wrap == NULL) return;
+
+    PVMP4AudioDecoderResetBuffer(wrap->pvaac_buffer);
+}
+
 void m4a_wrapper_deinit(m4a_decoder_handle_t decoder)
 {
     struct pvaac_wrapper *wrap = (struct pvaac_wrapper *)decoder->handle;
     if (wrap == NULL) return;
 
-    audio_free(wrap->pvaac_buffer);
-    audio_free(wrap);
+    pvaac_wrapper_destroy(decoder->arena, wrap);
+    decoder->handle = NULL;
 }
@@ -29,9 +29,14 @@ static esp_err_t m4a_decoder_destroy(audio_element_handle_t self)
 {
     m4a_decoder_handle_t decoder = (m4a_decoder_handle_t)audio_element_getdata(self);
     OS_LOGV(TAG, "Destroy m4a decoder");
-    if (decoder->handle != NULL)
+    if (decoder->codec_cache != NULL && *decoder->codec_cache == NULL) {
+        // give codec instance back, it's reset in place for next track
+        *decoder->codec_cache = decoder->handle;
+        decoder->handle = NULL;
+    } else if (decoder->handle != NULL) {
         m4a_wrapper_deinit(decoder);
-    audio_free(decoder);
+    }
+    media_arena_free(decoder->arena, decoder);
     return ESP_OK;
 }
 
@@ -40,7 +45,7 @@ static esp_err_t m4a_decoder_open(audio_element_handle_t self)
     esp_err_t err = ESP_OK;
     m4a_decoder_handle_t decoder = (m4a_decoder_handle_t)audio_element_getdata(self);
 
-    if (decoder->handle != NULL) {
+    if (decoder->opened) {
         OS_LOGD(TAG, "M4A decoder already opened");
         return ESP_OK;
     }
@@ -49,6 +54,8 @@ static esp_err_t m4a_decoder_open(audio_element_handle_t self)
     if (m4a_wrapper_init(decoder) != 0) {
         OS_LOGE(TAG, "Failed to init m4a wrapper");
         err = ESP_FAIL;
+    } else {
+        decoder->opened = true;
     }
     return err;
 }
@@ -59,11 +66,10 @@ static esp_err_t m4a_decoder_close(audio_element_handle_t self)
 
     if (audio_element_get_state(self) != AEL_STATE_PAUSED) {
         OS_LOGV(TAG, "Close m4a decoder");
-        m4a_wrapper_deinit(decoder);
+        decoder->opened = false;
 
         memset(&decoder->buf_in, 0x0, sizeof(decoder->buf_in));
         memset(&decoder->buf_out, 0x0, sizeof(decoder->buf_out));
-        decoder->handle = NULL;
         decoder->parsed_header = false;
 
         audio_element_info_t info = {0};
@@ -123,11 +129,11 @@ static esp_err_t m4a_decoder_seek(audio_element_handle_t self, long long offset)
 {
     m4a_decoder_handle_t decoder = (m4a_decoder_handle_t)audio_element_getdata(self);
 
-    m4a_wrapper_deinit(decoder);
-    if (m4a_wrapper_init(decoder) != 0) {
-        OS_LOGE(TAG, "Failed to init m4a wrapper");
-        return ESP_FAIL;
-    }
+    // reset codec in place, or it's reset when opening if it's closed
+    if (decoder->opened)
+        m4a_wrapper_reset(decoder);
+    // sample index looked up by parser is applied here, as the decoder isn't running now
+    decoder->m4a_info->stsz_samplesize_index = decoder->m4a_info->stsz_seek_index;
 
     memset(&decoder->buf_in, 0x0, sizeof(decoder->buf_in));
     memset(&decoder->buf_out, 0x0, sizeof(decoder->buf_out));
@@ -138,8 +144,9 @@ audio_element_handle_t m4a_decoder_init(struct m4a_decoder_cfg *config)
 {
     OS_LOGV(TAG, "Init m4a decoder");
 
-    m4a_decoder_handle_t decoder = audio_calloc(1, sizeof(struct m4a_decoder));
+    m4a_decoder_handle_t decoder = media_arena_calloc(config->arena, 1, sizeof(struct m4a_decoder));
     AUDIO_MEM_CHECK(TAG, decoder, return NULL);
+    decoder->arena = config->arena;
 
     audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
     cfg.destroy = m4a_decoder_destroy;
@@ -159,11 +166,18 @@ audio_element_handle_t m4a_decoder_init(struct m4a_decoder_cfg *config)
     decoder->m4a_info = config->m4a_info;
     decoder->el = el;
     audio_element_setdata(el, decoder);
+    decoder->channels = config->channels;
+    decoder->aac_plus = config->aac_plus;
+    decoder->codec_cache = config->codec_cache;
+    if (decoder->codec_cache != NULL) {
+        decoder->handle = *decoder->codec_cache;
+        *decoder->codec_cache = NULL;
+    }
 
     audio_element_set_input_timeout(el, M4A_DECODER_INPUT_TIMEOUT_MAX);
     return el;
 
 m4a_init_error:
-    audio_free(decoder);
+    media_arena_free(decoder->arena, decoder);
     return NULL;
 }
@@ -29,11 +29,16 @@ struct m4a_decoder_cfg {
     int   task_stack;     /*!< Task stack size */
     int   task_prio;      /*!< Task priority (based on freeRTOS priority) */
     struct m4a_info *m4a_info;
+    media_arena_handle_t arena; /*!< Optional, decoder and its scratch memory are allocated from it */
+    void **codec_cache;   /*!< Optional, codec instance is taken from it and given back when destroyed */
+    int   channels;       /*!< Optional, 2 upmixes mono streams to stereo, 0 or 1 leaves them mono */
+    bool  aac_plus;       /*!< Decode SBR of HE-AAC at twice the core samplerate, only if built with LITEPLAYER_CONFIG_AAC_PLUS */
 };
 
 #define DEFAULT_M4A_DECODER_CONFIG() {\
     .task_stack     = AAC_DECODER_TASK_STACK,\
     .task_prio      = AAC_DECODER_TASK_PRIO,\
+    .aac_plus       = true,\
 }
 
 struct m4a_decoder {
@@ -42,12 +47,18 @@ struct m4a_decoder {
     struct aac_buf_in       buf_in;
     struct aac_buf_out      buf_out;
     struct m4a_info        *m4a_info;
+    media_arena_handle_t    arena;
+    void                  **codec_cache;
+    int                     channels;
+    bool                    aac_plus;
+    bool                    opened;
     bool                    parsed_header;
 };
 
 typedef struct m4a_decoder *m4a_decoder_handle_t;
 
 int m4a_wrapper_run(m4a_decoder_handle_t decoder);
+void m4a_wrapper_reset(m4a_decoder_handle_t decoder);
 void m4a_wrapper_deinit(m4a_decoder_handle_t decoder);
 int m4a_wrapper_init(m4a_decoder_handle_t decoder);
 
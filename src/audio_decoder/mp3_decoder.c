@@ -28,9 +28,14 @@ static esp_err_t mp3_decoder_destroy(audio_element_handle_t self)
 {
     mp3_decoder_handle_t decoder = (mp3_decoder_handle_t)audio_element_getdata(self);
     OS_LOGV(TAG, "Destroy mp3 decoder");
-    if (decoder->handle != NULL)
+    if (decoder->codec_cache != NULL && *decoder->codec_cache == NULL) {
+        // give codec instance back, it's reset in place for next track
+        *decoder->codec_cache = decoder->handle;
+        decoder->handle = NULL;
+    } else if (decoder->handle != NULL) {
         mp3_wrapper_deinit(decoder);
-    audio_free(decoder);
+    }
+    media_arena_free(decoder->arena, decoder);
     return ESP_OK;
 }
 
@@ -39,7 +44,7 @@ static esp_err_t mp3_decoder_open(audio_element_handle_t self)
     esp_err_t status = ESP_OK;
     mp3_decoder_handle_t decoder = (mp3_decoder_handle_t)audio_element_getdata(self);
 
-    if (decoder->handle != NULL) {
+    if (decoder->opened) {
         OS_LOGD(TAG, "MP3 decoder already opened");
         return ESP_OK;
     }
@@ -48,6 +53,8 @@ static esp_err_t mp3_decoder_open(audio_element_handle_t self)
     if (mp3_wrapper_init(decoder) != 0) {
         OS_LOGE(TAG, "Failed to init mp3 wrapper");
         status = ESP_FAIL;
+    } else {
+        decoder->opened = true;
     }
     return status;
 }
@@ -58,11 +65,10 @@ static esp_err_t mp3_decoder_close(audio_element_handle_t self)
 
     if (audio_element_get_state(self) != AEL_STATE_PAUSED) {
         OS_LOGV(TAG, "Close mp3 decoder");
-        mp3_wrapper_deinit(decoder);
+        decoder->opened = false;
 
         memset(&decoder->buf_in, 0x0, sizeof(decoder->buf_in));
         memset(&decoder->buf_out, 0x0, sizeof(decoder->buf_out));
-        decoder->handle = NULL;
         decoder->parsed_header = false;
 
         audio_element_info_t info = {0};
@@ -122,11 +128,9 @@ static int mp3_decoder_seek(audio_element_handle_t self, long long offset)
 {
     mp3_decoder_handle_t decoder = (mp3_decoder_handle_t)audio_element_getdata(self);
 
-    mp3_wrapper_deinit(decoder);
-    if (mp3_wrapper_init(decoder) != 0) {
-        OS_LOGE(TAG, "Failed to init mp3 wrapper");
-        return ESP_FAIL;
-    }
+    // reset codec in place, or it's reset when opening if it's closed
+    if (decoder->opened)
+        mp3_wrapper_reset(decoder);
 
     memset(&decoder->buf_in, 0x0, sizeof(decoder->buf_in));
     memset(&decoder->buf_out, 0x0, sizeof(decoder->buf_out));
@@ -138,8 +142,9 @@ audio_element_handle_t mp3_decoder_init(struct mp3_decoder_cfg *config)
 {
     OS_LOGV(TAG, "Init mp3 decoder");
 
-    mp3_decoder_handle_t decoder = audio_calloc(1, sizeof(struct mp3_decoder));
+    mp3_decoder_handle_t decoder = media_arena_calloc(config->arena, 1, sizeof(struct mp3_decoder));
     AUDIO_MEM_CHECK(TAG, decoder, return NULL);
+    decoder->arena = config->arena;
 
     audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
     cfg.destroy = mp3_decoder_destroy;
@@ -159,6 +164,11 @@ audio_element_handle_t mp3_decoder_init(struct mp3_decoder_cfg *config)
     decoder->mp3_info = config->mp3_info;
     decoder->el = el;
     audio_element_setdata(el, decoder);
+    decoder->codec_cache = config->codec_cache;
+    if (decoder->codec_cache != NULL) {
+        decoder->handle = *decoder->codec_cache;
+        *decoder->codec_cache = NULL;
+    }
     
     audio_element_info_t info = {0};
     audio_element_setinfo(el, &info);
@@ -167,6 +177,6 @@ audio_element_handle_t mp3_decoder_init(struct mp3_decoder_cfg *config)
     return el;
 
 mp3_init_error:
-    audio_free(decoder);
+    media_arena_free(decoder->arena, decoder);
     return NULL;
 }
@@ -17,6 +17,7 @@
 
 #include "osal/os_thread.h"
 #include "esp_adf/audio_element.h"
+#include "liteplayer_arena.h"
 #include "audio_extractor/mp3_extractor.h"
 
 #ifdef __cplusplus
@@ -36,6 +37,8 @@ struct mp3_decoder_cfg {
     int   task_stack;     /*!< Task stack size */
     int   task_prio;      /*!< Task priority (based on freeRTOS priority) */
     struct mp3_info *mp3_info;
+    media_arena_handle_t arena; /*!< Optional, decoder and its scratch memory are allocated from it */
+    void **codec_cache;   /*!< Optional, codec instance is taken from it and given back when destroyed */
 };
 
 #define MP3_DECODER_TASK_STACK          (4 * 1024)
@@ -47,8 +50,7 @@ struct mp3_decoder_cfg {
 }
 
 struct mp3_buf_in {
-    char data[MP3_DECODER_INPUT_BUFFER_SIZE];
-    int  bytes_want;     // bytes that want to read
+    char *data;          // acquired in place from input
     int  bytes_read;     // bytes that have read
     bool eof;            // if end of stream
 };
@@ -65,6 +67,9 @@ struct mp3_decoder {
     struct mp3_buf_in       buf_in;
     struct mp3_buf_out      buf_out;
     struct mp3_info        *mp3_info;
+    media_arena_handle_t    arena;
+    void                  **codec_cache;
+    bool                    opened;
     bool                    parsed_header;
     bool                    seek_mode;
 };
@@ -72,6 +77,7 @@ struct mp3_decoder {
 typedef struct mp3_decoder *mp3_decoder_handle_t;
 
 int mp3_wrapper_init(mp3_decoder_handle_t decoder);
+void mp3_wrapper_reset(mp3_decoder_handle_t decoder);
 void mp3_wrapper_deinit(mp3_decoder_handle_t decoder);
 int mp3_wrapper_run(mp3_decoder_handle_t decoder);
 
@@ -84,6 +90,9 @@ int mp3_wrapper_run(mp3_decoder_handle_t decoder);
  */
 audio_element_handle_t mp3_decoder_init(struct mp3_decoder_cfg *config);
 
+// Free the codec instance given back to mp3_decoder_cfg.codec_cache
+void mp3_decoder_free_codec(void *codec);
+
 #ifdef __cplusplus
 }
 #endif
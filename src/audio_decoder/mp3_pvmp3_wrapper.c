@@ -28,10 +28,7 @@
 struct pvmp3_wrapper {
     tPVMP3DecoderExternal pvmp3_config;
     void *pvmp3_buffer;
-    bool new_frame;    // if reading new frame
     int  frame_size;
-    char seek_buffer[MP3_DECODER_INPUT_BUFFER_SIZE];
-    int  bytes_seek;
 };
 
 static int mp3_frame_size(char *buf)
@@ -144,162 +141,74 @@ finish:
     return found ? 0 : -1;
 }
 
+static int mp3_data_acquire(mp3_decoder_handle_t decoder, char **data, int wanted)
+{
+    struct mp3_buf_in *in = &decoder->buf_in;
+    int ret = audio_element_input_acquire(decoder->el, data, wanted);
+    if (ret >= wanted) {
+        return AEL_IO_OK;
+    } else if (ret > 0) {
+        OS_LOGW(TAG, "Read chunk insufficient: %d/%d, AEL_IO_DONE", ret, wanted);
+        in->eof = true;
+        return AEL_IO_DONE;
+    } else if (ret == AEL_IO_TIMEOUT) {
+        return AEL_IO_TIMEOUT;
+    } else if (ret == AEL_IO_OK || ret == AEL_IO_DONE || ret == AEL_IO_ABORT) {
+        in->eof = true;
+        return AEL_IO_DONE;
+    } else {
+        OS_LOGW(TAG, "Read chunk error: %d/%d", ret, wanted);
+        return AEL_IO_FAIL;
+    }
+}
+
 static int mp3_data_read(mp3_decoder_handle_t decoder)
 {
     struct pvmp3_wrapper *wrap = (struct pvmp3_wrapper *)(decoder->handle);
     struct mp3_buf_in *in = &decoder->buf_in;
+    char *data = NULL;
     int ret = 0;
 
     if (in->eof)
         return AEL_IO_DONE;
 
     if (decoder->seek_mode) {
-        wrap->bytes_seek = sizeof(wrap->seek_buffer);
-        ret = audio_element_input_chunk(decoder->el, wrap->seek_buffer, wrap->bytes_seek);
-        if (ret == wrap->bytes_seek) {
-            OS_LOGV(TAG, "SEEK_MODE: Read chunk succeed: %d/%d", ret, wrap->bytes_seek);
-        } else if (ret == AEL_IO_OK || ret == AEL_IO_DONE || ret == AEL_IO_ABORT) {
-            in->eof = true;
-            return AEL_IO_DONE;
-        } else if (ret < 0) {
-            OS_LOGW(TAG, "SEEK_MODE: Read chunk error: %d/%d", ret, wrap->bytes_seek);
+        ret = mp3_data_acquire(decoder, &data, MP3_DECODER_INPUT_BUFFER_SIZE);
+        if (ret != AEL_IO_OK)
             return ret;
-        } else {
-            OS_LOGW(TAG, "SEEK_MODE: Read chunk insufficient: %d/%d", ret, wrap->bytes_seek);
-            in->eof = true;
-            return AEL_IO_DONE;
-        }
 
         struct mp3_info *info = decoder->mp3_info;
-        ret = mp3_find_sync_offset(wrap->seek_buffer, wrap->bytes_seek, info);
+        ret = mp3_find_sync_offset(data, MP3_DECODER_INPUT_BUFFER_SIZE, info);
         if (ret != 0) {
             OS_LOGE(TAG, "SEEK_MODE: Failed to find sync word after seeking");
             return AEL_IO_FAIL;
         }
 
         OS_LOGV(TAG, "SEEK_MODE: Found sync offset: %d/%d, frame_size=%d",
-                info->frame_start_offset, wrap->bytes_seek, info->frame_size);
-
-        wrap->bytes_seek -= info->frame_start_offset;
-        if (wrap->bytes_seek > 0)
-            memmove(wrap->seek_buffer, &wrap->seek_buffer[info->frame_start_offset], wrap->bytes_seek);
-        in->bytes_want = 0;
-        in->bytes_read = 0;
-        wrap->frame_size = info->frame_size;
-        decoder->seek_mode = false;
-    }
+                info->frame_start_offset, MP3_DECODER_INPUT_BUFFER_SIZE, info->frame_size);
 
-    if (wrap->bytes_seek > 0) {
-        if (wrap->bytes_seek < wrap->frame_size) {
-            int remain = wrap->frame_size - wrap->bytes_seek;
-            OS_LOGD(TAG, "SEEK_MODE: Insufficient data, request more for whole frame, remain/frame: %d/%d",
-                    remain, wrap->frame_size);
-            ret = audio_element_input_chunk(decoder->el,
-                        wrap->seek_buffer+wrap->bytes_seek,
-                        remain);
-            if (ret == remain) {
-                OS_LOGV(TAG, "SEEK_MODE: Read chunk succeed: %d/%d", ret, remain);
-                wrap->bytes_seek = wrap->frame_size;
-            } else if (ret == AEL_IO_OK || ret == AEL_IO_DONE || ret == AEL_IO_ABORT) {
-                in->eof = true;
-                return AEL_IO_DONE;
-            } else if (ret < 0) {
-                OS_LOGW(TAG, "SEEK_MODE: Read chunk error: %d/%d", ret, remain);
-                return ret;
-            } else {
-                OS_LOGW(TAG, "SEEK_MODE: Read chunk insufficient: %d/%d", ret, remain);
-                in->eof = true;
-                return AEL_IO_DONE;
-            }
-        }
-
-        wrap->frame_size = mp3_frame_size(wrap->seek_buffer);
-        if (wrap->frame_size <= 0 || wrap->frame_size > wrap->bytes_seek) {
-            OS_LOGW(TAG, "SEEK_MODE: MP3 demux dummy data, AEL_IO_DONE");
-            //in->eof = true;
-            wrap->bytes_seek = 0;
-            return AEL_IO_DONE;
-        }
-
-        memcpy(in->data, wrap->seek_buffer, wrap->frame_size);
-        in->bytes_read = wrap->frame_size;
-        in->bytes_want = 0;
-
-        wrap->bytes_seek -= wrap->frame_size;
-        if (wrap->bytes_seek > 0)
-            memmove(wrap->seek_buffer, wrap->seek_buffer+wrap->frame_size, wrap->bytes_seek);
-
-        if (wrap->bytes_seek >= 4) {
-            wrap->frame_size = mp3_frame_size(wrap->seek_buffer);
-            if (wrap->frame_size <= 0 || wrap->frame_size > MP3_DECODER_INPUT_BUFFER_SIZE) {
-                OS_LOGW(TAG, "SEEK_MODE: MP3 demux dummy data, AEL_IO_DONE");
-                //in->eof = true;
-                wrap->bytes_seek = 0;
-                return AEL_IO_DONE;
-            }
-        }
-        return AEL_IO_OK;
-    }
-
-    if (in->bytes_want > 0) {
-        if (wrap->new_frame) {
-            OS_LOGD(TAG, "Remain %d/4 bytes header needed to read", in->bytes_want);
-            goto fill_header;
-        } else {
-            OS_LOGD(TAG, "Remain %d/%d bytes frame needed to read", in->bytes_want, wrap->frame_size);
-            goto fill_frame;
-        }
+        audio_element_input_commit(decoder->el, info->frame_start_offset);
+        decoder->seek_mode = false;
     }
 
-    in->bytes_want = 4;
-    in->bytes_read = 0;
-    wrap->new_frame = true;
-fill_header:
-    ret = audio_element_input(decoder->el, in->data+in->bytes_read, in->bytes_want);
-    if (ret < in->bytes_want) {
-        if (ret > 0) {
-            in->bytes_read += ret;
-            in->bytes_want -= ret;
-            return AEL_IO_TIMEOUT;
-        } else if (ret == AEL_IO_TIMEOUT) {
-            return AEL_IO_TIMEOUT;
-        } else if (ret == AEL_IO_OK || ret == AEL_IO_DONE || ret == AEL_IO_ABORT) {
-            in->eof = true;
-            return AEL_IO_DONE;
-        } else {
-            return AEL_IO_FAIL;
-        }
-    }
+    // peek header, then acquire the whole frame in place
+    ret = mp3_data_acquire(decoder, &data, 4);
+    if (ret != AEL_IO_OK)
+        return ret;
 
-    wrap->frame_size = mp3_frame_size(in->data);
+    wrap->frame_size = mp3_frame_size(data);
     if (wrap->frame_size <= 0 || wrap->frame_size > MP3_DECODER_INPUT_BUFFER_SIZE) {
         OS_LOGW(TAG, "MP3 demux dummy data, AEL_IO_DONE");
         //in->eof = true;
         return AEL_IO_DONE;
     }
 
-    in->bytes_read = 4;
-    in->bytes_want = wrap->frame_size - in->bytes_read;
-    wrap->new_frame = false;
-fill_frame:
-    ret = audio_element_input(decoder->el, in->data+in->bytes_read, in->bytes_want);
-    if (ret < in->bytes_want) {
-        if (ret > 0) {
-            in->bytes_read += ret;
-            in->bytes_want -= ret;
-            return AEL_IO_TIMEOUT;
-        } else if (ret == AEL_IO_TIMEOUT) {
-            return AEL_IO_TIMEOUT;
-        } else if (ret == AEL_IO_OK || ret == AEL_IO_DONE || ret == AEL_IO_ABORT) {
-            in->eof = true;
-            return AEL_IO_DONE;
-        } else {
-            return AEL_IO_FAIL;
-        }
-    }
+    ret = mp3_data_acquire(decoder, &data, wrap->frame_size);
+    if (ret != AEL_IO_OK)
+        return ret;
 
+    in->data = data;
     in->bytes_read = wrap->frame_size;
-    in->bytes_want = 0;
     return AEL_IO_OK;
 }
 
@@ -325,6 +234,9 @@ int mp3_wrapper_run(mp3_decoder_handle_t decoder)
     wrap->pvmp3_config.outputFrameSize = MP3_DECODER_OUTPUT_BUFFER_SIZE / sizeof(int16_t);
     wrap->pvmp3_config.crcEnabled = false;
     ERROR_CODE decoderErr = pvmp3_framedecoder(&wrap->pvmp3_config, wrap->pvmp3_buffer);
+    audio_element_input_commit(decoder->el, decoder->buf_in.bytes_read);
+    decoder->buf_in.data = NULL;
+    decoder->buf_in.bytes_read = 0;
     if (decoderErr != NO_DECODING_ERROR) {
         OS_LOGE(TAG, "PVMP3Decoder encountered error: %d", decoderErr);
         return AEL_PROCESS_FAIL;
@@ -352,17 +264,26 @@ int mp3_wrapper_run(mp3_decoder_handle_t decoder)
 
 int mp3_wrapper_init(mp3_decoder_handle_t decoder) 
 {
-    struct pvmp3_wrapper *wrap = audio_calloc(1, sizeof(struct pvmp3_wrapper));
+    struct pvmp3_wrapper *wrap = (struct pvmp3_wrapper *)decoder->handle;
+    if (wrap != NULL) {
+        // reuse the codec instance kept from last track, reset it in place
+        mp3_wrapper_reset(decoder);
+        return 0;
+    }
+
+    // codec instance outlives the track if it's kept in cache, so don't take it from arena
+    media_arena_handle_t arena = decoder->codec_cache != NULL ? NULL : decoder->arena;
+    wrap = media_arena_calloc(arena, 1, sizeof(struct pvmp3_wrapper));
     if (wrap == NULL) {
         OS_LOGE(TAG, "Failed to allocate memory for pvmp3 decoder");
         return -1;
     }
 
     uint32_t memRequirements = pvmp3_decoderMemRequirements();
-    wrap->pvmp3_buffer = audio_malloc(memRequirements);
+    wrap->pvmp3_buffer = media_arena_malloc(arena, memRequirements);
     if (wrap->pvmp3_buffer == NULL) {
         OS_LOGE(TAG, "Failed to allocate memory for pvmp3 decoder");
-        audio_free(wrap);
+        media_arena_free(arena, wrap);
         return -1;
     }
     pvmp3_InitDecoder(&wrap->pvmp3_config, wrap->pvmp3_buffer);
@@ -371,11 +292,30 @@ int mp3_wrapper_init(mp3_decoder_handle_t decoder)
     return 0;
 } 
 
+void mp3_wrapper_reset(mp3_decoder_handle_t decoder)
+{
+    struct pvmp3_wrapper *wrap = (struct pvmp3_wrapper *)decoder->handle;
+    if (wrap == NULL) return;
+
+    pvmp3_InitDecoder(&wrap->pvmp3_config, wrap->pvmp3_buffer);
+    wrap->frame_size = 0;
+}
+
 void mp3_wrapper_deinit(mp3_decoder_handle_t decoder)
 {
     struct pvmp3_wrapper *wrap = (struct pvmp3_wrapper *)decoder->handle;
     if (wrap == NULL) return;
 
+    media_arena_free(decoder->arena, wrap->pvmp3_buffer);
+    media_arena_free(decoder->arena, wrap);
+    decoder->handle = NULL;
+}
+
+void mp3_decoder_free_codec(void *codec)
+{
+    struct pvmp3_wrapper *wrap = (struct pvmp3_wrapper *)codec;
+    if (wrap == NULL) return;
+
     audio_free(wrap->pvmp3_buffer);
     audio_free(wrap);
 }
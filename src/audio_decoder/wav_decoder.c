@@ -31,6 +31,7 @@
 
 struct wav_buf_in {
     char *data;
+    char *ptr;           // data, or span acquired in place from input
     int  size;
     int  bytes_want;     // bytes that want to read
     int  bytes_read;     // bytes that have read
@@ -56,7 +57,9 @@ struct wav_decoder {
     bool                    filled_header;
     bool                    read_timeout;
     struct wav_info        *wav_info;
+    media_arena_handle_t    arena;
     int                     sink_bits;
+    bool                    raw_pcm;         // pcm is read out without converting
     drwav_uint64            prefered_frames;
 };
 typedef struct wav_decoder *wav_decoder_handle_t;
@@ -91,7 +94,7 @@ static size_t drwav_on_read(void *pUserData, void *pBufferOut, size_t bytesToRea
         bytesToRead = decoder->buf_in.bytes_read;
     }
     if (bytesToRead > 0) {
-        memcpy(pBufferOut, &decoder->buf_in.data[decoder->drwav_offset], bytesToRead);
+        memcpy(pBufferOut, &decoder->buf_in.ptr[decoder->drwav_offset], bytesToRead);
         decoder->drwav_offset += bytesToRead;
         decoder->buf_in.bytes_read -= bytesToRead;
     }
@@ -132,6 +135,7 @@ static int drwav_run(wav_decoder_handle_t decoder)
             memcpy(in->data, decoder->wav_info->header_buff, decoder->wav_info->header_size);
             in->bytes_read = decoder->wav_info->header_size;
         }
+        in->ptr = in->data;
 
         in->bytes_want = prefered_insize - in->bytes_read;
         ret = audio_element_input_chunk(decoder->el, in->data+in->bytes_read, in->bytes_want);
@@ -153,7 +157,8 @@ static int drwav_run(wav_decoder_handle_t decoder)
     }
 
     if (in->bytes_read < decoder->block_align) {
-        if (in->bytes_read > 0) {
+        if (in->bytes_read > 0 && in->ptr == in->data) {
+            // remaining bytes of header buffer, refill it by copying
             if (!decoder->read_timeout) {
                 //OS_LOGD(TAG, "Refill data with remaining bytes:%d, offset:%d",
                 //        in->bytes_read, decoder->drwav_offset);
@@ -161,27 +166,39 @@ static int drwav_run(wav_decoder_handle_t decoder)
                 in->bytes_want = prefered_insize - in->bytes_read;
                 decoder->drwav_offset = in->bytes_read;
             }
+            ret = audio_element_input_chunk(decoder->el, in->data+decoder->drwav_offset, in->bytes_want);
+            if (ret == in->bytes_want) {
+                in->bytes_read += ret;
+                decoder->drwav_offset = 0;
+            } else if (ret == AEL_IO_OK || ret == AEL_IO_DONE || ret == AEL_IO_ABORT) {
+                in->eof = true;
+                return AEL_IO_DONE;
+            } else if (ret < 0) {
+                OS_LOGW(TAG, "Read chunk error: %d/%d", ret, in->bytes_want);
+                decoder->read_timeout = true;
+                return ret;
+            } else {
+                in->eof = true;
+                in->bytes_read += ret;
+                decoder->drwav_offset = 0;
+            }
+            decoder->read_timeout = false;
         } else {
+            // decode from input in place, committed after drwav consumes it
             in->bytes_want = prefered_insize;
+            ret = audio_element_input_acquire(decoder->el, &in->ptr, in->bytes_want);
+            if (ret == AEL_IO_OK || ret == AEL_IO_DONE || ret == AEL_IO_ABORT) {
+                in->eof = true;
+                return AEL_IO_DONE;
+            } else if (ret < 0) {
+                OS_LOGW(TAG, "Read chunk error: %d/%d", ret, in->bytes_want);
+                return ret;
+            } else if (ret < decoder->block_align) {
+                in->eof = true;
+            }
+            in->bytes_read = ret;
             decoder->drwav_offset = 0;
         }
-        ret = audio_element_input_chunk(decoder->el, in->data+decoder->drwav_offset, in->bytes_want);
-        if (ret == in->bytes_want) {
-            in->bytes_read += ret;
-            decoder->drwav_offset = 0;
-        } else if (ret == AEL_IO_OK || ret == AEL_IO_DONE || ret == AEL_IO_ABORT) {
-            in->eof = true;
-            return AEL_IO_DONE;
-        } else if (ret < 0) {
-            OS_LOGW(TAG, "Read chunk error: %d/%d", ret, in->bytes_want);
-            decoder->read_timeout = true;
-            return ret;
-        } else {
-            in->eof = true;
-            in->bytes_read += ret;
-            decoder->drwav_offset = 0;
-        }
-        decoder->read_timeout = false;
     }
 
     if (!decoder->drwav_inited) {
@@ -197,25 +214,16 @@ static int drwav_run(wav_decoder_handle_t decoder)
             audio_element_info_t info = {0};
             info.samplerate = decoder->drwav.sampleRate;
             info.channels   = decoder->drwav.channels;
-#if defined(LITEPLAYER_CONFIG_SINK_FIXED_S16LE)
-            info.bits       = 16;
-#else
-            switch (decoder->drwav.bitsPerSample) {
-            case 16:
-                info.bits = 16;
-                break;
-            case 24:
-            case 32:
-                info.bits = 32;
-                break;
-            default:
-                if (decoder->drwav.bitsPerSample > 32)
-                    info.bits = 32;
-                else
-                    info.bits = 16;
-                break;
-            }
-#endif
+            // s16/s24/s32 pcm is out as it is, the sink format is negotiated by player
+            decoder->raw_pcm = decoder->drwav.translatedFormatTag == DR_WAVE_FORMAT_PCM &&
+                               (decoder->drwav.bitsPerSample == 16 ||
+                                decoder->drwav.bitsPerSample == 24 ||
+                                decoder->drwav.bitsPerSample == 32) &&
+                               decoder->drwav.fmt.blockAlign == decoder->drwav.channels*decoder->drwav.bitsPerSample/8;
+            if (decoder->raw_pcm)
+                info.bits = decoder->drwav.bitsPerSample;
+            else
+                info.bits = decoder->drwav.bitsPerSample > 16 ? 32 : 16;
             OS_LOGV(TAG,"Found wav header: SR=%d, CH=%d, BITS=%d", info.samplerate, info.channels, info.bits);
             audio_element_setinfo(decoder->el, &info);
             audio_element_report_info(decoder->el);
@@ -224,9 +232,9 @@ static int drwav_run(wav_decoder_handle_t decoder)
             if (decoder->sink_bits > decoder->drwav.bitsPerSample) {
                 int prefered_outsize = decoder->prefered_frames*decoder->sink_bits*info.channels/8;
                 if (prefered_outsize > decoder->buf_out.size) {
-                    audio_free(decoder->buf_out.data);
+                    media_arena_free(decoder->arena, decoder->buf_out.data);
                     decoder->buf_out.size = prefered_outsize;
-                    decoder->buf_out.data = audio_malloc(decoder->buf_out.size);
+                    decoder->buf_out.data = media_arena_malloc(decoder->arena, decoder->buf_out.size);
                     if (decoder->buf_out.data == NULL)
                         return AEL_PROCESS_FAIL;
                 }
@@ -240,26 +248,20 @@ static int drwav_run(wav_decoder_handle_t decoder)
     drwav_uint64 in_frames = (decoder->prefered_frames > in->bytes_read/decoder->block_align) ?
                              in->bytes_read/decoder->block_align : decoder->prefered_frames;
     drwav_uint64 out_frames;
-#if defined(LITEPLAYER_CONFIG_SINK_FIXED_S16LE)
-    drwav_int16 *out = (drwav_int16 *)(decoder->buf_out.data);
-    out_frames = drwav_read_pcm_frames_s16le(&decoder->drwav, in_frames, out);
-#else
-    switch (decoder->sink_bits) {
-    case 16: {
+    if (decoder->raw_pcm) {
+        out_frames = drwav_read_pcm_frames(&decoder->drwav, in_frames, decoder->buf_out.data);
+    } else if (decoder->sink_bits == 16) {
         drwav_int16 *out = (drwav_int16 *)(decoder->buf_out.data);
         out_frames = drwav_read_pcm_frames_s16le(&decoder->drwav, in_frames, out);
-        break;
-    }
-    case 32: {
+    } else {
         drwav_int32 *out = (drwav_int32 *)(decoder->buf_out.data);
         out_frames = drwav_read_pcm_frames_s32le(&decoder->drwav, in_frames, out);
-        break;
     }
-    default:
-        OS_LOGE(TAG, "Unsupported sample bits: %d", decoder->sink_bits);
-        return AEL_PROCESS_FAIL;
+    if (in->ptr != in->data) {
+        audio_element_input_commit(decoder->el, decoder->drwav_offset);
+        in->bytes_read = 0;
+        decoder->drwav_offset = 0;
     }
-#endif
     if (out_frames == 0) {
         OS_LOGW(TAG, "WAVDecode dummy data, AEL_IO_DONE");
         return AEL_IO_DONE;
@@ -273,9 +275,9 @@ static esp_err_t wav_decoder_destroy(audio_element_handle_t self)
 {
     wav_decoder_handle_t decoder = (wav_decoder_handle_t)audio_element_getdata(self);
     OS_LOGV(TAG, "Destroy wav decoder");
-    audio_free(decoder->buf_in.data);
-    audio_free(decoder->buf_out.data);
-    audio_free(decoder);
+    media_arena_free(decoder->arena, decoder->buf_in.data);
+    media_arena_free(decoder->arena, decoder->buf_out.data);
+    media_arena_free(decoder->arena, decoder);
     return ESP_OK;
 }
 
@@ -295,6 +297,8 @@ static esp_err_t wav_decoder_close(audio_element_handle_t self)
             drwav_uninit(&decoder->drwav);
             decoder->drwav_inited = false;
         }
+        // drwav is inited again with header when reopening, e.g. seeking after finished
+        decoder->filled_header = false;
         decoder->parsed_header = false;
 
         audio_element_info_t info = {0};
@@ -365,8 +369,15 @@ static int wav_decoder_process(audio_element_handle_t self, char *in_buffer, int
 static esp_err_t wav_decoder_seek(audio_element_handle_t self, long long offset)
 {
     wav_decoder_handle_t decoder = (wav_decoder_handle_t)audio_element_getdata(self);
+    if (decoder->drwav_inited) {
+        // drwav reads sequentially and counts down the data chunk, rewind it in place
+        drwav_uint64 pos = offset > 0 ? (drwav_uint64)offset : 0;
+        decoder->drwav.bytesRemaining =
+            pos < decoder->drwav.dataChunkDataSize ? decoder->drwav.dataChunkDataSize - pos : 0;
+    }
     decoder->drwav_offset = 0;
     decoder->read_timeout = false;
+    decoder->buf_in.ptr = decoder->buf_in.data;
     decoder->buf_in.bytes_read = 0;
     decoder->buf_in.bytes_want = 0;
     decoder->buf_in.eof = false;
@@ -392,15 +403,16 @@ audio_element_handle_t wav_decoder_init(struct wav_decoder_cfg *config)
         cfg.task_stack = WAV_DECODER_TASK_STACK;
     cfg.tag = "wav_decoder";
 
-    wav_decoder_handle_t decoder = audio_calloc(1, sizeof(struct wav_decoder));
+    wav_decoder_handle_t decoder = media_arena_calloc(config->arena, 1, sizeof(struct wav_decoder));
     if (decoder == NULL)
         return NULL;
+    decoder->arena = config->arena;
 
     decoder->prefered_frames = config->wav_info->sampleRate*WAV_DECODER_PREFERED_PEROID_MS/1000;
     decoder->buf_in.size = decoder->prefered_frames * config->wav_info->blockAlign;
     decoder->buf_out.size = decoder->prefered_frames * config->wav_info->blockAlign;
-    decoder->buf_in.data = audio_malloc(decoder->buf_in.size);
-    decoder->buf_out.data = audio_malloc(decoder->buf_out.size);
+    decoder->buf_in.data = media_arena_malloc(decoder->arena, decoder->buf_in.size);
+    decoder->buf_out.data = media_arena_malloc(decoder->arena, decoder->buf_out.size);
     AUDIO_MEM_CHECK(TAG, decoder->buf_in.data && decoder->buf_out.data, goto wav_init_error);
 
     audio_element_handle_t el = audio_element_init(&cfg);
@@ -419,9 +431,9 @@ audio_element_handle_t wav_decoder_init(struct wav_decoder_cfg *config)
 
 wav_init_error:
     if (decoder->buf_in.data)
-        audio_free(decoder->buf_in.data);
+        media_arena_free(decoder->arena, decoder->buf_in.data);
     if (decoder->buf_out.data)
-        audio_free(decoder->buf_out.data);
-    audio_free(decoder);
+        media_arena_free(decoder->arena, decoder->buf_out.data);
+    media_arena_free(decoder->arena, decoder);
     return NULL;
 }
@@ -28,6 +28,7 @@
 //#define STSZ_MAX_BUFFER       (256*1024)
 
 #define STREAM_BUFFER_SIZE    (2048)
+#define SMPB_SCAN_CARRY       (256)
 
 #define M4A_PARSER_TASK_PRIO  (OS_THREAD_PRIO_HIGH)
 #define M4A_PARSER_TASK_STACK (6144)
@@ -357,7 +358,7 @@ static AAC_ERR_T sttsin(atom_parser_handle_t handle, uint32_t atom_size)
 
     m4a_info->stts_time2sample_entries = u32in(buf); buf += 4;
     m4a_info->stts_time2sample =
-        audio_calloc(m4a_info->stts_time2sample_entries, sizeof(struct time2sample));
+        media_arena_calloc(m4a_info->arena, m4a_info->stts_time2sample_entries, sizeof(struct time2sample));
     if (m4a_info->stts_time2sample == NULL) {
         return AAC_ERR_NOMEM;
     }
@@ -394,7 +395,7 @@ static AAC_ERR_T stscin(atom_parser_handle_t handle, uint32_t atom_size)
 
     m4a_info->stsc_sample2chunk_entries = u32in(buf); buf += 4;
     m4a_info->stsc_sample2chunk =
-        audio_calloc(m4a_info->stsc_sample2chunk_entries, sizeof(struct sample2chunk));
+        media_arena_calloc(m4a_info->arena, m4a_info->stsc_sample2chunk_entries, sizeof(struct sample2chunk));
     if (m4a_info->stsc_sample2chunk == NULL) {
         return AAC_ERR_NOMEM;
     }
@@ -446,7 +447,7 @@ static AAC_ERR_T stszin(atom_parser_handle_t handle, uint32_t atom_size)
         return AAC_ERR_NOMEM;
     }
 #endif
-    m4a_info->stsz_samplesize = audio_calloc(m4a_info->stsz_samplesize_entries, sizeof(uint16_t));
+    m4a_info->stsz_samplesize = media_arena_calloc(m4a_info->arena, m4a_info->stsz_samplesize_entries, sizeof(uint16_t));
     if (m4a_info->stsz_samplesize == NULL) {
         return AAC_ERR_NOMEM;
     }
@@ -493,16 +494,18 @@ static AAC_ERR_T stcoin(atom_parser_handle_t handle, uint32_t atom_size)
     // Number of entries
     m4a_info->stco_chunk2offset_entries = u32in(buf); buf += 4;
     m4a_info->stco_chunk2offset =
-        audio_calloc(m4a_info->stco_chunk2offset_entries, sizeof(struct chunk2offset));
+        media_arena_calloc(m4a_info->arena, m4a_info->stco_chunk2offset_entries, sizeof(struct chunk2offset));
     if (m4a_info->stco_chunk2offset == NULL) {
         return AAC_ERR_NOMEM;
     }
 
     // first chunk offset
     uint32_t offset = u32in(buf); buf += 4;
+    m4a_info->mdat_offset = offset; // the table below skips the last chunk, the only one if all samples are in it
     uint32_t new_chunk = 1, old_chunk = 1;
     uint32_t old_first = m4a_info->stsc_sample2chunk[0].first_chunk;
-    uint32_t new_first = m4a_info->stsc_sample2chunk[1].first_chunk;
+    uint32_t new_first = m4a_info->stsc_sample2chunk_entries > 1 ?
+        m4a_info->stsc_sample2chunk[1].first_chunk : 0; // only one entry if all chunks are alike
     uint32_t old_samples = m4a_info->stsc_sample2chunk[0].samples_per_chunk;
     uint32_t new_samples = 0;
     uint32_t idx = 0;
@@ -535,8 +538,6 @@ static AAC_ERR_T stcoin(atom_parser_handle_t handle, uint32_t atom_size)
     m4a_info->stco_chunk2offset[idx].sample_index = 0;
     m4a_info->stco_chunk2offset[idx].chunk_offset = 0;
 
-    m4a_info->mdat_offset = m4a_info->stco_chunk2offset[0].chunk_offset;
-
     return atom_rb_read(handle, remain_byte);
 }
 
@@ -767,6 +768,8 @@ next_atom:
     } else if (memcmp(atom_name, "moov", 4) == 0) {
         OS_LOGV(TAG, "moov ahead of mdat");
         handle->m4a_info->moov_tail = false;
+        handle->m4a_info->moov_offset = offset;
+        handle->m4a_info->moov_size = atom_size;
         return moovin(handle, 8);
     } else {
         goto next_atom;
@@ -821,6 +824,80 @@ finish:
     return err;
 }
 
+/*
+ * iTunSMPB is a freeform metadata item: moov/udta/meta/ilst/----/{mean,name,data},
+ * the data payload is a string of hex words: " 00000000 DELAY PADDING VALID_SAMPLES ...".
+ * Instead of walking the optional atoms, the fetched bytes are scanned for the name.
+ */
+struct smpb_scanner {
+    char buf[STREAM_BUFFER_SIZE + SMPB_SCAN_CARRY];
+    int  size;
+    bool found;
+};
+
+static bool m4a_parse_smpb(char *buf, int size, struct m4a_info *info)
+{
+    char str[128];
+    int i;
+
+    for (i = 8; i + 16 <= size && i < 64; i++) {
+        if (memcmp(&buf[i], "data", 4) == 0)
+            break;
+    }
+    if (i + 16 > size || i >= 64)
+        return false;
+
+    int payload_size = (int)u32in((uint8_t *)&buf[i - 4]) - 16;
+    char *payload = &buf[i + 12];
+    if (payload_size > size - (i + 12))
+        payload_size = size - (i + 12);
+    if (payload_size <= 0)
+        return false;
+    if (payload_size > (int)sizeof(str) - 1)
+        payload_size = (int)sizeof(str) - 1;
+    memcpy(str, payload, payload_size);
+    str[payload_size] = '\0';
+
+    unsigned int reserved = 0, delay = 0, padding = 0;
+    unsigned long long samples = 0;
+    if (sscanf(str, "%x %x %x %llx", &reserved, &delay, &padding, &samples) != 4)
+        return false;
+
+    info->encoder_delay = delay;
+    info->encoder_padding = padding;
+    info->valid_samples = samples;
+    OS_LOGD(TAG, "iTunSMPB: delay=%u, padding=%u, valid_samples=%llu", delay, padding, samples);
+    return true;
+}
+
+static void m4a_scan_smpb(struct smpb_scanner *scanner, struct m4a_info *info, char *data, int size, bool final)
+{
+    do {
+        int bytes = sizeof(scanner->buf) - scanner->size;
+        if (bytes > size)
+            bytes = size;
+        memcpy(&scanner->buf[scanner->size], data, bytes);
+        scanner->size += bytes;
+        data += bytes;
+        size -= bytes;
+
+        // keep SMPB_SCAN_CARRY bytes behind the match, unless no more data
+        int limit = (final && size == 0) ? scanner->size - 7 : scanner->size - SMPB_SCAN_CARRY;
+        int i;
+        for (i = 0; i < limit; i++) {
+            if (memcmp(&scanner->buf[i], "iTunSMPB", 8) == 0) {
+                scanner->found = true;
+                m4a_parse_smpb(&scanner->buf[i], scanner->size - i, info);
+                return;
+            }
+        }
+        if (limit > 0) {
+            memmove(scanner->buf, &scanner->buf[limit], scanner->size - limit);
+            scanner->size -= limit;
+        }
+    } while (size > 0);
+}
+
 struct m4a_reader_priv {
     struct m4a_info *info;
     ringbuf_handle rb;
@@ -841,10 +918,16 @@ int m4a_extractor(m4a_fetch_cb fetch_cb, void *fetch_priv, struct m4a_info *info
     char buffer[STREAM_BUFFER_SIZE];
     int bytes_writen, bytes_read, offset = 0;
     bool double_check = false;
+    struct smpb_scanner *scanner = NULL;
 
     rb_atom = rb_create(STREAM_BUFFER_SIZE);
     if (rb_atom == NULL)
         return AAC_ERR_FAIL;
+    scanner = audio_calloc(1, sizeof(struct smpb_scanner));
+    if (scanner == NULL) {
+        rb_destroy(rb_atom);
+        return AAC_ERR_FAIL;
+    }
 
     struct m4a_reader_priv priv = {
         .info = info,
@@ -873,6 +956,8 @@ m4a_parse:
 
         offset += bytes_read;
         bytes_writen = 0;
+        if (!scanner->found)
+            m4a_scan_smpb(scanner, info, buffer, bytes_read, false);
 
         do {
             bytes_writen = rb_write(rb_atom, &buffer[bytes_writen], bytes_read, AUDIO_MAX_DELAY);
@@ -900,29 +985,48 @@ m4a_writen:
         if (priv.ret == AAC_ERR_AGAIN && info->parsed_once && info->moov_tail) {
             rb_reset(rb_atom);
             offset = info->moov_offset;
+            scanner->size = 0;
             goto m4a_parse;
         }
     }
 
+    if (priv.ret == AAC_ERR_NONE && !scanner->found) {
+        // udta is generally behind trak, go on fetching till the end of moov
+        uint32_t moov_end = info->moov_offset + info->moov_size;
+        while (!scanner->found && (info->moov_tail || offset < moov_end)) {
+            int wanted_size = sizeof(buffer);
+            if (!info->moov_tail && moov_end - offset < wanted_size)
+                wanted_size = moov_end - offset;
+            bytes_read = fetch_cb(buffer, wanted_size, offset, fetch_priv);
+            if (bytes_read <= 0)
+                break;
+            offset += bytes_read;
+            m4a_scan_smpb(scanner, info, buffer, bytes_read, false);
+        }
+        if (!scanner->found)
+            m4a_scan_smpb(scanner, info, buffer, 0, true);
+    }
+
 m4a_finish:
     if (priv.ret != AAC_ERR_NONE) {
         if (info->stsz_samplesize != NULL) {
-            audio_free(info->stsz_samplesize);
+            media_arena_free(info->arena, info->stsz_samplesize);
             info->stsz_samplesize = NULL;
         }
         if (info->stts_time2sample != NULL) {
-            audio_free(info->stts_time2sample);
+            media_arena_free(info->arena, info->stts_time2sample);
             info->stts_time2sample = NULL;
         }
         if (info->stsc_sample2chunk != NULL) {
-            audio_free(info->stsc_sample2chunk);
+            media_arena_free(info->arena, info->stsc_sample2chunk);
             info->stsc_sample2chunk = NULL;
         }
         if (info->stco_chunk2offset != NULL) {
-            audio_free(info->stco_chunk2offset);
+            media_arena_free(info->arena, info->stco_chunk2offset);
             info->stco_chunk2offset = NULL;
         }
     }
+    audio_free(scanner);
     rb_destroy(rb_atom);
     return priv.ret;
 }
@@ -18,6 +18,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "cutils/ringbuf.h"
+#include "liteplayer_arena.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -61,6 +62,7 @@ struct m4a_info {
     // stsz box: samplesize table
     uint32_t    stsz_samplesize_entries;
     uint32_t    stsz_samplesize_index;
+    uint32_t    stsz_seek_index; // set by seeking, taken by the decoder
     uint16_t   *stsz_samplesize; // need to free when resetting player
     uint32_t    stsz_samplesize_max;
 
@@ -79,11 +81,20 @@ struct m4a_info {
     // Audio Specific Config data:
     struct audio_specific_config asc;
 
+    // iTunSMPB: gapless info in time_scale units, valid_samples is 0 if unknown
+    uint32_t    encoder_delay;
+    uint32_t    encoder_padding;
+    uint64_t    valid_samples;
+
     bool        parsed_once;
     bool        moov_tail;
     uint32_t    moov_offset;
+    uint32_t    moov_size;
     uint32_t    mdat_size;
     uint32_t    mdat_offset;
+
+    // sample tables are allocated from arena if it's set, free them with media_arena_free()
+    media_arena_handle_t arena;
 };
 
 int m4a_parse_header(ringbuf_handle rb, struct m4a_info *info);
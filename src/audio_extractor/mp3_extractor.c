@@ -23,6 +23,7 @@
 #define TAG "[liteplayer]mp3_extractor"
 
 #define DEFAULT_MP3_PARSER_BUFFER_SIZE 2048
+#define MP3_DECODER_DELAY              529 // 528 samples of synthesis filterbank delay, plus 1
 
 int mp3_find_syncword(char *buf, int size)
 {
@@ -119,6 +120,12 @@ check_next_frame:
     info->sample_rate = sample_rate;
     info->bit_rate = bit_rate;
     info->frame_size = frame_size;
+    if (layer == 3)
+        info->frame_samples = 384;
+    else if (layer == 1 && ver != 3)
+        info->frame_samples = 576;
+    else
+        info->frame_samples = 1152;
 
     OS_LOGD(TAG, "channels=%d, sample_rate=%d, bit_rate=%d, frame_size=%d",
              info->channels, info->sample_rate, info->bit_rate, info->frame_size);
@@ -135,6 +142,54 @@ success:
     return 0;
 }
 
+/*
+ * Xing/Info header lives in the first frame which carries no audio, and the LAME tag
+ * behind it records encoder delay and padding, see http://gabriel.mp3-tech.org/mp3infotag.html
+ * Returns true if the first frame is a Xing/Info frame.
+ */
+static bool mp3_parse_xing(char *buf, int buf_size, struct mp3_info *info)
+{
+    unsigned char ver = (buf[1] >> 3) & 0x03;
+    unsigned char sMode = (buf[3] >> 6) & 0x03;
+    int offset;
+
+    // Xing header is behind the side information
+    if (ver == 3 /* V1 */)
+        offset = (sMode == 0x03) ? 21 : 36;
+    else
+        offset = (sMode == 0x03) ? 13 : 21;
+
+    if (offset + 8 > buf_size || offset + 8 > info->frame_size)
+        return false;
+    if (strncmp(&buf[offset], "Xing", 4) != 0 && strncmp(&buf[offset], "Info", 4) != 0)
+        return false;
+
+    unsigned char *p = (unsigned char *)&buf[offset + 4];
+    unsigned int flags = (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    p += 4;
+    if (flags & 0x01) {
+        if ((char *)p + 4 > buf + buf_size)
+            return true;
+        info->total_frames = (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+        p += 4;
+    }
+    if (flags & 0x02)
+        p += 4;   // bytes
+    if (flags & 0x04)
+        p += 100; // toc
+    if (flags & 0x08)
+        p += 4;   // quality
+
+    // LAME tag: encoder version[9], ..., delay[12 bits] and padding[12 bits] at offset 21
+    if ((char *)p + 24 <= buf + buf_size && strncmp((char *)p, "LAME", 4) == 0) {
+        int delay = (p[21] << 4) | (p[22] >> 4);
+        int padding = ((p[22] & 0x0F) << 8) | p[23];
+        info->encoder_delay = delay + MP3_DECODER_DELAY;
+        info->encoder_padding = padding > MP3_DECODER_DELAY ? padding - MP3_DECODER_DELAY : 0;
+    }
+    return true;
+}
+
 static void mp3_dump_info(struct mp3_info *info)
 {
     OS_LOGD(TAG, "MP3 INFO:");
@@ -143,6 +198,9 @@ static void mp3_dump_info(struct mp3_info *info)
     OS_LOGD(TAG, "  >bit_rate          : %d", info->bit_rate);
     OS_LOGD(TAG, "  >frame_size        : %d", info->frame_size);
     OS_LOGD(TAG, "  >frame_start_offset: %d", info->frame_start_offset);
+    OS_LOGD(TAG, "  >total_frames      : %d", info->total_frames);
+    OS_LOGD(TAG, "  >encoder_delay     : %d", info->encoder_delay);
+    OS_LOGD(TAG, "  >encoder_padding   : %d", info->encoder_padding);
 }
 
 int mp3_extractor(mp3_fetch_cb fetch_cb, void *fetch_priv, struct mp3_info *info)
@@ -154,6 +212,7 @@ int mp3_extractor(mp3_fetch_cb fetch_cb, void *fetch_priv, struct mp3_info *info
     int buf_size = sizeof(buf);
     int last_position = 0;
     int sync_offset = 0;
+    int frame_position = 0;
 
     buf_size = fetch_cb(buf, buf_size, 0, fetch_priv);
     if (buf_size < 4) {
@@ -177,6 +236,7 @@ int mp3_extractor(mp3_fetch_cb fetch_cb, void *fetch_priv, struct mp3_info *info
         int ret = mp3_parse_header(&buf[frame_start_offset], remain_size, info);
         if (ret == 0) {
             found = true;
+            frame_position = frame_start_offset;
             goto finish;
         }
     }
@@ -203,6 +263,7 @@ find_syncword:
         int ret = mp3_parse_header(&buf[last_position], buf_size - last_position, info);
         if (ret == 0) {
             found = true;
+            frame_position = last_position;
             goto finish;
         } else {
             OS_LOGV(TAG, "Retry to find sync word");
@@ -217,6 +278,10 @@ find_syncword:
 finish:
     if (found) {
         info->frame_start_offset = frame_start_offset + last_position;
+        if (mp3_parse_xing(&buf[frame_position], buf_size - frame_position, info)) {
+            // skip the Xing/Info frame, otherwise it's decoded as a frame of silence
+            info->frame_start_offset += info->frame_size;
+        }
         mp3_dump_info(info);
     }
     return found ? 0 : -1;
@@ -28,6 +28,10 @@ struct mp3_info {
     int bit_rate;
     int frame_size;
     int frame_start_offset;
+    int frame_samples;      // samples per frame
+    int total_frames;       // from Xing/Info header, 0 if unknown
+    int encoder_delay;      // from LAME tag, decoder delay included
+    int encoder_padding;    // from LAME tag, decoder delay excluded
 };
 
 int mp3_find_syncword(char *buf, int size);
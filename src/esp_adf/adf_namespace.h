@@ -60,6 +60,8 @@
 #define audio_element_report_pos                    ADF_NAMESPACE(audio_element_report_pos)
 #define audio_element_set_input_timeout             ADF_NAMESPACE(audio_element_set_input_timeout)
 #define audio_element_set_output_timeout            ADF_NAMESPACE(audio_element_set_output_timeout)
+#define audio_element_set_process_batch             ADF_NAMESPACE(audio_element_set_process_batch)
+#define audio_element_set_stats                     ADF_NAMESPACE(audio_element_set_stats)
 #define audio_element_reset_input_ringbuf           ADF_NAMESPACE(audio_element_reset_input_ringbuf)
 #define audio_element_change_cmd                    ADF_NAMESPACE(audio_element_change_cmd)
 #define audio_element_reset_output_ringbuf          ADF_NAMESPACE(audio_element_reset_output_ringbuf)
@@ -89,6 +91,7 @@
 #define audio_event_iface_set_cmd_waiting_timeout   ADF_NAMESPACE(audio_event_iface_set_cmd_waiting_timeout)
 #define audio_event_iface_waiting_cmd_msg           ADF_NAMESPACE(audio_event_iface_waiting_cmd_msg)
 #define audio_event_iface_cmd                       ADF_NAMESPACE(audio_event_iface_cmd)
+#define audio_event_iface_cmd_pending               ADF_NAMESPACE(audio_event_iface_cmd_pending)
 #define audio_event_iface_sendout                   ADF_NAMESPACE(audio_event_iface_sendout)
 #define audio_event_iface_discard                   ADF_NAMESPACE(audio_event_iface_discard)
 #define audio_event_iface_listen                    ADF_NAMESPACE(audio_event_iface_listen)
@@ -33,6 +33,8 @@
 #include "esp_adf/audio_event_iface.h"
 #include "esp_adf/audio_element.h"
 #include "esp_adf/audio_common.h"
+#include "liteplayer_stats.h"
+#include "liteplayer_trace_internal.h"
 
 #define TAG  "[liteplayer]audio_element"
 
@@ -79,6 +81,11 @@ struct audio_element {
         stream_callback_t       write_cb;
     } out;
 
+    /* Staging buffer of input span for IO_TYPE_CB */
+    char                        *in_span_buf;
+    int                         in_span_size;
+    int                         in_span_filled;
+
     audio_multi_rb_t            multi_in;
     audio_multi_rb_t            multi_out;
 
@@ -113,8 +120,14 @@ struct audio_element {
     bool                        is_running;
     bool                        task_run;
     bool                        stopping;
+    bool                        output_full;    /* Inline output timed out, it's backpressure rather than underrun */
+    int                         process_batch;
     long long                   offset;
 #define SEEK_COMPLETED          (-1)
+
+    /* Runtime counters */
+    struct media_stats          *stats;
+    unsigned long long          io_usec;    /* Time spent in input/output of the current process */
 };
 
 const static int TASK_CREATED_BIT       = (1 << 0);
@@ -126,6 +139,25 @@ const static int SEEKED_BIT             = (1 << 5);
 const static int STOPPED_BIT            = (1 << 6);
 const static int TASK_DESTROYED_BIT     = (1 << 7);
 
+// Input/output time is excluded from the decode time, @filled is -1 if not read from ringbuf
+static inline void audio_element_stats_io(audio_element_handle_t el, unsigned long long begin, int filled)
+{
+    if (el->stats == NULL)
+        return;
+    unsigned long long usec = media_stats_clock(el->stats) - begin;
+    el->io_usec += usec;
+    if (filled >= 0)
+        media_stats_ringbuf_read(el->stats, filled, usec);
+}
+
+static inline void audio_element_stats_process(audio_element_handle_t el, unsigned long long begin, int process_len)
+{
+    if (el->stats == NULL || process_len <= 0)
+        return;
+    unsigned long long usec = media_stats_clock(el->stats) - begin;
+    media_stats_decode(el->stats, usec > el->io_usec ? usec - el->io_usec : 0);
+}
+
 static void audio_element_set_state_event(audio_element_handle_t el, int state_bit)
 {
     os_mutex_lock(el->state_lock);
@@ -223,6 +255,7 @@ open_fail:
 static esp_err_t audio_element_process_seek(audio_element_handle_t el, long long offset)
 {
     esp_err_t ret = ESP_OK;
+    el->in_span_filled = 0;
     if (el->seek)
         ret = el->seek(el, offset);
     OS_LOGD(TAG, "[%s] seeked", el->tag);
@@ -248,6 +281,8 @@ static esp_err_t audio_element_process_close(audio_element_handle_t el)
             }
         }
 
+        if (el->state != AEL_STATE_PAUSED)
+            el->in_span_filled = 0;
         el->is_open = false;
         OS_LOGD(TAG, "[%s] closed", el->tag);
     }
@@ -280,8 +315,9 @@ static esp_err_t audio_element_on_cmd(audio_event_iface_msg_t *msg, void *contex
                 || (el->state == AEL_STATE_STOPPED)) {
                 break;
             }
-            audio_element_process_close(el);
+            // Set state before closing, so that output closer knows the stream is finished
             el->state = AEL_STATE_FINISHED;
+            audio_element_process_close(el);
             audio_event_iface_set_cmd_waiting_timeout(el->iface_event, AUDIO_MAX_DELAY);
             audio_element_report_status(el, AEL_STATUS_STATE_FINISHED);
             el->is_running = false;
@@ -353,13 +389,19 @@ static esp_err_t audio_element_on_cmd(audio_event_iface_msg_t *msg, void *contex
     return ESP_OK;
 }
 
+// Returns ESP_OK only if something processed, so that a batch is ended on error or eof
 static esp_err_t audio_element_process_running(audio_element_handle_t el)
 {
     int process_len = -1;
     if (el->state < AEL_STATE_RUNNING || !el->is_running || !el->is_open) {
         return ESP_ERR_INVALID_STATE;
     }
+    unsigned long long begin = media_stats_clock(el->stats);
+    el->io_usec = 0;
+    LITEPLAYER_TRACE_BEGIN(trace);
     process_len = el->process(el, el->buf, el->buf_size);
+    LITEPLAYER_TRACE_END(trace, "decode");
+    audio_element_stats_process(el, begin, process_len);
     if (process_len <= 0) {
         switch (process_len) {
             case AEL_IO_ABORT:
@@ -372,7 +414,7 @@ static esp_err_t audio_element_process_running(audio_element_handle_t el)
                     el->is_open = false;
                     el->is_running = false;
                     audio_element_resume(el, 0, 0);
-                    return ESP_OK;
+                    return ESP_FAIL;
                 }
                 audio_element_set_ringbuf_done(el);
                 audio_element_cmd_send(el, AEL_MSG_CMD_FINISH);
@@ -395,6 +437,7 @@ static esp_err_t audio_element_process_running(audio_element_handle_t el)
                 OS_LOGW(TAG, "[%s] Process return error,ret:%d", el->tag, process_len);
                 break;
         }
+        return ESP_FAIL;
     }
     return ESP_OK;
 }
@@ -402,18 +445,24 @@ static esp_err_t audio_element_process_running(audio_element_handle_t el)
 int audio_element_input(audio_element_handle_t el, char *buffer, int wanted_size)
 {
     int in_len = 0;
+    unsigned long long begin = media_stats_clock(el->stats);
     if (el->read_type == IO_TYPE_CB) {
         if (el->in.read_cb.read == NULL) {
             OS_LOGE(TAG, "[%s] Read IO Type callback but callback not set", el->tag);
             return ESP_FAIL;
         }
         in_len = el->in.read_cb.read(el, buffer, wanted_size, el->input_timeout_ms, el->in.read_cb.ctx);
+        audio_element_stats_io(el, begin, -1);
     } else if (el->read_type == IO_TYPE_RB) {
         if (el->in.input_rb == NULL) {
             OS_LOGE(TAG, "[%s] Read IO type ringbuf but ringbuf not set", el->tag);
             return ESP_FAIL;
         }
+        int filled = el->stats != NULL ? rb_bytes_filled(el->in.input_rb) : 0;
+        LITEPLAYER_TRACE_BEGIN(wait);
         in_len = rb_read(el->in.input_rb, buffer, wanted_size, el->input_timeout_ms);
+        LITEPLAYER_TRACE_END(wait, "ringbuf_read");
+        audio_element_stats_io(el, begin, filled);
     } else {
         OS_LOGE(TAG, "[%s] Invalid read IO type", el->tag);
         return ESP_FAIL;
@@ -450,6 +499,7 @@ int audio_element_input(audio_element_handle_t el, char *buffer, int wanted_size
 int audio_element_output(audio_element_handle_t el, char *buffer, int write_size)
 {
     int output_len = 0;
+    unsigned long long begin = media_stats_clock(el->stats);
     if (el->write_type == IO_TYPE_CB) {
         if (el->out.write_cb.write && write_size) {
             output_len = el->out.write_cb.write(el, buffer, write_size, el->output_timeout_ms, el->out.write_cb.ctx);
@@ -464,6 +514,7 @@ int audio_element_output(audio_element_handle_t el, char *buffer, int write_size
             }
         }
     }
+    audio_element_stats_io(el, begin, -1);
     if (output_len <= 0) {
         switch (output_len) {
             case AEL_IO_ABORT:
@@ -482,6 +533,11 @@ int audio_element_output(audio_element_handle_t el, char *buffer, int write_size
                 audio_element_cmd_send(el, AEL_MSG_CMD_ERROR);
                 break;
             case AEL_IO_TIMEOUT:
+                if (!el->task_run) {
+                    // Inline element retries the output later, nothing to pause
+                    el->output_full = true;
+                    break;
+                }
                 OS_LOGW(TAG, "OUT-[%s] AEL_IO_TIMEOUT", el->tag);
                 audio_element_cmd_send(el, AEL_MSG_CMD_PAUSE);
                 break;
@@ -497,18 +553,24 @@ int audio_element_output(audio_element_handle_t el, char *buffer, int write_size
 int audio_element_input_chunk(audio_element_handle_t el, char *buffer, int wanted_size)
 {
     int in_len = 0;
+    unsigned long long begin = media_stats_clock(el->stats);
     if (el->read_type == IO_TYPE_CB) {
         if (el->in.read_cb.read == NULL) {
             OS_LOGE(TAG, "[%s] Read IO Type callback but callback not set", el->tag);
             return ESP_FAIL;
         }
         in_len = el->in.read_cb.read(el, buffer, wanted_size, el->input_timeout_ms, el->in.read_cb.ctx);
+        audio_element_stats_io(el, begin, -1);
     } else if (el->read_type == IO_TYPE_RB) {
         if (el->in.input_rb == NULL) {
             OS_LOGE(TAG, "[%s] Read IO type ringbuf but ringbuf not set", el->tag);
             return ESP_FAIL;
         }
+        int filled = el->stats != NULL ? rb_bytes_filled(el->in.input_rb) : 0;
+        LITEPLAYER_TRACE_BEGIN(wait);
         in_len = rb_read_chunk(el->in.input_rb, buffer, wanted_size, el->input_timeout_ms);
+        LITEPLAYER_TRACE_END(wait, "ringbuf_read");
+        audio_element_stats_io(el, begin, filled);
     } else {
         OS_LOGE(TAG, "[%s] Invalid read IO type", el->tag);
         return ESP_FAIL;
@@ -542,9 +604,108 @@ int audio_element_input_chunk(audio_element_handle_t el, char *buffer, int wante
     return in_len;
 }
 
+static int audio_element_input_acquire_cb(audio_element_handle_t el, char **buffer, int wanted_size)
+{
+    if (el->in_span_size < wanted_size) {
+        char *buf = audio_realloc(el->in_span_buf, wanted_size);
+        if (buf == NULL) {
+            OS_LOGE(TAG, "[%s] Failed to allocate input span: %d", el->tag, wanted_size);
+            return ESP_FAIL;
+        }
+        el->in_span_buf = buf;
+        el->in_span_size = wanted_size;
+    }
+    while (el->in_span_filled < wanted_size) {
+        int in_len = el->in.read_cb.read(el, el->in_span_buf + el->in_span_filled,
+                                         wanted_size - el->in_span_filled,
+                                         el->input_timeout_ms, el->in.read_cb.ctx);
+        if (in_len <= 0) {
+            if (el->in_span_filled > 0 && (in_len == AEL_IO_DONE || in_len == AEL_IO_OK))
+                break;
+            return in_len;
+        }
+        el->in_span_filled += in_len;
+    }
+    *buffer = el->in_span_buf;
+    return el->in_span_filled < wanted_size ? el->in_span_filled : wanted_size;
+}
+
+int audio_element_input_acquire(audio_element_handle_t el, char **buffer, int wanted_size)
+{
+    int in_len = 0;
+    unsigned long long begin = media_stats_clock(el->stats);
+    if (el->read_type == IO_TYPE_CB) {
+        if (el->in.read_cb.read == NULL) {
+            OS_LOGE(TAG, "[%s] Read IO Type callback but callback not set", el->tag);
+            return ESP_FAIL;
+        }
+        in_len = audio_element_input_acquire_cb(el, buffer, wanted_size);
+        audio_element_stats_io(el, begin, -1);
+    } else if (el->read_type == IO_TYPE_RB) {
+        if (el->in.input_rb == NULL) {
+            OS_LOGE(TAG, "[%s] Read IO type ringbuf but ringbuf not set", el->tag);
+            return ESP_FAIL;
+        }
+        int filled = el->stats != NULL ? rb_bytes_filled(el->in.input_rb) : 0;
+        LITEPLAYER_TRACE_BEGIN(wait);
+        in_len = rb_acquire_read(el->in.input_rb, buffer, wanted_size, el->input_timeout_ms);
+        LITEPLAYER_TRACE_END(wait, "ringbuf_read");
+        audio_element_stats_io(el, begin, filled);
+    } else {
+        OS_LOGE(TAG, "[%s] Invalid read IO type", el->tag);
+        return ESP_FAIL;
+    }
+    if (in_len <= 0) {
+        switch (in_len) {
+            case AEL_IO_ABORT:
+                OS_LOGW(TAG, "IN-[%s] AEL_IO_ABORT", el->tag);
+                audio_element_set_ringbuf_done(el);
+                audio_element_stop(el);
+                break;
+            case AEL_IO_DONE:
+            case AEL_IO_OK:
+                OS_LOGD(TAG, "IN-[%s] AEL_IO_DONE,%d", el->tag, in_len);
+                break;
+            case AEL_IO_FAIL:
+                OS_LOGE(TAG, "IN-[%s] AEL_STATUS_ERROR_INPUT", el->tag);
+                audio_element_report_status(el, AEL_STATUS_ERROR_INPUT);
+                audio_element_cmd_send(el, AEL_MSG_CMD_ERROR);
+                break;
+            case AEL_IO_TIMEOUT:
+                OS_LOGV(TAG, "IN-[%s] AEL_IO_TIMEOUT", el->tag);
+                break;
+            default:
+                OS_LOGE(TAG, "IN-[%s] Input return not support,ret:%d", el->tag, in_len);
+                audio_element_cmd_send(el, AEL_MSG_CMD_PAUSE);
+                break;
+        }
+    }
+    return in_len;
+}
+
+int audio_element_input_commit(audio_element_handle_t el, int size)
+{
+    if (size <= 0)
+        return ESP_OK;
+    if (el->read_type == IO_TYPE_CB) {
+        if (size > el->in_span_filled) {
+            OS_LOGE(TAG, "[%s] Commit input overflow: %d/%d", el->tag, size, el->in_span_filled);
+            return ESP_FAIL;
+        }
+        el->in_span_filled -= size;
+        if (el->in_span_filled > 0)
+            memmove(el->in_span_buf, el->in_span_buf + size, el->in_span_filled);
+        return ESP_OK;
+    } else if (el->read_type == IO_TYPE_RB && el->in.input_rb != NULL) {
+        return rb_commit_read(el->in.input_rb, size) == RB_OK ? ESP_OK : ESP_FAIL;
+    }
+    return ESP_FAIL;
+}
+
 int audio_element_output_chunk(audio_element_handle_t el, char *buffer, int write_size)
 {
     int output_len = 0;
+    unsigned long long begin = media_stats_clock(el->stats);
     if (el->write_type == IO_TYPE_CB) {
         if (el->out.write_cb.write && write_size) {
             output_len = el->out.write_cb.write(el, buffer, write_size, el->output_timeout_ms, el->out.write_cb.ctx);
@@ -559,6 +720,7 @@ int audio_element_output_chunk(audio_element_handle_t el, char *buffer, int writ
             }
         }
     }
+    audio_element_stats_io(el, begin, -1);
     if (output_len <= 0) {
         switch (output_len) {
             case AEL_IO_ABORT:
@@ -577,6 +739,11 @@ int audio_element_output_chunk(audio_element_handle_t el, char *buffer, int writ
                 audio_element_cmd_send(el, AEL_MSG_CMD_ERROR);
                 break;
             case AEL_IO_TIMEOUT:
+                if (!el->task_run) {
+                    // Inline element retries the output later, nothing to pause
+                    el->output_full = true;
+                    break;
+                }
                 OS_LOGW(TAG, "OUT-[%s] AEL_IO_TIMEOUT", el->tag);
                 audio_element_cmd_send(el, AEL_MSG_CMD_PAUSE);
                 break;
@@ -609,8 +776,12 @@ static void *audio_element_task(void *pv)
             audio_element_set_state_event(el, STOPPED_BIT);
             break;
         }
-        if (audio_element_process_running(el) != ESP_OK) {
-            // continue;
+        // cmd queue is checked between batches, or as soon as a cmd is pending
+        for (int i = 0; i < el->process_batch; i++) {
+            if (audio_element_process_running(el) != ESP_OK)
+                break;
+            if (audio_event_iface_cmd_pending(el->iface_event))
+                break;
         }
     }
 
@@ -618,6 +789,7 @@ static void *audio_element_task(void *pv)
     if (el->buf) audio_free(el->buf);
     OS_LOGV(TAG, "[%s] el task deleted,%p", el->tag, os_thread_self());
     el->task_run = false;
+    LITEPLAYER_TRACE_THREAD_EXIT();
     audio_element_set_state_event(el, TASK_DESTROYED_BIT);
     return NULL;
 }
@@ -928,6 +1100,24 @@ esp_err_t audio_element_set_output_timeout(audio_element_handle_t el, int timeou
     return ESP_FAIL;
 }
 
+esp_err_t audio_element_set_process_batch(audio_element_handle_t el, int frames)
+{
+    if (el && frames > 0) {
+        el->process_batch = frames;
+        return ESP_OK;
+    }
+    return ESP_FAIL;
+}
+
+esp_err_t audio_element_set_stats(audio_element_handle_t el, struct media_stats *stats)
+{
+    if (el) {
+        el->stats = stats;
+        return ESP_OK;
+    }
+    return ESP_FAIL;
+}
+
 int audio_element_get_output_ringbuf_size(audio_element_handle_t el)
 {
     if (el) {
@@ -1052,6 +1242,7 @@ audio_element_handle_t audio_element_init(audio_element_cfg_t *config)
     audio_element_setinfo(el, &info);
     audio_element_set_input_timeout(el, AUDIO_MAX_DELAY);
     audio_element_set_output_timeout(el, AUDIO_MAX_DELAY);
+    audio_element_set_process_batch(el, DEFAULT_ELEMENT_PROCESS_BATCH);
 
     if (config->reader != NULL) {
         el->read_type = IO_TYPE_CB;
@@ -1129,6 +1320,9 @@ esp_err_t audio_element_deinit(audio_element_handle_t el)
     if (el->report_info) {
         audio_free(el->report_info);
     }
+    if (el->in_span_buf) {
+        audio_free(el->in_span_buf);
+    }
     audio_free(el);
     return ESP_OK;
 }
@@ -1362,6 +1556,164 @@ esp_err_t audio_element_wait_for_stop_ms(audio_element_handle_t el, int timeout_
     return ret;
 }
 
+esp_err_t audio_element_run_inline(audio_element_handle_t el)
+{
+    if (el->task_run) {
+        OS_LOGE(TAG, "[%s] Element task has been created", el->tag);
+        return ESP_FAIL;
+    }
+    OS_LOGV(TAG, "[%s] Element starting inline", el->tag);
+    if (el->buf_size > 0 && el->buf == NULL) {
+        el->buf = audio_malloc(el->buf_size);
+        AUDIO_MEM_CHECK(TAG, el->buf, return ESP_FAIL);
+    }
+    audio_event_iface_discard(el->iface_event);
+    audio_element_force_set_state(el, AEL_STATE_INIT);
+    audio_element_clear_state_event(el, STOPPED_BIT);
+    if (audio_element_process_open(el) != ESP_OK) {
+        audio_event_iface_discard(el->iface_event);
+        el->state = AEL_STATE_ERROR;
+        return ESP_FAIL;
+    }
+    audio_element_force_set_state(el, AEL_STATE_RUNNING);
+    el->is_running = true;
+    return ESP_OK;
+}
+
+int audio_element_process_inline(audio_element_handle_t el)
+{
+    if (el->state == AEL_STATE_FINISHED)
+        return AEL_IO_DONE;
+    if (el->state != AEL_STATE_RUNNING || !el->is_running || !el->is_open)
+        return AEL_IO_FAIL;
+
+    unsigned long long begin = media_stats_clock(el->stats);
+    el->io_usec = 0;
+    el->output_full = false;
+    LITEPLAYER_TRACE_BEGIN(trace);
+    int process_len = el->process(el, el->buf, el->buf_size);
+    LITEPLAYER_TRACE_END(trace, "decode");
+    audio_element_stats_process(el, begin, process_len);
+    // Commands posted by input/output helpers are meant for the element task,
+    // here the state is derived from the process result directly
+    audio_event_iface_discard(el->iface_event);
+    if (process_len > 0)
+        return process_len;
+
+    switch (process_len) {
+        case AEL_IO_TIMEOUT:
+            OS_LOGV(TAG, "[%s] ERROR_PROCESS, AEL_IO_TIMEOUT", el->tag);
+            if (!el->output_full)
+                audio_element_report_status(el, AEL_STATUS_ERROR_TIMEOUT);
+            return AEL_IO_TIMEOUT;
+        case AEL_IO_DONE:
+        case AEL_IO_OK:
+            el->state = AEL_STATE_FINISHED;
+            audio_element_process_close(el);
+            el->is_running = false;
+            audio_element_report_status(el, AEL_STATUS_STATE_FINISHED);
+            audio_element_set_state_event(el, STOPPED_BIT);
+            return AEL_IO_DONE;
+        case AEL_IO_ABORT:
+            OS_LOGW(TAG, "[%s] ERROR_PROCESS, AEL_IO_ABORT", el->tag);
+            audio_element_process_close(el);
+            el->state = AEL_STATE_STOPPED;
+            el->is_running = false;
+            audio_element_set_state_event(el, STOPPED_BIT);
+            return AEL_IO_ABORT;
+        default:
+            OS_LOGE(TAG, "[%s] ERROR_PROCESS, ret:%d", el->tag, process_len);
+            audio_element_report_status(el, AEL_STATUS_ERROR_PROCESS);
+            audio_element_process_close(el);
+            el->state = AEL_STATE_ERROR;
+            el->is_running = false;
+            audio_element_set_state_event(el, STOPPED_BIT);
+            return AEL_IO_FAIL;
+    }
+}
+
+esp_err_t audio_element_seek_inline(audio_element_handle_t el, long long offset)
+{
+    if (el->task_run || (el->state != AEL_STATE_RUNNING && el->state != AEL_STATE_PAUSED)) {
+        OS_LOGE(TAG, "[%s] SEEK: Element not running inline, state:%d", el->tag, el->state);
+        return ESP_FAIL;
+    }
+    // Close as paused, so the decoder keeps its context while the input is reopened
+    el->state = AEL_STATE_PAUSED;
+    audio_element_process_close(el);
+    if (audio_element_process_seek(el, offset) != ESP_OK ||
+        audio_element_process_open(el) != ESP_OK) {
+        audio_event_iface_discard(el->iface_event);
+        el->state = AEL_STATE_ERROR;
+        el->is_running = false;
+        return ESP_FAIL;
+    }
+    audio_element_force_set_state(el, AEL_STATE_RUNNING);
+    el->is_running = true;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_pause_inline(audio_element_handle_t el)
+{
+    if (!el->task_run && el->state == AEL_STATE_FINISHED) {
+        // finished before pausing, same as audio_element_pause()
+        audio_element_force_set_state(el, AEL_STATE_PAUSED);
+        return ESP_OK;
+    }
+    if (el->task_run || (el->state != AEL_STATE_RUNNING && el->state != AEL_STATE_PAUSED)) {
+        OS_LOGE(TAG, "[%s] PAUSE: Element not running inline, state:%d", el->tag, el->state);
+        return ESP_FAIL;
+    }
+    if (el->state == AEL_STATE_PAUSED)
+        return ESP_OK;
+    el->state = AEL_STATE_PAUSED;
+    audio_element_process_close(el);
+    el->is_running = false;
+    audio_element_report_status(el, AEL_STATUS_STATE_PAUSED);
+    return ESP_OK;
+}
+
+esp_err_t audio_element_resume_inline(audio_element_handle_t el)
+{
+    if (el->task_run || (el->state != AEL_STATE_RUNNING && el->state != AEL_STATE_PAUSED)) {
+        OS_LOGE(TAG, "[%s] RESUME: Element not running inline, state:%d", el->tag, el->state);
+        return ESP_FAIL;
+    }
+    if (el->state == AEL_STATE_RUNNING && el->is_open) {
+        el->is_running = true;
+        return ESP_OK;
+    }
+    if (audio_element_process_open(el) != ESP_OK) {
+        audio_event_iface_discard(el->iface_event);
+        el->state = AEL_STATE_ERROR;
+        el->is_running = false;
+        return ESP_FAIL;
+    }
+    audio_element_force_set_state(el, AEL_STATE_RUNNING);
+    el->is_running = true;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_stop_inline(audio_element_handle_t el)
+{
+    if (el->task_run) {
+        OS_LOGE(TAG, "[%s] Element task has been created", el->tag);
+        return ESP_FAIL;
+    }
+    audio_element_process_close(el);
+    if (el->buf) {
+        audio_free(el->buf);
+        el->buf = NULL;
+    }
+    if (el->state != AEL_STATE_STOPPED) {
+        el->state = AEL_STATE_STOPPED;
+        el->is_running = false;
+        audio_element_report_status(el, AEL_STATUS_STATE_STOPPED);
+    }
+    audio_element_set_state_event(el, STOPPED_BIT);
+    return ESP_OK;
+}
+
 esp_err_t audio_element_multi_input(audio_element_handle_t el, char *buffer, int wanted_size, int index, int timeout_ms)
 {
     esp_err_t ret = ESP_OK;
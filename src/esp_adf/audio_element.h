@@ -105,6 +105,8 @@ typedef enum {
 
 typedef struct audio_element *audio_element_handle_t;
 
+struct media_stats;
+
 /**
  * @brief Audio Element user reserved data
  */
@@ -176,6 +178,7 @@ typedef struct {
 #define DEFAULT_ELEMENT_BUFFER_LENGTH   (1024)
 #define DEFAULT_ELEMENT_STACK_SIZE      (2*1024)
 #define DEFAULT_ELEMENT_TASK_PRIO       (OS_THREAD_PRIO_NORMAL)
+#define DEFAULT_ELEMENT_PROCESS_BATCH   (1)
 
 #define DEFAULT_AUDIO_ELEMENT_CONFIG() {                \
     .buffer_len         = DEFAULT_ELEMENT_BUFFER_LENGTH,\
@@ -390,6 +393,81 @@ esp_err_t audio_element_resume(audio_element_handle_t el, float wait_for_rb_thre
  */
 esp_err_t audio_element_seek(audio_element_handle_t el, long long offset);
 
+/**
+ * @brief      Open Audio Element on the caller's thread, no task is created.
+ *             The element is driven by audio_element_process_inline() afterwards, pause/resume/seek
+ *             requests are not available, use the *_inline() variants instead.
+ *
+ * @param[in]  el    The audio element handle
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL
+ */
+esp_err_t audio_element_run_inline(audio_element_handle_t el);
+
+/**
+ * @brief      Run the process function of an inline element once on the caller's thread.
+ *             Status is reported through the event callback as if the element was running in a task.
+ *
+ * @param[in]  el    The audio element handle
+ *
+ * @return
+ *     - > 0, bytes processed
+ *     - AEL_IO_DONE, element finished
+ *     - AEL_IO_TIMEOUT, nothing processed, try again, input timeout is reported as
+ *       AEL_STATUS_ERROR_TIMEOUT, output timeout isn't as it's backpressure of the sink
+ *     - AEL_IO_FAIL/AEL_IO_ABORT, element stopped on error
+ */
+int audio_element_process_inline(audio_element_handle_t el);
+
+/**
+ * @brief      Seek an inline element to the offset, the input is reopened before it returns.
+ *
+ * @param[in]  el                     The audio element handle
+ * @param[in]  offset                 The offset
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL
+ */
+esp_err_t audio_element_seek_inline(audio_element_handle_t el, long long offset);
+
+/**
+ * @brief      Close an inline element as paused, the decoder keeps its context,
+ *             audio_element_process_inline() fails until it's resumed.
+ *
+ * @param[in]  el    The audio element handle
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL
+ */
+esp_err_t audio_element_pause_inline(audio_element_handle_t el);
+
+/**
+ * @brief      Reopen an inline element paused by audio_element_pause_inline().
+ *
+ * @param[in]  el    The audio element handle
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL
+ */
+esp_err_t audio_element_resume_inline(audio_element_handle_t el);
+
+/**
+ * @brief      Close an inline element and put it into 'STOPPED' state,
+ *             it must be called before audio_element_deinit().
+ *
+ * @param[in]  el    The audio element handle
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL
+ */
+esp_err_t audio_element_stop_inline(audio_element_handle_t el);
+
 /**
  * @brief      This function will add a `listener` to listen to all events from audio element `el`.
  *             Any event from el->external_event will be send to the `listener`.
@@ -587,6 +665,32 @@ esp_err_t audio_element_set_input_timeout(audio_element_handle_t el, int timeout
  */
 esp_err_t audio_element_set_output_timeout(audio_element_handle_t el, int timeout_ms);
 
+/**
+ * @brief      Set max process calls between checks of the cmd queue (default is `DEFAULT_ELEMENT_PROCESS_BATCH`).
+ *             A batch still ends at once if a cmd is pending, or process returns nothing.
+ *
+ * @param[in]  el      The audio element handle
+ * @param[in]  frames  The process calls per batch, must be > 0
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL
+ */
+esp_err_t audio_element_set_process_batch(audio_element_handle_t el, int frames);
+
+/**
+ * @brief      Attach runtime counters, decode time of each process call is recorded with
+ *             input/output time excluded, and the input ringbuf fill is sampled on reading.
+ *
+ * @param[in]  el     The audio element handle
+ * @param[in]  stats  The counters, see liteplayer_stats.h, NULL to detach
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL
+ */
+esp_err_t audio_element_set_stats(audio_element_handle_t el, struct media_stats *stats);
+
 /**
  * @brief      Reset inputbuffer.
  *
@@ -664,6 +768,36 @@ int audio_element_output(audio_element_handle_t el, char *buffer, int write_size
  */
 int audio_element_input_chunk(audio_element_handle_t el, char *buffer, int wanted_size);
 
+/**
+ * @brief      Call this function to get Element input the whole chunk in place, without copying.
+ *             With ringbuffer, the span points into the ringbuffer, with read callback,
+ *             the data is staged in a buffer owned by Element.
+ *             Input isn't consumed until audio_element_input_commit(), acquiring again returns
+ *             the same data. Less than `wanted_size` is returned only at the end of stream
+ *             (or if the span wraps around the end of a ringbuffer created without enough span).
+ *
+ * @param[in]  el            The audio element handle
+ * @param[out] buffer        The pointer to the acquired span
+ * @param[in]  wanted_size   The wanted size
+ *
+ * @return
+ *        - > 0 number of bytes in the span
+ *        - <=0 audio_element_err_t
+ */
+int audio_element_input_acquire(audio_element_handle_t el, char **buffer, int wanted_size);
+
+/**
+ * @brief      Call this function to consume `size` bytes of the span acquired by audio_element_input_acquire()
+ *
+ * @param[in]  el            The audio element handle
+ * @param[in]  size          The consumed size
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL
+ */
+int audio_element_input_commit(audio_element_handle_t el, int size);
+
 /**
  * @brief      Call this function to sendout Element output the whole chunk
  *             Depending on setup using ringbuffer or function callback, Element will invoke write to ringbuffer, or call write callback funtion.
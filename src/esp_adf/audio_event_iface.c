@@ -30,6 +30,21 @@
 
 #define TAG  "[liteplayer]audio_event"
 
+#if defined(__STDC_NO_ATOMICS__)
+// IMPORTANT:
+//   IF ATOMIC NOT SUPPORTED, INTERNAL QUEUE IS POLLED EVERY TIME AS IF CMD IS PENDING
+#define ATOMIC_DECLARE(obj)         int obj
+#define ATOMIC_PENDING(obj)         1
+#define ATOMIC_INC(obj)
+#define ATOMIC_DEC(obj)
+
+#else
+#include <stdatomic.h>
+#define ATOMIC_DECLARE(obj)         atomic_int obj
+#define ATOMIC_PENDING(obj)         (atomic_load_explicit(&(obj), memory_order_acquire) > 0)
+#define ATOMIC_INC(obj)             atomic_fetch_add_explicit(&(obj), 1, memory_order_release)
+#define ATOMIC_DEC(obj)             atomic_fetch_sub_explicit(&(obj), 1, memory_order_relaxed)
+#endif
 
 typedef struct audio_event_iface_item {
     STAILQ_ENTRY(audio_event_iface_item)    next;
@@ -55,6 +70,9 @@ struct audio_event_iface {
     on_event_iface_func         on_cmd;
     unsigned int                timeout_ms;
     int                         type;
+    // counted before sent and after received, so never below the number of queued cmds,
+    // lets non-blocking waiting skip the queue and its lock if nothing is pending
+    ATOMIC_DECLARE(cmd_pending);
 };
 
 audio_event_iface_handle_t audio_event_iface_init(audio_event_iface_cfg_t *config)
@@ -234,7 +252,10 @@ esp_err_t audio_event_iface_set_cmd_waiting_timeout(audio_event_iface_handle_t e
 esp_err_t audio_event_iface_waiting_cmd_msg(audio_event_iface_handle_t evt)
 {
     audio_event_iface_msg_t msg;
+    if (evt->timeout_ms == 0 && !ATOMIC_PENDING(evt->cmd_pending))
+        return ESP_OK;
     if (evt->internal_queue && (mqueue_receive(evt->internal_queue, (char *)&msg, evt->timeout_ms) == 0)) {
+        ATOMIC_DEC(evt->cmd_pending);
         if (evt->on_cmd && evt->on_cmd((void *)&msg, evt->context) != ESP_OK) {
             return ESP_FAIL;
         }
@@ -244,13 +265,22 @@ esp_err_t audio_event_iface_waiting_cmd_msg(audio_event_iface_handle_t evt)
 
 esp_err_t audio_event_iface_cmd(audio_event_iface_handle_t evt, audio_event_iface_msg_t *msg)
 {
-    if (evt->internal_queue && (mqueue_send(evt->internal_queue, (char *)msg, 0) != 0)) {
+    if (evt->internal_queue == NULL)
+        return ESP_OK;
+    ATOMIC_INC(evt->cmd_pending);
+    if (mqueue_send(evt->internal_queue, (char *)msg, 0) != 0) {
+        ATOMIC_DEC(evt->cmd_pending);
         OS_LOGD(TAG, "There are no space to dispatch queue");
         return ESP_FAIL;
     }
     return ESP_OK;
 }
 
+bool audio_event_iface_cmd_pending(audio_event_iface_handle_t evt)
+{
+    return evt->internal_queue != NULL && ATOMIC_PENDING(evt->cmd_pending);
+}
+
 esp_err_t audio_event_iface_sendout(audio_event_iface_handle_t evt, audio_event_iface_msg_t *msg)
 {
     if (evt->external_queue) {
@@ -269,7 +299,8 @@ esp_err_t audio_event_iface_discard(audio_event_iface_handle_t evt)
         while (mqueue_receive(evt->external_queue, (char *)&msg, 0) == 0);
     }
     if (evt->internal_queue && evt->internal_queue_size) {
-        while (mqueue_receive(evt->internal_queue, (char *)&msg, 0) == 0);
+        while (mqueue_receive(evt->internal_queue, (char *)&msg, 0) == 0)
+            ATOMIC_DEC(evt->cmd_pending);
     }
     if (evt->queue_set && evt->queue_set_size) {
         while (audio_event_iface_read(evt, &msg, 0) == ESP_OK);
@@ -140,7 +140,7 @@ esp_err_t audio_event_iface_remove_listener(audio_event_iface_handle_t listener,
 esp_err_t audio_event_iface_set_cmd_waiting_timeout(audio_event_iface_handle_t evt, unsigned int timeout_ms);
 
 /**
- * @brief      Waiting internal queue message
+ * @brief      Waiting internal queue message, returns at once if the wait time is 0 and no message pending
  *
  * @param      evt        The event
  *
@@ -162,6 +162,17 @@ esp_err_t audio_event_iface_waiting_cmd_msg(audio_event_iface_handle_t evt);
  */
 esp_err_t audio_event_iface_cmd(audio_event_iface_handle_t evt, audio_event_iface_msg_t *msg);
 
+/**
+ * @brief      Check if any message is pending in internal queue, without locking the queue
+ *
+ * @param      evt   The event
+ *
+ * @return
+ *     - true, a message is pending or being sent
+ *     - false, no message
+ */
+bool audio_event_iface_cmd_pending(audio_event_iface_handle_t evt);
+
 /**
  * @brief      Trigger and event out with a message
  *
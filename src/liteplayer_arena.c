@@ -0,0 +1,213 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "osal/os_thread.h"
+#include "cutils/log_helper.h"
+#include "esp_adf/audio_common.h"
+#include "liteplayer_main.h"
+#include "liteplayer_arena.h"
+
+#define TAG "[liteplayer]arena"
+
+#define ARENA_ALIGN             ( 8 )
+#define ARENA_ALIGNED(size)     (((size) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+// Header in front of each block, blocks are chained backwards from the last one
+struct arena_block {
+    int size;       // block size, header included
+    int prev;       // offset of the previous block, -1 if none
+    int freed;
+    int reserved;
+};
+
+struct media_arena {
+    char *base;
+    int size;
+    int top;        // offset of free space
+    int last;       // offset of the last block, -1 if none
+    int watermark;  // peak of top since created
+    int fallbacks;  // allocations served by heap
+    int holders;
+    bool destroyed;
+    os_mutex lock;
+};
+
+#define ARENA_BLOCK(arena, offset) ((struct arena_block *)((arena)->base + (offset)))
+
+media_arena_handle_t media_arena_create(int size)
+{
+    if (size <= 0)
+        return NULL;
+
+    struct media_arena *arena = audio_calloc(1, sizeof(struct media_arena));
+    if (arena == NULL)
+        return NULL;
+    arena->size = ARENA_ALIGNED(size);
+    arena->base = audio_malloc(arena->size);
+    arena->lock = os_mutex_create();
+    if (arena->base == NULL || arena->lock == NULL)
+        goto create_fail;
+    arena->last = -1;
+    return arena;
+
+create_fail:
+    if (arena->base != NULL)
+        audio_free(arena->base);
+    if (arena->lock != NULL)
+        os_mutex_destroy(arena->lock);
+    audio_free(arena);
+    return NULL;
+}
+
+void *media_arena_malloc(media_arena_handle_t arena, int size)
+{
+    if (size < 0)
+        return NULL;
+    if (arena == NULL)
+        return audio_malloc(size);
+
+    int need = ARENA_ALIGNED(size) + (int)sizeof(struct arena_block);
+    os_mutex_lock(arena->lock);
+    if (need > arena->size - arena->top) {
+        arena->fallbacks++;
+        os_mutex_unlock(arena->lock);
+        OS_LOGW(TAG, "Arena exhausted, allocating %d bytes from heap", size);
+        return audio_malloc(size);
+    }
+    struct arena_block *block = ARENA_BLOCK(arena, arena->top);
+    block->size = need;
+    block->prev = arena->last;
+    block->freed = 0;
+    arena->last = arena->top;
+    arena->top += need;
+    if (arena->top > arena->watermark)
+        arena->watermark = arena->top;
+    os_mutex_unlock(arena->lock);
+    return block + 1;
+}
+
+void *media_arena_calloc(media_arena_handle_t arena, int n, int size)
+{
+    if (n < 0 || size < 0 || (size > 0 && n > 0x7FFFFFFF / size))
+        return NULL;
+    void *ptr = media_arena_malloc(arena, n * size);
+    if (ptr != NULL)
+        memset(ptr, 0x0, n * size);
+    return ptr;
+}
+
+char *media_arena_strdup(media_arena_handle_t arena, const char *str)
+{
+    if (str == NULL)
+        return NULL;
+    int len = strlen(str);
+    char *dup = media_arena_malloc(arena, len + 1);
+    if (dup != NULL)
+        memcpy(dup, str, len + 1);
+    return dup;
+}
+
+void media_arena_free(media_arena_handle_t arena, void *ptr)
+{
+    if (ptr == NULL)
+        return;
+    if (arena == NULL || (char *)ptr < arena->base || (char *)ptr >= arena->base + arena->size) {
+        audio_free(ptr);
+        return;
+    }
+
+    os_mutex_lock(arena->lock);
+    ((struct arena_block *)ptr - 1)->freed = 1;
+    // unwind freed blocks at the end, so that a reopened decoder takes the same space
+    while (arena->last >= 0 && ARENA_BLOCK(arena, arena->last)->freed) {
+        arena->top = arena->last;
+        arena->last = ARENA_BLOCK(arena, arena->last)->prev;
+    }
+    os_mutex_unlock(arena->lock);
+}
+
+void media_arena_reset(media_arena_handle_t arena)
+{
+    if (arena == NULL)
+        return;
+    os_mutex_lock(arena->lock);
+    if (arena->holders == 0) {
+        arena->top = 0;
+        arena->last = -1;
+    } else {
+        OS_LOGD(TAG, "Arena held by %d threads, reset is deferred", arena->holders);
+    }
+    os_mutex_unlock(arena->lock);
+}
+
+void media_arena_hold(media_arena_handle_t arena)
+{
+    if (arena == NULL)
+        return;
+    os_mutex_lock(arena->lock);
+    arena->holders++;
+    os_mutex_unlock(arena->lock);
+}
+
+static void media_arena_free_all(struct media_arena *arena)
+{
+    os_mutex_destroy(arena->lock);
+    audio_free(arena->base);
+    audio_free(arena);
+}
+
+void media_arena_release(media_arena_handle_t arena)
+{
+    if (arena == NULL)
+        return;
+    os_mutex_lock(arena->lock);
+    arena->holders--;
+    bool free_all = arena->destroyed && arena->holders == 0;
+    os_mutex_unlock(arena->lock);
+    if (free_all)
+        media_arena_free_all(arena);
+}
+
+void media_arena_get(media_arena_handle_t arena, struct liteplayer_stats *out)
+{
+    if (out == NULL)
+        return;
+    if (arena == NULL) {
+        out->arena_size = 0;
+        out->arena_watermark = 0;
+        out->arena_fallbacks = 0;
+        return;
+    }
+    os_mutex_lock(arena->lock);
+    out->arena_size = arena->size;
+    out->arena_watermark = arena->watermark;
+    out->arena_fallbacks = arena->fallbacks;
+    os_mutex_unlock(arena->lock);
+}
+
+void media_arena_destroy(media_arena_handle_t arena)
+{
+    if (arena == NULL)
+        return;
+    os_mutex_lock(arena->lock);
+    arena->destroyed = true;
+    bool free_all = arena->holders == 0;
+    os_mutex_unlock(arena->lock);
+    if (free_all)
+        media_arena_free_all(arena);
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _LITEPLAYER_ARENA_H_
+#define _LITEPLAYER_ARENA_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct liteplayer_stats;
+
+typedef struct media_arena *media_arena_handle_t;
+
+/*
+ * Bump allocator for track-scoped allocations of a player, e.g. source ringbuf, decoder,
+ * m4a sample tables, all of them are reclaimed at once by media_arena_reset(). A freed block
+ * is reclaimed at once only if nothing is allocated behind it, e.g. decoder reopened when
+ * seeking, others wait for the reset. Allocations that don't fit in fall back to the heap.
+ * All functions accept a NULL handle and use the heap, so the pipeline runs the same with
+ * arena disabled. Thread safe.
+ */
+media_arena_handle_t media_arena_create(int size);
+
+void *media_arena_malloc(media_arena_handle_t arena, int size);
+
+void *media_arena_calloc(media_arena_handle_t arena, int n, int size);
+
+char *media_arena_strdup(media_arena_handle_t arena, const char *str);
+
+// Free memory from media_arena_malloc/calloc/strdup, either in arena or fallen back to heap
+void media_arena_free(media_arena_handle_t arena, void *ptr);
+
+// Reclaim all blocks in O(1), deferred to the next reset if the arena is held
+void media_arena_reset(media_arena_handle_t arena);
+
+// Detached threads, e.g. async parser and source, hold the arena till they leave, as they
+// may outlive the player reset, so that their memory isn't reused by the next track
+void media_arena_hold(media_arena_handle_t arena);
+
+void media_arena_release(media_arena_handle_t arena);
+
+// Fill arena_size, arena_watermark and arena_fallbacks of @out
+void media_arena_get(media_arena_handle_t arena, struct liteplayer_stats *out);
+
+// Arena is freed after the last holder released it
+void media_arena_destroy(media_arena_handle_t arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _LITEPLAYER_ARENA_H_
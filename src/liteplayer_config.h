@@ -28,15 +28,77 @@ extern "C" {
 // media decoder definations, core feature
 #define DEFAULT_MEDIA_DECODER_TASK_PRIO          ( OS_THREAD_PRIO_REALTIME )
 #define DEFAULT_MEDIA_DECODER_TASK_STACKSIZE     ( 1024*16 )
+// frames decoded in a row by decoder task, the cmd queue is checked in between only if a cmd is pending
+#define DEFAULT_MEDIA_DECODER_TASK_FRAMES        ( 4 )
 
 // media source definations, core feature
 #define DEFAULT_MEDIA_SOURCE_TASK_PRIO           ( OS_THREAD_PRIO_HIGH )
 #define DEFAULT_MEDIA_SOURCE_TASK_STACKSIZE      ( 1024*6 )
+// contiguous view area of source ringbuf, decoders read frames in place,
+// must cover the largest frame that decoder acquires (mp3: 1940, aac: 1536)
+#define DEFAULT_MEDIA_SOURCE_SPAN_SIZE           ( 1024*4 )
+
+// hls segment prefetch definations, see liteplayer_set_hls_prefetch()
+// segments downloading at the same time, the playing one included, one thread for each
+#define DEFAULT_M3U_PREFETCH_SEGMENTS            ( 2 )
+#define DEFAULT_M3U_PREFETCH_MAX_SEGMENTS        ( 4 )
+// bytes of downloaded segments waiting to be fed to source ringbuf
+#define DEFAULT_M3U_PREFETCH_CACHE_SIZE          ( 1024*256 )
+// reconnects of a segment on failures, the download resumes from the bytes fetched
+#define DEFAULT_M3U_PREFETCH_RETRY               ( 3 )
+
+// hls variant switching definations, by the throughput measured by segment prefetch
+// variants of master playlist kept, in the order of EXT-X-STREAM-INF
+#define DEFAULT_M3U_MAX_VARIANTS                 ( 8 )
+// a variant is sustainable if its BANDWIDTH is within the percent of the throughput
+#define DEFAULT_M3U_SWITCH_UP_PERCENT            ( 70 )
+// switch down once the playing variant takes more than the percent of the throughput,
+// the gap between the two percents keeps the selection from flapping
+#define DEFAULT_M3U_SWITCH_DOWN_PERCENT          ( 85 )
+// segments queued from a variant before switching up again, so that new samples are taken
+#define DEFAULT_M3U_SWITCH_UP_SEGMENTS           ( 2 )
+// segments a variant failed to switch to is skipped for, doubled by each failure in a row
+#define DEFAULT_M3U_SWITCH_BACKOFF_SEGMENTS      ( 4 )
+#define DEFAULT_M3U_SWITCH_BACKOFF_MAX_SHIFT     ( 4 )
+
+// media sink definations, for output latency buffering, see liteplayer_set_output_latency_ms()
+#define DEFAULT_MEDIA_SINK_TASK_PRIO             ( OS_THREAD_PRIO_REALTIME )
+#define DEFAULT_MEDIA_SINK_TASK_STACKSIZE        ( 1024*4 )
+// contiguous view area of pcm ringbuf, also the max bytes written to sink each time
+#define DEFAULT_MEDIA_SINK_SPAN_SIZE             ( 1024*4 )
+
+// software volume definations, see liteplayer_set_volume()
+// ramp applied when playing pcm is cut or continued by pausing, resuming, seeking or stopping
+#define DEFAULT_MEDIA_VOLUME_FADE_MS             ( 10 )
+// max wait for the fade out to be written, pcm is cut anyway after it
+#define DEFAULT_MEDIA_VOLUME_FADE_TIMEOUT_MS     ( 100 )
+
+// post-processing chain definations, see liteplayer_insert_dsp()
+#define DEFAULT_MEDIA_DSP_STAGES                 ( 8 )
+
+// software mixer definations, see liteplayer_mixer.h
+#define DEFAULT_MIXER_TASK_PRIO                  ( OS_THREAD_PRIO_REALTIME )
+#define DEFAULT_MIXER_TASK_STACKSIZE             ( 1024*4 )
+
+// executor mode, frames decoded in one task run before the worker is yielded to other players
+#define DEFAULT_MEDIA_EXECUTOR_TASK_FRAMES       ( 8 )
+// executor mode, delay before a decode task that timed out on io runs again
+#define DEFAULT_MEDIA_EXECUTOR_RETRY_MS          ( 10 )
+// executor mode, decoder waits for source ringbuf no longer than this, workers never block on io
+#define DEFAULT_MEDIA_EXECUTOR_INPUT_TIMEOUT_MS  ( 1 )
+// executor mode, output latency if not set, pcm is always buffered for the sink thread
+#define DEFAULT_MEDIA_EXECUTOR_SINK_LATENCY_MS   ( 100 )
 
 // playlist player definations, for playlist support
 #define DEFAULT_LISTPLAYER_TASK_PRIO             ( OS_THREAD_PRIO_HIGH )
 #define DEFAULT_LISTPLAYER_TASK_STACKSIZE        ( 1024*4 )
 
+// pipeline trace definations, only with LITEPLAYER_CONFIG_TRACE, see liteplayer_trace.h
+// threads recording at the same time, events of more threads are dropped
+#define DEFAULT_TRACE_THREADS                    ( 32 )
+// latest events kept per thread, must be power of 2
+#define DEFAULT_TRACE_EVENTS_PER_THREAD          ( 1024 )
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,274 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "osal/os_thread.h"
+#include "cutils/log_helper.h"
+#include "esp_adf/audio_common.h"
+#include "liteplayer_config.h"
+#include "liteplayer_dsp.h"
+
+#define TAG "[liteplayer]dsp"
+
+struct dsp_stage {
+    struct dsp_wrapper *dsp;
+    dsp_handle_t handle; // NULL if not opened or the format isn't supported
+    bool bypass;
+};
+
+struct dsp_stages {
+    struct dsp_stage stages[DEFAULT_MEDIA_DSP_STAGES];
+    int count;
+};
+
+/*
+ * Stages are double buffered so that processing never takes a lock: edits copy the
+ * current set into the other one, change it, swap it in, then wait for buffers still
+ * processed with the old set before closing the handles replaced.
+ */
+struct dsp_chain {
+    os_mutex lock; // serializes edits, never taken while processing
+    struct dsp_stages sets[2];
+    _Atomic(struct dsp_stages *) current;
+    atomic_int busy[2]; // buffers being processed with each set
+    bool opened;
+    int samplerate;
+    int channels;
+    int bits;
+};
+
+dsp_chain_handle_t dsp_chain_create()
+{
+    struct dsp_chain *chain = audio_calloc(1, sizeof(struct dsp_chain));
+    if (chain == NULL)
+        return NULL;
+    chain->lock = os_mutex_create();
+    if (chain->lock == NULL) {
+        audio_free(chain);
+        return NULL;
+    }
+    atomic_init(&chain->current, &chain->sets[0]);
+    atomic_init(&chain->busy[0], 0);
+    atomic_init(&chain->busy[1], 0);
+    return chain;
+}
+
+static int dsp_chain_find(struct dsp_stages *set, struct dsp_wrapper *dsp)
+{
+    for (int i = 0; i < set->count; i++) {
+        if (set->stages[i].dsp == dsp)
+            return i;
+    }
+    return -1;
+}
+
+static void dsp_stage_open(struct dsp_chain *chain, struct dsp_stage *stage)
+{
+    stage->handle = stage->dsp->open(chain->samplerate, chain->channels, chain->bits, stage->dsp->priv_data);
+    if (stage->handle == NULL)
+        OS_LOGW(TAG, "Stage[%s] skipped, unsupported format: rate:%d, channels:%d, bits:%d",
+                stage->dsp->name(), chain->samplerate, chain->channels, chain->bits);
+}
+
+// Copy of the current stages to edit, called with lock held
+static struct dsp_stages *dsp_chain_edit(struct dsp_chain *chain)
+{
+    struct dsp_stages *current = atomic_load(&chain->current);
+    struct dsp_stages *next = current == &chain->sets[0] ? &chain->sets[1] : &chain->sets[0];
+    *next = *current;
+    return next;
+}
+
+static void dsp_stage_close(struct dsp_stage *stage)
+{
+    if (stage->handle != NULL) {
+        stage->dsp->close(stage->handle);
+        stage->handle = NULL;
+    }
+}
+
+// Swap in the edited stages, returns the old set once no buffer is processed with it
+static struct dsp_stages *dsp_chain_commit(struct dsp_chain *chain, struct dsp_stages *next)
+{
+    struct dsp_stages *old = atomic_exchange(&chain->current, next);
+    while (atomic_load(&chain->busy[old - chain->sets]) > 0)
+        os_thread_sleep_msec(1);
+    return old;
+}
+
+int dsp_chain_insert(dsp_chain_handle_t chain, int index, struct dsp_wrapper *dsp)
+{
+    int ret = -1;
+    os_mutex_lock(chain->lock);
+    struct dsp_stages *next = dsp_chain_edit(chain);
+    if (next->count >= DEFAULT_MEDIA_DSP_STAGES || dsp_chain_find(next, dsp) >= 0) {
+        OS_LOGE(TAG, "Can't insert stage[%s], full or inserted already", dsp->name());
+        goto insert_out;
+    }
+    if (index < 0 || index > next->count)
+        index = next->count;
+    memmove(&next->stages[index + 1], &next->stages[index],
+            (next->count - index) * sizeof(struct dsp_stage));
+    struct dsp_stage *stage = &next->stages[index];
+    stage->dsp = dsp;
+    stage->handle = NULL;
+    stage->bypass = false;
+    next->count++;
+    if (chain->opened)
+        dsp_stage_open(chain, stage);
+    dsp_chain_commit(chain, next);
+    ret = 0;
+insert_out:
+    os_mutex_unlock(chain->lock);
+    return ret;
+}
+
+int dsp_chain_remove(dsp_chain_handle_t chain, struct dsp_wrapper *dsp)
+{
+    os_mutex_lock(chain->lock);
+    struct dsp_stages *next = dsp_chain_edit(chain);
+    int index = dsp_chain_find(next, dsp);
+    if (index >= 0) {
+        struct dsp_stage stage = next->stages[index];
+        next->count--;
+        memmove(&next->stages[index], &next->stages[index + 1],
+                (next->count - index) * sizeof(struct dsp_stage));
+        dsp_chain_commit(chain, next);
+        dsp_stage_close(&stage);
+    }
+    os_mutex_unlock(chain->lock);
+    return index >= 0 ? 0 : -1;
+}
+
+int dsp_chain_move(dsp_chain_handle_t chain, struct dsp_wrapper *dsp, int index)
+{
+    os_mutex_lock(chain->lock);
+    struct dsp_stages *next = dsp_chain_edit(chain);
+    int from = dsp_chain_find(next, dsp);
+    if (from >= 0) {
+        if (index < 0 || index >= next->count)
+            index = next->count - 1;
+        struct dsp_stage stage = next->stages[from];
+        if (index > from)
+            memmove(&next->stages[from], &next->stages[from + 1], (index - from) * sizeof(struct dsp_stage));
+        else
+            memmove(&next->stages[index + 1], &next->stages[index], (from - index) * sizeof(struct dsp_stage));
+        next->stages[index] = stage;
+        dsp_chain_commit(chain, next);
+    }
+    os_mutex_unlock(chain->lock);
+    return from >= 0 ? 0 : -1;
+}
+
+int dsp_chain_bypass(dsp_chain_handle_t chain, struct dsp_wrapper *dsp, bool bypass)
+{
+    os_mutex_lock(chain->lock);
+    struct dsp_stages *next = dsp_chain_edit(chain);
+    int index = dsp_chain_find(next, dsp);
+    if (index >= 0) {
+        next->stages[index].bypass = bypass;
+        dsp_chain_commit(chain, next);
+    }
+    os_mutex_unlock(chain->lock);
+    return index >= 0 ? 0 : -1;
+}
+
+// Reopen all stages with the current format, called with lock held
+static void dsp_chain_reopen(struct dsp_chain *chain)
+{
+    struct dsp_stages *next = dsp_chain_edit(chain);
+    for (int i = 0; i < next->count; i++)
+        dsp_stage_open(chain, &next->stages[i]);
+    struct dsp_stages *old = dsp_chain_commit(chain, next);
+    for (int i = 0; i < old->count; i++)
+        dsp_stage_close(&old->stages[i]);
+}
+
+void dsp_chain_open(dsp_chain_handle_t chain, int samplerate, int channels, int bits)
+{
+    os_mutex_lock(chain->lock);
+    if (!chain->opened || chain->samplerate != samplerate ||
+        chain->channels != channels || chain->bits != bits) {
+        chain->opened = true;
+        chain->samplerate = samplerate;
+        chain->channels = channels;
+        chain->bits = bits;
+        dsp_chain_reopen(chain);
+    }
+    os_mutex_unlock(chain->lock);
+}
+
+void dsp_chain_reset(dsp_chain_handle_t chain)
+{
+    os_mutex_lock(chain->lock);
+    if (chain->opened)
+        dsp_chain_reopen(chain);
+    os_mutex_unlock(chain->lock);
+}
+
+void dsp_chain_close(dsp_chain_handle_t chain)
+{
+    os_mutex_lock(chain->lock);
+    struct dsp_stages *next = dsp_chain_edit(chain);
+    for (int i = 0; i < next->count; i++)
+        next->stages[i].handle = NULL;
+    struct dsp_stages *old = dsp_chain_commit(chain, next);
+    for (int i = 0; i < old->count; i++)
+        dsp_stage_close(&old->stages[i]);
+    chain->opened = false;
+    os_mutex_unlock(chain->lock);
+}
+
+int dsp_chain_process(dsp_chain_handle_t chain, char *pcm, int bytes)
+{
+    // register on the set before using it, retry if it's swapped out meanwhile
+    struct dsp_stages *set;
+    atomic_int *busy;
+    for (;;) {
+        set = atomic_load(&chain->current);
+        busy = &chain->busy[set - chain->sets];
+        atomic_fetch_add(busy, 1);
+        if (atomic_load(&chain->current) == set)
+            break;
+        atomic_fetch_sub(busy, 1);
+    }
+
+    int stages = 0;
+    for (int i = 0; i < set->count; i++) {
+        struct dsp_stage *stage = &set->stages[i];
+        if (stage->bypass || stage->handle == NULL)
+            continue;
+        if (stage->dsp->process(stage->handle, pcm, bytes) != 0) {
+            OS_LOGE(TAG, "Stage[%s] failed to process pcm", stage->dsp->name());
+            stages = -1;
+            break;
+        }
+        stages++;
+    }
+    atomic_fetch_sub_explicit(busy, 1, memory_order_release);
+    return stages;
+}
+
+void dsp_chain_destroy(dsp_chain_handle_t chain)
+{
+    if (chain == NULL)
+        return;
+    dsp_chain_close(chain);
+    os_mutex_destroy(chain->lock);
+    audio_free(chain);
+}
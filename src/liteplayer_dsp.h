@@ -0,0 +1,66 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef _LITEPLAYER_DSP_H_
+#define _LITEPLAYER_DSP_H_
+
+#include <stdbool.h>
+#include "liteplayer_adapter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct dsp_chain *dsp_chain_handle_t;
+
+/*
+ * Chain of post-processing stages run in order, in place on decoded pcm.
+ * Stages sit in a fixed array of DEFAULT_MEDIA_DSP_STAGES slots, inserting, moving
+ * and bypassing only shuffle slots. A stage is opened with the current format when
+ * it's inserted, and reopened when the format changes.
+ * The chain may be edited from any thread while another one processes pcm, processing
+ * never blocks, an edit waits for the buffer being processed at most.
+ */
+dsp_chain_handle_t dsp_chain_create();
+
+// Insert @dsp before the stage at @index, appended if @index is negative or beyond the last
+int dsp_chain_insert(dsp_chain_handle_t chain, int index, struct dsp_wrapper *dsp);
+
+// @dsp is closed if it's opened
+int dsp_chain_remove(dsp_chain_handle_t chain, struct dsp_wrapper *dsp);
+
+int dsp_chain_move(dsp_chain_handle_t chain, struct dsp_wrapper *dsp, int index);
+
+int dsp_chain_bypass(dsp_chain_handle_t chain, struct dsp_wrapper *dsp, bool bypass);
+
+// Format of pcm to process, stages are only reopened if it's changed
+void dsp_chain_open(dsp_chain_handle_t chain, int samplerate, int channels, int bits);
+
+// Reopen all stages to drop their history, e.g. filter state after seeking
+void dsp_chain_reset(dsp_chain_handle_t chain);
+
+// Close all stages, e.g. at the end of stream
+void dsp_chain_close(dsp_chain_handle_t chain);
+
+// Returns stages run, 0 if pcm is left untouched, -1 if a stage failed
+int dsp_chain_process(dsp_chain_handle_t chain, char *pcm, int bytes);
+
+void dsp_chain_destroy(dsp_chain_handle_t chain);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _LITEPLAYER_DSP_H_
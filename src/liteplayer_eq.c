@@ -0,0 +1,389 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "osal/os_thread.h"
+#include "cutils/log_helper.h"
+#include "esp_adf/audio_common.h"
+#include "liteplayer_pcm.h"
+#include "liteplayer_eq.h"
+
+#define TAG "[liteplayer]eq"
+
+#define EQ_MAX_CHANNELS     ( 8 )
+// samples converted to float at a time
+#define EQ_BLOCK_SAMPLES    ( 512 )
+// filter history below it is flushed to zero, denormals are slow on most cpus
+#define EQ_DENORMAL         ( 1e-20f )
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+struct eq_params {
+    struct eq_band bands[EQ_MAX_BANDS];
+};
+
+/*
+ * Bands are double buffered so that processing never takes a lock: a setter writes the
+ * other set and swaps it in, then bumps serial. Instances copy the current set when
+ * serial changes and drop the copy if serial changed again meanwhile, as the set might
+ * have been rewritten by the next setter while copying.
+ */
+struct eq {
+    os_mutex lock; // serializes setters
+    struct eq_params params[2];
+    _Atomic(struct eq_params *) current;
+    atomic_int serial;
+    int count;
+    struct dsp_wrapper wrapper;
+};
+
+// transposed direct form II, normalized by a0
+struct eq_biquad {
+    float b0, b1, b2, a1, a2;
+};
+
+struct eq_instance {
+    struct eq *eq;
+    int samplerate;
+    int channels;
+    int bits;
+    int serial;
+    bool active[EQ_MAX_BANDS];
+    struct eq_biquad biquads[EQ_MAX_BANDS];
+    float z1[EQ_MAX_BANDS][EQ_MAX_CHANNELS];
+    float z2[EQ_MAX_BANDS][EQ_MAX_CHANNELS];
+    unsigned int dither_seed;
+    float fbuf[EQ_BLOCK_SAMPLES];
+};
+
+static bool eq_band_valid(const struct eq_band *band)
+{
+    return band->filter >= EQ_FILTER_PEAKING && band->filter <= EQ_FILTER_HIGH_PASS &&
+           band->freq > 0.0f && band->q > 0.0f;
+}
+
+// Returns false if the band is flat
+static bool eq_band_design(const struct eq_band *band, int samplerate, struct eq_biquad *bq)
+{
+    if (band->gain_db == 0.0f && band->filter != EQ_FILTER_LOW_PASS && band->filter != EQ_FILTER_HIGH_PASS)
+        return false;
+
+    double freq = band->freq < samplerate * 0.49 ? band->freq : samplerate * 0.49;
+    double w0 = 2 * M_PI * freq / samplerate;
+    double cosw = cos(w0);
+    double alpha = sin(w0) / (2 * band->q);
+    double A = pow(10.0, band->gain_db / 40.0);
+    double sqa = 2 * sqrt(A) * alpha;
+    double b0, b1, b2, a0, a1, a2;
+
+    switch (band->filter) {
+    case EQ_FILTER_LOW_SHELF:
+        b0 = A * ((A + 1) - (A - 1) * cosw + sqa);
+        b1 = 2 * A * ((A - 1) - (A + 1) * cosw);
+        b2 = A * ((A + 1) - (A - 1) * cosw - sqa);
+        a0 = (A + 1) + (A - 1) * cosw + sqa;
+        a1 = -2 * ((A - 1) + (A + 1) * cosw);
+        a2 = (A + 1) + (A - 1) * cosw - sqa;
+        break;
+    case EQ_FILTER_HIGH_SHELF:
+        b0 = A * ((A + 1) + (A - 1) * cosw + sqa);
+        b1 = -2 * A * ((A - 1) + (A + 1) * cosw);
+        b2 = A * ((A + 1) + (A - 1) * cosw - sqa);
+        a0 = (A + 1) - (A - 1) * cosw + sqa;
+        a1 = 2 * ((A - 1) - (A + 1) * cosw);
+        a2 = (A + 1) - (A - 1) * cosw - sqa;
+        break;
+    case EQ_FILTER_LOW_PASS:
+        b0 = (1 - cosw) / 2;
+        b1 = 1 - cosw;
+        b2 = (1 - cosw) / 2;
+        a0 = 1 + alpha;
+        a1 = -2 * cosw;
+        a2 = 1 - alpha;
+        break;
+    case EQ_FILTER_HIGH_PASS:
+        b0 = (1 + cosw) / 2;
+        b1 = -(1 + cosw);
+        b2 = (1 + cosw) / 2;
+        a0 = 1 + alpha;
+        a1 = -2 * cosw;
+        a2 = 1 - alpha;
+        break;
+    default:
+        b0 = 1 + alpha * A;
+        b1 = -2 * cosw;
+        b2 = 1 - alpha * A;
+        a0 = 1 + alpha / A;
+        a1 = -2 * cosw;
+        a2 = 1 - alpha / A;
+        break;
+    }
+
+    bq->b0 = (float)(b0 / a0);
+    bq->b1 = (float)(b1 / a0);
+    bq->b2 = (float)(b2 / a0);
+    bq->a1 = (float)(a1 / a0);
+    bq->a2 = (float)(a2 / a0);
+    return true;
+}
+
+// Pick up the bands changed since the last buffer, history of flat bands is dropped
+static void eq_instance_update(struct eq_instance *inst)
+{
+    struct eq *eq = inst->eq;
+    int serial = atomic_load_explicit(&eq->serial, memory_order_acquire);
+    if (inst->serial == serial)
+        return;
+
+    struct eq_params params = *atomic_load_explicit(&eq->current, memory_order_acquire);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&eq->serial, memory_order_relaxed) != serial)
+        return; // changed while copying, picked up with the next buffer
+
+    inst->serial = serial;
+    for (int b = 0; b < EQ_MAX_BANDS; b++) {
+        bool active = b < eq->count && eq_band_design(&params.bands[b], inst->samplerate, &inst->biquads[b]);
+        if (!active) {
+            memset(inst->z1[b], 0x0, sizeof(inst->z1[b]));
+            memset(inst->z2[b], 0x0, sizeof(inst->z2[b]));
+        }
+        inst->active[b] = active;
+    }
+}
+
+/*
+ * Filter @frames of interleaved float pcm with one biquad. The recursion runs along the
+ * frames, so the simd lanes hold the channels of a frame, groups of 4 or 2 channels.
+ */
+static void eq_biquad_process(const struct eq_biquad *bq, float *z1, float *z2,
+                              float *buf, int frames, int channels)
+{
+    int ch = 0;
+#if defined(__SSE2__)
+    const __m128 b0 = _mm_set1_ps(bq->b0);
+    const __m128 b1 = _mm_set1_ps(bq->b1);
+    const __m128 b2 = _mm_set1_ps(bq->b2);
+    const __m128 a1 = _mm_set1_ps(bq->a1);
+    const __m128 a2 = _mm_set1_ps(bq->a2);
+    for (; ch + 4 <= channels; ch += 4) {
+        __m128 s1 = _mm_loadu_ps(z1 + ch);
+        __m128 s2 = _mm_loadu_ps(z2 + ch);
+        for (int i = 0; i < frames; i++) {
+            float *p = buf + i * channels + ch;
+            __m128 x = _mm_loadu_ps(p);
+            __m128 y = _mm_add_ps(_mm_mul_ps(b0, x), s1);
+            s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), s2);
+            s2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+            _mm_storeu_ps(p, y);
+        }
+        _mm_storeu_ps(z1 + ch, s1);
+        _mm_storeu_ps(z2 + ch, s2);
+    }
+    for (; ch + 2 <= channels; ch += 2) {
+        __m128 s1 = _mm_castpd_ps(_mm_load_sd((const double *)(z1 + ch)));
+        __m128 s2 = _mm_castpd_ps(_mm_load_sd((const double *)(z2 + ch)));
+        for (int i = 0; i < frames; i++) {
+            float *p = buf + i * channels + ch;
+            __m128 x = _mm_castpd_ps(_mm_load_sd((const double *)p));
+            __m128 y = _mm_add_ps(_mm_mul_ps(b0, x), s1);
+            s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), s2);
+            s2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+            _mm_store_sd((double *)p, _mm_castps_pd(y));
+        }
+        _mm_store_sd((double *)(z1 + ch), _mm_castps_pd(s1));
+        _mm_store_sd((double *)(z2 + ch), _mm_castps_pd(s2));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; ch + 4 <= channels; ch += 4) {
+        float32x4_t s1 = vld1q_f32(z1 + ch);
+        float32x4_t s2 = vld1q_f32(z2 + ch);
+        for (int i = 0; i < frames; i++) {
+            float *p = buf + i * channels + ch;
+            float32x4_t x = vld1q_f32(p);
+            float32x4_t y = vmlaq_n_f32(s1, x, bq->b0);
+            s1 = vmlsq_n_f32(vmlaq_n_f32(s2, x, bq->b1), y, bq->a1);
+            s2 = vmlsq_n_f32(vmulq_n_f32(x, bq->b2), y, bq->a2);
+            vst1q_f32(p, y);
+        }
+        vst1q_f32(z1 + ch, s1);
+        vst1q_f32(z2 + ch, s2);
+    }
+    for (; ch + 2 <= channels; ch += 2) {
+        float32x2_t s1 = vld1_f32(z1 + ch);
+        float32x2_t s2 = vld1_f32(z2 + ch);
+        for (int i = 0; i < frames; i++) {
+            float *p = buf + i * channels + ch;
+            float32x2_t x = vld1_f32(p);
+            float32x2_t y = vmla_n_f32(s1, x, bq->b0);
+            s1 = vmls_n_f32(vmla_n_f32(s2, x, bq->b1), y, bq->a1);
+            s2 = vmls_n_f32(vmul_n_f32(x, bq->b2), y, bq->a2);
+            vst1_f32(p, y);
+        }
+        vst1_f32(z1 + ch, s1);
+        vst1_f32(z2 + ch, s2);
+    }
+#endif
+    for (; ch < channels; ch++) {
+        float s1 = z1[ch], s2 = z2[ch];
+        for (int i = 0; i < frames; i++) {
+            float *p = buf + i * channels + ch;
+            float x = *p;
+            float y = bq->b0 * x + s1;
+            s1 = bq->b1 * x - bq->a1 * y + s2;
+            s2 = bq->b2 * x - bq->a2 * y;
+            *p = y;
+        }
+        z1[ch] = s1;
+        z2[ch] = s2;
+    }
+}
+
+static const char *eq_wrapper_name()
+{
+    return "eq";
+}
+
+static dsp_handle_t eq_wrapper_open(int samplerate, int channels, int bits, void *priv_data)
+{
+    if (samplerate <= 0 || channels <= 0 || channels > EQ_MAX_CHANNELS || pcm_sample_bytes(bits) == 0)
+        return NULL;
+    struct eq_instance *inst = audio_calloc(1, sizeof(struct eq_instance));
+    if (inst == NULL)
+        return NULL;
+    inst->eq = (struct eq *)priv_data;
+    inst->samplerate = samplerate;
+    inst->channels = channels;
+    inst->bits = bits;
+    inst->serial = -1;
+    inst->dither_seed = 1;
+    return inst;
+}
+
+static int eq_wrapper_process(dsp_handle_t handle, char *buffer, int size)
+{
+    struct eq_instance *inst = (struct eq_instance *)handle;
+    eq_instance_update(inst);
+
+    int bands = 0;
+    for (int b = 0; b < EQ_MAX_BANDS; b++)
+        bands += inst->active[b] ? 1 : 0;
+    if (bands == 0)
+        return 0;
+
+    int channels = inst->channels;
+    int sample_size = pcm_sample_bytes(inst->bits);
+    int samples = size / sample_size;
+    samples -= samples % channels;
+    int block = EQ_BLOCK_SAMPLES - EQ_BLOCK_SAMPLES % channels;
+    for (int i = 0; i < samples; i += block) {
+        int n = samples - i < block ? samples - i : block;
+        char *pcm = buffer + i * sample_size;
+        pcm_to_f32(pcm, inst->bits, inst->fbuf, n);
+        for (int b = 0; b < EQ_MAX_BANDS; b++) {
+            if (inst->active[b])
+                eq_biquad_process(&inst->biquads[b], inst->z1[b], inst->z2[b], inst->fbuf, n / channels, channels);
+        }
+        pcm_from_f32(inst->fbuf, pcm, inst->bits, n, inst->bits == 16 ? &inst->dither_seed : NULL);
+    }
+
+    for (int b = 0; b < EQ_MAX_BANDS; b++) {
+        for (int ch = 0; ch < channels; ch++) {
+            if (fabsf(inst->z1[b][ch]) < EQ_DENORMAL)
+                inst->z1[b][ch] = 0.0f;
+            if (fabsf(inst->z2[b][ch]) < EQ_DENORMAL)
+                inst->z2[b][ch] = 0.0f;
+        }
+    }
+    return 0;
+}
+
+static void eq_wrapper_close(dsp_handle_t handle)
+{
+    audio_free(handle);
+}
+
+eq_handle_t eq_create(const struct eq_band *bands, int count)
+{
+    if (count < 0 || count > EQ_MAX_BANDS || (count > 0 && bands == NULL))
+        return NULL;
+    for (int i = 0; i < count; i++) {
+        if (!eq_band_valid(&bands[i])) {
+            OS_LOGE(TAG, "Invalid band[%d]: filter:%d, freq:%f, q:%f", i, bands[i].filter, bands[i].freq, bands[i].q);
+            return NULL;
+        }
+    }
+
+    struct eq *eq = audio_calloc(1, sizeof(struct eq));
+    if (eq == NULL)
+        return NULL;
+    eq->lock = os_mutex_create();
+    if (eq->lock == NULL) {
+        audio_free(eq);
+        return NULL;
+    }
+    if (count > 0)
+        memcpy(eq->params[0].bands, bands, count * sizeof(struct eq_band));
+    atomic_init(&eq->current, &eq->params[0]);
+    atomic_init(&eq->serial, 0);
+    eq->count = count;
+    eq->wrapper.priv_data = eq;
+    eq->wrapper.name = eq_wrapper_name;
+    eq->wrapper.open = eq_wrapper_open;
+    eq->wrapper.process = eq_wrapper_process;
+    eq->wrapper.close = eq_wrapper_close;
+    return eq;
+}
+
+int eq_set_band(eq_handle_t handle, int index, const struct eq_band *band)
+{
+    if (handle == NULL || band == NULL || index < 0 || index >= handle->count || !eq_band_valid(band))
+        return -1;
+    os_mutex_lock(handle->lock);
+    struct eq_params *current = atomic_load_explicit(&handle->current, memory_order_relaxed);
+    struct eq_params *next = current == &handle->params[0] ? &handle->params[1] : &handle->params[0];
+    // an instance still copying next sees serial bumped since, before these writes
+    atomic_thread_fence(memory_order_release);
+    *next = *current;
+    next->bands[index] = *band;
+    atomic_store_explicit(&handle->current, next, memory_order_release);
+    atomic_fetch_add_explicit(&handle->serial, 1, memory_order_release);
+    os_mutex_unlock(handle->lock);
+    return 0;
+}
+
+struct dsp_wrapper *eq_get_dsp_wrapper(eq_handle_t handle)
+{
+    return handle != NULL ? &handle->wrapper : NULL;
+}
+
+void eq_destroy(eq_handle_t handle)
+{
+    if (handle == NULL)
+        return;
+    os_mutex_destroy(handle->lock);
+    audio_free(handle);
+}
@@ -31,9 +31,25 @@
 
 #define DEFAULT_PLAYLIST_URL_LEN  128
 
+struct listplayer_slot {
+    struct listplayer          *list;
+    liteplayer_handle_t         player;
+};
+
+/*
+ * Gapless: while the current player is playing the tail of a track, the next track is
+ * prepared and started on a second player, which takes over the sink once the current
+ * one finishes, see liteplayer_set_next_player(). The two players swap roles at the end
+ * of each track. It works with async source only, which reports NEARLYCOMPLETED.
+ */
 struct listplayer {
     struct listplayer_cfg       cfg;
     liteplayer_handle_t         player;
+    liteplayer_handle_t         next_player;
+    enum liteplayer_state       next_state;
+    bool                        next_nearly_completed;
+    bool                        next_wanted; // prepare next player once it's idle
+    struct listplayer_slot      slots[2];
     liteplayer_adapter_handle_t adapter;
     mlooper_handle              looper;
     os_mutex                    lock;
@@ -70,6 +86,9 @@ enum {
     PLAYER_DO_PREV,
     PLAYER_DO_STOP,
     PLAYER_DO_RESET,
+    PLAYER_DO_PREPARE_NEXT, // msg->data is listplayer_slot
+    PLAYER_DO_START_NEXT,
+    PLAYER_DO_RESET_NEXT,
 };
 
 static void playlist_clear(listplayer_handle_t handle)
@@ -195,13 +214,102 @@ resolve_done:
     return ret;
 }
 
+static struct listplayer_slot *listplayer_slot_of(listplayer_handle_t handle, liteplayer_handle_t player)
+{
+    return handle->slots[0].player == player ? &handle->slots[0] : &handle->slots[1];
+}
+
+static void listplayer_post_slot_message(listplayer_handle_t handle, int what, liteplayer_handle_t player)
+{
+    struct message *msg = message_obtain(what, 0, 0, listplayer_slot_of(handle, player));
+    if (msg != NULL)
+        mlooper_post_message(handle->looper, msg);
+}
+
+// Called with lock held, states of next player are never reported to user
+static void listplayer_next_state_callback(listplayer_handle_t handle, enum liteplayer_state state)
+{
+    switch (state) {
+    case LITEPLAYER_PREPARED:
+        listplayer_post_slot_message(handle, PLAYER_DO_START_NEXT, handle->next_player);
+        break;
+    case LITEPLAYER_NEARLYCOMPLETED:
+        handle->next_nearly_completed = true;
+        break;
+    case LITEPLAYER_IDLE:
+        handle->next_nearly_completed = false;
+        if (handle->next_wanted) {
+            handle->next_wanted = false;
+            listplayer_post_slot_message(handle, PLAYER_DO_PREPARE_NEXT, handle->next_player);
+        }
+        break;
+    default:
+        break;
+    }
+    handle->next_state = state;
+}
+
+// Called with lock held, swap players if next one is ready to take over
+static bool listplayer_switch_to_next(listplayer_handle_t handle)
+{
+    if (handle->next_state == LITEPLAYER_IDLE || handle->next_state >= LITEPLAYER_STOPPED)
+        return false;
+
+    if (!handle->is_looping) {
+        if (handle->url_curr == list_tail(&handle->url_list)) {
+            handle->url_curr = list_head(&handle->url_list);
+        } else {
+            handle->url_curr = handle->url_curr->next;
+        }
+    }
+
+    liteplayer_handle_t prev = handle->player;
+    enum liteplayer_state state = handle->next_state;
+    bool nearly_completed = handle->next_nearly_completed;
+    handle->player = handle->next_player;
+    handle->next_player = prev;
+    handle->next_state = LITEPLAYER_COMPLETED;
+    handle->next_nearly_completed = false;
+    OS_LOGD(TAG, "Switched to next player in state=[%d]", state);
+
+    listplayer_post_slot_message(handle, PLAYER_DO_RESET_NEXT, prev);
+    if (state == LITEPLAYER_COMPLETED) {
+        struct message *msg = message_obtain(PLAYER_DO_STOP, 0, 0, handle);
+        if (msg != NULL)
+            mlooper_post_message(handle->looper, msg);
+    } else {
+        handle->next_wanted = nearly_completed;
+    }
+    return true;
+}
+
+// Called on looper thread, unlink and reset next player
+static void listplayer_cancel_next(listplayer_handle_t handle)
+{
+    os_mutex_lock(handle->lock);
+    liteplayer_handle_t player = handle->player;
+    liteplayer_handle_t next = handle->next_player;
+    handle->next_wanted = false;
+    os_mutex_unlock(handle->lock);
+
+    liteplayer_set_next_player(player, NULL);
+    liteplayer_reset(next);
+}
+
 static int listplayer_state_callback(enum liteplayer_state state, int errcode, void *priv)
 {
-    listplayer_handle_t handle = (listplayer_handle_t)priv;
+    struct listplayer_slot *slot = (struct listplayer_slot *)priv;
+    listplayer_handle_t handle = slot->list;
     bool state_sync = true;
 
     os_mutex_lock(handle->lock);
 
+    if (slot->player != handle->player) {
+        listplayer_next_state_callback(handle, state);
+        os_mutex_unlock(handle->lock);
+        return 0;
+    }
+
     switch (state) {
     case LITEPLAYER_INITED:
         if (handle->has_inited) {
@@ -249,11 +357,21 @@ static int listplayer_state_callback(enum liteplayer_state state, int errcode, v
     case LITEPLAYER_NEARLYCOMPLETED:
         if (handle->is_list || handle->is_looping) {
             state_sync = false;
+            if (handle->url_count > 0) {
+                if (handle->next_state == LITEPLAYER_IDLE)
+                    listplayer_post_slot_message(handle, PLAYER_DO_PREPARE_NEXT, handle->next_player);
+                else
+                    handle->next_wanted = true;
+            }
         }
         break;
 
     case LITEPLAYER_COMPLETED:
-        if (handle->is_list || handle->is_looping) {
+        if ((handle->is_list || handle->is_looping) && handle->url_count > 0 &&
+            listplayer_switch_to_next(handle)) {
+            state_sync = false;
+            state = LITEPLAYER_STARTED;
+        } else if (handle->is_list || handle->is_looping) {
             struct message *msg = message_obtain(PLAYER_DO_STOP, 0, 0, handle);
             if (msg != NULL) {
                 state_sync = false;
@@ -327,8 +445,66 @@ static int listplayer_state_callback(enum liteplayer_state state, int errcode, v
     return 0;
 }
 
+static void listplayer_looper_handle_next(struct message *msg)
+{
+    struct listplayer_slot *slot = (struct listplayer_slot *)msg->data;
+    listplayer_handle_t handle = slot->list;
+
+    switch (msg->what) {
+    case PLAYER_DO_PREPARE_NEXT: {
+        const char *url = NULL;
+        liteplayer_handle_t player = NULL;
+        os_mutex_lock(handle->lock);
+        if (slot->player == handle->next_player && handle->next_state == LITEPLAYER_IDLE &&
+            handle->state >= LITEPLAYER_STARTED && handle->state <= LITEPLAYER_NEARLYCOMPLETED &&
+            (handle->is_list || handle->is_looping) && handle->url_count > 0) {
+            struct listnode *item = handle->url_curr;
+            if (!handle->is_looping)
+                item = (item == list_tail(&handle->url_list)) ? list_head(&handle->url_list) : item->next;
+            struct url_node *node = listnode_to_item(item, struct url_node, listnode);
+            url = audio_strdup(node->url);
+            player = handle->player;
+        }
+        os_mutex_unlock(handle->lock);
+        if (url != NULL) {
+            OS_LOGD(TAG, "Preparing next player: %s", url);
+            if (liteplayer_set_data_source(slot->player, url) == 0) {
+                liteplayer_set_next_player(player, slot->player);
+                liteplayer_prepare_async(slot->player);
+            }
+            audio_free(url);
+        }
+        break;
+    }
+
+    case PLAYER_DO_START_NEXT:
+        liteplayer_start(slot->player);
+        break;
+
+    case PLAYER_DO_RESET_NEXT: {
+        os_mutex_lock(handle->lock);
+        bool is_next = slot->player == handle->next_player;
+        liteplayer_handle_t player = handle->player;
+        os_mutex_unlock(handle->lock);
+        if (is_next) {
+            liteplayer_set_next_player(player, NULL);
+            liteplayer_reset(slot->player);
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
 static void listplayer_looper_handle(struct message *msg)
 {
+    if (msg->what >= PLAYER_DO_PREPARE_NEXT) {
+        listplayer_looper_handle_next(msg);
+        return;
+    }
+
     listplayer_handle_t handle = (listplayer_handle_t)msg->data;
 
     switch (msg->what) {
@@ -377,8 +553,10 @@ static void listplayer_looper_handle(struct message *msg)
             }
         }
         os_mutex_unlock(handle->lock);
-        if (handle->is_list)
+        if (handle->is_list) {
+            listplayer_cancel_next(handle);
             liteplayer_stop(handle->player);
+        }
         break;
     }
 
@@ -399,16 +577,20 @@ static void listplayer_looper_handle(struct message *msg)
             }
         }
         os_mutex_unlock(handle->lock);
-        if (handle->is_list)
+        if (handle->is_list) {
+            listplayer_cancel_next(handle);
             liteplayer_stop(handle->player);
+        }
         break;
     }
 
     case PLAYER_DO_STOP:
+        listplayer_cancel_next(handle);
         liteplayer_stop(handle->player);
         break;
 
     case PLAYER_DO_RESET:
+        listplayer_cancel_next(handle);
         liteplayer_reset(handle->player);
         break;
 
@@ -447,6 +629,16 @@ listplayer_handle_t listplayer_create(struct listplayer_cfg *cfg)
         handle->player = liteplayer_create();
         if (handle->player == NULL)
             goto failed;
+        handle->next_player = liteplayer_create();
+        if (handle->next_player == NULL)
+            goto failed;
+
+        for (int i = 0; i < 2; i++) {
+            handle->slots[i].list = handle;
+            handle->slots[i].player = (i == 0) ? handle->player : handle->next_player;
+            liteplayer_register_state_listener(handle->slots[i].player,
+                                               listplayer_state_callback, &handle->slots[i]);
+        }
 
         struct os_thread_attr attr = {
             .name = "ael-listplayer",
@@ -482,6 +674,7 @@ int listplayer_register_source_wrapper(listplayer_handle_t handle, struct source
     os_mutex_unlock(handle->lock);
 
     handle->adapter->add_source_wrapper(handle->adapter, wrapper);
+    liteplayer_register_source_wrapper(handle->next_player, wrapper);
     return liteplayer_register_source_wrapper(handle->player, wrapper);
 }
 
@@ -499,9 +692,177 @@ int listplayer_register_sink_wrapper(listplayer_handle_t handle, struct sink_wra
     os_mutex_unlock(handle->lock);
 
     handle->adapter->add_sink_wrapper(handle->adapter, wrapper);
+    liteplayer_register_sink_wrapper(handle->next_player, wrapper);
     return liteplayer_register_sink_wrapper(handle->player, wrapper);
 }
 
+int listplayer_set_output_latency_ms(listplayer_handle_t handle, int latency_ms)
+{
+    if (handle == NULL)
+        return -1;
+
+    os_mutex_lock(handle->lock);
+    if (handle->state != LITEPLAYER_IDLE) {
+        OS_LOGE(TAG, "Can't set output latency in state=[%d]", handle->state);
+        os_mutex_unlock(handle->lock);
+        return -1;
+    }
+    os_mutex_unlock(handle->lock);
+
+    liteplayer_set_output_latency_ms(handle->next_player, latency_ms);
+    return liteplayer_set_output_latency_ms(handle->player, latency_ms);
+}
+
+int listplayer_set_output_samplerate(listplayer_handle_t handle, int samplerate)
+{
+    if (handle == NULL)
+        return -1;
+
+    os_mutex_lock(handle->lock);
+    if (handle->state != LITEPLAYER_IDLE) {
+        OS_LOGE(TAG, "Can't set output samplerate in state=[%d]", handle->state);
+        os_mutex_unlock(handle->lock);
+        return -1;
+    }
+    os_mutex_unlock(handle->lock);
+
+    liteplayer_set_output_samplerate(handle->next_player, samplerate);
+    return liteplayer_set_output_samplerate(handle->player, samplerate);
+}
+
+int listplayer_set_output_channels(listplayer_handle_t handle, int channels)
+{
+    if (handle == NULL)
+        return -1;
+
+    os_mutex_lock(handle->lock);
+    if (handle->state != LITEPLAYER_IDLE) {
+        OS_LOGE(TAG, "Can't set output channels in state=[%d]", handle->state);
+        os_mutex_unlock(handle->lock);
+        return -1;
+    }
+    os_mutex_unlock(handle->lock);
+
+    liteplayer_set_output_channels(handle->next_player, channels);
+    return liteplayer_set_output_channels(handle->player, channels);
+}
+
+int listplayer_set_aac_plus(listplayer_handle_t handle, bool enabled)
+{
+    if (handle == NULL)
+        return -1;
+
+    os_mutex_lock(handle->lock);
+    if (handle->state != LITEPLAYER_IDLE) {
+        OS_LOGE(TAG, "Can't set aac plus in state=[%d]", handle->state);
+        os_mutex_unlock(handle->lock);
+        return -1;
+    }
+    os_mutex_unlock(handle->lock);
+
+    liteplayer_set_aac_plus(handle->next_player, enabled);
+    return liteplayer_set_aac_plus(handle->player, enabled);
+}
+
+int listplayer_set_hls_prefetch(listplayer_handle_t handle, int segments, int cache_size)
+{
+    if (handle == NULL)
+        return -1;
+
+    os_mutex_lock(handle->lock);
+    if (handle->state != LITEPLAYER_IDLE) {
+        OS_LOGE(TAG, "Can't set hls prefetch in state=[%d]", handle->state);
+        os_mutex_unlock(handle->lock);
+        return -1;
+    }
+    os_mutex_unlock(handle->lock);
+
+    liteplayer_set_hls_prefetch(handle->next_player, segments, cache_size);
+    return liteplayer_set_hls_prefetch(handle->player, segments, cache_size);
+}
+
+int listplayer_set_arena_size(listplayer_handle_t handle, int size)
+{
+    if (handle == NULL)
+        return -1;
+
+    os_mutex_lock(handle->lock);
+    if (handle->state != LITEPLAYER_IDLE) {
+        OS_LOGE(TAG, "Can't set arena size in state=[%d]", handle->state);
+        os_mutex_unlock(handle->lock);
+        return -1;
+    }
+    os_mutex_unlock(handle->lock);
+
+    if (liteplayer_set_arena_size(handle->next_player, size) != 0)
+        return -1;
+    return liteplayer_set_arena_size(handle->player, size);
+}
+
+int listplayer_set_volume(listplayer_handle_t handle, float gain, int ramp_ms)
+{
+    if (handle == NULL)
+        return -1;
+
+    os_mutex_lock(handle->lock);
+    int ret = liteplayer_set_volume(handle->next_player, gain, ramp_ms);
+    ret |= liteplayer_set_volume(handle->player, gain, ramp_ms);
+    os_mutex_unlock(handle->lock);
+    return ret;
+}
+
+int listplayer_insert_dsp(listplayer_handle_t handle, int index, struct dsp_wrapper *dsp)
+{
+    if (handle == NULL)
+        return -1;
+
+    os_mutex_lock(handle->lock);
+    int ret = liteplayer_insert_dsp(handle->next_player, index, dsp);
+    if (ret == 0) {
+        ret = liteplayer_insert_dsp(handle->player, index, dsp);
+        if (ret != 0)
+            liteplayer_remove_dsp(handle->next_player, dsp);
+    }
+    os_mutex_unlock(handle->lock);
+    return ret;
+}
+
+int listplayer_remove_dsp(listplayer_handle_t handle, struct dsp_wrapper *dsp)
+{
+    if (handle == NULL)
+        return -1;
+
+    os_mutex_lock(handle->lock);
+    int ret = liteplayer_remove_dsp(handle->next_player, dsp);
+    ret |= liteplayer_remove_dsp(handle->player, dsp);
+    os_mutex_unlock(handle->lock);
+    return ret;
+}
+
+int listplayer_move_dsp(listplayer_handle_t handle, struct dsp_wrapper *dsp, int index)
+{
+    if (handle == NULL)
+        return -1;
+
+    os_mutex_lock(handle->lock);
+    int ret = liteplayer_move_dsp(handle->next_player, dsp, index);
+    ret |= liteplayer_move_dsp(handle->player, dsp, index);
+    os_mutex_unlock(handle->lock);
+    return ret;
+}
+
+int listplayer_bypass_dsp(listplayer_handle_t handle, struct dsp_wrapper *dsp, bool bypass)
+{
+    if (handle == NULL)
+        return -1;
+
+    os_mutex_lock(handle->lock);
+    int ret = liteplayer_bypass_dsp(handle->next_player, dsp, bypass);
+    ret |= liteplayer_bypass_dsp(handle->player, dsp, bypass);
+    os_mutex_unlock(handle->lock);
+    return ret;
+}
+
 int listplayer_register_state_listener(listplayer_handle_t handle, liteplayer_state_cb listener, void *listener_priv)
 {
     if (handle == NULL)
@@ -566,7 +927,6 @@ int listplayer_set_data_source(listplayer_handle_t handle, const char *url)
     else
         return -1;
 
-    liteplayer_register_state_listener(handle->player, listplayer_state_callback, (void *)handle);
     struct message *msg = message_obtain(PLAYER_DO_SET_SOURCE, 0, 0, handle);
     if (msg != NULL) {
         mlooper_post_message(handle->looper, msg);
@@ -693,6 +1053,9 @@ int listplayer_set_single_looping(listplayer_handle_t handle, bool enable)
             return -1;
         }
         handle->is_looping = enable;
+        // next player is prepared with another url, drop it
+        if (handle->next_state != LITEPLAYER_IDLE)
+            listplayer_post_slot_message(handle, PLAYER_DO_RESET_NEXT, handle->next_player);
     }
     os_mutex_unlock(handle->lock);
     return 0;
@@ -748,6 +1111,10 @@ void listplayer_destroy(listplayer_handle_t handle)
         return;
     if (handle->looper != NULL)
         mlooper_destroy(handle->looper);
+    if (handle->player != NULL)
+        liteplayer_set_next_player(handle->player, NULL);
+    if (handle->next_player != NULL)
+        liteplayer_destroy(handle->next_player);
     if (handle->player != NULL)
         liteplayer_destroy(handle->player);
     if (handle->adapter != NULL)
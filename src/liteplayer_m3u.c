@@ -0,0 +1,518 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cutils/log_helper.h"
+#include "esp_adf/audio_common.h"
+
+#include "liteplayer_config.h"
+#include "liteplayer_m3u.h"
+
+#define TAG "[liteplayer]m3u"
+
+#define DEFAULT_M3U_CHUNK_SIZE ( 1024*2 ) // playlist read size, lines over twice of it are truncated
+
+// Playlist read by chunks, a line spanning chunks is moved to front before reading the next one
+struct m3u_reader {
+    struct source_wrapper *ops;
+    source_handle_t source;
+    int begin;   // start of the line parsing
+    int scanned; // bytes looked for the line end
+    int end;     // bytes in buffer
+    bool eof;
+    bool error;
+    bool skip;   // dropping the rest of a line longer than buffer till its end
+    bool truncated; // the line got last is the head of a longer one
+    char buffer[DEFAULT_M3U_CHUNK_SIZE*2 + 1]; // the partial line and the chunk read after it
+};
+
+void m3u_list_clear(struct m3u_list *list)
+{
+    if (list->segments != NULL)
+        audio_free(list->segments);
+    if (list->strings != NULL)
+        audio_free(list->strings);
+    memset(list, 0x0, sizeof(struct m3u_list));
+}
+
+bool m3u_list_empty(struct m3u_list *list)
+{
+    return list->head == list->count;
+}
+
+const char *m3u_list_front(struct m3u_list *list, long long *sequence)
+{
+    struct m3u_segment *segment = &list->segments[list->head];
+    *sequence = segment->sequence;
+    return list->strings + segment->url;
+}
+
+void m3u_list_pop(struct m3u_list *list)
+{
+    list->head++;
+}
+
+static void m3u_list_compact(struct m3u_list *list)
+{
+    int offset = list->head < list->count ? list->segments[list->head].url : list->strings_used;
+    memmove(list->strings, list->strings + offset, list->strings_used - offset);
+    list->strings_used -= offset;
+    memmove(list->segments, list->segments + list->head, (list->count - list->head) * sizeof(struct m3u_segment));
+    list->count -= list->head;
+    list->head = 0;
+    for (int i = 0; i < list->count; i++)
+        list->segments[i].url -= offset;
+}
+
+int m3u_list_insert(struct m3u_list *list, const char *url, long long sequence)
+{
+    int len = strlen(url) + 1;
+    if (list->head > 0 && (list->count == list->capacity || list->strings_used + len > list->strings_size))
+        m3u_list_compact(list);
+
+    if (list->count == list->capacity) {
+        int capacity = list->capacity > 0 ? list->capacity*2 : 16;
+        struct m3u_segment *segments = audio_realloc(list->segments, capacity * sizeof(struct m3u_segment));
+        if (segments == NULL)
+            return -1;
+        list->segments = segments;
+        list->capacity = capacity;
+    }
+    if (list->strings_used + len > list->strings_size) {
+        int size = list->strings_size > 0 ? list->strings_size : 1024;
+        while (size < list->strings_used + len)
+            size *= 2;
+        char *strings = audio_realloc(list->strings, size);
+        if (strings == NULL)
+            return -1;
+        list->strings = strings;
+        list->strings_size = size;
+    }
+
+    memcpy(list->strings + list->strings_used, url, len);
+    list->segments[list->count].url = list->strings_used;
+    list->segments[list->count].sequence = sequence;
+    list->count++;
+    list->strings_used += len;
+    return 0;
+}
+
+struct m3u_reader *m3u_reader_open(struct source_wrapper *ops, const char *url)
+{
+    struct m3u_reader *reader = audio_calloc(1, sizeof(struct m3u_reader));
+    if (reader == NULL)
+        return NULL;
+    reader->ops = ops;
+    reader->source = ops->open(url, 0, ops->priv_data);
+    if (reader->source == NULL) {
+        OS_LOGE(TAG, "Failed to connect m3u url");
+        audio_free(reader);
+        return NULL;
+    }
+    return reader;
+}
+
+void m3u_reader_close(struct m3u_reader *reader)
+{
+    reader->ops->close(reader->source);
+    audio_free(reader);
+}
+
+bool m3u_reader_failed(struct m3u_reader *reader)
+{
+    return reader->error;
+}
+
+bool m3u_reader_truncated(struct m3u_reader *reader)
+{
+    return reader->truncated;
+}
+
+char *m3u_reader_get_line(struct m3u_reader *reader)
+{
+    char *line = NULL;
+    reader->truncated = false;
+    while (true) {
+        while (reader->scanned < reader->end) {
+            char c = reader->buffer[reader->scanned];
+            if (c != '\r' && c != '\n') {
+                reader->scanned++;
+                continue;
+            }
+            reader->buffer[reader->scanned++] = '\0';
+            line = reader->buffer + reader->begin;
+            reader->begin = reader->scanned;
+            if (reader->skip || line[0] == '\0') {
+                reader->skip = false;
+                continue;
+            }
+            return line;
+        }
+
+        if (reader->error)
+            return NULL;
+        if (reader->eof) {
+            // the last line without line break
+            if (reader->begin < reader->end && !reader->skip) {
+                reader->buffer[reader->end] = '\0';
+                line = reader->buffer + reader->begin;
+                reader->begin = reader->end;
+                return line;
+            }
+            return NULL;
+        }
+
+        int partial = reader->end - reader->begin;
+        if (reader->skip) {
+            partial = 0;
+        } else if (partial == (int)sizeof(reader->buffer) - 1) {
+            // the head is returned so that the line is still counted, the rest is dropped
+            OS_LOGW(TAG, "Line longer than %d bytes, truncated", partial);
+            reader->buffer[reader->end] = '\0';
+            line = reader->buffer + reader->begin;
+            reader->begin = reader->scanned = reader->end;
+            reader->skip = true;
+            reader->truncated = true;
+            return line;
+        }
+        memmove(reader->buffer, reader->buffer + reader->begin, partial);
+        reader->begin = 0;
+        reader->scanned = reader->end = partial;
+
+        int size = sizeof(reader->buffer) - 1 - partial;
+        if (size > DEFAULT_M3U_CHUNK_SIZE)
+            size = DEFAULT_M3U_CHUNK_SIZE;
+        int ret = reader->ops->read(reader->source, reader->buffer + reader->end, size);
+        if (ret < 0) {
+            OS_LOGE(TAG, "Failed to read m3u content");
+            reader->error = true;
+        } else if (ret == 0) {
+            reader->eof = true;
+        } else {
+            reader->end += ret;
+        }
+    }
+}
+
+char *m3u_parser_resolve_uri(const char *base, const char *line)
+{
+    int size = strlen(base) + strlen(line) + sizeof("https:");
+    char *uri = audio_malloc(size);
+    if (uri == NULL)
+        return NULL;
+
+    if (strstr(line, "http") == line) { // full uri
+        snprintf(uri, size, "%s", line);
+    } else if (strstr(line, "//") == line) { //schemeless uri
+        if (strstr(base, "https") == base)
+            snprintf(uri, size, "https:%s", line);
+        else
+            snprintf(uri, size, "http:%s", line);
+    } else if (strstr(line, "/") == line) { // Root uri
+        const char *host = strstr(base, "//");
+        const char *path = host != NULL ? strstr(host + 2, "/") : NULL;
+        if (path == NULL)
+            goto resolve_failed;
+        snprintf(uri, size, "%.*s%s", (int)(path - base), base, line);
+    } else { // Relative URI
+        const char *pos = strrchr(base, '/'); // Search for last "/"
+        if (pos == NULL)
+            goto resolve_failed;
+        snprintf(uri, size, "%.*s%s", (int)(pos + 1 - base), base, line);
+    }
+    return uri;
+
+resolve_failed:
+    OS_LOGE(TAG, "Failed to resolve uri:%s, base:%s", line, base);
+    audio_free(uri);
+    return NULL;
+}
+
+int m3u_parser_get_attr(const char *attrs, const char *name, char *value, int size)
+{
+    int name_len = strlen(name);
+    const char *p = attrs;
+    while (*p != '\0') {
+        const char *eq = strchr(p, '=');
+        if (eq == NULL)
+            return -1;
+        bool match = eq - p == name_len && strncmp(p, name, name_len) == 0;
+        const char *begin = eq + 1, *end = NULL;
+        if (*begin == '"') {
+            begin++;
+            end = strchr(begin, '"');
+            if (end == NULL)
+                end = begin + strlen(begin);
+            p = *end == '"' ? end + 1 : end;
+        } else {
+            end = strchr(begin, ',');
+            if (end == NULL)
+                end = begin + strlen(begin);
+            p = end;
+        }
+        if (match) {
+            snprintf(value, size, "%.*s", (int)(end - begin), begin);
+            return 0;
+        }
+        if (*p == ',')
+            p++;
+    }
+    return -1;
+}
+
+void m3u_playlist_init(struct m3u_playlist *playlist, struct source_wrapper *ops, const char *url)
+{
+    memset(playlist, 0x0, sizeof(struct m3u_playlist));
+    playlist->ops = ops;
+    playlist->url = url;
+    playlist->next_sequence = -1;
+    playlist->variant = -1;
+}
+
+void m3u_playlist_clear(struct m3u_playlist *playlist)
+{
+    m3u_list_clear(&playlist->list);
+    for (int i = 0; i < playlist->variant_count; i++)
+        audio_free(playlist->variants[i].url);
+    if (playlist->variants != NULL)
+        audio_free(playlist->variants);
+    playlist->variants = NULL;
+    playlist->variant_count = 0;
+}
+
+static const char *m3u_playlist_url(struct m3u_playlist *playlist)
+{
+    if (playlist->variant >= 0)
+        return playlist->variants[playlist->variant].url;
+    return playlist->url;
+}
+
+int m3u_playlist_resolve(struct m3u_playlist *playlist)
+{
+    int ret = -1;
+    const char *url = m3u_playlist_url(playlist);
+    struct m3u_reader *reader = m3u_reader_open(playlist->ops, url);
+    if (reader == NULL)
+        goto resolve_done;
+
+    char *line = NULL;
+    char *uri = NULL;
+    char temp[32];
+    bool is_valid_m3u = false;
+    bool is_valid_url = false;
+    bool is_variant = false;
+    bool is_master = playlist->variant < 0; // variants of a media playlist are ignored
+    struct m3u_variant variant;
+    long long sequence = 0, first_sequence = 0, first_added = -1;
+    int added = 0;
+    bool hls = false, endlist = false;
+    int target_duration = 0;
+    while ((line = m3u_reader_get_line(reader)) != NULL) {
+        if (!is_valid_m3u && strcmp(line, "#EXTM3U") == 0) {
+            is_valid_m3u = true;
+            continue;
+        }
+        if (strstr(line, "http") == line || (is_valid_url && line[0] != '#')) {
+            is_valid_m3u = true;
+            is_valid_url = false;
+            if (is_variant) {
+                is_variant = false;
+                if (playlist->variants == NULL)
+                    playlist->variants = audio_calloc(DEFAULT_M3U_MAX_VARIANTS, sizeof(struct m3u_variant));
+                if (playlist->variants == NULL || playlist->variant_count >= DEFAULT_M3U_MAX_VARIANTS ||
+                    m3u_reader_truncated(reader)) {
+                    OS_LOGW(TAG, "Variant ignored:%.64s", line);
+                } else if ((variant.url = m3u_parser_resolve_uri(url, line)) != NULL) {
+                    playlist->variants[playlist->variant_count++] = variant;
+                }
+                continue;
+            }
+            // skip the segments queued already
+            if (hls && playlist->next_sequence >= 0 && sequence < playlist->next_sequence) {
+                sequence++;
+                continue;
+            }
+            if (m3u_reader_truncated(reader)) {
+                // never queued a truncated uri, the following segments keep their sequence numbers
+                OS_LOGE(TAG, "Segment[%lld] ignored, uri is too long:%.64s", sequence, line);
+            } else if ((uri = m3u_parser_resolve_uri(url, line)) != NULL) {
+                if (m3u_list_insert(&playlist->list, uri, sequence) == 0) {
+                    if (first_added < 0)
+                        first_added = sequence;
+                    added++;
+                }
+                audio_free(uri);
+            }
+            sequence++;
+            continue;
+        }
+        if (!is_valid_m3u) {
+            break;
+        }
+        if (strstr(line, "#EXT-X-TARGETDURATION:") == line) {
+            hls = true;
+            target_duration = atoi(line + strlen("#EXT-X-TARGETDURATION:"));
+            if (target_duration <= 0)
+                target_duration = 1;
+            continue;
+        } else if (strstr(line, "#EXT-X-MEDIA-SEQUENCE:") == line) {
+            sequence = atoll(line + strlen("#EXT-X-MEDIA-SEQUENCE:"));
+            first_sequence = sequence;
+            continue;
+        } else if (strcmp(line, "#EXT-X-ENDLIST") == 0) {
+            endlist = true;
+            continue;
+        }
+        if (!is_valid_url && strstr(line, "#EXTINF") == line) {
+            is_valid_url = true;
+            continue;
+        } else if (!is_valid_url && is_master && strstr(line, "#EXT-X-STREAM-INF:") == line) {
+            const char *attrs = line + strlen("#EXT-X-STREAM-INF:");
+            memset(&variant, 0x0, sizeof(variant));
+            if (m3u_parser_get_attr(attrs, "BANDWIDTH", temp, sizeof(temp)) == 0)
+                variant.bandwidth = atoi(temp);
+            m3u_parser_get_attr(attrs, "CODECS", variant.codecs, sizeof(variant.codecs));
+            is_variant = true;
+            is_valid_url = true;
+            continue;
+        } else if (strncmp(line, "#", 1) == 0) {
+            /**
+             * Some other playlist field we don't support.
+             * Simply treat this as a comment and continue to find next line.
+             */
+            continue;
+        }
+    }
+
+    if (!is_valid_m3u)
+        goto resolve_done;
+    if (m3u_reader_failed(reader)) // keep the segments parsed, the rest are got by reloading if live
+        OS_LOGW(TAG, "Playlist is truncated by read failure, %d segments parsed", added);
+    playlist->hls = hls;
+    playlist->endlist = endlist;
+    if (hls) {
+        playlist->target_duration = target_duration;
+        if (first_added > playlist->next_sequence && playlist->next_sequence >= 0)
+            OS_LOGW(TAG, "Segments [%lld, %lld) are gone before reloading",
+                    playlist->next_sequence, first_added);
+        if (sequence >= playlist->next_sequence) {
+            playlist->next_sequence = sequence;
+        } else {
+            // restarted by server, queue the whole playlist at next reloading
+            OS_LOGW(TAG, "Media sequence goes back from %lld to %lld", playlist->next_sequence, sequence);
+            playlist->next_sequence = first_sequence;
+        }
+    }
+    ret = added;
+
+#if defined(SYSUTILS_HAVE_VERBOSE_LOG_ENABLED)
+    for (int i = playlist->list.head; i < playlist->list.count; i++)
+        OS_LOGV(TAG, "-->m3ulist: url[%lld]=[%s]", playlist->list.segments[i].sequence,
+                playlist->list.strings + playlist->list.segments[i].url);
+#endif
+
+resolve_done:
+    if (reader != NULL)
+        m3u_reader_close(reader);
+
+    if (ret >= 0 && playlist->variant < 0 && playlist->variant_count > 0) {
+        // master playlist, start with the first variant as m3u_get_first_url() does
+        for (int i = 0; i < playlist->variant_count; i++)
+            OS_LOGD(TAG, "Variant[%d]: bandwidth:%d, codecs:%s, url:%s", i,
+                    playlist->variants[i].bandwidth, playlist->variants[i].codecs, playlist->variants[i].url);
+        playlist->variant = 0;
+        ret = m3u_playlist_resolve(playlist);
+    }
+    return ret;
+}
+
+// Variants switched between must share the codecs of the first one, which the decoder is probed by
+static bool m3u_variant_compatible(struct m3u_playlist *playlist, int index)
+{
+    const char *codecs = playlist->variants[0].codecs;
+    return index == 0 || (codecs[0] != '\0' && strcmp(codecs, playlist->variants[index].codecs) == 0);
+}
+
+int m3u_variant_select(struct m3u_playlist *playlist, int bandwidth, long long sequence)
+{
+    int playing = playlist->variant;
+    if (playing < 0 || playlist->variant_count <= 1 || bandwidth <= 0)
+        return playing;
+
+    long long sustainable = (long long)bandwidth * DEFAULT_M3U_SWITCH_UP_PERCENT / 100;
+    int best = -1, lowest = -1;
+    for (int i = 0; i < playlist->variant_count; i++) {
+        struct m3u_variant *variant = &playlist->variants[i];
+        if (!m3u_variant_compatible(playlist, i))
+            continue;
+        if (i != playing && sequence < variant->retry_sequence)
+            continue;
+        if (lowest < 0 || variant->bandwidth < playlist->variants[lowest].bandwidth)
+            lowest = i;
+        if (variant->bandwidth <= sustainable &&
+            (best < 0 || variant->bandwidth > playlist->variants[best].bandwidth))
+            best = i;
+    }
+    if (best < 0)
+        best = lowest;
+
+    long long current = playlist->variants[playing].bandwidth;
+    if (playlist->variants[best].bandwidth > current) {
+        if (playlist->variant_segments >= DEFAULT_M3U_SWITCH_UP_SEGMENTS)
+            return best;
+    } else if (playlist->variants[best].bandwidth < current) {
+        if (current*100 > (long long)bandwidth*DEFAULT_M3U_SWITCH_DOWN_PERCENT)
+            return best;
+    }
+    return playing;
+}
+
+int m3u_variant_switch(struct m3u_playlist *playlist, int variant, long long sequence)
+{
+    struct m3u_list left = playlist->list;
+    int playing = playlist->variant;
+    int playing_segments = playlist->variant_segments;
+    long long next_sequence = playlist->next_sequence;
+
+    memset(&playlist->list, 0x0, sizeof(struct m3u_list));
+    playlist->variant = variant;
+    playlist->variant_segments = 0;
+    playlist->next_sequence = sequence;
+    int ret = m3u_playlist_resolve(playlist);
+    if (ret < 0 || (ret == 0 && !m3u_list_empty(&left))) {
+        struct m3u_variant *failed = &playlist->variants[variant];
+        int shift = failed->failures < DEFAULT_M3U_SWITCH_BACKOFF_MAX_SHIFT ?
+                failed->failures : DEFAULT_M3U_SWITCH_BACKOFF_MAX_SHIFT;
+        int backoff = DEFAULT_M3U_SWITCH_BACKOFF_SEGMENTS << shift;
+        failed->failures++;
+        failed->retry_sequence = sequence + backoff;
+        OS_LOGW(TAG, "Failed to switch to variant[%d], keep playing variant[%d], retry in %d segments",
+                variant, playing, backoff);
+        m3u_list_clear(&playlist->list);
+        playlist->list = left;
+        playlist->variant = playing;
+        playlist->variant_segments = playing_segments;
+        playlist->next_sequence = next_sequence;
+        return -1;
+    }
+    playlist->variants[variant].failures = 0;
+    OS_LOGI(TAG, "Switched from variant[%d] to variant[%d] at sequence:%lld, bandwidth:%d->%d",
+            playing, variant, sequence,
+            playlist->variants[playing].bandwidth, playlist->variants[variant].bandwidth);
+    m3u_list_clear(&left);
+    return ret;
+}
@@ -0,0 +1,147 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _LITEPLAYER_M3U_H_
+#define _LITEPLAYER_M3U_H_
+
+#include <stdbool.h>
+#include "liteplayer_adapter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Segments to queue in play order. Urls are packed back to back in one string arena, the
+ * segments refer to them by offset. Segments before @head are queued already, they are
+ * dropped by compacting once the arrays are full, so a live playlist doesn't grow them.
+ */
+struct m3u_segment {
+    int url;            // offset in strings
+    long long sequence; // EXT-X-MEDIA-SEQUENCE, or index for playlist other than hls
+};
+
+struct m3u_list {
+    struct m3u_segment *segments;
+    int head;           // first segment not queued yet
+    int count;
+    int capacity;
+    char *strings;
+    int strings_used;
+    int strings_size;
+};
+
+void m3u_list_clear(struct m3u_list *list);
+
+bool m3u_list_empty(struct m3u_list *list);
+
+const char *m3u_list_front(struct m3u_list *list, long long *sequence);
+
+// Url got by m3u_list_front() is valid till the next insertion
+void m3u_list_pop(struct m3u_list *list);
+
+int m3u_list_insert(struct m3u_list *list, const char *url, long long sequence);
+
+// Playlist read by chunks, see m3u_reader_get_line()
+struct m3u_reader;
+
+struct m3u_reader *m3u_reader_open(struct source_wrapper *ops, const char *url);
+
+/*
+ * Next non-empty line terminated in place, valid till the next call, NULL at the end of
+ * playlist, or if read failed. A line longer than two read chunks is truncated, the head
+ * is returned so that it's still counted, see m3u_reader_truncated().
+ */
+char *m3u_reader_get_line(struct m3u_reader *reader);
+
+// True if the line got last is truncated
+bool m3u_reader_truncated(struct m3u_reader *reader);
+
+// True if reading stopped by a read failure rather than the end of playlist
+bool m3u_reader_failed(struct m3u_reader *reader);
+
+void m3u_reader_close(struct m3u_reader *reader);
+
+// Absolute url of @line in playlist @base, freed by caller, NULL if @base has no path to resolve against
+char *m3u_parser_resolve_uri(const char *base, const char *line);
+
+// Value of attribute @name in the list of #EXT-X-STREAM-INF, quotes stripped, -1 if not found
+int m3u_parser_get_attr(const char *attrs, const char *name, char *value, int size);
+
+struct m3u_variant {
+    char *url;                // media playlist
+    int bandwidth;            // BANDWIDTH of EXT-X-STREAM-INF, peak bits per second
+    char codecs[64];          // CODECS, empty if not given
+    int failures;             // switches to it failed in a row
+    long long retry_sequence; // not switched to before this segment once a switch failed
+};
+
+/*
+ * State of a playlist resolved again and again, segments not queued yet are in @list.
+ * For hls media playlists, live if no EXT-X-ENDLIST, reloaded every EXT-X-TARGETDURATION,
+ * segments already queued are skipped by their media sequence numbers.
+ * For hls master playlists, variants are switched by the throughput at segment boundaries.
+ */
+struct m3u_playlist {
+    struct source_wrapper *ops;
+    const char *url;            // playlist given, master playlist if variants are found
+    struct m3u_list list;
+
+    bool hls;
+    bool endlist;
+    int target_duration;        // seconds
+    long long next_sequence;    // EXT-X-MEDIA-SEQUENCE of the next segment to queue, -1 if none yet
+
+    struct m3u_variant *variants;
+    int variant_count;
+    int variant;                // playing, -1 if not a master playlist
+    int variant_segments;       // segments queued since switched to the playing variant
+};
+
+// @ops and @url aren't copied, they must be kept till the playlist is cleared
+void m3u_playlist_init(struct m3u_playlist *playlist, struct source_wrapper *ops, const char *url);
+
+/*
+ * Returns segments appended to the list, -1 if the playlist can't be read.
+ * A master playlist is resolved once, its variants are kept and the first one is played.
+ */
+int m3u_playlist_resolve(struct m3u_playlist *playlist);
+
+void m3u_playlist_clear(struct m3u_playlist *playlist);
+
+/*
+ * Variant to play the next segment @sequence by @bandwidth measured. Switch up to the highest
+ * one sustainable once the playing one is measured for a few segments, switch down as soon as
+ * the playing one isn't sustainable, see DEFAULT_M3U_SWITCH_UP_PERCENT and _DOWN_PERCENT.
+ * Only variants with the same CODECS as the first one are switched to, the decoder is probed
+ * by the first one. EXT-X-STREAM-INF tells no samplerate or channels, CODECS is the only hint
+ * of them (mp4a.40.2 and mp4a.40.5 decode to different rates), so variants without CODECS are
+ * never switched to. A variant failed to switch to is skipped for a while, see
+ * DEFAULT_M3U_SWITCH_BACKOFF_SEGMENTS.
+ */
+int m3u_variant_select(struct m3u_playlist *playlist, int bandwidth, long long sequence);
+
+/*
+ * Resolve media playlist of @variant from segment @sequence on, in place of the segments left
+ * of the playing variant, sequence numbers of variants are aligned, see rfc8216 6.2.4.
+ * Returns segments appended to the list, or -1 if failed and the playing variant is kept,
+ * the failed one is skipped by m3u_variant_select() till a few segments later.
+ */
+int m3u_variant_switch(struct m3u_playlist *playlist, int variant, long long sequence);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _LITEPLAYER_M3U_H_
@@ -18,6 +18,7 @@
 
 #include "osal/os_thread.h"
 #include "cutils/ringbuf.h"
+#include "cutils/executor.h"
 #include "cutils/log_helper.h"
 #include "esp_adf/audio_element.h"
 #include "esp_adf/audio_event_iface.h"
@@ -31,11 +32,34 @@
 #include "liteplayer_adapter.h"
 #include "liteplayer_config.h"
 #include "liteplayer_source.h"
+#include "liteplayer_sink.h"
+#include "liteplayer_resampler.h"
+#include "liteplayer_pcm.h"
+#include "liteplayer_volume.h"
+#include "liteplayer_dsp.h"
+#include "liteplayer_stats.h"
+#include "liteplayer_arena.h"
+#include "liteplayer_trace_internal.h"
 #include "liteplayer_parser.h"
 #include "liteplayer_main.h"
 
 #define TAG "[liteplayer]core"
 
+#if defined(__STDC_NO_ATOMICS__)
+// IMPORTANT:
+//   IF ATOMIC NOT SUPPORTED, POSITION READ BY OTHER THREADS MAY BE TORN
+#define ATOMIC_DECLARE_LL(obj)      long long obj
+#define ATOMIC_LOAD(obj)            obj
+#define ATOMIC_STORE(obj, val)      obj = val
+#define ATOMIC_FETCH_ADD(obj, val)  (obj += val, obj - val)
+#else
+#include <stdatomic.h>
+#define ATOMIC_DECLARE_LL(obj)      atomic_llong obj
+#define ATOMIC_LOAD(obj)            atomic_load_explicit(&(obj), memory_order_relaxed)
+#define ATOMIC_STORE(obj, val)      atomic_store_explicit(&(obj), val, memory_order_relaxed)
+#define ATOMIC_FETCH_ADD(obj, val)  atomic_fetch_add_explicit(&(obj), val, memory_order_relaxed)
+#endif
+
 struct liteplayer {
     const char             *url; // TTS   : tts.mp3
                                  // HTTP  : http://..., https://...
@@ -47,6 +71,8 @@ struct liteplayer {
     liteplayer_state_cb     state_listener;
     void                   *state_userdata;
     bool                    state_error;
+    bool                    state_starting;    // start/resume in progress, decoder may finish before it returns
+    bool                    state_finished;    // finished event deferred until start/resume returns
 
     liteplayer_adapter_handle_t  adapter_handle;
     struct source_wrapper       *source_ops;
@@ -56,23 +82,84 @@ struct liteplayer {
     struct media_codec_info media_codec_info;
 
     audio_element_handle_t  ael_decoder;
+    void                   *codec_cache;       // codec instance kept from last track, reset in place by next decoder
+    audio_codec_t           codec_cache_type;
 
     struct media_source_info media_source_info;
     media_source_handle_t    media_source_handle;
+    char                    *source_ringbuf_buffer; // data of source ringbuf if it's in arena
     int                      source_buffer_size; // for source synchronous mode
     char                    *source_buffer_addr; // for source synchronous mode
+    int                      prefetch_segments; // for m3u, see liteplayer_set_hls_prefetch()
+    int                      prefetch_cache_size;
 
     sink_handle_t           sink_handle;
     int                     sink_samplerate;
     int                     sink_channels;
     int                     sink_bits;
-    long long               sink_position;
+    int                     output_bits;       // bits of pcm written to sink, negotiated when opening sink
+    ATOMIC_DECLARE_LL(sink_position);          // pcm bytes played, added by sink thread, read by get_position
     bool                    sink_inited;
+    int                     sink_open_samplerate; // format of the opened sink, it may be taken over
+    int                     sink_open_channels;
+    int                     sink_open_bits;
+    bool                    sink_pending;      // waiting for the sink handed over by previous player
+    bool                    sink_abort;
+    bool                    sink_released;     // sink is closed or handed over, can't link next player
+    os_cond                 sink_cond;
+    struct liteplayer      *next_player;       // for gapless, takes over the sink at the end of stream
+
+    int                     sink_latency_ms;   // pcm buffered between decoder and sink thread, 0 if disabled
+    ringbuf_handle          sink_ringbuf;
+    char                   *sink_tail;         // executor mode, processed pcm that didn't fit in sink ringbuf
+    int                     sink_tail_size;
+    int                     sink_tail_len;
+    int                     sink_tail_offset;
+    media_sink_handle_t     media_sink_handle;
+    bool                    sink_flush;        // drop pcm buffered before seeking at next opening
+
+    int                     output_samplerate; // sink is opened at this rate if set, pcm is resampled
+    int                     output_channels;   // 1 mixes pcm down to mono, 2 mixes mono up to stereo, 0 as decoded
+    bool                    aac_plus_disabled; // HE-AAC decoded without SBR, see liteplayer_set_aac_plus()
+    resampler_handle_t      resampler;
+    char                   *resample_buffer;
+    int                     resample_buffer_size;
+    char                   *convert_buffer;    // decoded pcm converted to output_bits
+    int                     convert_buffer_size;
+    char                   *mix_buffer;        // mono pcm mixed up to stereo
+    int                     mix_buffer_size;
+    volume_handle_t         volume;            // software gain, see liteplayer_set_volume()
+    dsp_chain_handle_t      dsp_chain;         // post-processing of decoded pcm, see liteplayer_insert_dsp()
+
+    bool                    trim_inited;       // encoder delay and padding trimming, in bytes
+    long long               trim_head;
+    long long               trim_remain;       // -1 if unlimited
 
     int                     seek_time;
     long long               seek_offset;
+
+    bool                    pcm_reader;        // for pull mode, decoder runs inline on the caller's thread
+    char                   *pcm_buffer;
+    int                     pcm_buffer_size;
+    int                     pcm_filled;
+    int                     pcm_offset;
+
+    executor_handle         executor;          // shared worker pool, decoder runs as tasks on it
+    os_mutex                exec_lock;
+    os_cond                 exec_cond;
+    bool                    exec_running;      // decode task should keep resubmitting itself
+    bool                    exec_scheduled;    // a task is queued or running on the executor
+
+    media_stats_handle_t    stats;             // runtime counters, see liteplayer_get_stats()
+    media_arena_handle_t    arena;             // track-scoped allocations, see liteplayer_set_arena_size()
 };
 
+// Decoder runs inline, either on the caller's thread or on the executor
+#define media_player_inline(handle) ((handle)->pcm_reader || (handle)->executor != NULL)
+
+// Async source is read by the source thread, except for pcm reader that reads it inline
+#define media_player_source_async(handle) ((handle)->source_ops->async_mode && !(handle)->pcm_reader)
+
 static int audio_source_open(audio_element_handle_t self, void *ctx)
 {
     liteplayer_handle_t handle = (liteplayer_handle_t)ctx;
@@ -84,6 +171,7 @@ static int audio_source_open(audio_element_handle_t self, void *ctx)
             OS_LOGE(TAG, "Failed to open source");
             return AEL_IO_FAIL;
         }
+        media_stats_source_reconnect(handle->stats);
         rb_reset(handle->media_source_info.out_ringbuf);
     }
     return AEL_IO_OK;
@@ -104,14 +192,17 @@ static int audio_source_read(audio_element_handle_t self, char *buffer, int len,
     int bytes_want = len - bytes_remain;
     int bytes_read = 0;
     if (bytes_want < handle->source_buffer_size/2) {
+        LITEPLAYER_TRACE_BEGIN(trace);
         bytes_read = handle->source_ops->read(handle->media_source_info.source_handle,
                                               handle->source_buffer_addr,
                                               handle->source_buffer_size);
+        LITEPLAYER_TRACE_END(trace, "source_read");
+        media_stats_source_read(handle->stats, bytes_read);
         if (bytes_read < 0 || bytes_read > handle->source_buffer_size) {
             OS_LOGE(TAG, "Failed to read source, ret:%d", bytes_read);
             return AEL_IO_FAIL;
         } else if (bytes_read == 0) {
-            return AEL_IO_DONE;
+            return bytes_remain > 0 ? bytes_remain : AEL_IO_DONE;
         } else if (bytes_read > bytes_want) {
             memcpy(buffer + bytes_remain, handle->source_buffer_addr, bytes_want);
             rb_write_chunk(handle->media_source_info.out_ringbuf,
@@ -124,13 +215,16 @@ static int audio_source_read(audio_element_handle_t self, char *buffer, int len,
             return bytes_read + bytes_remain;
         }
     } else {
+        LITEPLAYER_TRACE_BEGIN(trace);
         bytes_read = handle->source_ops->read(handle->media_source_info.source_handle,
                 buffer + bytes_remain, bytes_want);
+        LITEPLAYER_TRACE_END(trace, "source_read");
+        media_stats_source_read(handle->stats, bytes_read);
         if (bytes_read < 0 || bytes_read > bytes_want) {
             OS_LOGE(TAG, "Failed to read source, ret:%d", bytes_read);
             return AEL_IO_FAIL;
         } else if (bytes_read == 0) {
-            return AEL_IO_DONE;
+            return bytes_remain > 0 ? bytes_remain : AEL_IO_DONE;
         } else {
             return bytes_read + bytes_remain;
         }
@@ -148,6 +242,232 @@ static void audio_source_close(audio_element_handle_t self, void *ctx)
     }
 }
 
+/*
+ * Move the opened sync source to @pos without reopening it, bytes still buffered in ringbuf
+ * are kept if @pos falls into them, otherwise the source is seeked. Returns false if the
+ * source handle is gone or can't be moved, the caller should close and reopen it then.
+ */
+static bool media_player_reuse_source(liteplayer_handle_t handle, long long pos)
+{
+    source_handle_t source = handle->media_source_info.source_handle;
+    ringbuf_handle rb = handle->media_source_info.out_ringbuf;
+    if (source == NULL)
+        return false;
+
+    long long source_pos = handle->source_ops->content_pos(source);
+    int bytes_filled = rb_bytes_filled(rb);
+    if (pos <= source_pos && pos >= source_pos - bytes_filled) {
+        int bytes_drop = bytes_filled - (int)(source_pos - pos);
+        OS_LOGD(TAG, "Reusing source handle, drop %d/%d bytes in ringbuf", bytes_drop, bytes_filled);
+        while (bytes_drop > 0) {
+            char *span = NULL;
+            int bytes_span = rb_acquire_read(rb, &span, bytes_drop, 0);
+            if (bytes_span <= 0 || rb_commit_read(rb, bytes_span) != RB_OK)
+                return false;
+            bytes_drop -= bytes_span;
+        }
+        return true;
+    }
+
+    rb_reset(rb);
+    OS_LOGD(TAG, "Reusing source handle, seeking %lld>>%lld", source_pos, pos);
+    media_stats_source_reconnect(handle->stats);
+    return handle->source_ops->seek(source, (long)pos) == 0;
+}
+
+/*
+ * Hand the opened sink over to the next player if stream is finished, so that pcm of
+ * the next player is spliced into the same sink without closing/reopening the device.
+ * Next player always stops waiting for the sink, returns true if the sink is taken over.
+ */
+static bool media_player_handover_sink(liteplayer_handle_t handle, bool finished)
+{
+    bool handover = false;
+
+    os_mutex_lock(handle->state_lock);
+    handle->sink_released = true;
+    liteplayer_handle_t next = handle->next_player;
+    if (next != NULL) {
+        os_mutex_lock(next->state_lock);
+        if (finished && next->sink_pending && next->sink_handle == NULL && handle->sink_handle != NULL &&
+            next->sink_ops != NULL && next->sink_ops->write == handle->sink_ops->write &&
+            next->sink_ops->close == handle->sink_ops->close &&
+            next->sink_ops->priv_data == handle->sink_ops->priv_data) {
+            OS_LOGI(TAG, "Handing sink over to next player");
+            next->sink_handle = handle->sink_handle;
+            next->sink_open_samplerate = handle->sink_open_samplerate;
+            next->sink_open_channels = handle->sink_open_channels;
+            next->sink_open_bits = handle->sink_open_bits;
+            handle->sink_handle = NULL;
+            handover = true;
+        }
+        next->sink_pending = false;
+        os_cond_signal(next->sink_cond);
+        os_mutex_unlock(next->state_lock);
+        handle->next_player = NULL;
+    }
+    os_mutex_unlock(handle->state_lock);
+
+    return handover;
+}
+
+static void media_sink_state_callback(enum media_sink_state state, int bytes, void *priv);
+
+// Samplerate of pcm written to sink
+static int media_player_output_samplerate(liteplayer_handle_t handle)
+{
+    if (handle->output_samplerate > 0 && !handle->pcm_reader)
+        return handle->output_samplerate;
+    return handle->sink_samplerate;
+}
+
+// Channels of pcm written to sink, mono is mixed down from any layout, stereo only from mono
+static int media_player_output_channels(liteplayer_handle_t handle)
+{
+    if (handle->pcm_reader)
+        return handle->sink_channels;
+    if (handle->output_channels == 1 && handle->sink_channels > 1)
+        return 1;
+    if (handle->output_channels == 2 && handle->sink_channels == 1)
+        return 2;
+    return handle->sink_channels;
+}
+
+/*
+ * Bits of pcm written to sink, the decoded format if sink supports it, otherwise the
+ * nearest one without losing precision, then the nearest narrower one.
+ * Resampler works on s16 only.
+ */
+static int media_player_negotiate_bits(liteplayer_handle_t handle)
+{
+    static const int prefered_bits[][4] = {
+        { 16, 16, 32, 24 },
+        { 24, 24, 32, 16 },
+        { 32, 32, 24, 16 },
+    };
+    if (media_player_output_samplerate(handle) != handle->sink_samplerate)
+        return 16;
+
+    int formats = SINK_FORMAT_S16LE;
+    if (handle->sink_ops->formats != NULL)
+        formats = handle->sink_ops->formats(handle->sink_ops->priv_data);
+    for (int i = 0; i < sizeof(prefered_bits)/sizeof(prefered_bits[0]); i++) {
+        if (prefered_bits[i][0] != handle->sink_bits)
+            continue;
+        for (int j = 1; j < 4; j++) {
+            int bits = prefered_bits[i][j];
+            int format = bits == 16 ? SINK_FORMAT_S16LE : (bits == 24 ? SINK_FORMAT_S24LE : SINK_FORMAT_S32LE);
+            if (formats & format)
+                return bits;
+        }
+    }
+    return 16;
+}
+
+static void media_player_destroy_resampler(liteplayer_handle_t handle)
+{
+    if (handle->resampler != NULL) {
+        resampler_destroy(handle->resampler);
+        handle->resampler = NULL;
+    }
+    if (handle->resample_buffer != NULL) {
+        audio_free(handle->resample_buffer);
+        handle->resample_buffer = NULL;
+    }
+    handle->resample_buffer_size = 0;
+}
+
+static void media_player_destroy_convert_buffer(liteplayer_handle_t handle)
+{
+    if (handle->convert_buffer != NULL) {
+        audio_free(handle->convert_buffer);
+        handle->convert_buffer = NULL;
+    }
+    handle->convert_buffer_size = 0;
+    if (handle->mix_buffer != NULL) {
+        audio_free(handle->mix_buffer);
+        handle->mix_buffer = NULL;
+    }
+    handle->mix_buffer_size = 0;
+}
+
+static void media_player_destroy_sink_ringbuf(liteplayer_handle_t handle)
+{
+    os_mutex_lock(handle->state_lock);
+    ringbuf_handle rb = handle->sink_ringbuf;
+    handle->sink_ringbuf = NULL;
+    handle->sink_flush = false;
+    os_mutex_unlock(handle->state_lock);
+    if (rb != NULL)
+        rb_destroy(rb);
+    if (handle->sink_tail != NULL) {
+        audio_free(handle->sink_tail);
+        handle->sink_tail = NULL;
+    }
+    handle->sink_tail_size = 0;
+    handle->sink_tail_len = 0;
+    handle->sink_tail_offset = 0;
+}
+
+// Executor mode always buffers pcm, so that a worker never blocks on writing the sink
+static int media_player_sink_latency_ms(liteplayer_handle_t handle)
+{
+    if (handle->executor != NULL && handle->sink_latency_ms <= 0)
+        return DEFAULT_MEDIA_EXECUTOR_SINK_LATENCY_MS;
+    return handle->sink_latency_ms;
+}
+
+/*
+ * Output latency mode: decoder writes pcm into sink_ringbuf, and the sink thread moves
+ * it to the opened sink. The ringbuf is kept while paused, so that the buffered pcm is
+ * played after resuming, and it's flushed if paused for seeking.
+ */
+static int media_player_start_sink(liteplayer_handle_t handle)
+{
+    int frame_size = media_player_output_channels(handle) * handle->output_bits / 8;
+    int samplerate = media_player_output_samplerate(handle);
+    if (frame_size <= 0 || samplerate <= 0)
+        return ESP_FAIL;
+
+    if (handle->sink_ringbuf == NULL) {
+        int latency_ms = media_player_sink_latency_ms(handle);
+        long long frames = (long long)samplerate * latency_ms / 1000;
+        int size = (int)frames * frame_size;
+        if (size < 2 * frame_size)
+            size = 2 * frame_size;
+        OS_LOGD(TAG, "Create sink ringbuf, latency:%dms, size:%d", latency_ms, size);
+        ringbuf_handle rb = rb_create_spsc(size, DEFAULT_MEDIA_SINK_SPAN_SIZE);
+        if (rb == NULL)
+            return ESP_FAIL;
+        os_mutex_lock(handle->state_lock);
+        handle->sink_ringbuf = rb;
+        if (handle->sink_abort)
+            rb_abort(rb);
+        os_mutex_unlock(handle->state_lock);
+    } else if (handle->sink_flush) {
+        rb_reset(handle->sink_ringbuf);
+        handle->sink_tail_len = 0;
+        handle->sink_tail_offset = 0;
+        ATOMIC_STORE(handle->sink_position, 0);
+    }
+    handle->sink_flush = false;
+
+    int size = rb_get_size(handle->sink_ringbuf);
+    int chunk_size = size/4 < DEFAULT_MEDIA_SINK_SPAN_SIZE ? size/4 : DEFAULT_MEDIA_SINK_SPAN_SIZE;
+    chunk_size -= chunk_size % frame_size;
+    struct media_sink_info info = {
+        .sink_handle = handle->sink_handle,
+        .sink_ops = handle->sink_ops,
+        .in_ringbuf = handle->sink_ringbuf,
+        .chunk_size = chunk_size > 0 ? chunk_size : frame_size,
+        .prefill_size = size/2 - (size/2) % frame_size,
+        .stats = handle->stats,
+        .volume = handle->volume,
+    };
+    handle->media_sink_handle = media_sink_start_async(&info, media_sink_state_callback, handle);
+    return handle->media_sink_handle != NULL ? ESP_OK : ESP_FAIL;
+}
+
 static int audio_sink_open(audio_element_handle_t self, void *ctx)
 {
     liteplayer_handle_t handle = (liteplayer_handle_t)ctx;
@@ -155,33 +475,391 @@ static int audio_sink_open(audio_element_handle_t self, void *ctx)
         OS_LOGV(TAG, "Sink not inited, abort opening");
         return AEL_IO_OK;
     }
+
+    os_mutex_lock(handle->state_lock);
+    while (handle->sink_pending && !handle->sink_abort) {
+        OS_LOGD(TAG, "Waiting for sink of previous player");
+        os_cond_wait(handle->sink_cond, handle->state_lock);
+    }
+    bool abort = handle->sink_abort;
+    os_mutex_unlock(handle->state_lock);
+    if (abort)
+        return AEL_IO_ABORT;
+
+    if (pcm_sample_bytes(handle->sink_bits) == 0) {
+        OS_LOGE(TAG, "Unsupported pcm bits: %d", handle->sink_bits);
+        return AEL_IO_FAIL;
+    }
+    handle->output_bits = media_player_negotiate_bits(handle);
+    if (handle->output_bits != handle->sink_bits)
+        OS_LOGI(TAG, "Converting pcm: %dbits->%dbits", handle->sink_bits, handle->output_bits);
+    int channels = media_player_output_channels(handle);
+    if (channels != handle->sink_channels)
+        OS_LOGI(TAG, "Mixing pcm: %dch->%dch", handle->sink_channels, channels);
+    dsp_chain_open(handle->dsp_chain, handle->sink_samplerate, channels, handle->sink_bits);
+    if (handle->sink_flush)
+        dsp_chain_reset(handle->dsp_chain);
+
+    int samplerate = media_player_output_samplerate(handle);
+    if (samplerate != handle->sink_samplerate) {
+        if (handle->resampler == NULL) {
+            OS_LOGI(TAG, "Resampling pcm: %d->%d", handle->sink_samplerate, samplerate);
+            handle->resampler = resampler_create(handle->sink_samplerate, samplerate, channels);
+            if (handle->resampler == NULL) {
+                OS_LOGE(TAG, "Failed to create resampler");
+                return AEL_IO_FAIL;
+            }
+        } else if (handle->sink_flush && resampler_reset(handle->resampler) != 0) {
+            OS_LOGE(TAG, "Failed to reset resampler");
+            return AEL_IO_FAIL;
+        }
+    }
+
+    if (handle->sink_handle != NULL &&
+        (handle->sink_open_samplerate != samplerate ||
+         handle->sink_open_channels != channels ||
+         handle->sink_open_bits != handle->output_bits)) {
+        OS_LOGI(TAG, "Closing sink taken over, format changed");
+        handle->sink_ops->close(handle->sink_handle);
+        handle->sink_handle = NULL;
+    }
+
     OS_LOGI(TAG, "Opening sink: rate:%d, channels:%d, bits:%d",
-            handle->sink_samplerate, handle->sink_channels, handle->sink_bits);
+            samplerate, channels, handle->output_bits);
     if (handle->sink_handle == NULL) {
-        handle->sink_handle = handle->sink_ops->open(handle->sink_samplerate,
-                                                     handle->sink_channels,
-                                                     handle->sink_bits,
+        handle->sink_handle = handle->sink_ops->open(samplerate,
+                                                     channels,
+                                                     handle->output_bits,
                                                      handle->sink_ops->priv_data);
         if (handle->sink_handle == NULL) {
             OS_LOGE(TAG, "Failed to open sink");
             return AEL_IO_FAIL;
         }
+        handle->sink_open_samplerate = samplerate;
+        handle->sink_open_channels = channels;
+        handle->sink_open_bits = handle->output_bits;
+    }
+    volume_set_format(handle->volume, samplerate, channels, handle->output_bits);
+
+    if (media_player_sink_latency_ms(handle) > 0 && media_player_start_sink(handle) != ESP_OK) {
+        OS_LOGE(TAG, "Failed to start sink thread");
+        return AEL_IO_FAIL;
     }
+    handle->sink_flush = false;
     return AEL_IO_OK;
 }
 
+/*
+ * Drop encoder delay at head and padding at tail, returns bytes of pcm to output,
+ * *buffer is moved forward if head is trimmed.
+ * Trimming is skipped after seeking, as decoder doesn't start at the first frame.
+ */
+static int media_player_trim_pcm(liteplayer_handle_t handle, char **buffer, int len)
+{
+    if (!handle->trim_inited) {
+        handle->trim_inited = true;
+        handle->trim_head = 0;
+        handle->trim_remain = -1;
+        struct media_codec_info *codec = &handle->media_codec_info;
+        if (handle->seek_time == 0 && codec->gapless_samples > 0 && codec->codec_samplerate > 0) {
+            long long frame_size = handle->sink_channels * handle->sink_bits / 8;
+            long long delay = (long long)codec->gapless_delay * handle->sink_samplerate / codec->codec_samplerate;
+            long long samples = codec->gapless_samples * handle->sink_samplerate / codec->codec_samplerate;
+            handle->trim_head = delay * frame_size;
+            handle->trim_remain = samples * frame_size;
+            OS_LOGD(TAG, "Trimming pcm: delay=%lld, valid_samples=%lld", delay, samples);
+        }
+    }
+
+    if (handle->trim_head > 0) {
+        int bytes = handle->trim_head > len ? len : (int)handle->trim_head;
+        handle->trim_head -= bytes;
+        *buffer += bytes;
+        len -= bytes;
+    }
+    if (handle->trim_remain >= 0) {
+        if (len > handle->trim_remain)
+            len = (int)handle->trim_remain;
+        handle->trim_remain -= len;
+    }
+    return len;
+}
+
+// Duration of decoded pcm, before trimming and resampling
+static unsigned long long media_player_pcm_usec(liteplayer_handle_t handle, int bytes)
+{
+    int bytes_per_sec = handle->sink_samplerate * handle->sink_channels * handle->sink_bits / 8;
+    return bytes_per_sec > 0 ? (unsigned long long)bytes * 1000000 / bytes_per_sec : 0;
+}
+
+/*
+ * Mix pcm to the output channels, mixed down in place, or up into mix_buffer,
+ * returns bytes of pcm mixed.
+ */
+static int media_player_mix_pcm(liteplayer_handle_t handle, char **buffer, int len)
+{
+    int channels = media_player_output_channels(handle);
+    int frames = len / (handle->sink_channels * pcm_sample_bytes(handle->sink_bits));
+    char *out = *buffer;
+    if (channels > handle->sink_channels) {
+        int size = frames * channels * pcm_sample_bytes(handle->sink_bits);
+        if (size > handle->mix_buffer_size) {
+            char *mix_buffer = audio_realloc(handle->mix_buffer, size);
+            if (mix_buffer == NULL) {
+                OS_LOGE(TAG, "Failed to allocate mix buffer");
+                return -1;
+            }
+            handle->mix_buffer = mix_buffer;
+            handle->mix_buffer_size = size;
+        }
+        out = handle->mix_buffer;
+    }
+
+    int bytes = pcm_mix_channels(*buffer, handle->sink_channels, out, channels, handle->sink_bits, frames);
+    *buffer = out;
+    return bytes;
+}
+
+// Convert pcm into convert_buffer, returns bytes of pcm converted
+static int media_player_convert_pcm(liteplayer_handle_t handle, char **buffer, int len)
+{
+    int samples = len / pcm_sample_bytes(handle->sink_bits);
+    int size = samples * pcm_sample_bytes(handle->output_bits);
+    if (size > handle->convert_buffer_size) {
+        char *convert_buffer = audio_realloc(handle->convert_buffer, size);
+        if (convert_buffer == NULL) {
+            OS_LOGE(TAG, "Failed to allocate convert buffer");
+            return -1;
+        }
+        handle->convert_buffer = convert_buffer;
+        handle->convert_buffer_size = size;
+    }
+
+    int bytes = pcm_convert(*buffer, handle->sink_bits, handle->convert_buffer, handle->output_bits, samples);
+    *buffer = handle->convert_buffer;
+    return bytes;
+}
+
+// Resample pcm into resample_buffer, returns bytes of pcm resampled
+static int media_player_resample_pcm(liteplayer_handle_t handle, char **buffer, int len)
+{
+    int frame_size = media_player_output_channels(handle) * sizeof(short);
+    int in_frames = len / frame_size;
+    int size = resampler_get_output_frames(handle->resampler, in_frames) * frame_size;
+    if (size > handle->resample_buffer_size) {
+        char *resample_buffer = audio_realloc(handle->resample_buffer, size);
+        if (resample_buffer == NULL) {
+            OS_LOGE(TAG, "Failed to allocate resample buffer");
+            return -1;
+        }
+        handle->resample_buffer = resample_buffer;
+        handle->resample_buffer_size = size;
+    }
+
+    int out_frames = resampler_process(handle->resampler, (const short *)(*buffer), in_frames,
+                                       (short *)handle->resample_buffer);
+    if (out_frames < 0)
+        return -1;
+    *buffer = handle->resample_buffer;
+    return out_frames * frame_size;
+}
+
+// Write pcm to the sink ringbuf, it waits for room only if @wait
+static int media_player_write_ringbuf(liteplayer_handle_t handle, char *pcm, int pcm_len, bool wait)
+{
+    if (!wait) {
+        // the decoder is the only writer, room available can't shrink, rb_write won't block
+        int bytes_available = rb_bytes_available(handle->sink_ringbuf);
+        if (pcm_len > bytes_available)
+            pcm_len = bytes_available;
+    }
+    if (pcm_len == 0)
+        return 0;
+
+    // sink position is counted by the sink thread
+    unsigned long long begin = media_stats_clock(handle->stats);
+    LITEPLAYER_TRACE_BEGIN(trace);
+    int bytes_written = rb_write(handle->sink_ringbuf, pcm, pcm_len, 0);
+    LITEPLAYER_TRACE_END(trace, "ringbuf_write");
+    media_stats_ringbuf_write(handle->stats, media_stats_clock(handle->stats) - begin);
+    if (bytes_written == pcm_len)
+        return bytes_written;
+    if (bytes_written == RB_ABORT)
+        return AEL_IO_ABORT;
+    OS_LOGE(TAG, "Failed to write pcm ringbuf, ret:%d", bytes_written);
+    return AEL_IO_FAIL;
+}
+
+/*
+ * Executor mode: write the pcm kept from the last time, returns AEL_IO_TIMEOUT if the ringbuf
+ * is still too full for all of it and !@wait, the decoder keeps its output and retries later.
+ */
+static int media_player_flush_sink_tail(liteplayer_handle_t handle, bool wait)
+{
+    if (handle->sink_tail_len == 0)
+        return AEL_IO_OK;
+    int bytes_written = media_player_write_ringbuf(handle,
+                                                   handle->sink_tail + handle->sink_tail_offset,
+                                                   handle->sink_tail_len, wait);
+    if (bytes_written < 0)
+        return bytes_written;
+    handle->sink_tail_offset += bytes_written;
+    handle->sink_tail_len -= bytes_written;
+    return handle->sink_tail_len > 0 ? AEL_IO_TIMEOUT : AEL_IO_OK;
+}
+
+// Executor mode: keep pcm that doesn't fit in the ringbuf, it's written first next time
+static int media_player_keep_sink_tail(liteplayer_handle_t handle, char *pcm, int pcm_len)
+{
+    if (pcm_len > handle->sink_tail_size) {
+        char *sink_tail = audio_realloc(handle->sink_tail, pcm_len);
+        if (sink_tail == NULL) {
+            OS_LOGE(TAG, "Failed to allocate sink tail");
+            return AEL_IO_FAIL;
+        }
+        handle->sink_tail = sink_tail;
+        handle->sink_tail_size = pcm_len;
+    }
+    memcpy(handle->sink_tail, pcm, pcm_len);
+    handle->sink_tail_offset = 0;
+    handle->sink_tail_len = pcm_len;
+    return AEL_IO_OK;
+}
+
+// Write all of the processed pcm, to the sink ringbuf if buffered, or to the sink
+static int media_player_write_all(liteplayer_handle_t handle, char *pcm, int pcm_len)
+{
+    if (handle->sink_ringbuf != NULL) {
+        // a worker doesn't wait for room, the rest is kept and written before next pcm
+        bool wait = handle->executor == NULL;
+        int bytes_written = media_player_write_ringbuf(handle, pcm, pcm_len, wait);
+        if (bytes_written < 0)
+            return bytes_written;
+        if (bytes_written < pcm_len)
+            return media_player_keep_sink_tail(handle, pcm + bytes_written, pcm_len - bytes_written);
+        return AEL_IO_OK;
+    }
+
+    // processed pcm can't be given back to the decoder, write all of it
+    while (pcm_len > 0) {
+        unsigned long long begin = media_stats_clock(handle->stats);
+        LITEPLAYER_TRACE_BEGIN(trace);
+        int bytes_written = handle->sink_ops->write(handle->sink_handle, pcm, pcm_len);
+        LITEPLAYER_TRACE_END(trace, "sink_write");
+        media_stats_sink_write(handle->stats, media_stats_clock(handle->stats) - begin,
+                               bytes_written < pcm_len);
+        if (bytes_written < 0 || bytes_written > pcm_len) {
+            OS_LOGE(TAG, "Failed to write pcm, ret:%d", bytes_written);
+            return AEL_IO_FAIL;
+        }
+        ATOMIC_FETCH_ADD(handle->sink_position, bytes_written);
+        pcm += bytes_written;
+        pcm_len -= bytes_written;
+    }
+    return AEL_IO_OK;
+}
+
+// Write the tail held in the resampler filter at the end of stream, it's lost otherwise
+static void media_player_flush_resampler(liteplayer_handle_t handle)
+{
+    if (handle->resampler == NULL || handle->sink_handle == NULL)
+        return;
+
+    int frame_size = media_player_output_channels(handle) * sizeof(short);
+    int size = resampler_get_output_frames(handle->resampler, 0) * frame_size;
+    if (size > handle->resample_buffer_size) {
+        char *resample_buffer = audio_realloc(handle->resample_buffer, size);
+        if (resample_buffer == NULL) {
+            OS_LOGE(TAG, "Failed to allocate resample buffer");
+            return;
+        }
+        handle->resample_buffer = resample_buffer;
+        handle->resample_buffer_size = size;
+    }
+
+    int out_frames = resampler_flush(handle->resampler, (short *)handle->resample_buffer);
+    if (out_frames <= 0)
+        return;
+    char *pcm = handle->resample_buffer;
+    int pcm_len = out_frames * frame_size;
+    if (handle->sink_ringbuf == NULL)
+        volume_process(handle->volume, pcm, pcm_len);
+    media_player_write_all(handle, pcm, pcm_len);
+}
+
 static int audio_sink_write(audio_element_handle_t self, char *buffer, int len, int timeout_ms, void *ctx)
 {
     liteplayer_handle_t handle = (liteplayer_handle_t)ctx;
     if (!handle->sink_inited) {
         handle->sink_inited = true;
-        if (audio_sink_open(self, ctx) != 0)
+        int ret = audio_sink_open(self, ctx);
+        if (ret != AEL_IO_OK) {
+            // sink isn't opened, don't write to it if decoder goes on
+            handle->sink_inited = false;
+            return ret;
+        }
+    }
+
+    // pcm kept from the last time goes first, the decoder holds @buffer till it's written
+    if (handle->sink_tail_len > 0) {
+        int ret = media_player_flush_sink_tail(handle, false);
+        if (ret != AEL_IO_OK)
+            return ret;
+    }
+
+    media_stats_decode_output(handle->stats, media_player_pcm_usec(handle, len));
+
+    char *pcm = buffer;
+    int pcm_len = media_player_trim_pcm(handle, &pcm, len);
+    if (pcm_len == 0)
+        return len;
+
+    bool mixed = media_player_output_channels(handle) != handle->sink_channels;
+    if (mixed) {
+        pcm_len = media_player_mix_pcm(handle, &pcm, pcm_len);
+        if (pcm_len < 0)
+            return AEL_IO_FAIL;
+    }
+
+    int stages = dsp_chain_process(handle->dsp_chain, pcm, pcm_len);
+    if (stages < 0)
+        return AEL_IO_FAIL;
+
+    if (handle->output_bits != handle->sink_bits) {
+        pcm_len = media_player_convert_pcm(handle, &pcm, pcm_len);
+        if (pcm_len < 0)
             return AEL_IO_FAIL;
     }
 
-    int bytes_written = handle->sink_ops->write(handle->sink_handle, buffer, len);
-    if (bytes_written >= 0 && bytes_written <= len) {
-        handle->sink_position += bytes_written;
+    if (handle->resampler != NULL) {
+        pcm_len = media_player_resample_pcm(handle, &pcm, pcm_len);
+        if (pcm_len < 0)
+            return AEL_IO_FAIL;
+        if (pcm_len == 0)
+            return len;
+    }
+
+    // volume is applied by the sink thread if pcm is buffered
+    bool scaled = handle->sink_ringbuf == NULL && volume_process(handle->volume, pcm, pcm_len) > 0;
+
+    if (handle->sink_ringbuf != NULL ||
+        handle->resampler != NULL || handle->output_bits != handle->sink_bits || scaled || mixed || stages > 0) {
+        int ret = media_player_write_all(handle, pcm, pcm_len);
+        return ret == AEL_IO_OK ? len : ret;
+    }
+
+    unsigned long long begin = media_stats_clock(handle->stats);
+    LITEPLAYER_TRACE_BEGIN(trace);
+    int bytes_written = handle->sink_ops->write(handle->sink_handle, pcm, pcm_len);
+    LITEPLAYER_TRACE_END(trace, "sink_write");
+    media_stats_sink_write(handle->stats, media_stats_clock(handle->stats) - begin, bytes_written < pcm_len);
+    if (bytes_written >= 0 && bytes_written <= pcm_len) {
+        ATOMIC_FETCH_ADD(handle->sink_position, bytes_written);
+        if (bytes_written == pcm_len)
+            return len; // trimmed tail is consumed too
+        if (handle->trim_remain >= 0)
+            handle->trim_remain += pcm_len - bytes_written;
+        bytes_written += pcm - buffer;
     } else {
         OS_LOGE(TAG, "Failed to write pcm, ret:%d", bytes_written);
         bytes_written = AEL_IO_FAIL;
@@ -192,17 +870,57 @@ static int audio_sink_write(audio_element_handle_t self, char *buffer, int len,
 static void audio_sink_close(audio_element_handle_t self, void *ctx)
 {
     liteplayer_handle_t handle = (liteplayer_handle_t)ctx;
+    if (audio_element_get_state(self) == AEL_STATE_FINISHED) {
+        // end of stream, the sink is drained anyway, waiting for room is bounded by latency
+        media_player_flush_sink_tail(handle, true);
+        media_player_flush_resampler(handle);
+        media_player_flush_sink_tail(handle, true);
+    }
+    if (handle->media_sink_handle != NULL) {
+        // play out the buffered pcm at the end of stream, before handing the sink over
+        if (audio_element_get_state(self) == AEL_STATE_FINISHED)
+            media_sink_drain(handle->media_sink_handle);
+        else
+            media_sink_stop(handle->media_sink_handle);
+        handle->media_sink_handle = NULL;
+    }
+    if (audio_element_get_state(self) != AEL_STATE_PAUSED)
+        media_player_handover_sink(handle, audio_element_get_state(self) == AEL_STATE_FINISHED);
     if (handle->sink_handle != NULL) {
         OS_LOGI(TAG, "Closing sink");
         handle->sink_ops->close(handle->sink_handle);
         handle->sink_handle = NULL;
     }
     if (audio_element_get_state(self) != AEL_STATE_PAUSED) {
-        handle->sink_position = 0;
+        media_player_destroy_sink_ringbuf(handle);
+        media_player_destroy_resampler(handle);
+        media_player_destroy_convert_buffer(handle);
+        dsp_chain_close(handle->dsp_chain);
+        ATOMIC_STORE(handle->sink_position, 0);
         handle->sink_inited = false;
     }
 }
 
+static int pcm_reader_write(audio_element_handle_t self, char *buffer, int len, int timeout_ms, void *ctx)
+{
+    liteplayer_handle_t handle = (liteplayer_handle_t)ctx;
+    int bytes_consumed = len;
+    media_stats_decode_output(handle->stats, media_player_pcm_usec(handle, len));
+    len = media_player_trim_pcm(handle, &buffer, len);
+    if (handle->pcm_filled + len > handle->pcm_buffer_size) {
+        char *pcm_buffer = audio_realloc(handle->pcm_buffer, handle->pcm_filled + len);
+        if (pcm_buffer == NULL) {
+            OS_LOGE(TAG, "Failed to allocate pcm buffer");
+            return AEL_IO_FAIL;
+        }
+        handle->pcm_buffer = pcm_buffer;
+        handle->pcm_buffer_size = handle->pcm_filled + len;
+    }
+    memcpy(handle->pcm_buffer + handle->pcm_filled, buffer, len);
+    handle->pcm_filled += len;
+    return bytes_consumed;
+}
+
 static void media_player_state_callback(liteplayer_handle_t handle, enum liteplayer_state state, int errcode)
 {
     if (state == LITEPLAYER_ERROR) {
@@ -219,6 +937,14 @@ static void media_player_state_callback(liteplayer_handle_t handle, enum litepla
     }
 }
 
+static void media_player_set_starting(liteplayer_handle_t handle)
+{
+    os_mutex_lock(handle->state_lock);
+    handle->state_starting = true;
+    handle->state_finished = false;
+    os_mutex_unlock(handle->state_lock);
+}
+
 static int audio_element_state_callback(audio_element_handle_t el, audio_event_iface_msg_t *msg, void *ctx)
 {
     liteplayer_handle_t handle = (liteplayer_handle_t)ctx;
@@ -242,6 +968,7 @@ static int audio_element_state_callback(audio_element_handle_t el, audio_event_i
 
             case AEL_STATUS_ERROR_TIMEOUT:
                 if (msg->source == (void *)handle->ael_decoder) {
+                    media_stats_underrun(handle->stats);
                     OS_LOGW(TAG, "[ %s-%s ] Receive inputtimeout event, filled/total: %d/%d",
                             handle->source_ops->url_protocol(), audio_element_get_tag(el),
                             rb_bytes_filled(handle->media_source_info.out_ringbuf),
@@ -271,7 +998,9 @@ static int audio_element_state_callback(audio_element_handle_t el, audio_event_i
                 if (msg->source == (void *)handle->ael_decoder) {
                     OS_LOGD(TAG, "[ %s-%s ] Receive finished event",
                             handle->source_ops->url_protocol(), audio_element_get_tag(el));
-                    if (handle->state < LITEPLAYER_STARTED) {
+                    if (handle->state_starting) {
+                        handle->state_finished = true;
+                    } else if (handle->state < LITEPLAYER_STARTED) {
                         OS_LOGE(TAG, "Receive finished event before starting player, it should not happen");
                         handle->state = LITEPLAYER_ERROR;
                         media_player_state_callback(handle, LITEPLAYER_ERROR, ESP_FAIL);
@@ -336,6 +1065,33 @@ static void media_source_state_callback(enum media_source_state state, void *pri
     os_mutex_unlock(handle->state_lock);
 }
 
+static void media_sink_state_callback(enum media_sink_state state, int bytes, void *priv)
+{
+    liteplayer_handle_t handle = (liteplayer_handle_t)priv;
+
+    if (state == MEDIA_SINK_WRITE_SUCCEED) {
+        ATOMIC_FETCH_ADD(handle->sink_position, bytes);
+        return;
+    }
+
+    os_mutex_lock(handle->state_lock);
+
+    switch (state) {
+    case MEDIA_SINK_WRITE_FAILED:
+        OS_LOGE(TAG, "[ %s-sink ] Receive error[%d]", handle->source_ops->url_protocol(), state);
+        handle->state = LITEPLAYER_ERROR;
+        media_player_state_callback(handle, LITEPLAYER_ERROR, state);
+        break;
+    case MEDIA_SINK_WRITE_DONE:
+        OS_LOGD(TAG, "[ %s-sink ] Receive outputdone event", handle->source_ops->url_protocol());
+        break;
+    default:
+        break;
+    }
+
+    os_mutex_unlock(handle->state_lock);
+}
+
 static void media_parser_state_callback(enum media_parser_state state, struct media_codec_info *info, void *priv)
 {
     liteplayer_handle_t handle = (liteplayer_handle_t)priv;
@@ -361,14 +1117,200 @@ static void media_parser_state_callback(enum media_parser_state state, struct me
     os_mutex_unlock(handle->state_lock);
 }
 
+static void media_player_abort_sink(liteplayer_handle_t handle)
+{
+    os_mutex_lock(handle->state_lock);
+    handle->sink_abort = true;
+    handle->sink_pending = false;
+    os_cond_signal(handle->sink_cond);
+    if (handle->sink_ringbuf != NULL)
+        rb_abort(handle->sink_ringbuf); // unblock decoder writing to a full ringbuf
+    os_mutex_unlock(handle->state_lock);
+    media_player_handover_sink(handle, false);
+}
+
+/*
+ * Ramp the playing pcm down to silence before it's cut by pausing, seeking or stopping,
+ * so that it doesn't click, returns true if faded out, volume_fade_in() ramps it back.
+ */
+static bool media_player_fade_out(liteplayer_handle_t handle)
+{
+    os_mutex_lock(handle->state_lock);
+    bool playing = handle->state == LITEPLAYER_STARTED || handle->state == LITEPLAYER_NEARLYCOMPLETED;
+    os_mutex_unlock(handle->state_lock);
+    if (!playing || handle->pcm_reader)
+        return false;
+
+    volume_fade_out(handle->volume, DEFAULT_MEDIA_VOLUME_FADE_MS);
+    if (!volume_wait_silent(handle->volume, DEFAULT_MEDIA_VOLUME_FADE_TIMEOUT_MS))
+        OS_LOGD(TAG, "Timeout to fade out, sink may be stalled");
+    return true;
+}
+
+/*
+ * Executor mode: decoding is split into tasks of a few frames, a task resubmits itself
+ * until the player is halted or the stream ends, so that many players share the workers.
+ */
+static void media_player_decode_task(void *arg)
+{
+    liteplayer_handle_t handle = (liteplayer_handle_t)arg;
+    int process_len = AEL_IO_TIMEOUT;
+
+    os_mutex_lock(handle->exec_lock);
+    for (int i = 0; i < DEFAULT_MEDIA_EXECUTOR_TASK_FRAMES && handle->exec_running; i++) {
+        process_len = audio_element_process_inline(handle->ael_decoder);
+        if (process_len < 0)
+            break;
+    }
+
+    // No data or room for now, retry a bit later rather than spinning a worker on it
+    unsigned long delay_ms = process_len == AEL_IO_TIMEOUT ? DEFAULT_MEDIA_EXECUTOR_RETRY_MS : 0;
+    bool resubmit = handle->exec_running && (process_len > 0 || process_len == AEL_IO_TIMEOUT);
+    if (resubmit && executor_submit_delayed(handle->executor, media_player_decode_task, handle, delay_ms) != 0) {
+        OS_LOGE(TAG, "Failed to resubmit decode task");
+        resubmit = false;
+        os_mutex_lock(handle->state_lock);
+        handle->state = LITEPLAYER_ERROR;
+        media_player_state_callback(handle, LITEPLAYER_ERROR, ESP_FAIL);
+        os_mutex_unlock(handle->state_lock);
+    }
+    if (!resubmit) {
+        handle->exec_running = false;
+        handle->exec_scheduled = false;
+        os_cond_broadcast(handle->exec_cond);
+    }
+    os_mutex_unlock(handle->exec_lock);
+}
+
+static void media_player_parse_task(void *arg)
+{
+    liteplayer_handle_t handle = (liteplayer_handle_t)arg;
+    struct media_codec_info codec_info;
+    memset(&codec_info, 0x0, sizeof(codec_info));
+
+    if (media_parser_get_codec_info(&handle->media_source_info, &codec_info) == ESP_OK)
+        media_parser_state_callback(MEDIA_PARSER_SUCCEED, &codec_info, handle);
+    else
+        media_parser_state_callback(MEDIA_PARSER_FAILED, NULL, handle);
+
+    os_mutex_lock(handle->exec_lock);
+    handle->exec_scheduled = false;
+    os_cond_broadcast(handle->exec_cond);
+    os_mutex_unlock(handle->exec_lock);
+}
+
+static int media_player_exec_submit(liteplayer_handle_t handle, executor_task_cb task)
+{
+    int ret = ESP_OK;
+    os_mutex_lock(handle->exec_lock);
+    handle->exec_running = true;
+    if (!handle->exec_scheduled) {
+        handle->exec_scheduled = true;
+        if (executor_submit(handle->executor, task, handle) != 0) {
+            OS_LOGE(TAG, "Failed to submit task to executor");
+            handle->exec_running = false;
+            handle->exec_scheduled = false;
+            ret = ESP_FAIL;
+        }
+    }
+    os_mutex_unlock(handle->exec_lock);
+    return ret;
+}
+
+static int media_player_exec_start(liteplayer_handle_t handle)
+{
+    int ret = media_player_exec_submit(handle, media_player_decode_task);
+    if (ret != ESP_OK) {
+        os_mutex_lock(handle->state_lock);
+        handle->state = LITEPLAYER_ERROR;
+        media_player_state_callback(handle, LITEPLAYER_ERROR, ret);
+        os_mutex_unlock(handle->state_lock);
+    }
+    return ret;
+}
+
+// Stop rescheduling and wait for the queued task to retire, element is then safe to touch
+static void media_player_exec_halt(liteplayer_handle_t handle)
+{
+    if (handle->executor == NULL)
+        return;
+    os_mutex_lock(handle->exec_lock);
+    handle->exec_running = false;
+    while (handle->exec_scheduled)
+        os_cond_wait(handle->exec_cond, handle->exec_lock);
+    os_mutex_unlock(handle->exec_lock);
+}
+
+// Source ringbuf lives as long as the data source, its data is taken from arena if enabled
+static ringbuf_handle media_player_create_source_ringbuf(liteplayer_handle_t handle)
+{
+    int size = handle->source_ops->buffer_size;
+    if (handle->arena == NULL)
+        return rb_create_spsc(size, DEFAULT_MEDIA_SOURCE_SPAN_SIZE);
+
+    handle->source_ringbuf_buffer = media_arena_malloc(handle->arena, size + DEFAULT_MEDIA_SOURCE_SPAN_SIZE);
+    if (handle->source_ringbuf_buffer == NULL)
+        return NULL;
+    ringbuf_handle rb = rb_create_spsc_static(handle->source_ringbuf_buffer, size, DEFAULT_MEDIA_SOURCE_SPAN_SIZE);
+    if (rb == NULL) {
+        media_arena_free(handle->arena, handle->source_ringbuf_buffer);
+        handle->source_ringbuf_buffer = NULL;
+    }
+    return rb;
+}
+
+static void media_player_destroy_source_ringbuf(liteplayer_handle_t handle)
+{
+    if (handle->media_source_info.out_ringbuf != NULL) {
+        rb_destroy(handle->media_source_info.out_ringbuf);
+        handle->media_source_info.out_ringbuf = NULL;
+    }
+    if (handle->source_ringbuf_buffer != NULL) {
+        media_arena_free(handle->arena, handle->source_ringbuf_buffer);
+        handle->source_ringbuf_buffer = NULL;
+    }
+}
+
+// Aac and m4a decoders share the same codec instance
+static audio_codec_t media_player_codec_family(audio_codec_t codec_type)
+{
+    return codec_type == AUDIO_CODEC_M4A ? AUDIO_CODEC_AAC : codec_type;
+}
+
+static void media_player_free_codec(liteplayer_handle_t handle)
+{
+    switch (handle->codec_cache_type) {
+    case AUDIO_CODEC_MP3:
+        mp3_decoder_free_codec(handle->codec_cache);
+        break;
+    case AUDIO_CODEC_AAC:
+        aac_decoder_free_codec(handle->codec_cache);
+        break;
+    default:
+        break;
+    }
+    handle->codec_cache = NULL;
+}
+
 static void main_pipeline_deinit(liteplayer_handle_t handle)
 {
+    media_player_abort_sink(handle);
+    media_player_exec_halt(handle);
+
     if (handle->ael_decoder != NULL) {
         OS_LOGD(TAG, "Destroy audio decoder");
+        if (media_player_inline(handle))
+            audio_element_stop_inline(handle->ael_decoder);
         audio_element_deinit(handle->ael_decoder);
         handle->ael_decoder = NULL;
     }
 
+    if (handle->media_sink_handle != NULL) {
+        media_sink_stop(handle->media_sink_handle);
+        handle->media_sink_handle = NULL;
+    }
+    media_player_destroy_sink_ringbuf(handle);
+
     if (handle->media_parser_handle != NULL) {
         media_parser_stop(handle->media_parser_handle);
         handle->media_parser_handle = NULL;
@@ -382,27 +1324,38 @@ static void main_pipeline_deinit(liteplayer_handle_t handle)
         handle->media_source_info.source_handle = NULL;
     }
 
-    if (handle->media_source_info.out_ringbuf != NULL) {
-        rb_destroy(handle->media_source_info.out_ringbuf);
-        handle->media_source_info.out_ringbuf = NULL;
-    }
+    media_player_destroy_source_ringbuf(handle);
 
     if (handle->source_buffer_addr != NULL) {
-        audio_free(handle->source_buffer_addr);
+        media_arena_free(handle->arena, handle->source_buffer_addr);
         handle->source_buffer_addr = NULL;
     }
+
+    if (handle->pcm_buffer != NULL) {
+        audio_free(handle->pcm_buffer);
+        handle->pcm_buffer = NULL;
+    }
+    handle->pcm_buffer_size = 0;
+    handle->pcm_filled = 0;
+    handle->pcm_offset = 0;
 }
 
 static int main_pipeline_init(liteplayer_handle_t handle)
 {
     {
         OS_LOGD(TAG, "[1.0] Create decoder element");
+        audio_codec_t codec_family = media_player_codec_family(handle->media_codec_info.codec_type);
+        if (handle->codec_cache != NULL && handle->codec_cache_type != codec_family)
+            media_player_free_codec(handle);
+        handle->codec_cache_type = codec_family;
         switch (handle->media_codec_info.codec_type) {
         case AUDIO_CODEC_MP3: {
             struct mp3_decoder_cfg mp3_cfg = DEFAULT_MP3_DECODER_CONFIG();
             mp3_cfg.task_prio            = DEFAULT_MEDIA_DECODER_TASK_PRIO;
             mp3_cfg.task_stack           = DEFAULT_MEDIA_DECODER_TASK_STACKSIZE;
             mp3_cfg.mp3_info             = &(handle->media_codec_info.detail.mp3_info);
+            mp3_cfg.arena                = handle->arena;
+            mp3_cfg.codec_cache          = &handle->codec_cache;
             handle->ael_decoder = mp3_decoder_init(&mp3_cfg);
             break;
         }
@@ -411,6 +1364,10 @@ static int main_pipeline_init(liteplayer_handle_t handle)
             aac_cfg.task_prio            = DEFAULT_MEDIA_DECODER_TASK_PRIO;
             aac_cfg.task_stack           = DEFAULT_MEDIA_DECODER_TASK_STACKSIZE;
             aac_cfg.aac_info             = &(handle->media_codec_info.detail.aac_info);
+            aac_cfg.arena                = handle->arena;
+            aac_cfg.codec_cache          = &handle->codec_cache;
+            aac_cfg.channels             = handle->pcm_reader ? 0 : handle->output_channels;
+            aac_cfg.aac_plus             = !handle->aac_plus_disabled;
             handle->ael_decoder = aac_decoder_init(&aac_cfg);
             break;
         }
@@ -419,6 +1376,10 @@ static int main_pipeline_init(liteplayer_handle_t handle)
             m4a_cfg.task_prio            = DEFAULT_MEDIA_DECODER_TASK_PRIO;
             m4a_cfg.task_stack           = DEFAULT_MEDIA_DECODER_TASK_STACKSIZE;
             m4a_cfg.m4a_info             = &(handle->media_codec_info.detail.m4a_info);
+            m4a_cfg.arena                = handle->arena;
+            m4a_cfg.codec_cache          = &handle->codec_cache;
+            m4a_cfg.channels             = handle->pcm_reader ? 0 : handle->output_channels;
+            m4a_cfg.aac_plus             = !handle->aac_plus_disabled;
             handle->ael_decoder = m4a_decoder_init(&m4a_cfg);
             break;
         }
@@ -427,6 +1388,7 @@ static int main_pipeline_init(liteplayer_handle_t handle)
             wav_cfg.task_prio            = DEFAULT_MEDIA_DECODER_TASK_PRIO;
             wav_cfg.task_stack           = DEFAULT_MEDIA_DECODER_TASK_STACKSIZE;
             wav_cfg.wav_info             = &(handle->media_codec_info.detail.wav_info);
+            wav_cfg.arena                = handle->arena;
             handle->ael_decoder = wav_decoder_init(&wav_cfg);
             break;
         }
@@ -454,22 +1416,34 @@ static int main_pipeline_init(liteplayer_handle_t handle)
 
     {
         OS_LOGD(TAG, "[1.1] Create sink element");
-        handle->sink_position = 0;
+        ATOMIC_STORE(handle->sink_position, 0);
+        handle->trim_inited = false;
         handle->sink_samplerate = handle->media_codec_info.codec_samplerate;
         handle->sink_channels = handle->media_codec_info.codec_channels;
         handle->sink_bits = handle->media_codec_info.codec_bits;
-        stream_callback_t audio_sink = {
-            .open = audio_sink_open,
-            .write = audio_sink_write,
-            .close = audio_sink_close,
-            .ctx = handle,
-        };
-        audio_element_set_write_cb(handle->ael_decoder, &audio_sink);
+        if (handle->pcm_reader) {
+            stream_callback_t pcm_sink = {
+                .write = pcm_reader_write,
+                .ctx = handle,
+            };
+            audio_element_set_write_cb(handle->ael_decoder, &pcm_sink);
+        } else {
+            stream_callback_t audio_sink = {
+                .open = audio_sink_open,
+                .write = audio_sink_write,
+                .close = audio_sink_close,
+                .ctx = handle,
+            };
+            audio_element_set_write_cb(handle->ael_decoder, &audio_sink);
+        }
     }
 
-    if (handle->source_ops->async_mode) {
+    if (media_player_source_async(handle)) {
         OS_LOGD(TAG, "[1.2] Create source element, async mode, ringbuf size: %d", handle->source_ops->buffer_size);
         audio_element_set_input_ringbuf(handle->ael_decoder, handle->media_source_info.out_ringbuf);
+        // a worker doesn't wait for network, decode task is retried a bit later
+        if (handle->executor != NULL)
+            audio_element_set_input_timeout(handle->ael_decoder, DEFAULT_MEDIA_EXECUTOR_INPUT_TIMEOUT_MS);
         handle->media_source_info.content_pos = handle->media_codec_info.content_pos + handle->seek_offset;
         handle->media_source_handle =
             media_source_start_async(&handle->media_source_info, media_source_state_callback, handle);
@@ -477,7 +1451,7 @@ static int main_pipeline_init(liteplayer_handle_t handle)
     } else {
         OS_LOGD(TAG, "[1.2] Create source element, sync mode, ringbuf size: %d", handle->source_ops->buffer_size);
         handle->source_buffer_size = handle->source_ops->buffer_size;
-        handle->source_buffer_addr = audio_malloc(handle->source_buffer_size);
+        handle->source_buffer_addr = media_arena_malloc(handle->arena, handle->source_buffer_size);
         AUDIO_MEM_CHECK(TAG, handle->source_buffer_addr, return ESP_FAIL);
         stream_callback_t audio_source = {
             .open = audio_source_open,
@@ -488,94 +1462,287 @@ static int main_pipeline_init(liteplayer_handle_t handle)
         audio_element_set_read_cb(handle->ael_decoder, &audio_source);
     }
 
-    {
-        OS_LOGD(TAG, "[2.0] Register event callback of decoder elements");
-        audio_element_set_event_callback(handle->ael_decoder, audio_element_state_callback, handle);
-    }
+    {
+        OS_LOGD(TAG, "[2.0] Register event callback of decoder elements");
+        audio_element_set_event_callback(handle->ael_decoder, audio_element_state_callback, handle);
+        audio_element_set_stats(handle->ael_decoder, handle->stats);
+        audio_element_set_process_batch(handle->ael_decoder, DEFAULT_MEDIA_DECODER_TASK_FRAMES);
+    }
+
+    if (media_player_inline(handle)) {
+        OS_LOGD(TAG, "[3.0] Run decoder element inline");
+        if (audio_element_run_inline(handle->ael_decoder) != 0)
+            return ESP_FAIL;
+    } else {
+        OS_LOGD(TAG, "[3.0] Run decoder element");
+        if (audio_element_run(handle->ael_decoder) != 0)
+            return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+liteplayer_handle_t liteplayer_create()
+{
+    liteplayer_handle_t handle = audio_calloc(1, sizeof(struct liteplayer));
+    if (handle != NULL) {
+        handle->state = LITEPLAYER_IDLE;
+        handle->io_lock = os_mutex_create();
+        handle->state_lock = os_mutex_create();
+        handle->sink_cond = os_cond_create();
+        handle->exec_lock = os_mutex_create();
+        handle->exec_cond = os_cond_create();
+        handle->adapter_handle = liteplayer_adapter_init();
+        handle->stats = media_stats_create();
+        handle->volume = volume_create();
+        handle->dsp_chain = dsp_chain_create();
+        if (handle->io_lock == NULL || handle->state_lock == NULL ||
+            handle->sink_cond == NULL || handle->exec_lock == NULL ||
+            handle->exec_cond == NULL || handle->adapter_handle == NULL ||
+            handle->stats == NULL || handle->volume == NULL || handle->dsp_chain == NULL) {
+            goto create_fail;
+        }
+    }
+    return handle;
+
+create_fail:
+    if (handle->io_lock != NULL)
+        os_mutex_destroy(handle->io_lock);
+    if (handle->state_lock != NULL)
+        os_mutex_destroy(handle->state_lock);
+    if (handle->sink_cond != NULL)
+        os_cond_destroy(handle->sink_cond);
+    if (handle->exec_lock != NULL)
+        os_mutex_destroy(handle->exec_lock);
+    if (handle->exec_cond != NULL)
+        os_cond_destroy(handle->exec_cond);
+    if (handle->adapter_handle != NULL)
+        handle->adapter_handle->destory(handle->adapter_handle);
+    media_stats_destroy(handle->stats);
+    volume_destroy(handle->volume);
+    dsp_chain_destroy(handle->dsp_chain);
+    audio_free(handle);
+    return NULL;
+}
+
+int liteplayer_register_source_wrapper(liteplayer_handle_t handle, struct source_wrapper *wrapper)
+{
+    if (handle == NULL || wrapper == NULL)
+        return ESP_FAIL;
+
+    os_mutex_lock(handle->io_lock);
+    if (handle->state != LITEPLAYER_IDLE) {
+        OS_LOGE(TAG, "Can't register source wrapper in state=[%d]", handle->state);
+        os_mutex_unlock(handle->io_lock);
+        return ESP_FAIL;
+    }
+    int ret = handle->adapter_handle->add_source_wrapper(handle->adapter_handle, wrapper);
+    os_mutex_unlock(handle->io_lock);
+    return ret;
+}
+
+int liteplayer_register_sink_wrapper(liteplayer_handle_t handle, struct sink_wrapper *wrapper)
+{
+    if (handle == NULL || wrapper == NULL)
+        return ESP_FAIL;
+
+    os_mutex_lock(handle->io_lock);
+    if (handle->state != LITEPLAYER_IDLE) {
+        OS_LOGE(TAG, "Can't register sink wrapper in state=[%d]", handle->state);
+        os_mutex_unlock(handle->io_lock);
+        return ESP_FAIL;
+    }
+    int ret = handle->adapter_handle->add_sink_wrapper(handle->adapter_handle, wrapper);
+    os_mutex_unlock(handle->io_lock);
+    return ret;
+}
+
+int liteplayer_register_state_listener(liteplayer_handle_t handle, liteplayer_state_cb listener, void *listener_priv)
+{
+    if (handle == NULL || listener == NULL)
+        return ESP_FAIL;
+
+    os_mutex_lock(handle->io_lock);
+    if (handle->state != LITEPLAYER_IDLE) {
+        OS_LOGE(TAG, "Can't set listener in state=[%d]", handle->state);
+        os_mutex_unlock(handle->io_lock);
+        return ESP_FAIL;
+    }
+    handle->state_listener = listener;
+    handle->state_userdata = listener_priv;
+    os_mutex_unlock(handle->io_lock);
+    return ESP_OK;
+}
+
+int liteplayer_set_executor(liteplayer_handle_t handle, struct executor *executor)
+{
+    if (handle == NULL)
+        return ESP_FAIL;
+
+    os_mutex_lock(handle->io_lock);
+    if (handle->state != LITEPLAYER_IDLE) {
+        OS_LOGE(TAG, "Can't set executor in state=[%d]", handle->state);
+        os_mutex_unlock(handle->io_lock);
+        return ESP_FAIL;
+    }
+    handle->executor = executor;
+    os_mutex_unlock(handle->io_lock);
+    return ESP_OK;
+}
+
+int liteplayer_set_output_latency_ms(liteplayer_handle_t handle, int latency_ms)
+{
+    if (handle == NULL || latency_ms < 0)
+        return ESP_FAIL;
 
-    {
-        OS_LOGD(TAG, "[3.0] Run decoder element");
-        if (audio_element_run(handle->ael_decoder) != 0)
-            return ESP_FAIL;
+    os_mutex_lock(handle->io_lock);
+    if (handle->state != LITEPLAYER_IDLE) {
+        OS_LOGE(TAG, "Can't set output latency in state=[%d]", handle->state);
+        os_mutex_unlock(handle->io_lock);
+        return ESP_FAIL;
     }
-
+    handle->sink_latency_ms = latency_ms;
+    os_mutex_unlock(handle->io_lock);
     return ESP_OK;
 }
 
-liteplayer_handle_t liteplayer_create()
+int liteplayer_set_output_samplerate(liteplayer_handle_t handle, int samplerate)
 {
-    liteplayer_handle_t handle = audio_calloc(1, sizeof(struct liteplayer));
-    if (handle != NULL) {
-        handle->state = LITEPLAYER_IDLE;
-        handle->io_lock = os_mutex_create();
-        handle->state_lock = os_mutex_create();
-        handle->adapter_handle = liteplayer_adapter_init();
-        if (handle->io_lock == NULL || handle->state_lock == NULL || handle->adapter_handle == NULL) {
-            goto create_fail;
-        }
+    if (handle == NULL || samplerate < 0)
+        return ESP_FAIL;
+
+    os_mutex_lock(handle->io_lock);
+    if (handle->state != LITEPLAYER_IDLE) {
+        OS_LOGE(TAG, "Can't set output samplerate in state=[%d]", handle->state);
+        os_mutex_unlock(handle->io_lock);
+        return ESP_FAIL;
     }
-    return handle;
+    handle->output_samplerate = samplerate;
+    os_mutex_unlock(handle->io_lock);
+    return ESP_OK;
+}
 
-create_fail:
-    if (handle->io_lock != NULL)
-        os_mutex_destroy(handle->io_lock);
-    if (handle->state_lock != NULL)
-        os_mutex_destroy(handle->state_lock);
-    if (handle->adapter_handle != NULL)
-        handle->adapter_handle->destory(handle->adapter_handle);
-    audio_free(handle);
-    return NULL;
+int liteplayer_set_output_channels(liteplayer_handle_t handle, int channels)
+{
+    if (handle == NULL || channels < 0 || channels > 2)
+        return ESP_FAIL;
+
+    os_mutex_lock(handle->io_lock);
+    if (handle->state != LITEPLAYER_IDLE) {
+        OS_LOGE(TAG, "Can't set output channels in state=[%d]", handle->state);
+        os_mutex_unlock(handle->io_lock);
+        return ESP_FAIL;
+    }
+    handle->output_channels = channels;
+    os_mutex_unlock(handle->io_lock);
+    return ESP_OK;
 }
 
-int liteplayer_register_source_wrapper(liteplayer_handle_t handle, struct source_wrapper *wrapper)
+int liteplayer_set_aac_plus(liteplayer_handle_t handle, bool enabled)
 {
-    if (handle == NULL || wrapper == NULL)
+    if (handle == NULL)
+        return ESP_FAIL;
+#if !defined(LITEPLAYER_CONFIG_AAC_PLUS)
+    if (enabled) {
+        OS_LOGE(TAG, "Can't enable aac plus, not built with LITEPLAYER_CONFIG_AAC_PLUS");
         return ESP_FAIL;
+    }
+#endif
 
     os_mutex_lock(handle->io_lock);
     if (handle->state != LITEPLAYER_IDLE) {
-        OS_LOGE(TAG, "Can't register source wrapper in state=[%d]", handle->state);
+        OS_LOGE(TAG, "Can't set aac plus in state=[%d]", handle->state);
         os_mutex_unlock(handle->io_lock);
         return ESP_FAIL;
     }
-    int ret = handle->adapter_handle->add_source_wrapper(handle->adapter_handle, wrapper);
+    handle->aac_plus_disabled = !enabled;
     os_mutex_unlock(handle->io_lock);
-    return ret;
+    return ESP_OK;
 }
 
-int liteplayer_register_sink_wrapper(liteplayer_handle_t handle, struct sink_wrapper *wrapper)
+int liteplayer_set_hls_prefetch(liteplayer_handle_t handle, int segments, int cache_size)
 {
-    if (handle == NULL || wrapper == NULL)
+    if (handle == NULL || segments < 0 || cache_size < 0)
         return ESP_FAIL;
 
     os_mutex_lock(handle->io_lock);
     if (handle->state != LITEPLAYER_IDLE) {
-        OS_LOGE(TAG, "Can't register sink wrapper in state=[%d]", handle->state);
+        OS_LOGE(TAG, "Can't set hls prefetch in state=[%d]", handle->state);
         os_mutex_unlock(handle->io_lock);
         return ESP_FAIL;
     }
-    int ret = handle->adapter_handle->add_sink_wrapper(handle->adapter_handle, wrapper);
+    handle->prefetch_segments = segments;
+    handle->prefetch_cache_size = cache_size;
     os_mutex_unlock(handle->io_lock);
-    return ret;
+    return ESP_OK;
 }
 
-int liteplayer_register_state_listener(liteplayer_handle_t handle, liteplayer_state_cb listener, void *listener_priv)
+int liteplayer_set_arena_size(liteplayer_handle_t handle, int size)
 {
-    if (handle == NULL || listener == NULL)
+    if (handle == NULL || size < 0)
         return ESP_FAIL;
 
     os_mutex_lock(handle->io_lock);
     if (handle->state != LITEPLAYER_IDLE) {
-        OS_LOGE(TAG, "Can't set listener in state=[%d]", handle->state);
+        OS_LOGE(TAG, "Can't set arena size in state=[%d]", handle->state);
         os_mutex_unlock(handle->io_lock);
         return ESP_FAIL;
     }
-    handle->state_listener = listener;
-    handle->state_userdata = listener_priv;
+    media_arena_destroy(handle->arena);
+    handle->arena = NULL;
+    if (size > 0) {
+        handle->arena = media_arena_create(size);
+        if (handle->arena == NULL) {
+            OS_LOGE(TAG, "Failed to create arena, size:%d", size);
+            os_mutex_unlock(handle->io_lock);
+            return ESP_FAIL;
+        }
+    }
     os_mutex_unlock(handle->io_lock);
     return ESP_OK;
 }
 
+int liteplayer_set_volume(liteplayer_handle_t handle, float gain, int ramp_ms)
+{
+    if (handle == NULL || !(gain >= 0.0f && gain <= 1.0f) || ramp_ms < 0)
+        return ESP_FAIL;
+
+    OS_LOGD(TAG, "Set player volume: gain=%.3f, ramp=%dms", gain, ramp_ms);
+    volume_set_gain(handle->volume, gain, ramp_ms);
+    return ESP_OK;
+}
+
+int liteplayer_insert_dsp(liteplayer_handle_t handle, int index, struct dsp_wrapper *dsp)
+{
+    if (handle == NULL || dsp == NULL || dsp->name == NULL ||
+        dsp->open == NULL || dsp->process == NULL || dsp->close == NULL)
+        return ESP_FAIL;
+
+    OS_LOGD(TAG, "Insert dsp: name=%s, index=%d", dsp->name(), index);
+    return dsp_chain_insert(handle->dsp_chain, index, dsp) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+int liteplayer_remove_dsp(liteplayer_handle_t handle, struct dsp_wrapper *dsp)
+{
+    if (handle == NULL || dsp == NULL)
+        return ESP_FAIL;
+    return dsp_chain_remove(handle->dsp_chain, dsp) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+int liteplayer_move_dsp(liteplayer_handle_t handle, struct dsp_wrapper *dsp, int index)
+{
+    if (handle == NULL || dsp == NULL)
+        return ESP_FAIL;
+    return dsp_chain_move(handle->dsp_chain, dsp, index) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+int liteplayer_bypass_dsp(liteplayer_handle_t handle, struct dsp_wrapper *dsp, bool bypass)
+{
+    if (handle == NULL || dsp == NULL)
+        return ESP_FAIL;
+    return dsp_chain_bypass(handle->dsp_chain, dsp, bypass) == 0 ? ESP_OK : ESP_FAIL;
+}
+
 int liteplayer_set_data_source(liteplayer_handle_t handle, const char *url)
 {
     if (handle == NULL || url == NULL)
@@ -607,12 +1774,20 @@ int liteplayer_set_data_source(liteplayer_handle_t handle, const char *url)
             handle->source_ops->url_protocol(), handle->sink_ops->name());
 
     handle->state_error = false;
-    handle->url = audio_strdup(url);
+    handle->url = media_arena_strdup(handle->arena, url);
     AUDIO_MEM_CHECK(TAG, handle->url, goto set_fail);
 
     handle->media_source_info.url = handle->url;
     handle->media_source_info.source_ops = handle->source_ops;
-    handle->media_source_info.out_ringbuf = rb_create(handle->source_ops->buffer_size);
+    handle->media_source_info.stats = handle->stats;
+    handle->media_source_info.arena = handle->arena;
+    handle->media_source_info.prefetch_segments = handle->prefetch_segments;
+    handle->media_source_info.prefetch_cache_size = handle->prefetch_cache_size;
+#if defined(LITEPLAYER_CONFIG_AAC_PLUS)
+    handle->media_source_info.aac_plus = !handle->aac_plus_disabled;
+#endif
+    media_stats_reset(handle->stats);
+    handle->media_source_info.out_ringbuf = media_player_create_source_ringbuf(handle);
     AUDIO_MEM_CHECK(TAG, handle->media_source_info.out_ringbuf, goto set_fail);
 
     {
@@ -626,12 +1801,9 @@ int liteplayer_set_data_source(liteplayer_handle_t handle, const char *url)
     return ESP_OK;
 
 set_fail:
-    if (handle->media_source_info.out_ringbuf != NULL) {
-        rb_destroy(handle->media_source_info.out_ringbuf);
-        handle->media_source_info.out_ringbuf = NULL;
-    }
+    media_player_destroy_source_ringbuf(handle);
     if (handle->url != NULL) {
-        audio_free(handle->url);
+        media_arena_free(handle->arena, (char *)handle->url);
         handle->url = NULL;
     }
     os_mutex_unlock(handle->io_lock);
@@ -684,7 +1856,21 @@ int liteplayer_prepare_async(liteplayer_handle_t handle)
     }
 
     int ret = ESP_OK;
-    if (handle->source_ops->async_mode) {
+    if (handle->executor != NULL && !handle->source_ops->async_mode) {
+        ret = media_player_exec_submit(handle, media_player_parse_task);
+        if (ret != ESP_OK) {
+            os_mutex_lock(handle->state_lock);
+            handle->state = LITEPLAYER_ERROR;
+            media_player_state_callback(handle, LITEPLAYER_ERROR, ret);
+            os_mutex_unlock(handle->state_lock);
+        }
+    } else if (handle->source_ops->async_mode) {
+        if (handle->media_parser_handle != NULL) {
+            // still INITED till the parser reports, don't leak the running parser
+            OS_LOGE(TAG, "Already preparing");
+            os_mutex_unlock(handle->io_lock);
+            return ESP_FAIL;
+        }
         handle->media_parser_handle = media_parser_start_async(&handle->media_source_info,
                                                                media_parser_state_callback,
                                                                handle);
@@ -733,6 +1919,9 @@ int liteplayer_start(liteplayer_handle_t handle)
 
     int ret = ESP_OK;
 
+    // parse task may be retiring after reporting prepared
+    media_player_exec_halt(handle);
+
     if (handle->state == LITEPLAYER_PREPARED) {
         if (handle->ael_decoder == NULL)
             ret = main_pipeline_init(handle);
@@ -740,16 +1929,34 @@ int liteplayer_start(liteplayer_handle_t handle)
         if (handle->ael_decoder == NULL)
             ret = ESP_FAIL;
     }
-    if (ret == ESP_OK)
-        ret = audio_element_resume(handle->ael_decoder, 0, 0);
+
+    media_player_set_starting(handle);
+    volume_fade_in(handle->volume, DEFAULT_MEDIA_VOLUME_FADE_MS);
+    if (ret == ESP_OK) {
+        if (handle->executor != NULL) {
+            ret = audio_element_resume_inline(handle->ael_decoder);
+        } else {
+            ret = audio_element_resume(handle->ael_decoder, 0, 0);
+        }
+    }
 
     {
         os_mutex_lock(handle->state_lock);
         handle->state = (ret == ESP_OK) ? LITEPLAYER_STARTED : LITEPLAYER_ERROR;
         media_player_state_callback(handle, handle->state, ret);
+        if (handle->state_finished && handle->state == LITEPLAYER_STARTED) {
+            handle->state = LITEPLAYER_COMPLETED;
+            media_player_state_callback(handle, LITEPLAYER_COMPLETED, 0);
+        }
+        handle->state_starting = false;
+        handle->state_finished = false;
         os_mutex_unlock(handle->state_lock);
     }
 
+    // decode task is scheduled once in STARTED state, it may finish immediately
+    if (ret == ESP_OK && handle->executor != NULL)
+        ret = media_player_exec_start(handle);
+
     os_mutex_unlock(handle->io_lock);
     return ret;
 }
@@ -763,13 +1970,21 @@ int liteplayer_pause(liteplayer_handle_t handle)
 
     os_mutex_lock(handle->io_lock);
 
-    if (handle->state != LITEPLAYER_STARTED) {
+    if (handle->state != LITEPLAYER_STARTED || handle->pcm_reader) {
         OS_LOGE(TAG, "Can't pause in state=[%d]", handle->state);
         os_mutex_unlock(handle->io_lock);
         return ESP_FAIL;
     }
 
-    int ret = audio_element_pause(handle->ael_decoder);
+    media_player_fade_out(handle);
+
+    int ret = ESP_OK;
+    if (handle->executor != NULL) {
+        media_player_exec_halt(handle);
+        ret = audio_element_pause_inline(handle->ael_decoder);
+    } else {
+        ret = audio_element_pause(handle->ael_decoder);
+    }
 
     {
         os_mutex_lock(handle->state_lock);
@@ -791,21 +2006,39 @@ int liteplayer_resume(liteplayer_handle_t handle)
 
     os_mutex_lock(handle->io_lock);
 
-    if (handle->state != LITEPLAYER_PAUSED && handle->state != LITEPLAYER_SEEKCOMPLETED) {
+    if ((handle->state != LITEPLAYER_PAUSED && handle->state != LITEPLAYER_SEEKCOMPLETED) || handle->pcm_reader) {
         OS_LOGE(TAG, "Can't resume in state=[%d]", handle->state);
         os_mutex_unlock(handle->io_lock);
         return ESP_FAIL;
     }
 
-    int ret = audio_element_resume(handle->ael_decoder, 0, 0);
+    media_player_set_starting(handle);
+    volume_fade_in(handle->volume, DEFAULT_MEDIA_VOLUME_FADE_MS);
+
+    int ret = ESP_OK;
+    if (handle->executor != NULL) {
+        ret = audio_element_resume_inline(handle->ael_decoder);
+    } else {
+        ret = audio_element_resume(handle->ael_decoder, 0, 0);
+    }
 
     {
         os_mutex_lock(handle->state_lock);
         handle->state = (ret == ESP_OK) ? LITEPLAYER_STARTED : LITEPLAYER_ERROR;
         media_player_state_callback(handle, handle->state, ret);
+        if (handle->state_finished && handle->state == LITEPLAYER_STARTED) {
+            handle->state = LITEPLAYER_COMPLETED;
+            media_player_state_callback(handle, LITEPLAYER_COMPLETED, 0);
+        }
+        handle->state_starting = false;
+        handle->state_finished = false;
         os_mutex_unlock(handle->state_lock);
     }
 
+    // decode task is scheduled once in STARTED state, it may finish immediately
+    if (ret == ESP_OK && handle->executor != NULL)
+        ret = media_player_exec_start(handle);
+
     os_mutex_unlock(handle->io_lock);
     return ret;
 }
@@ -819,6 +2052,8 @@ int liteplayer_seek(liteplayer_handle_t handle, int msec)
 
     int ret = ESP_FAIL;
     bool state_sync = false;
+    bool faded = false;
+    LITEPLAYER_TRACE_BEGIN(trace);
 
     os_mutex_lock(handle->io_lock);
 
@@ -834,6 +2069,11 @@ int liteplayer_seek(liteplayer_handle_t handle, int msec)
         goto seek_out;
     }
 
+    faded = media_player_fade_out(handle);
+
+    // decode task must not run while the decoder is being seeked
+    media_player_exec_halt(handle);
+
     long long offset = media_parser_get_seek_offset(&handle->media_codec_info, msec);
     if (offset < 0) {
         ret = ESP_OK;
@@ -842,7 +2082,9 @@ int liteplayer_seek(liteplayer_handle_t handle, int msec)
 
     handle->seek_time = (msec/1000)*1000;
     handle->seek_offset = offset;
-    handle->sink_position = 0;
+    ATOMIC_STORE(handle->sink_position, 0);
+    handle->sink_flush = true;
+    handle->trim_inited = false;
 
     state_sync = true;
 
@@ -851,6 +2093,42 @@ int liteplayer_seek(liteplayer_handle_t handle, int msec)
         handle->media_parser_handle = NULL;
     }
 
+    if (handle->executor != NULL) {
+        if (handle->ael_decoder == NULL) {
+            ret = main_pipeline_init(handle);
+            if (ret != ESP_OK)
+                goto seek_out;
+        }
+    }
+
+    if (media_player_inline(handle)) {
+        if (handle->media_source_handle != NULL) {
+            media_source_stop(handle->media_source_handle);
+            handle->media_source_handle = NULL;
+            rb_reset(handle->media_source_info.out_ringbuf);
+            handle->media_source_info.source_handle = NULL;
+            handle->media_source_info.content_pos = handle->media_codec_info.content_pos + handle->seek_offset;
+            handle->media_source_handle =
+                media_source_start_async(&handle->media_source_info, media_source_state_callback, handle);
+            if (handle->media_source_handle == NULL) {
+                OS_LOGE(TAG, "Failed to restart source");
+                ret = ESP_FAIL;
+                goto seek_out;
+            }
+        } else if (!media_player_reuse_source(handle, handle->media_codec_info.content_pos + handle->seek_offset)) {
+            if (handle->media_source_info.source_handle != NULL) {
+                OS_LOGI(TAG, "Closing source");
+                handle->source_ops->close(handle->media_source_info.source_handle);
+                handle->media_source_info.source_handle = NULL;
+            }
+            rb_reset(handle->media_source_info.out_ringbuf);
+        }
+        handle->pcm_filled = 0;
+        handle->pcm_offset = 0;
+        ret = audio_element_seek_inline(handle->ael_decoder, handle->seek_offset);
+        goto seek_out;
+    }
+
     if (handle->ael_decoder == NULL) {
         ret = main_pipeline_init(handle);
         if (ret != ESP_OK)
@@ -863,14 +2141,16 @@ int liteplayer_seek(liteplayer_handle_t handle, int msec)
         if (handle->media_source_handle != NULL) {
             media_source_stop(handle->media_source_handle);
             handle->media_source_handle = NULL;
-        } else if (handle->media_source_info.source_handle != NULL) {
-            OS_LOGI(TAG, "Closing source");
-            handle->source_ops->close(handle->media_source_info.source_handle);
-            handle->media_source_info.source_handle = NULL;
+            rb_reset(handle->media_source_info.out_ringbuf);
+        } else if (!media_player_reuse_source(handle, handle->media_codec_info.content_pos + handle->seek_offset)) {
+            if (handle->media_source_info.source_handle != NULL) {
+                OS_LOGI(TAG, "Closing source");
+                handle->source_ops->close(handle->media_source_info.source_handle);
+                handle->media_source_info.source_handle = NULL;
+            }
+            rb_reset(handle->media_source_info.out_ringbuf);
         }
 
-        rb_reset(handle->media_source_info.out_ringbuf);
-
         if (handle->source_ops->async_mode) {
             handle->media_source_info.source_handle = NULL;
             handle->media_source_info.content_pos = handle->media_codec_info.content_pos + handle->seek_offset;
@@ -898,9 +2178,16 @@ seek_out:
         handle->state = (ret == ESP_OK) ? LITEPLAYER_SEEKCOMPLETED : LITEPLAYER_ERROR;
         media_player_state_callback(handle, handle->state, ret);
         os_mutex_unlock(handle->state_lock);
+    } else {
+        // seek is ignored, keep playing
+        if (faded)
+            volume_fade_in(handle->volume, DEFAULT_MEDIA_VOLUME_FADE_MS);
+        if (handle->executor != NULL && handle->state == LITEPLAYER_STARTED)
+            media_player_exec_start(handle);
     }
 
     os_mutex_unlock(handle->io_lock);
+    LITEPLAYER_TRACE_END(trace, "seek");
     return ret;
 }
 
@@ -924,6 +2211,22 @@ int liteplayer_stop(liteplayer_handle_t handle)
         return ESP_FAIL;
     }
 
+    if (handle->pcm_reader) {
+        ret = audio_element_stop_inline(handle->ael_decoder);
+        goto stop_out;
+    }
+
+    media_player_fade_out(handle);
+
+    if (handle->executor != NULL) {
+        media_player_abort_sink(handle);
+        media_player_exec_halt(handle);
+        ret = audio_element_stop_inline(handle->ael_decoder);
+        goto stop_out;
+    }
+
+    media_player_abort_sink(handle);
+
     ret = audio_element_stop(handle->ael_decoder);
     ret |= audio_element_wait_for_stop_ms(handle->ael_decoder, AUDIO_MAX_DELAY);
     audio_element_reset_state(handle->ael_decoder);
@@ -931,6 +2234,7 @@ int liteplayer_stop(liteplayer_handle_t handle)
     audio_element_reset_output_ringbuf(handle->ael_decoder);
 
 stop_out:
+    volume_reset(handle->volume);
     {
         os_mutex_lock(handle->state_lock);
         handle->state = LITEPLAYER_STOPPED;
@@ -958,20 +2262,27 @@ int liteplayer_reset(liteplayer_handle_t handle)
 
     main_pipeline_deinit(handle);
 
+    if (handle->sink_handle != NULL) {
+        // sink taken over from previous player, but never opened by decoder
+        OS_LOGI(TAG, "Closing sink");
+        handle->sink_ops->close(handle->sink_handle);
+        handle->sink_handle = NULL;
+    }
+
     if (handle->url != NULL) {
-        audio_free(handle->url);
+        media_arena_free(handle->arena, (char *)handle->url);
         handle->url = NULL;
     }
 
     if (handle->media_codec_info.codec_type == AUDIO_CODEC_M4A) {
         if (handle->media_codec_info.detail.m4a_info.stsz_samplesize != NULL)
-            audio_free(handle->media_codec_info.detail.m4a_info.stsz_samplesize);
+            media_arena_free(handle->arena, handle->media_codec_info.detail.m4a_info.stsz_samplesize);
         if (handle->media_codec_info.detail.m4a_info.stts_time2sample != NULL)
-            audio_free(handle->media_codec_info.detail.m4a_info.stts_time2sample);
+            media_arena_free(handle->arena, handle->media_codec_info.detail.m4a_info.stts_time2sample);
         if (handle->media_codec_info.detail.m4a_info.stsc_sample2chunk != NULL)
-            audio_free(handle->media_codec_info.detail.m4a_info.stsc_sample2chunk);
+            media_arena_free(handle->arena, handle->media_codec_info.detail.m4a_info.stsc_sample2chunk);
         if (handle->media_codec_info.detail.m4a_info.stco_chunk2offset != NULL)
-            audio_free(handle->media_codec_info.detail.m4a_info.stco_chunk2offset);
+            media_arena_free(handle->arena, handle->media_codec_info.detail.m4a_info.stco_chunk2offset);
     } else if (handle->media_codec_info.codec_type == AUDIO_CODEC_WAV) {
         if (handle->media_codec_info.detail.wav_info.header_buff != NULL)
             audio_free(handle->media_codec_info.detail.wav_info.header_buff);
@@ -986,10 +2297,26 @@ int liteplayer_reset(liteplayer_handle_t handle)
     handle->sink_samplerate = 0;
     handle->sink_channels = 0;
     handle->sink_bits = 0;
-    handle->sink_position = 0;
+    handle->output_bits = 0;
+    ATOMIC_STORE(handle->sink_position, 0);
     handle->sink_inited = false;
+    handle->sink_open_samplerate = 0;
+    handle->sink_open_channels = 0;
+    handle->sink_open_bits = 0;
+    handle->sink_pending = false;
+    handle->sink_abort = false;
+    handle->sink_released = false;
+    handle->sink_flush = false;
+    media_player_destroy_resampler(handle);
+    media_player_destroy_convert_buffer(handle);
+    volume_reset(handle->volume);
+    dsp_chain_close(handle->dsp_chain);
+    handle->trim_inited = false;
     handle->seek_time = 0;
     handle->seek_offset = 0;
+    handle->pcm_reader = false;
+    // everything of the data source is freed, reclaim the arena for the next one
+    media_arena_reset(handle->arena);
 
     {
         os_mutex_lock(handle->state_lock);
@@ -1009,15 +2336,157 @@ int liteplayer_reset(liteplayer_handle_t handle)
     return ESP_OK;
 }
 
+int liteplayer_open_pcm_reader(liteplayer_handle_t handle, int *samplerate, int *channels, int *bits)
+{
+    if (handle == NULL)
+        return ESP_FAIL;
+
+    OS_LOGI(TAG, "Opening pcm reader[%s]", handle->source_ops->url_protocol());
+
+    os_mutex_lock(handle->io_lock);
+
+    if (handle->state != LITEPLAYER_INITED) {
+        OS_LOGE(TAG, "Can't open pcm reader in state=[%d]", handle->state);
+        os_mutex_unlock(handle->io_lock);
+        return ESP_FAIL;
+    }
+
+    handle->pcm_reader = true;
+    int ret = media_parser_get_codec_info(&handle->media_source_info, &handle->media_codec_info);
+    if (ret == ESP_OK)
+        ret = main_pipeline_init(handle);
+
+    // Decode until the first pcm is out, so that the reported pcm format is known
+    while (ret == ESP_OK && handle->pcm_filled == 0) {
+        int process_len = audio_element_process_inline(handle->ael_decoder);
+        if (process_len == AEL_IO_DONE)
+            break;
+        if (process_len < 0 && process_len != AEL_IO_TIMEOUT)
+            ret = ESP_FAIL;
+    }
+
+    if (ret == ESP_OK) {
+        if (samplerate != NULL)
+            *samplerate = handle->sink_samplerate;
+        if (channels != NULL)
+            *channels = handle->sink_channels;
+        if (bits != NULL)
+            *bits = handle->sink_bits;
+    }
+
+    {
+        os_mutex_lock(handle->state_lock);
+        if (ret != ESP_OK)
+            handle->state = LITEPLAYER_ERROR;
+        else if (handle->state != LITEPLAYER_COMPLETED)
+            handle->state = LITEPLAYER_STARTED;
+        media_player_state_callback(handle, handle->state, ret);
+        os_mutex_unlock(handle->state_lock);
+    }
+
+    os_mutex_unlock(handle->io_lock);
+    return ret;
+}
+
+int liteplayer_read_pcm(liteplayer_handle_t handle, char *buf, int frames)
+{
+    if (handle == NULL || buf == NULL || frames <= 0)
+        return ESP_FAIL;
+
+    os_mutex_lock(handle->io_lock);
+
+    if (!handle->pcm_reader ||
+        (handle->state != LITEPLAYER_STARTED &&
+         handle->state != LITEPLAYER_SEEKCOMPLETED &&
+         handle->state != LITEPLAYER_COMPLETED)) {
+        OS_LOGE(TAG, "Can't read pcm in state=[%d]", handle->state);
+        os_mutex_unlock(handle->io_lock);
+        return ESP_FAIL;
+    }
+
+    int frame_size = handle->sink_channels * handle->sink_bits / 8;
+    int bytes_want = frames * frame_size;
+    int bytes_read = 0;
+    int ret = ESP_OK;
+
+    while (bytes_read < bytes_want) {
+        if (handle->pcm_offset < handle->pcm_filled) {
+            int bytes = handle->pcm_filled - handle->pcm_offset;
+            if (bytes > bytes_want - bytes_read)
+                bytes = bytes_want - bytes_read;
+            memcpy(buf + bytes_read, handle->pcm_buffer + handle->pcm_offset, bytes);
+            handle->pcm_offset += bytes;
+            bytes_read += bytes;
+            continue;
+        }
+
+        handle->pcm_filled = 0;
+        handle->pcm_offset = 0;
+        int process_len = audio_element_process_inline(handle->ael_decoder);
+        if (process_len == AEL_IO_DONE)
+            break;
+        if (process_len < 0 && process_len != AEL_IO_TIMEOUT) {
+            ret = ESP_FAIL;
+            break;
+        }
+    }
+
+    ATOMIC_FETCH_ADD(handle->sink_position, bytes_read);
+    os_mutex_unlock(handle->io_lock);
+    if (ret != ESP_OK && bytes_read == 0)
+        return ESP_FAIL;
+    return bytes_read / frame_size;
+}
+
+int liteplayer_set_next_player(liteplayer_handle_t handle, liteplayer_handle_t next)
+{
+    if (handle == NULL || next == handle)
+        return ESP_FAIL;
+
+    if (next != NULL) {
+        os_mutex_lock(next->io_lock);
+        if (next->state > LITEPLAYER_PREPARED || media_player_inline(next)) {
+            OS_LOGE(TAG, "Can't set next player in state=[%d]", next->state);
+            os_mutex_unlock(next->io_lock);
+            return ESP_FAIL;
+        }
+        os_mutex_unlock(next->io_lock);
+    }
+
+    int ret = ESP_OK;
+    os_mutex_lock(handle->state_lock);
+    if (handle->next_player != NULL) {
+        // release the previous one, it opens its own sink if waiting
+        os_mutex_lock(handle->next_player->state_lock);
+        handle->next_player->sink_pending = false;
+        os_cond_signal(handle->next_player->sink_cond);
+        os_mutex_unlock(handle->next_player->state_lock);
+        handle->next_player = NULL;
+    }
+    if (next != NULL) {
+        if (handle->sink_released) {
+            OS_LOGE(TAG, "Can't set next player, sink is released");
+            ret = ESP_FAIL;
+        } else {
+            os_mutex_lock(next->state_lock);
+            next->sink_pending = true;
+            os_mutex_unlock(next->state_lock);
+            handle->next_player = next;
+        }
+    }
+    os_mutex_unlock(handle->state_lock);
+    return ret;
+}
+
 int liteplayer_get_position(liteplayer_handle_t handle, int *msec)
 {
     if (handle == NULL || msec == NULL)
         return ESP_FAIL;
 
-    int samplerate = handle->sink_samplerate;
-    int channels = handle->sink_channels;
-    int bits = handle->sink_bits;
-    long long position = handle->sink_position;
+    int samplerate = media_player_output_samplerate(handle);
+    int channels = media_player_output_channels(handle);
+    int bits = handle->pcm_reader ? handle->sink_bits : handle->output_bits;
+    long long position = ATOMIC_LOAD(handle->sink_position);
     int seek_time = handle->seek_time;
 
     if (samplerate == 0 || channels == 0 || bits == 0) {
@@ -1043,6 +2512,16 @@ int liteplayer_get_duration(liteplayer_handle_t handle, int *msec)
     return ESP_OK;
 }
 
+int liteplayer_get_stats(liteplayer_handle_t handle, struct liteplayer_stats *stats)
+{
+    if (handle == NULL || stats == NULL)
+        return ESP_FAIL;
+
+    media_stats_get(handle->stats, stats);
+    media_arena_get(handle->arena, stats);
+    return ESP_OK;
+}
+
 void liteplayer_destroy(liteplayer_handle_t handle)
 {
     if (handle == NULL)
@@ -1052,7 +2531,15 @@ void liteplayer_destroy(liteplayer_handle_t handle)
         liteplayer_reset(handle);
 
     handle->adapter_handle->destory(handle->adapter_handle);
+    os_cond_destroy(handle->sink_cond);
+    os_cond_destroy(handle->exec_cond);
+    os_mutex_destroy(handle->exec_lock);
     os_mutex_destroy(handle->state_lock);
     os_mutex_destroy(handle->io_lock);
+    media_stats_destroy(handle->stats);
+    volume_destroy(handle->volume);
+    dsp_chain_destroy(handle->dsp_chain);
+    media_arena_destroy(handle->arena);
+    media_player_free_codec(handle);
     audio_free(handle);
 }
@@ -0,0 +1,554 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "osal/os_thread.h"
+#include "osal/os_time.h"
+#include "cutils/log_helper.h"
+#include "cutils/ringbuf.h"
+#include "cutils/list.h"
+#include "esp_adf/audio_common.h"
+#include "liteplayer_config.h"
+#include "liteplayer_mixer.h"
+
+#define TAG "[liteplayer]mixer"
+
+// periods buffered by each input, writing blocks when they are all filled
+#define DEFAULT_MIXER_INPUT_PERIODS ( 4 )
+
+#define MIXER_GAIN_UNITY            ( 32768 ) // Q15
+
+struct mixer_input {
+    struct mixer          *mixer;
+    struct listnode        listnode;
+    struct sink_wrapper    wrapper;
+    ringbuf_handle         ringbuf;
+    int                    channels;
+    bool                   opened;     // mixed by mixer thread
+    bool                   closing;    // close waits for the buffered pcm to be mixed
+    float                  gain;
+    float                  gain_target;
+    float                  gain_step;  // per frame
+    int                    ramp_frames;
+    short                 *pcm;        // a period of input pcm, converted to mixer channels
+};
+
+struct mixer {
+    struct mixer_cfg       cfg;
+    struct sink_wrapper    sink_ops;
+    bool                   has_sink;
+    sink_handle_t          sink_handle; // accessed by mixer thread only
+    int                    period_frames;
+    short                 *mix_buffer;
+    struct listnode        inputs;
+    os_mutex               lock;        // lock for inputs
+    os_cond                cond;        // input opened/closed/written, or input detached
+    os_thread              tid;
+    bool                   waiting;
+    bool                   exit;
+};
+
+static inline short mixer_sat16(int sample)
+{
+    if (sample > 32767)
+        return 32767;
+    if (sample < -32768)
+        return -32768;
+    return (short)sample;
+}
+
+// dst += src * gain, saturated, gain in Q15, gain of MIXER_GAIN_UNITY bypasses the multiply
+static void mixer_accumulate(short *dst, const short *src, int samples, int gain)
+{
+    int i = 0;
+    if (gain <= 0)
+        return;
+
+#if defined(__SSE2__)
+    if (gain >= MIXER_GAIN_UNITY) {
+        for (; i + 8 <= samples; i += 8) {
+            __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_adds_epi16(d, s));
+        }
+    } else {
+        const __m128i g = _mm_set1_epi16((short)gain);
+        const __m128i round = _mm_set1_epi32(1 << 14);
+        for (; i + 8 <= samples; i += 8) {
+            __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i lo = _mm_mullo_epi16(s, g);
+            __m128i hi = _mm_mulhi_epi16(s, g);
+            __m128i p0 = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), round), 15);
+            __m128i p1 = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), round), 15);
+            __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_adds_epi16(d, _mm_packs_epi32(p0, p1)));
+        }
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    if (gain >= MIXER_GAIN_UNITY) {
+        for (; i + 8 <= samples; i += 8)
+            vst1q_s16(dst + i, vqaddq_s16(vld1q_s16(dst + i), vld1q_s16(src + i)));
+    } else {
+        for (; i + 8 <= samples; i += 8) {
+            int16x8_t s = vqrdmulhq_n_s16(vld1q_s16(src + i), (short)gain);
+            vst1q_s16(dst + i, vqaddq_s16(vld1q_s16(dst + i), s));
+        }
+    }
+#endif
+
+    if (gain >= MIXER_GAIN_UNITY) {
+        for (; i < samples; i++)
+            dst[i] = mixer_sat16(dst[i] + src[i]);
+    } else {
+        for (; i < samples; i++)
+            dst[i] = mixer_sat16(dst[i] + ((src[i] * gain + (1 << 14)) >> 15));
+    }
+}
+
+static inline int mixer_gain_q15(float gain)
+{
+    return (int)(gain * MIXER_GAIN_UNITY + 0.5f);
+}
+
+static void mixer_input_mix(struct mixer_input *input, short *dst, int frames, int channels)
+{
+    const short *src = input->pcm;
+    int i = 0;
+
+    // gain is stepped per frame while ramping
+    for (; i < frames && input->ramp_frames > 0; i++) {
+        input->ramp_frames--;
+        input->gain = input->ramp_frames > 0 ? input->gain + input->gain_step : input->gain_target;
+        int gain = mixer_gain_q15(input->gain);
+        for (int ch = 0; ch < channels; ch++) {
+            int idx = i*channels + ch;
+            dst[idx] = mixer_sat16(dst[idx] + ((src[idx] * gain + (1 << 14)) >> 15));
+        }
+    }
+
+    if (i < frames)
+        mixer_accumulate(dst + i*channels, src + i*channels, (frames - i)*channels, mixer_gain_q15(input->gain));
+}
+
+// convert in place, input->pcm holds a period of the larger channel count
+static void mixer_input_convert(struct mixer_input *input, int frames, int channels)
+{
+    short *pcm = input->pcm;
+    if (input->channels == 1 && channels == 2) {
+        for (int i = frames - 1; i >= 0; i--)
+            pcm[2*i] = pcm[2*i + 1] = pcm[i];
+    } else if (input->channels == 2 && channels == 1) {
+        for (int i = 0; i < frames; i++)
+            pcm[i] = (short)((pcm[2*i] + pcm[2*i + 1]) >> 1);
+    }
+}
+
+// all opened inputs have a full period buffered, or are closing
+static bool mixer_inputs_ready(struct mixer *mixer)
+{
+    struct listnode *item;
+    list_for_each(item, &mixer->inputs) {
+        struct mixer_input *input = listnode_to_item(item, struct mixer_input, listnode);
+        if (input->opened && !input->closing &&
+            rb_bytes_filled(input->ringbuf) < mixer->period_frames * input->channels * (int)sizeof(short))
+            return false;
+    }
+    return true;
+}
+
+static bool mixer_inputs_opened(struct mixer *mixer)
+{
+    struct listnode *item;
+    list_for_each(item, &mixer->inputs) {
+        struct mixer_input *input = listnode_to_item(item, struct mixer_input, listnode);
+        if (input->opened)
+            return true;
+    }
+    return false;
+}
+
+// returns frames mixed into mix_buffer
+static int mixer_mix_inputs(struct mixer *mixer)
+{
+    int channels = mixer->cfg.channels;
+    int frames_mixed = 0;
+    struct listnode *item;
+
+    memset(mixer->mix_buffer, 0x0, mixer->period_frames * channels * sizeof(short));
+
+    list_for_each(item, &mixer->inputs) {
+        struct mixer_input *input = listnode_to_item(item, struct mixer_input, listnode);
+        if (!input->opened)
+            continue;
+
+        int frame_size = input->channels * sizeof(short);
+        int bytes = rb_bytes_filled(input->ringbuf);
+        if (bytes > mixer->period_frames * frame_size)
+            bytes = mixer->period_frames * frame_size;
+        bytes -= bytes % frame_size;
+        if (bytes == 0) {
+            if (input->closing) {
+                input->opened = false;
+                os_cond_broadcast(mixer->cond);
+            }
+            continue;
+        }
+
+        if (rb_read(input->ringbuf, (char *)input->pcm, bytes, 0) != bytes) {
+            OS_LOGE(TAG, "Failed to read input ringbuf");
+            continue;
+        }
+        int frames = bytes / frame_size;
+        mixer_input_convert(input, frames, channels);
+        mixer_input_mix(input, mixer->mix_buffer, frames, channels);
+        if (frames > frames_mixed)
+            frames_mixed = frames;
+    }
+
+    return frames_mixed;
+}
+
+static void mixer_write_sink(struct mixer *mixer, int frames)
+{
+    if (mixer->sink_handle == NULL) {
+        OS_LOGI(TAG, "Opening sink: rate:%d, channels:%d, bits:16", mixer->cfg.samplerate, mixer->cfg.channels);
+        mixer->sink_handle = mixer->sink_ops.open(mixer->cfg.samplerate, mixer->cfg.channels, 16,
+                                                  mixer->sink_ops.priv_data);
+        if (mixer->sink_handle == NULL) {
+            OS_LOGE(TAG, "Failed to open sink");
+            os_thread_sleep_msec(mixer->cfg.period_ms); // pcm is dropped, keep inputs paced
+            return;
+        }
+    }
+
+    char *pcm = (char *)mixer->mix_buffer;
+    int remain = frames * mixer->cfg.channels * sizeof(short);
+    while (remain > 0) {
+        int bytes_written = mixer->sink_ops.write(mixer->sink_handle, pcm, remain);
+        if (bytes_written <= 0 || bytes_written > remain) {
+            OS_LOGE(TAG, "Failed to write pcm, ret:%d", bytes_written);
+            break;
+        }
+        pcm += bytes_written;
+        remain -= bytes_written;
+    }
+}
+
+static void mixer_close_sink(struct mixer *mixer)
+{
+    if (mixer->sink_handle != NULL) {
+        OS_LOGI(TAG, "Closing sink");
+        mixer->sink_ops.close(mixer->sink_handle);
+        mixer->sink_handle = NULL;
+    }
+}
+
+static void *mixer_thread(void *arg)
+{
+    struct mixer *mixer = (struct mixer *)arg;
+
+    OS_LOGD(TAG, "Mixer thread enter");
+
+    os_mutex_lock(mixer->lock);
+    while (!mixer->exit) {
+        if (!mixer_inputs_opened(mixer)) {
+            if (mixer->sink_handle != NULL) {
+                os_mutex_unlock(mixer->lock);
+                mixer_close_sink(mixer);
+                os_mutex_lock(mixer->lock);
+                continue;
+            }
+            mixer->waiting = true;
+            os_cond_wait(mixer->cond, mixer->lock);
+            mixer->waiting = false;
+            continue;
+        }
+
+        // wait for a full period of all inputs, mix what is buffered if any input underruns,
+        // a write to one input mustn't cut the wait short for the others
+        unsigned long long deadline = os_monotonic_usec() + mixer->cfg.period_ms * 1000;
+        while (!mixer->exit && !mixer_inputs_ready(mixer)) {
+            unsigned long long now = os_monotonic_usec();
+            if (now >= deadline)
+                break;
+            mixer->waiting = true;
+            os_cond_timedwait(mixer->cond, mixer->lock, (unsigned long)(deadline - now));
+            mixer->waiting = false;
+        }
+        if (mixer->exit)
+            break;
+
+        int frames = mixer_mix_inputs(mixer);
+        os_mutex_unlock(mixer->lock);
+        if (frames > 0)
+            mixer_write_sink(mixer, frames);
+        os_mutex_lock(mixer->lock);
+    }
+    os_mutex_unlock(mixer->lock);
+
+    mixer_close_sink(mixer);
+
+    OS_LOGD(TAG, "Mixer thread leave");
+    return NULL;
+}
+
+static const char *mixer_input_name()
+{
+    return "mixer";
+}
+
+static sink_handle_t mixer_input_open(int samplerate, int channels, int bits, void *priv_data)
+{
+    struct mixer_input *input = (struct mixer_input *)priv_data;
+    struct mixer *mixer = input->mixer;
+
+    if (samplerate != mixer->cfg.samplerate || bits != 16 || (channels != 1 && channels != 2)) {
+        OS_LOGE(TAG, "Unsupported input format: rate:%d, channels:%d, bits:%d, mixer rate:%d",
+                samplerate, channels, bits, mixer->cfg.samplerate);
+        return NULL;
+    }
+    if (!mixer->has_sink) {
+        OS_LOGE(TAG, "No sink registered");
+        return NULL;
+    }
+
+    // a player may be opening it before the previous one has closed it
+    os_mutex_lock(mixer->lock);
+    while (input->opened || input->ringbuf != NULL)
+        os_cond_wait(mixer->cond, mixer->lock);
+    os_mutex_unlock(mixer->lock);
+
+    int size = mixer->period_frames * channels * sizeof(short) * DEFAULT_MIXER_INPUT_PERIODS;
+    ringbuf_handle rb = rb_create_spsc(size, 0);
+    if (rb == NULL) {
+        OS_LOGE(TAG, "Failed to create input ringbuf");
+        return NULL;
+    }
+
+    os_mutex_lock(mixer->lock);
+    input->ringbuf = rb;
+    input->channels = channels;
+    input->closing = false;
+    input->opened = true;
+    os_cond_broadcast(mixer->cond);
+    os_mutex_unlock(mixer->lock);
+    return input;
+}
+
+static int mixer_input_write(sink_handle_t handle, char *buffer, int size)
+{
+    struct mixer_input *input = (struct mixer_input *)handle;
+    struct mixer *mixer = input->mixer;
+
+    // a full input drains in DEFAULT_MIXER_INPUT_PERIODS periods if the real sink keeps up,
+    // a stalled sink returns a short write, so that the player can still be stopped
+    int timeout_ms = mixer->cfg.period_ms * DEFAULT_MIXER_INPUT_PERIODS * 2;
+    int bytes_written = rb_write(input->ringbuf, buffer, size, timeout_ms);
+    if (bytes_written == RB_TIMEOUT)
+        bytes_written = 0;
+    else if (bytes_written < 0)
+        return -1;
+
+    os_mutex_lock(mixer->lock);
+    if (mixer->waiting)
+        os_cond_broadcast(mixer->cond);
+    os_mutex_unlock(mixer->lock);
+    return bytes_written;
+}
+
+static void mixer_input_close(sink_handle_t handle)
+{
+    struct mixer_input *input = (struct mixer_input *)handle;
+    struct mixer *mixer = input->mixer;
+
+    os_mutex_lock(mixer->lock);
+    input->closing = true;
+    os_cond_broadcast(mixer->cond);
+    while (input->opened)
+        os_cond_wait(mixer->cond, mixer->lock);
+    ringbuf_handle rb = input->ringbuf;
+    input->ringbuf = NULL;
+    os_cond_broadcast(mixer->cond);
+    os_mutex_unlock(mixer->lock);
+
+    rb_destroy(rb);
+}
+
+mixer_handle_t mixer_create(struct mixer_cfg *cfg)
+{
+    struct mixer_cfg default_cfg = DEFAULT_MIXER_CFG();
+    if (cfg == NULL)
+        cfg = &default_cfg;
+    if (cfg->samplerate <= 0 || cfg->period_ms <= 0 || (cfg->channels != 1 && cfg->channels != 2)) {
+        OS_LOGE(TAG, "Invalid mixer config");
+        return NULL;
+    }
+
+    mixer_handle_t handle = audio_calloc(1, sizeof(struct mixer));
+    if (handle == NULL)
+        return NULL;
+
+    memcpy(&handle->cfg, cfg, sizeof(struct mixer_cfg));
+    list_init(&handle->inputs);
+    handle->period_frames = cfg->samplerate * cfg->period_ms / 1000;
+    handle->mix_buffer = audio_calloc(handle->period_frames * cfg->channels, sizeof(short));
+    handle->lock = os_mutex_create();
+    handle->cond = os_cond_create();
+    if (handle->period_frames <= 0 || handle->mix_buffer == NULL ||
+        handle->lock == NULL || handle->cond == NULL)
+        goto create_fail;
+
+    struct os_thread_attr attr = {
+        .name = "ael-mixer",
+        .priority = DEFAULT_MIXER_TASK_PRIO,
+        .stacksize = DEFAULT_MIXER_TASK_STACKSIZE,
+        .joinable = true,
+    };
+    handle->tid = os_thread_create(&attr, mixer_thread, handle);
+    if (handle->tid == NULL)
+        goto create_fail;
+
+    return handle;
+
+create_fail:
+    if (handle->lock != NULL)
+        os_mutex_destroy(handle->lock);
+    if (handle->cond != NULL)
+        os_cond_destroy(handle->cond);
+    if (handle->mix_buffer != NULL)
+        audio_free(handle->mix_buffer);
+    audio_free(handle);
+    return NULL;
+}
+
+int mixer_register_sink_wrapper(mixer_handle_t handle, struct sink_wrapper *wrapper)
+{
+    if (handle == NULL || wrapper == NULL)
+        return -1;
+
+    os_mutex_lock(handle->lock);
+    if (mixer_inputs_opened(handle)) {
+        OS_LOGE(TAG, "Can't register sink wrapper while inputs are opened");
+        os_mutex_unlock(handle->lock);
+        return -1;
+    }
+    memcpy(&handle->sink_ops, wrapper, sizeof(struct sink_wrapper));
+    handle->has_sink = true;
+    os_mutex_unlock(handle->lock);
+    return 0;
+}
+
+mixer_input_handle_t mixer_input_create(mixer_handle_t handle)
+{
+    if (handle == NULL)
+        return NULL;
+
+    struct mixer_input *input = audio_calloc(1, sizeof(struct mixer_input));
+    if (input == NULL)
+        return NULL;
+
+    input->pcm = audio_calloc(handle->period_frames * 2, sizeof(short));
+    if (input->pcm == NULL) {
+        audio_free(input);
+        return NULL;
+    }
+    input->mixer = handle;
+    input->gain = 1.0f;
+    input->gain_target = 1.0f;
+    input->wrapper.priv_data = input;
+    input->wrapper.name = mixer_input_name;
+    input->wrapper.open = mixer_input_open;
+    input->wrapper.write = mixer_input_write;
+    input->wrapper.close = mixer_input_close;
+
+    os_mutex_lock(handle->lock);
+    list_add_tail(&handle->inputs, &input->listnode);
+    os_mutex_unlock(handle->lock);
+    return input;
+}
+
+struct sink_wrapper *mixer_input_get_sink_wrapper(mixer_input_handle_t input)
+{
+    return input != NULL ? &input->wrapper : NULL;
+}
+
+int mixer_input_set_gain(mixer_input_handle_t input, float gain, int ramp_ms)
+{
+    if (input == NULL)
+        return -1;
+
+    if (gain < 0.0f)
+        gain = 0.0f;
+    else if (gain > 1.0f)
+        gain = 1.0f;
+
+    struct mixer *mixer = input->mixer;
+    os_mutex_lock(mixer->lock);
+    input->gain_target = gain;
+    input->ramp_frames = ramp_ms > 0 ? (int)((long long)mixer->cfg.samplerate * ramp_ms / 1000) : 0;
+    if (input->ramp_frames > 0)
+        input->gain_step = (gain - input->gain) / input->ramp_frames;
+    else
+        input->gain = gain;
+    os_mutex_unlock(mixer->lock);
+    return 0;
+}
+
+void mixer_input_destroy(mixer_input_handle_t input)
+{
+    if (input == NULL)
+        return;
+
+    struct mixer *mixer = input->mixer;
+    os_mutex_lock(mixer->lock);
+    if (input->opened || input->ringbuf != NULL) {
+        OS_LOGE(TAG, "Can't destroy input opened by player");
+        os_mutex_unlock(mixer->lock);
+        return;
+    }
+    list_remove(&input->listnode);
+    os_mutex_unlock(mixer->lock);
+
+    audio_free(input->pcm);
+    audio_free(input);
+}
+
+void mixer_destroy(mixer_handle_t handle)
+{
+    if (handle == NULL)
+        return;
+
+    os_mutex_lock(handle->lock);
+    handle->exit = true;
+    os_cond_broadcast(handle->cond);
+    os_mutex_unlock(handle->lock);
+    os_thread_join(handle->tid, NULL);
+
+    if (!list_empty(&handle->inputs))
+        OS_LOGW(TAG, "Destroying mixer with inputs not destroyed");
+
+    os_cond_destroy(handle->cond);
+    os_mutex_destroy(handle->lock);
+    audio_free(handle->mix_buffer);
+    audio_free(handle);
+}
@@ -24,6 +24,7 @@
 
 #include "liteplayer_config.h"
 #include "liteplayer_parser.h"
+#include "liteplayer_trace_internal.h"
 
 #define TAG "[liteplayer]parser"
 
@@ -33,6 +34,7 @@
 
 struct media_parser_priv {
     struct media_source_info source;
+    struct source_wrapper source_ops; // copied, parser thread may outlive the player adapter
     struct media_codec_info codec;
     char header_buffer[DEFAULT_MEDIA_PARSER_BUFFER_SIZE];
     int header_size;
@@ -83,7 +85,7 @@ static audio_codec_t get_codec_type(const char *url, char *buf)
     return codec;
 }
 
-static int media_parser_fetch(char *buf, int wanted_size, long offset, void *arg)
+static int media_parser_fetch_source(char *buf, int wanted_size, long offset, void *arg)
 {
     struct media_parser_priv *priv = (struct media_parser_priv *)arg;
     int bytes_read = ESP_FAIL;
@@ -208,6 +210,14 @@ read_want:
     return bytes_read;
 }
 
+static int media_parser_fetch(char *buf, int wanted_size, long offset, void *arg)
+{
+    LITEPLAYER_TRACE_BEGIN(trace);
+    int bytes_read = media_parser_fetch_source(buf, wanted_size, offset, arg);
+    LITEPLAYER_TRACE_END(trace, "parser_fetch");
+    return bytes_read;
+}
+
 static int media_parser_extract(struct media_parser_priv *priv)
 {
     int ret = ESP_FAIL;
@@ -234,6 +244,14 @@ static int media_parser_extract(struct media_parser_priv *priv)
             codec->content_len = priv->source.source_ops->content_len(priv->source.source_handle);
             codec->bytes_per_sec = codec->detail.mp3_info.bit_rate*1000/8;
             codec->duration_ms = (codec->content_len - codec->content_pos)*8/codec->detail.mp3_info.bit_rate;
+            if (codec->detail.mp3_info.total_frames > 0) {
+                long long samples = (long long)codec->detail.mp3_info.total_frames*codec->detail.mp3_info.frame_samples;
+                samples -= codec->detail.mp3_info.encoder_delay + codec->detail.mp3_info.encoder_padding;
+                if (samples > 0) {
+                    codec->gapless_delay = codec->detail.mp3_info.encoder_delay;
+                    codec->gapless_samples = samples;
+                }
+            }
             ret = ESP_OK;
         }
         break;
@@ -254,19 +272,27 @@ static int media_parser_extract(struct media_parser_priv *priv)
     }
 
     case AUDIO_CODEC_M4A:
+        codec->detail.m4a_info.arena = priv->source.arena;
         if (m4a_extractor(media_parser_fetch, priv, &(codec->detail.m4a_info)) == 0) {
             codec->content_pos = codec->detail.m4a_info.mdat_offset;
             codec->content_len = priv->source.source_ops->content_len(priv->source.source_handle);
-        #if defined(LITEPLAYER_CONFIG_AAC_SBR)
-            codec->codec_samplerate = codec->detail.m4a_info.samplerate;
-            codec->codec_channels = codec->detail.m4a_info.channels;
-        #else
-            codec->codec_samplerate = codec->detail.m4a_info.asc.samplerate;
-            codec->codec_channels = codec->detail.m4a_info.asc.channels;
-        #endif
+            if (priv->source.aac_plus) {
+                codec->codec_samplerate = codec->detail.m4a_info.samplerate;
+                codec->codec_channels = codec->detail.m4a_info.channels;
+            } else {
+                codec->codec_samplerate = codec->detail.m4a_info.asc.samplerate;
+                codec->codec_channels = codec->detail.m4a_info.asc.channels;
+            }
             codec->codec_bits = codec->detail.m4a_info.bits;
             codec->duration_ms =
                 (int)(codec->detail.m4a_info.duration/codec->detail.m4a_info.time_scale*1000);
+            if (codec->detail.m4a_info.valid_samples > 0 && codec->detail.m4a_info.time_scale > 0) {
+                // iTunSMPB counts in track timescale, decoder may output at another rate without SBR
+                codec->gapless_delay = (int)((long long)codec->detail.m4a_info.encoder_delay*
+                    codec->codec_samplerate/codec->detail.m4a_info.time_scale);
+                codec->gapless_samples = (long long)(codec->detail.m4a_info.valid_samples*
+                    codec->codec_samplerate/codec->detail.m4a_info.time_scale);
+            }
             ret = ESP_OK;
         }
         break;
@@ -331,9 +357,15 @@ static int media_parser_main(struct media_parser_priv *priv)
 
         // We can reuse the source handle, if:
         //   content_pos >= frame_start_offset, and valid data in reuse buffer is sufficient
+        // otherwise seek the opened source back to frame_start_offset, e.g. moov box is
+        // behind mdat box, so that media source doesn't need to reopen the url
         if (content_pos < priv->codec.content_pos ||
-            (content_pos - priv->codec.content_pos) > priv->reuse_size)
-            goto reuse_out;
+            (content_pos - priv->codec.content_pos) > priv->reuse_size) {
+            OS_LOGD(TAG, "Seeking %ld>>%ld to reuse source handle", content_pos, priv->codec.content_pos);
+            if (priv->source.source_ops->seek(priv->source.source_handle, priv->codec.content_pos) != 0)
+                goto reuse_out;
+            content_pos = priv->codec.content_pos;
+        }
 
         if (priv->lock != NULL)
             os_mutex_lock(priv->lock);
@@ -382,19 +414,17 @@ int media_parser_get_codec_info(struct media_source_info *source, struct media_c
 
     bool free_url = false;
     if (strstr(priv->source.url, ".m3u") != NULL) {
-        char temp[256];
-        int ret = m3u_get_first_url(source, temp, sizeof(temp));
-        if (ret == 0) {
-            const char *media_url = audio_strdup(&temp[0]);
-            if (media_url != NULL) {
-                priv->source.url = media_url;
-                free_url = true;
-                OS_LOGV(TAG, "M3U first url: %s", media_url);
-            }
+        char *media_url = m3u_get_first_url(source);
+        if (media_url != NULL) {
+            priv->source.url = media_url;
+            free_url = true;
+            OS_LOGV(TAG, "M3U first url: %s", media_url);
         }
     }
 
+    LITEPLAYER_TRACE_BEGIN(trace);
     int ret = media_parser_main(priv);
+    LITEPLAYER_TRACE_END(trace, "parse");
     // update source handle for media source, we will reuse this handle
     source->source_handle = priv->source.source_handle;
     if (ret == ESP_OK)
@@ -412,19 +442,17 @@ static int media_parser_get_codec_info2(struct media_parser_priv *priv)
         return ESP_FAIL;
 
     if (strstr(priv->source.url, ".m3u") != NULL) {
-        char temp[256];
-        int ret = m3u_get_first_url(&priv->source, temp, sizeof(temp));
-        if (ret == 0) {
-            const char *media_url = audio_strdup(&temp[0]);
-            if (media_url != NULL) {
-                audio_free(priv->source.url);
-                priv->source.url = media_url;
-                OS_LOGV(TAG, "M3U first url: %s", media_url);
-            }
+        char *media_url = m3u_get_first_url(&priv->source);
+        if (media_url != NULL) {
+            audio_free(priv->source.url);
+            priv->source.url = media_url;
+            OS_LOGV(TAG, "M3U first url: %s", media_url);
         }
     }
 
+    LITEPLAYER_TRACE_BEGIN(trace);
     int ret = media_parser_main(priv);
+    LITEPLAYER_TRACE_END(trace, "parse");
     return ret;
 }
 
@@ -436,6 +464,7 @@ static void media_parser_cleanup(struct media_parser_priv *priv)
         os_cond_destroy(priv->cond);
     if (priv->source.url != NULL)
         audio_free(priv->source.url);
+    media_arena_release(priv->source.arena);
     audio_free(priv);
 }
 
@@ -466,6 +495,7 @@ static void *media_parser_thread(void *arg)
 
     media_parser_cleanup(priv);
     OS_LOGD(TAG, "Media parser task leave");
+    LITEPLAYER_TRACE_THREAD_EXIT();
     return NULL;
 }
 
@@ -474,14 +504,18 @@ media_parser_handle_t media_parser_start_async(struct media_source_info *source,
                                                void *listener_priv)
 {
     struct media_parser_priv *priv = audio_calloc(1, sizeof(struct media_parser_priv));
-    if (priv == NULL || source == NULL || source->url == NULL || source->out_ringbuf == NULL)
+    if (priv == NULL || source == NULL || source->url == NULL || source->out_ringbuf == NULL ||
+        source->source_ops == NULL)
         goto start_failed;
 
     memcpy(&priv->source, source, sizeof(struct media_source_info));
+    memcpy(&priv->source_ops, source->source_ops, sizeof(struct source_wrapper));
+    priv->source.source_ops = &priv->source_ops;
     priv->ringbuf_size = rb_get_size(source->out_ringbuf);
     priv->listener = listener;
     priv->listener_priv = listener_priv;
     priv->listener_source = source;
+    media_arena_hold(priv->source.arena);
     priv->lock = os_mutex_create();
     priv->cond = os_cond_create();
     priv->source.url = audio_strdup(source->url);
@@ -539,7 +573,7 @@ long long media_parser_get_seek_offset(struct media_codec_info *codec, int seek_
             break;
         }
         offset = (long long)sample_offset - codec->content_pos;
-        codec->detail.m4a_info.stsz_samplesize_index = sample_index;
+        codec->detail.m4a_info.stsz_seek_index = sample_index;
         break;
     }
     default:
@@ -40,6 +40,8 @@ struct media_codec_info {
     long                content_len;
     int                 bytes_per_sec;
     int                 duration_ms;
+    int                 gapless_delay;      // encoder delay in samples, trimmed from head
+    long long           gapless_samples;    // valid samples after trimming, 0 if unknown
     union {
         struct wav_info wav_info;
         struct mp3_info mp3_info;
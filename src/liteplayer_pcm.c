@@ -0,0 +1,655 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "liteplayer_pcm.h"
+
+// s24 is packed with byte shuffles, available since ssse3
+#if defined(__AVX2__) || defined(__SSSE3__)
+#define PCM_SIMD_SHUFFLE
+#endif
+// float to int is rounded to nearest even, the same as lrintf, neon supports it since armv8
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define PCM_NEON_ROUND
+#endif
+
+#define PCM_S16_SCALE       ( 32768.0f )
+#define PCM_S32_SCALE       ( 2147483648.0f )
+#define PCM_S32_MAX_FLOAT   ( 2147483520.0f ) // largest float below 2^31
+
+// noise is generated per block, then added by the simd kernel
+#define PCM_DITHER_BLOCK    ( 64 )
+
+void pcm_s16_to_s32(const short *in, int *out, int samples)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= samples; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_slli_epi32(_mm256_cvtepi16_epi32(x), 16));
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= samples; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_unpacklo_epi16(zero, x));
+        _mm_storeu_si128((__m128i *)(out + i + 4), _mm_unpackhi_epi16(zero, x));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 8 <= samples; i += 8) {
+        int16x8_t x = vld1q_s16(in + i);
+        vst1q_s32(out + i, vshll_n_s16(vget_low_s16(x), 16));
+        vst1q_s32(out + i + 4, vshll_n_s16(vget_high_s16(x), 16));
+    }
+#endif
+    for (; i < samples; i++)
+        out[i] = (int)((unsigned int)(unsigned short)in[i] << 16);
+}
+
+void pcm_s32_to_s16(const int *in, short *out, int samples)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 16 <= samples; i += 16) {
+        __m256i x0 = _mm256_srai_epi32(_mm256_loadu_si256((const __m256i *)(in + i)), 16);
+        __m256i x1 = _mm256_srai_epi32(_mm256_loadu_si256((const __m256i *)(in + i + 8)), 16);
+        // packs works in 128-bit lanes, restore the order of 64-bit groups
+        __m256i y = _mm256_permute4x64_epi64(_mm256_packs_epi32(x0, x1), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *)(out + i), y);
+    }
+#elif defined(__SSE2__)
+    for (; i + 8 <= samples; i += 8) {
+        __m128i x0 = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(in + i)), 16);
+        __m128i x1 = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(in + i + 4)), 16);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(x0, x1));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 8 <= samples; i += 8) {
+        int16x4_t y0 = vshrn_n_s32(vld1q_s32(in + i), 16);
+        int16x4_t y1 = vshrn_n_s32(vld1q_s32(in + i + 4), 16);
+        vst1q_s16(out + i, vcombine_s16(y0, y1));
+    }
+#endif
+    for (; i < samples; i++)
+        out[i] = (short)(in[i] >> 16);
+}
+
+void pcm_s24_to_s32(const unsigned char *in, int *out, int samples)
+{
+    int i = 0;
+#if defined(PCM_SIMD_SHUFFLE)
+    const __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    // 4 samples are taken from a 16 bytes load, which mustn't go beyond the input
+    for (; i + 6 <= samples; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i * 3));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_shuffle_epi8(x, shuffle));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 8 <= samples; i += 8) {
+        uint8x8x3_t x = vld3_u8(in + i * 3);
+        uint16x8_t lo = vshll_n_u8(x.val[0], 8);
+        uint16x8_t hi = vorrq_u16(vmovl_u8(x.val[1]), vshll_n_u8(x.val[2], 8));
+        uint16x8x2_t y = vzipq_u16(lo, hi);
+        vst1q_s32(out + i, vreinterpretq_s32_u16(y.val[0]));
+        vst1q_s32(out + i + 4, vreinterpretq_s32_u16(y.val[1]));
+    }
+#endif
+    for (; i < samples; i++) {
+        const unsigned char *p = in + i * 3;
+        out[i] = (int)(((unsigned int)p[0] << 8) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 24));
+    }
+}
+
+void pcm_s32_to_s24(const int *in, unsigned char *out, int samples)
+{
+    int i = 0;
+#if defined(PCM_SIMD_SHUFFLE)
+    const __m128i shuffle = _mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1);
+    // 12 bytes of 4 samples are out with a 16 bytes store, the rest is overwritten later
+    for (; i + 6 <= samples; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm_storeu_si128((__m128i *)(out + i * 3), _mm_shuffle_epi8(x, shuffle));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 8 <= samples; i += 8) {
+        uint32x4_t x0 = vreinterpretq_u32_s32(vld1q_s32(in + i));
+        uint32x4_t x1 = vreinterpretq_u32_s32(vld1q_s32(in + i + 4));
+        uint8x8x3_t y;
+        y.val[0] = vmovn_u16(vcombine_u16(vmovn_u32(vshrq_n_u32(x0, 8)), vmovn_u32(vshrq_n_u32(x1, 8))));
+        y.val[1] = vmovn_u16(vcombine_u16(vmovn_u32(vshrq_n_u32(x0, 16)), vmovn_u32(vshrq_n_u32(x1, 16))));
+        y.val[2] = vmovn_u16(vcombine_u16(vmovn_u32(vshrq_n_u32(x0, 24)), vmovn_u32(vshrq_n_u32(x1, 24))));
+        vst3_u8(out + i * 3, y);
+    }
+#endif
+    for (; i < samples; i++) {
+        unsigned int x = (unsigned int)in[i];
+        unsigned char *p = out + i * 3;
+        p[0] = (unsigned char)(x >> 8);
+        p[1] = (unsigned char)(x >> 16);
+        p[2] = (unsigned char)(x >> 24);
+    }
+}
+
+void pcm_s16_to_f32(const short *in, float *out, int samples)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256 scale = _mm256_set1_ps(1.0f / PCM_S16_SCALE);
+    for (; i + 8 <= samples; i += 8) {
+        __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(in + i)));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(x), scale));
+    }
+#elif defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(1.0f / PCM_S16_SCALE);
+    for (; i + 8 <= samples; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i x0 = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        __m128i x1 = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(x0), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(x1), scale));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 8 <= samples; i += 8) {
+        int16x8_t x = vld1q_s16(in + i);
+        vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), 1.0f / PCM_S16_SCALE));
+        vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), 1.0f / PCM_S16_SCALE));
+    }
+#endif
+    for (; i < samples; i++)
+        out[i] = (float)in[i] * (1.0f / PCM_S16_SCALE);
+}
+
+void pcm_s32_to_f32(const int *in, float *out, int samples)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256 scale = _mm256_set1_ps(1.0f / PCM_S32_SCALE);
+    for (; i + 8 <= samples; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(in + i));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(x), scale));
+    }
+#elif defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(1.0f / PCM_S32_SCALE);
+    for (; i + 4 <= samples; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(x), scale));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 4 <= samples; i += 4)
+        vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(in + i)), 1.0f / PCM_S32_SCALE));
+#endif
+    for (; i < samples; i++)
+        out[i] = (float)in[i] * (1.0f / PCM_S32_SCALE);
+}
+
+void pcm_f32_to_s32(const float *in, int *out, int samples)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256 scale = _mm256_set1_ps(PCM_S32_SCALE);
+    const __m256 lo = _mm256_set1_ps(-PCM_S32_SCALE);
+    const __m256 hi = _mm256_set1_ps(PCM_S32_MAX_FLOAT);
+    for (; i + 8 <= samples; i += 8) {
+        __m256 x = _mm256_mul_ps(_mm256_loadu_ps(in + i), scale);
+        x = _mm256_min_ps(_mm256_max_ps(x, lo), hi);
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_cvtps_epi32(x));
+    }
+#elif defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(PCM_S32_SCALE);
+    const __m128 lo = _mm_set1_ps(-PCM_S32_SCALE);
+    const __m128 hi = _mm_set1_ps(PCM_S32_MAX_FLOAT);
+    for (; i + 4 <= samples; i += 4) {
+        __m128 x = _mm_mul_ps(_mm_loadu_ps(in + i), scale);
+        x = _mm_min_ps(_mm_max_ps(x, lo), hi);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_cvtps_epi32(x));
+    }
+#elif defined(PCM_NEON_ROUND)
+    for (; i + 4 <= samples; i += 4) {
+        float32x4_t x = vmulq_n_f32(vld1q_f32(in + i), PCM_S32_SCALE);
+        x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(-PCM_S32_SCALE)), vdupq_n_f32(PCM_S32_MAX_FLOAT));
+        vst1q_s32(out + i, vcvtnq_s32_f32(x));
+    }
+#endif
+    for (; i < samples; i++) {
+        float x = in[i] * PCM_S32_SCALE;
+        x = x < -PCM_S32_SCALE ? -PCM_S32_SCALE : (x > PCM_S32_MAX_FLOAT ? PCM_S32_MAX_FLOAT : x);
+        out[i] = (int)lrintf(x);
+    }
+}
+
+// @noise is added in lsb if not NULL
+static void pcm_f32_to_s16_block(const float *in, short *out, int samples, const float *noise)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256 scale = _mm256_set1_ps(PCM_S16_SCALE);
+    const __m256 lo = _mm256_set1_ps(-PCM_S16_SCALE);
+    const __m256 hi = _mm256_set1_ps(PCM_S16_SCALE - 1.0f);
+    for (; i + 16 <= samples; i += 16) {
+        __m256 x0 = _mm256_mul_ps(_mm256_loadu_ps(in + i), scale);
+        __m256 x1 = _mm256_mul_ps(_mm256_loadu_ps(in + i + 8), scale);
+        if (noise != NULL) {
+            x0 = _mm256_add_ps(x0, _mm256_loadu_ps(noise + i));
+            x1 = _mm256_add_ps(x1, _mm256_loadu_ps(noise + i + 8));
+        }
+        __m256i y0 = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(x0, lo), hi));
+        __m256i y1 = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(x1, lo), hi));
+        __m256i y = _mm256_permute4x64_epi64(_mm256_packs_epi32(y0, y1), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *)(out + i), y);
+    }
+#elif defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(PCM_S16_SCALE);
+    const __m128 lo = _mm_set1_ps(-PCM_S16_SCALE);
+    const __m128 hi = _mm_set1_ps(PCM_S16_SCALE - 1.0f);
+    for (; i + 8 <= samples; i += 8) {
+        __m128 x0 = _mm_mul_ps(_mm_loadu_ps(in + i), scale);
+        __m128 x1 = _mm_mul_ps(_mm_loadu_ps(in + i + 4), scale);
+        if (noise != NULL) {
+            x0 = _mm_add_ps(x0, _mm_loadu_ps(noise + i));
+            x1 = _mm_add_ps(x1, _mm_loadu_ps(noise + i + 4));
+        }
+        __m128i y0 = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(x0, lo), hi));
+        __m128i y1 = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(x1, lo), hi));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(y0, y1));
+    }
+#elif defined(PCM_NEON_ROUND)
+    for (; i + 8 <= samples; i += 8) {
+        float32x4_t x0 = vmulq_n_f32(vld1q_f32(in + i), PCM_S16_SCALE);
+        float32x4_t x1 = vmulq_n_f32(vld1q_f32(in + i + 4), PCM_S16_SCALE);
+        if (noise != NULL) {
+            x0 = vaddq_f32(x0, vld1q_f32(noise + i));
+            x1 = vaddq_f32(x1, vld1q_f32(noise + i + 4));
+        }
+        // saturated by converting and narrowing
+        int16x4_t y0 = vqmovn_s32(vcvtnq_s32_f32(x0));
+        int16x4_t y1 = vqmovn_s32(vcvtnq_s32_f32(x1));
+        vst1q_s16(out + i, vcombine_s16(y0, y1));
+    }
+#endif
+    for (; i < samples; i++) {
+        float x = in[i] * PCM_S16_SCALE + (noise != NULL ? noise[i] : 0.0f);
+        x = x < -PCM_S16_SCALE ? -PCM_S16_SCALE : (x > PCM_S16_SCALE - 1.0f ? PCM_S16_SCALE - 1.0f : x);
+        out[i] = (short)lrintf(x);
+    }
+}
+
+static inline float pcm_dither_uniform(unsigned int *seed)
+{
+    *seed = *seed * 1664525u + 1013904223u;
+    return (float)(*seed >> 8) * (1.0f / 16777216.0f);
+}
+
+void pcm_f32_to_s16(const float *in, short *out, int samples, unsigned int *dither_seed)
+{
+    if (dither_seed == NULL) {
+        pcm_f32_to_s16_block(in, out, samples, NULL);
+        return;
+    }
+
+    float noise[PCM_DITHER_BLOCK];
+    for (int i = 0; i < samples; i += PCM_DITHER_BLOCK) {
+        int n = samples - i < PCM_DITHER_BLOCK ? samples - i : PCM_DITHER_BLOCK;
+        // difference of two uniform noises, triangular in (-1, 1) lsb
+        for (int k = 0; k < n; k++)
+            noise[k] = pcm_dither_uniform(dither_seed) - pcm_dither_uniform(dither_seed);
+        pcm_f32_to_s16_block(in + i, out + i, n, noise);
+    }
+}
+
+void pcm_gain_s16(short *buf, int samples, int gain_q15)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256i g = _mm256_set1_epi16((short)gain_q15);
+    for (; i + 16 <= samples; i += 16) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(buf + i));
+        _mm256_storeu_si256((__m256i *)(buf + i), _mm256_mulhrs_epi16(x, g));
+    }
+#elif defined(__SSSE3__)
+    const __m128i g = _mm_set1_epi16((short)gain_q15);
+    for (; i + 8 <= samples; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(buf + i));
+        _mm_storeu_si128((__m128i *)(buf + i), _mm_mulhrs_epi16(x, g));
+    }
+#elif defined(__SSE2__)
+    const __m128i g = _mm_set1_epi16((short)gain_q15);
+    const __m128i round = _mm_set1_epi32(1 << 14);
+    for (; i + 8 <= samples; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(buf + i));
+        __m128i lo = _mm_mullo_epi16(x, g);
+        __m128i hi = _mm_mulhi_epi16(x, g);
+        __m128i y0 = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), round), 15);
+        __m128i y1 = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), round), 15);
+        _mm_storeu_si128((__m128i *)(buf + i), _mm_packs_epi32(y0, y1));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 8 <= samples; i += 8)
+        vst1q_s16(buf + i, vqrdmulhq_n_s16(vld1q_s16(buf + i), (short)gain_q15));
+#endif
+    for (; i < samples; i++)
+        buf[i] = (short)((buf[i] * gain_q15 + (1 << 14)) >> 15);
+}
+
+void pcm_gain_f32(float *buf, int samples, float gain)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256 g = _mm256_set1_ps(gain);
+    for (; i + 8 <= samples; i += 8)
+        _mm256_storeu_ps(buf + i, _mm256_mul_ps(_mm256_loadu_ps(buf + i), g));
+#elif defined(__SSE2__)
+    const __m128 g = _mm_set1_ps(gain);
+    for (; i + 4 <= samples; i += 4)
+        _mm_storeu_ps(buf + i, _mm_mul_ps(_mm_loadu_ps(buf + i), g));
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 4 <= samples; i += 4)
+        vst1q_f32(buf + i, vmulq_n_f32(vld1q_f32(buf + i), gain));
+#endif
+    for (; i < samples; i++)
+        buf[i] *= gain;
+}
+
+void pcm_ramp_f32(float *buf, int frames, int channels, float gain, float step)
+{
+    int samples = frames * channels;
+    int i = 0;
+    // vector lanes hold whole frames for mono and stereo, gains are advanced per vector
+#if defined(__AVX2__)
+    if (channels == 1 || channels == 2) {
+        __m256 g = channels == 1 ? _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7) :
+                                   _mm256_setr_ps(0, 0, 1, 1, 2, 2, 3, 3);
+        g = _mm256_add_ps(_mm256_mul_ps(g, _mm256_set1_ps(step)), _mm256_set1_ps(gain));
+        const __m256 inc = _mm256_set1_ps(step * (8 / channels));
+        for (; i + 8 <= samples; i += 8) {
+            _mm256_storeu_ps(buf + i, _mm256_mul_ps(_mm256_loadu_ps(buf + i), g));
+            g = _mm256_add_ps(g, inc);
+        }
+    }
+#elif defined(__SSE2__)
+    if (channels == 1 || channels == 2) {
+        __m128 g = channels == 1 ? _mm_setr_ps(0, 1, 2, 3) : _mm_setr_ps(0, 0, 1, 1);
+        g = _mm_add_ps(_mm_mul_ps(g, _mm_set1_ps(step)), _mm_set1_ps(gain));
+        const __m128 inc = _mm_set1_ps(step * (4 / channels));
+        for (; i + 4 <= samples; i += 4) {
+            _mm_storeu_ps(buf + i, _mm_mul_ps(_mm_loadu_ps(buf + i), g));
+            g = _mm_add_ps(g, inc);
+        }
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    if (channels == 1 || channels == 2) {
+        static const float mono[4] = { 0, 1, 2, 3 };
+        static const float stereo[4] = { 0, 0, 1, 1 };
+        float32x4_t g = vld1q_f32(channels == 1 ? mono : stereo);
+        g = vmlaq_n_f32(vdupq_n_f32(gain), g, step);
+        const float32x4_t inc = vdupq_n_f32(step * (4 / channels));
+        for (; i + 4 <= samples; i += 4) {
+            vst1q_f32(buf + i, vmulq_f32(vld1q_f32(buf + i), g));
+            g = vaddq_f32(g, inc);
+        }
+    }
+#endif
+    for (; i < samples; i++)
+        buf[i] *= gain + step * (i / channels);
+}
+
+// s24 goes through s32 kept on stack
+#define PCM_S24_BLOCK       ( 64 )
+
+void pcm_to_f32(const char *in, int bits, float *out, int samples)
+{
+    if (bits == 16) {
+        pcm_s16_to_f32((const short *)in, out, samples);
+    } else if (bits == 24) {
+        int tmp[PCM_S24_BLOCK];
+        for (int i = 0; i < samples; i += PCM_S24_BLOCK) {
+            int n = samples - i < PCM_S24_BLOCK ? samples - i : PCM_S24_BLOCK;
+            pcm_s24_to_s32((const unsigned char *)in + i * 3, tmp, n);
+            pcm_s32_to_f32(tmp, out + i, n);
+        }
+    } else {
+        pcm_s32_to_f32((const int *)in, out, samples);
+    }
+}
+
+void pcm_from_f32(const float *in, char *out, int bits, int samples, unsigned int *dither_seed)
+{
+    if (bits == 16) {
+        pcm_f32_to_s16(in, (short *)out, samples, dither_seed);
+    } else if (bits == 24) {
+        int tmp[PCM_S24_BLOCK];
+        for (int i = 0; i < samples; i += PCM_S24_BLOCK) {
+            int n = samples - i < PCM_S24_BLOCK ? samples - i : PCM_S24_BLOCK;
+            pcm_f32_to_s32(in + i, tmp, n);
+            pcm_s32_to_s24(tmp, (unsigned char *)out + i * 3, n);
+        }
+    } else {
+        pcm_f32_to_s32(in, (int *)out, samples);
+    }
+}
+
+void pcm_downmix_s16(const short *in, short *out, int frames)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256i ones = _mm256_set1_epi16(1);
+    for (; i + 16 <= frames; i += 16) {
+        // madd sums each frame into 32 bits, so L + R doesn't overflow
+        __m256i s0 = _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *)(in + 2 * i)), ones);
+        __m256i s1 = _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *)(in + 2 * i + 16)), ones);
+        __m256i y = _mm256_packs_epi32(_mm256_srai_epi32(s0, 1), _mm256_srai_epi32(s1, 1));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_permute4x64_epi64(y, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+#elif defined(__SSE2__)
+    const __m128i ones = _mm_set1_epi16(1);
+    for (; i + 8 <= frames; i += 8) {
+        __m128i s0 = _mm_madd_epi16(_mm_loadu_si128((const __m128i *)(in + 2 * i)), ones);
+        __m128i s1 = _mm_madd_epi16(_mm_loadu_si128((const __m128i *)(in + 2 * i + 8)), ones);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(_mm_srai_epi32(s0, 1), _mm_srai_epi32(s1, 1)));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t x = vld2q_s16(in + 2 * i);
+        vst1q_s16(out + i, vhaddq_s16(x.val[0], x.val[1]));
+    }
+#endif
+    for (; i < frames; i++)
+        out[i] = (short)((in[2 * i] + in[2 * i + 1]) >> 1);
+}
+
+void pcm_downmix_s32(const int *in, int *out, int frames)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i one = _mm_set1_epi32(1);
+    for (; i + 4 <= frames; i += 4) {
+        __m128 x0 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(in + 2 * i)));
+        __m128 x1 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(in + 2 * i + 4)));
+        __m128i l = _mm_castps_si128(_mm_shuffle_ps(x0, x1, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i r = _mm_castps_si128(_mm_shuffle_ps(x0, x1, _MM_SHUFFLE(3, 1, 3, 1)));
+        // floor((l + r) / 2) without overflow
+        __m128i y = _mm_add_epi32(_mm_add_epi32(_mm_srai_epi32(l, 1), _mm_srai_epi32(r, 1)),
+                                  _mm_and_si128(_mm_and_si128(l, r), one));
+        _mm_storeu_si128((__m128i *)(out + i), y);
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 4 <= frames; i += 4) {
+        int32x4x2_t x = vld2q_s32(in + 2 * i);
+        vst1q_s32(out + i, vhaddq_s32(x.val[0], x.val[1]));
+    }
+#endif
+    for (; i < frames; i++)
+        out[i] = (int)(((long long)in[2 * i] + in[2 * i + 1]) >> 1);
+}
+
+void pcm_upmix_s16(const short *in, short *out, int frames)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 8 <= frames; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm_storeu_si128((__m128i *)(out + 2 * i), _mm_unpacklo_epi16(x, x));
+        _mm_storeu_si128((__m128i *)(out + 2 * i + 8), _mm_unpackhi_epi16(x, x));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t y;
+        y.val[0] = y.val[1] = vld1q_s16(in + i);
+        vst2q_s16(out + 2 * i, y);
+    }
+#endif
+    for (; i < frames; i++)
+        out[2 * i] = out[2 * i + 1] = in[i];
+}
+
+void pcm_upmix_s32(const int *in, int *out, int frames)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= frames; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm_storeu_si128((__m128i *)(out + 2 * i), _mm_unpacklo_epi32(x, x));
+        _mm_storeu_si128((__m128i *)(out + 2 * i + 4), _mm_unpackhi_epi32(x, x));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 4 <= frames; i += 4) {
+        int32x4x2_t y;
+        y.val[0] = y.val[1] = vld1q_s32(in + i);
+        vst2q_s32(out + 2 * i, y);
+    }
+#endif
+    for (; i < frames; i++)
+        out[2 * i] = out[2 * i + 1] = in[i];
+}
+
+// Sample of any integer format, left aligned in 32 bits
+static inline int pcm_load_s32(const unsigned char *p, int bytes)
+{
+    if (bytes == 2)
+        return (int)((unsigned int)(p[0] | (p[1] << 8)) << 16);
+    if (bytes == 3)
+        return (int)((unsigned int)(p[0] | (p[1] << 8) | (p[2] << 16)) << 8);
+    return (int)((unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24));
+}
+
+static inline void pcm_store_s32(unsigned char *p, int bytes, int sample)
+{
+    unsigned int x = (unsigned int)sample >> ((4 - bytes) * 8);
+    for (int i = 0; i < bytes; i++, x >>= 8)
+        p[i] = (unsigned char)x;
+}
+
+int pcm_mix_channels(const char *in, int in_channels, char *out, int out_channels, int bits, int frames)
+{
+    int bytes = pcm_sample_bytes(bits);
+    if (bytes == 0 || frames < 0 || in_channels <= 0 ||
+        !(out_channels == 1 || (out_channels == 2 && in_channels == 1)))
+        return -1;
+
+    const unsigned char *src = (const unsigned char *)in;
+    unsigned char *dst = (unsigned char *)out;
+    if (in_channels == out_channels) {
+        memmove(out, in, frames * in_channels * bytes);
+    } else if (in_channels == 2 && bits == 16) {
+        pcm_downmix_s16((const short *)in, (short *)out, frames);
+    } else if (in_channels == 2 && bits == 32) {
+        pcm_downmix_s32((const int *)in, (int *)out, frames);
+    } else if (in_channels == 2) {
+        int tmp[PCM_S24_BLOCK];
+        for (int i = 0; i < frames; i += PCM_S24_BLOCK / 2) {
+            int n = frames - i < PCM_S24_BLOCK / 2 ? frames - i : PCM_S24_BLOCK / 2;
+            pcm_s24_to_s32(src + i * 6, tmp, n * 2);
+            pcm_downmix_s32(tmp, tmp, n);
+            pcm_s32_to_s24(tmp, dst + i * 3, n);
+        }
+    } else if (out_channels == 1) {
+        for (int i = 0; i < frames; i++, src += in_channels * bytes, dst += bytes) {
+            long long sum = 0;
+            for (int ch = 0; ch < in_channels; ch++)
+                sum += pcm_load_s32(src + ch * bytes, bytes);
+            pcm_store_s32(dst, bytes, (int)(sum / in_channels));
+        }
+    } else if (bits == 16) {
+        pcm_upmix_s16((const short *)in, (short *)out, frames);
+    } else if (bits == 32) {
+        pcm_upmix_s32((const int *)in, (int *)out, frames);
+    } else {
+        for (int i = 0; i < frames; i++, src += 3, dst += 6) {
+            memcpy(dst, src, 3);
+            memcpy(dst + 3, src, 3);
+        }
+    }
+    return frames * out_channels * bytes;
+}
+
+int pcm_sample_bytes(int bits)
+{
+    switch (bits) {
+    case 16:
+        return 2;
+    case 24:
+        return 3;
+    case 32:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+int pcm_convert(const char *in, int in_bits, char *out, int out_bits, int samples)
+{
+    int in_bytes = pcm_sample_bytes(in_bits);
+    int out_bytes = pcm_sample_bytes(out_bits);
+    if (in_bytes == 0 || out_bytes == 0 || samples < 0)
+        return -1;
+
+    const unsigned char *src = (const unsigned char *)in;
+    unsigned char *dst = (unsigned char *)out;
+    if (in_bits == out_bits) {
+        memcpy(out, in, samples * in_bytes);
+    } else if (in_bits == 16 && out_bits == 32) {
+        pcm_s16_to_s32((const short *)in, (int *)out, samples);
+    } else if (in_bits == 32 && out_bits == 16) {
+        pcm_s32_to_s16((const int *)in, (short *)out, samples);
+    } else if (in_bits == 24 && out_bits == 32) {
+        pcm_s24_to_s32(src, (int *)out, samples);
+    } else if (in_bits == 32 && out_bits == 24) {
+        pcm_s32_to_s24((const int *)in, dst, samples);
+    } else if (in_bits == 16 && out_bits == 24) {
+        for (int i = 0; i < samples; i++, src += 2, dst += 3) {
+            dst[0] = 0;
+            dst[1] = src[0];
+            dst[2] = src[1];
+        }
+    } else {
+        // 24 to 16
+        for (int i = 0; i < samples; i++, src += 3, dst += 2) {
+            dst[0] = src[1];
+            dst[1] = src[2];
+        }
+    }
+    return samples * out_bytes;
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _LITEPLAYER_PCM_H_
+#define _LITEPLAYER_PCM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Conversion kernels of interleaved little-endian pcm, @samples counts the samples
+ * of all channels. s24 is packed in 3 bytes, float is full scale at 1.0.
+ * Narrowing integer conversions drop the low bits, the same as dr_wav does.
+ */
+void pcm_s16_to_s32(const short *in, int *out, int samples);
+void pcm_s32_to_s16(const int *in, short *out, int samples);
+void pcm_s24_to_s32(const unsigned char *in, int *out, int samples);
+void pcm_s32_to_s24(const int *in, unsigned char *out, int samples);
+void pcm_s16_to_f32(const short *in, float *out, int samples);
+void pcm_s32_to_f32(const int *in, float *out, int samples);
+void pcm_f32_to_s32(const float *in, int *out, int samples);
+
+// Rounded and clipped, TPDF dither of 1 lsb is added if @dither_seed is not NULL, also for pcm_from_f32()
+void pcm_f32_to_s16(const float *in, short *out, int samples, unsigned int *dither_seed);
+
+// In place gain, @gain_q15 in [0, 32767], rounded to nearest
+void pcm_gain_s16(short *buf, int samples, int gain_q15);
+void pcm_gain_f32(float *buf, int samples, float gain);
+
+// In place linear ramp of interleaved frames, frame i is scaled by @gain + i * @step
+void pcm_ramp_f32(float *buf, int frames, int channels, float gain, float step);
+
+// Between 16/24/32 bits integer pcm and float, e.g. for the float stages
+void pcm_to_f32(const char *in, int bits, float *out, int samples);
+void pcm_from_f32(const float *in, char *out, int bits, int samples, unsigned int *dither_seed);
+
+// Stereo to mono by averaging L and R, @out may be @in
+void pcm_downmix_s16(const short *in, short *out, int frames);
+void pcm_downmix_s32(const int *in, int *out, int frames);
+
+// Mono to stereo by duplicating, @out mustn't overlap @in
+void pcm_upmix_s16(const short *in, short *out, int frames);
+void pcm_upmix_s32(const int *in, int *out, int frames);
+
+/*
+ * Mix 16/24/32 bits integer pcm down to mono from any channels, or up to stereo from mono,
+ * returns bytes written. Mixing down may be done in place, mixing up mustn't overlap @in.
+ */
+int pcm_mix_channels(const char *in, int in_channels, char *out, int out_channels, int bits, int frames);
+
+// Bytes of a sample of the integer pcm format, 0 if not supported
+int pcm_sample_bytes(int bits);
+
+// Convert between 16/24/32 bits integer pcm, @out mustn't overlap @in, returns bytes written
+int pcm_convert(const char *in, int in_bits, char *out, int out_bits, int samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _LITEPLAYER_PCM_H_
@@ -0,0 +1,456 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "osal/os_thread.h"
+#include "osal/os_time.h"
+#include "cutils/log_helper.h"
+#include "cutils/list.h"
+#include "esp_adf/audio_common.h"
+#include "liteplayer_config.h"
+#include "liteplayer_prefetch.h"
+
+#define TAG "[liteplayer]prefetch"
+
+#define PREFETCH_CHUNK_SIZE        ( 1024*8 )
+#define PREFETCH_RETRY_INTERVAL_MS ( 500 )
+// a throughput sample covers at least this much transfer time, shorter ones are merged
+#define PREFETCH_SAMPLE_MIN_USEC   ( 1000*20 )
+
+struct prefetch_chunk {
+    struct listnode listnode;
+    int size;
+    int offset;
+    char data[PREFETCH_CHUNK_SIZE];
+};
+
+enum prefetch_segment_state {
+    PREFETCH_SEGMENT_PENDING,
+    PREFETCH_SEGMENT_LOADING,
+    PREFETCH_SEGMENT_DONE,
+    PREFETCH_SEGMENT_FAILED,
+};
+
+struct prefetch_segment {
+    struct listnode listnode;
+    char *url;
+    long long content_pos; // where the download goes on, only touched by its worker
+    enum prefetch_segment_state state;
+    struct listnode chunks;
+    int cached;
+};
+
+struct segment_prefetch {
+    struct source_wrapper source_ops; // copied, workers may outlive the caller
+    os_mutex lock;
+    os_cond cond; // signaled on queueing, downloading, reading and aborting
+    struct listnode segments; // in play order, the first is playing
+    int segments_max;
+    int cache_size;
+    int cached; // bytes in chunks, and reserved by the reading workers
+    int refs;   // owner and workers, the last one frees
+    bool abort;
+
+    // throughput of all workers, counted only while any of them is opening or reading
+    int transfers;                  // workers in open or read
+    unsigned long long busy_since;  // when transfers went from 0 to 1
+    unsigned long long busy_usec;   // transfer time since the last sample
+    long long busy_bytes;           // bytes downloaded since the last sample
+    int bandwidth;                  // smoothed, bits per second, 0 if not measured yet
+
+    int reconnects; // since taken by segment_prefetch_reconnects()
+};
+
+static void prefetch_segment_free(struct prefetch_segment *seg)
+{
+    struct listnode *item, *tmp;
+    list_for_each_safe(item, tmp, &seg->chunks) {
+        struct prefetch_chunk *chunk = listnode_to_item(item, struct prefetch_chunk, listnode);
+        list_remove(item);
+        audio_free(chunk);
+    }
+    audio_free(seg->url);
+    audio_free(seg);
+}
+
+static void segment_prefetch_free(struct segment_prefetch *prefetch)
+{
+    struct listnode *item, *tmp;
+    list_for_each_safe(item, tmp, &prefetch->segments) {
+        struct prefetch_segment *seg = listnode_to_item(item, struct prefetch_segment, listnode);
+        list_remove(item);
+        prefetch_segment_free(seg);
+    }
+    if (prefetch->lock != NULL)
+        os_mutex_destroy(prefetch->lock);
+    if (prefetch->cond != NULL)
+        os_cond_destroy(prefetch->cond);
+    audio_free(prefetch);
+}
+
+// Segments behind the playing one leave a quarter of the cache to it
+static bool segment_prefetch_cache_allowed(struct segment_prefetch *prefetch, struct prefetch_segment *seg)
+{
+    int limit = prefetch->cache_size;
+    if (list_head(&prefetch->segments) != &seg->listnode)
+        limit -= prefetch->cache_size/4;
+    return prefetch->cached + PREFETCH_CHUNK_SIZE <= limit;
+}
+
+// Called with lock held, around each open and read of the workers
+static void segment_prefetch_transfer_begin(struct segment_prefetch *prefetch)
+{
+    if (prefetch->transfers++ == 0)
+        prefetch->busy_since = os_monotonic_usec();
+}
+
+static void segment_prefetch_transfer_end(struct segment_prefetch *prefetch, int bytes)
+{
+    if (--prefetch->transfers == 0)
+        prefetch->busy_usec += os_monotonic_usec() - prefetch->busy_since;
+    if (bytes > 0)
+        prefetch->busy_bytes += bytes;
+}
+
+// Called with lock held once a segment is downloaded, the sample is folded into an EWMA
+static void segment_prefetch_sample(struct segment_prefetch *prefetch)
+{
+    unsigned long long now = os_monotonic_usec();
+    unsigned long long busy = prefetch->busy_usec;
+    if (prefetch->transfers > 0)
+        busy += now - prefetch->busy_since;
+    if (busy < PREFETCH_SAMPLE_MIN_USEC || prefetch->busy_bytes <= 0)
+        return;
+
+    long long sample = prefetch->busy_bytes * 8 * 1000000 / (long long)busy;
+    if (sample > 0x7FFFFFFF)
+        sample = 0x7FFFFFFF;
+    if (prefetch->bandwidth == 0)
+        prefetch->bandwidth = (int)sample;
+    else
+        prefetch->bandwidth += (int)((sample - prefetch->bandwidth) * 3 / 10);
+    OS_LOGV(TAG, "Throughput sample:%lldbps, estimate:%dbps", sample, prefetch->bandwidth);
+
+    prefetch->busy_usec = 0;
+    prefetch->busy_bytes = 0;
+    if (prefetch->transfers > 0)
+        prefetch->busy_since = now;
+}
+
+// Returns true if the segment is downloaded completely
+static bool segment_prefetch_download(struct segment_prefetch *prefetch, struct prefetch_segment *seg)
+{
+    struct source_wrapper *ops = &prefetch->source_ops;
+    source_handle_t source = NULL;
+    bool done = false;
+    int retry = 0;
+
+    while (true) {
+        int ret = -1;
+        if (source == NULL) {
+            os_mutex_lock(prefetch->lock);
+            segment_prefetch_transfer_begin(prefetch);
+            os_mutex_unlock(prefetch->lock);
+            source = ops->open(seg->url, seg->content_pos, ops->priv_data);
+            os_mutex_lock(prefetch->lock);
+            segment_prefetch_transfer_end(prefetch, 0);
+            os_mutex_unlock(prefetch->lock);
+        }
+
+        if (source != NULL) {
+            os_mutex_lock(prefetch->lock);
+            while (!prefetch->abort && !segment_prefetch_cache_allowed(prefetch, seg))
+                os_cond_wait(prefetch->cond, prefetch->lock);
+            if (prefetch->abort) {
+                os_mutex_unlock(prefetch->lock);
+                break;
+            }
+            prefetch->cached += PREFETCH_CHUNK_SIZE;
+            segment_prefetch_transfer_begin(prefetch);
+            os_mutex_unlock(prefetch->lock);
+
+            struct prefetch_chunk *chunk = audio_malloc(sizeof(struct prefetch_chunk));
+            if (chunk != NULL)
+                ret = ops->read(source, chunk->data, PREFETCH_CHUNK_SIZE);
+
+            os_mutex_lock(prefetch->lock);
+            prefetch->cached -= PREFETCH_CHUNK_SIZE;
+            segment_prefetch_transfer_end(prefetch, ret);
+            if (ret > 0) {
+                chunk->size = ret;
+                chunk->offset = 0;
+                list_add_tail(&seg->chunks, &chunk->listnode);
+                seg->cached += ret;
+                prefetch->cached += ret;
+                chunk = NULL;
+            }
+            os_cond_broadcast(prefetch->cond);
+            os_mutex_unlock(prefetch->lock);
+
+            if (chunk != NULL)
+                audio_free(chunk);
+            if (ret > 0) {
+                seg->content_pos += ret;
+                retry = 0;
+                continue;
+            } else if (ret == 0) {
+                done = true;
+                break;
+            }
+            ops->close(source);
+            source = NULL;
+        }
+
+        if (retry++ >= DEFAULT_M3U_PREFETCH_RETRY) {
+            OS_LOGE(TAG, "Failed to download segment:%s", seg->url);
+            break;
+        }
+        OS_LOGW(TAG, "Reconnecting segment from pos:%d, retry:%d", (int)seg->content_pos, retry);
+        unsigned long long deadline = os_monotonic_usec() + PREFETCH_RETRY_INTERVAL_MS*retry*1000ULL;
+        os_mutex_lock(prefetch->lock);
+        prefetch->reconnects++;
+        while (!prefetch->abort) {
+            unsigned long long now = os_monotonic_usec();
+            if (now >= deadline)
+                break;
+            os_cond_timedwait(prefetch->cond, prefetch->lock, (unsigned long)(deadline - now));
+        }
+        ret = prefetch->abort ? -1 : 0;
+        os_mutex_unlock(prefetch->lock);
+        if (ret != 0)
+            break;
+    }
+
+    if (source != NULL)
+        ops->close(source);
+    return done;
+}
+
+static void *segment_prefetch_thread(void *arg)
+{
+    struct segment_prefetch *prefetch = (struct segment_prefetch *)arg;
+
+    os_mutex_lock(prefetch->lock);
+    while (!prefetch->abort) {
+        struct prefetch_segment *seg = NULL;
+        struct listnode *item;
+        list_for_each(item, &prefetch->segments) {
+            struct prefetch_segment *temp = listnode_to_item(item, struct prefetch_segment, listnode);
+            if (temp->state == PREFETCH_SEGMENT_PENDING) {
+                seg = temp;
+                break;
+            }
+        }
+        if (seg == NULL) {
+            os_cond_wait(prefetch->cond, prefetch->lock);
+            continue;
+        }
+
+        // a loading segment is only dropped by the reader once it's done or failed
+        seg->state = PREFETCH_SEGMENT_LOADING;
+        os_mutex_unlock(prefetch->lock);
+        bool done = segment_prefetch_download(prefetch, seg);
+        os_mutex_lock(prefetch->lock);
+        seg->state = done ? PREFETCH_SEGMENT_DONE : PREFETCH_SEGMENT_FAILED;
+        if (done)
+            segment_prefetch_sample(prefetch);
+        os_cond_broadcast(prefetch->cond);
+    }
+    bool last = --prefetch->refs == 0;
+    os_mutex_unlock(prefetch->lock);
+
+    if (last)
+        segment_prefetch_free(prefetch);
+    OS_LOGV(TAG, "Prefetch task leave");
+    return NULL;
+}
+
+segment_prefetch_handle_t segment_prefetch_create(struct source_wrapper *source_ops,
+                                                  int segments, int cache_size)
+{
+    if (source_ops == NULL)
+        return NULL;
+    if (segments <= 0)
+        segments = DEFAULT_M3U_PREFETCH_SEGMENTS;
+    if (segments > DEFAULT_M3U_PREFETCH_MAX_SEGMENTS)
+        segments = DEFAULT_M3U_PREFETCH_MAX_SEGMENTS;
+    if (cache_size <= 0)
+        cache_size = DEFAULT_M3U_PREFETCH_CACHE_SIZE;
+    if (cache_size < PREFETCH_CHUNK_SIZE*4)
+        cache_size = PREFETCH_CHUNK_SIZE*4;
+
+    struct segment_prefetch *prefetch = audio_calloc(1, sizeof(struct segment_prefetch));
+    if (prefetch == NULL)
+        return NULL;
+    memcpy(&prefetch->source_ops, source_ops, sizeof(struct source_wrapper));
+    list_init(&prefetch->segments);
+    prefetch->cache_size = cache_size;
+    prefetch->refs = 1;
+    prefetch->lock = os_mutex_create();
+    prefetch->cond = os_cond_create();
+    if (prefetch->lock == NULL || prefetch->cond == NULL) {
+        segment_prefetch_free(prefetch);
+        return NULL;
+    }
+
+    struct os_thread_attr attr = {
+        .name = "ael-prefetch",
+        .priority = DEFAULT_MEDIA_SOURCE_TASK_PRIO,
+        .stacksize = DEFAULT_MEDIA_SOURCE_TASK_STACKSIZE,
+        .joinable = false,
+    };
+    int workers = 0;
+    for (int i = 0; i < segments; i++) {
+        os_mutex_lock(prefetch->lock);
+        prefetch->refs++;
+        os_mutex_unlock(prefetch->lock);
+        if (os_thread_create(&attr, segment_prefetch_thread, prefetch) == NULL) {
+            os_mutex_lock(prefetch->lock);
+            prefetch->refs--;
+            os_mutex_unlock(prefetch->lock);
+            break;
+        }
+        workers++;
+    }
+    if (workers == 0) {
+        segment_prefetch_free(prefetch);
+        return NULL;
+    }
+
+    prefetch->segments_max = workers;
+    OS_LOGD(TAG, "Prefetching %d segments, cache size:%d", workers, cache_size);
+    return prefetch;
+}
+
+int segment_prefetch_pending(segment_prefetch_handle_t prefetch)
+{
+    int count = 0;
+    struct listnode *item;
+    os_mutex_lock(prefetch->lock);
+    list_for_each(item, &prefetch->segments)
+        count++;
+    os_mutex_unlock(prefetch->lock);
+    return count;
+}
+
+int segment_prefetch_vacancy(segment_prefetch_handle_t prefetch)
+{
+    return prefetch->segments_max - segment_prefetch_pending(prefetch);
+}
+
+int segment_prefetch_bandwidth(segment_prefetch_handle_t prefetch)
+{
+    os_mutex_lock(prefetch->lock);
+    int bandwidth = prefetch->bandwidth;
+    os_mutex_unlock(prefetch->lock);
+    return bandwidth;
+}
+
+int segment_prefetch_reconnects(segment_prefetch_handle_t prefetch)
+{
+    os_mutex_lock(prefetch->lock);
+    int reconnects = prefetch->reconnects;
+    prefetch->reconnects = 0;
+    os_mutex_unlock(prefetch->lock);
+    return reconnects;
+}
+
+int segment_prefetch_queue(segment_prefetch_handle_t prefetch, const char *url, long long content_pos)
+{
+    struct prefetch_segment *seg = audio_calloc(1, sizeof(struct prefetch_segment));
+    if (seg == NULL)
+        return -1;
+    seg->url = audio_strdup(url);
+    if (seg->url == NULL) {
+        audio_free(seg);
+        return -1;
+    }
+    seg->content_pos = content_pos;
+    seg->state = PREFETCH_SEGMENT_PENDING;
+    list_init(&seg->chunks);
+
+    os_mutex_lock(prefetch->lock);
+    list_add_tail(&prefetch->segments, &seg->listnode);
+    os_cond_broadcast(prefetch->cond);
+    os_mutex_unlock(prefetch->lock);
+    return 0;
+}
+
+int segment_prefetch_read(segment_prefetch_handle_t prefetch, char *buffer, int size)
+{
+    int ret = -1;
+
+    os_mutex_lock(prefetch->lock);
+    while (!prefetch->abort && !list_empty(&prefetch->segments)) {
+        struct listnode *front = list_head(&prefetch->segments);
+        struct prefetch_segment *seg = listnode_to_item(front, struct prefetch_segment, listnode);
+
+        if (!list_empty(&seg->chunks)) {
+            ret = 0;
+            while (ret < size && !list_empty(&seg->chunks)) {
+                struct listnode *item = list_head(&seg->chunks);
+                struct prefetch_chunk *chunk = listnode_to_item(item, struct prefetch_chunk, listnode);
+                int bytes = chunk->size - chunk->offset;
+                if (bytes > size - ret)
+                    bytes = size - ret;
+                memcpy(buffer + ret, chunk->data + chunk->offset, bytes);
+                chunk->offset += bytes;
+                ret += bytes;
+                if (chunk->offset == chunk->size) {
+                    list_remove(item);
+                    audio_free(chunk);
+                }
+            }
+            seg->cached -= ret;
+            prefetch->cached -= ret;
+            os_cond_broadcast(prefetch->cond);
+            break;
+        }
+
+        if (seg->state == PREFETCH_SEGMENT_DONE || seg->state == PREFETCH_SEGMENT_FAILED) {
+            ret = seg->state == PREFETCH_SEGMENT_DONE ? 0 : -1;
+            list_remove(front);
+            prefetch_segment_free(seg);
+            os_cond_broadcast(prefetch->cond); // the next segment is playing now
+            break;
+        }
+
+        os_cond_wait(prefetch->cond, prefetch->lock);
+    }
+    os_mutex_unlock(prefetch->lock);
+    return ret;
+}
+
+void segment_prefetch_abort(segment_prefetch_handle_t prefetch)
+{
+    os_mutex_lock(prefetch->lock);
+    prefetch->abort = true;
+    os_cond_broadcast(prefetch->cond);
+    os_mutex_unlock(prefetch->lock);
+}
+
+void segment_prefetch_destroy(segment_prefetch_handle_t prefetch)
+{
+    if (prefetch == NULL)
+        return;
+    segment_prefetch_abort(prefetch);
+    os_mutex_lock(prefetch->lock);
+    bool last = --prefetch->refs == 0;
+    os_mutex_unlock(prefetch->lock);
+    if (last)
+        segment_prefetch_free(prefetch);
+}
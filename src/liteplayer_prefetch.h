@@ -0,0 +1,72 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef _LITEPLAYER_PREFETCH_H_
+#define _LITEPLAYER_PREFETCH_H_
+
+#include "liteplayer_adapter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct segment_prefetch *segment_prefetch_handle_t;
+
+/*
+ * Downloads queued segments of hls in the background, @segments at the same time,
+ * and feeds them in order. Bytes waiting to be read are bounded by @cache_size, the
+ * playing segment always keeps a quarter of it, so that segments behind can't starve it.
+ * A failed download is reconnected and resumed, hidden behind the bytes already cached.
+ * Worker threads may outlive the handle till their blocking read returns.
+ */
+segment_prefetch_handle_t segment_prefetch_create(struct source_wrapper *source_ops,
+                                                  int segments, int cache_size);
+
+// Segments queued and not read up yet, the playing one included
+int segment_prefetch_pending(segment_prefetch_handle_t prefetch);
+
+// Segments may be queued now, one worker is left for each
+int segment_prefetch_vacancy(segment_prefetch_handle_t prefetch);
+
+/*
+ * Download throughput in bits per second, 0 if not measured yet. Sampled when a segment is
+ * downloaded and smoothed, time spent waiting for the cache to drain isn't counted, so it
+ * tells what the network sustains rather than how fast the segments are played.
+ */
+int segment_prefetch_bandwidth(segment_prefetch_handle_t prefetch);
+
+// Downloads reconnected since the last call, e.g. to add to source_reconnects of stats
+int segment_prefetch_reconnects(segment_prefetch_handle_t prefetch);
+
+// Queue @url to download from @content_pos, @url is copied
+int segment_prefetch_queue(segment_prefetch_handle_t prefetch, const char *url, long long content_pos);
+
+/*
+ * Read bytes of the first queued segment, blocks till any is downloaded.
+ * Returns 0 if the segment is read up, -1 if it failed or nothing is queued or aborted,
+ * the segment is dropped in both cases and the next read goes on with the next one.
+ */
+int segment_prefetch_read(segment_prefetch_handle_t prefetch, char *buffer, int size);
+
+// Wake up and fail the blocking read, downloads are stopped
+void segment_prefetch_abort(segment_prefetch_handle_t prefetch);
+
+void segment_prefetch_destroy(segment_prefetch_handle_t prefetch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _LITEPLAYER_PREFETCH_H_
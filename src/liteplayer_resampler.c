@@ -0,0 +1,292 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "cutils/log_helper.h"
+#include "esp_adf/audio_common.h"
+#include "liteplayer_resampler.h"
+
+#define TAG "[liteplayer]resampler"
+
+// taps per phase, multiple of 8 for the simd kernels
+#define RESAMPLER_TAPS          ( 24 )
+// phases are quantized if the reduced output rate is larger, e.g. 11025->48000
+#define RESAMPLER_MAX_PHASES    ( 640 )
+#define RESAMPLER_KAISER_BETA   ( 7.0 )
+#define RESAMPLER_CUTOFF        ( 0.92 )  // of the lower nyquist
+#define RESAMPLER_MAX_CHANNELS  ( 2 )
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+struct resampler {
+    int in_rate;
+    int out_rate;
+    int channels;
+    int step;           // input advance per output frame = step/den samples
+    int den;
+    int phases;
+    short *coefs;       // phases * RESAMPLER_TAPS, Q15
+    int frac;           // output position between two input samples, in 1/den
+    short *history[RESAMPLER_MAX_CHANNELS]; // deinterleaved input, filter window starts at 0
+    int filled;
+    int size;
+};
+
+static int resampler_gcd(int a, int b)
+{
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static double resampler_bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// windowed sinc, each phase is normalized to unity dc gain
+static void resampler_build_coefs(struct resampler *rs)
+{
+    double cutoff = RESAMPLER_CUTOFF * 0.5;
+    if (rs->out_rate < rs->in_rate)
+        cutoff = cutoff * rs->out_rate / rs->in_rate;
+    double i0_beta = resampler_bessel_i0(RESAMPLER_KAISER_BETA);
+    double half = RESAMPLER_TAPS / 2;
+    double taps[RESAMPLER_TAPS];
+
+    for (int p = 0; p < rs->phases; p++) {
+        double sum = 0.0;
+        for (int k = 0; k < RESAMPLER_TAPS; k++) {
+            double d = (k - half + 1) - (double)p / rs->phases;
+            double x = d / half;
+            double w = x*x < 1.0 ? resampler_bessel_i0(RESAMPLER_KAISER_BETA * sqrt(1.0 - x*x)) / i0_beta : 0.0;
+            double s = d == 0.0 ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * d) / (M_PI * d);
+            taps[k] = s * w;
+            sum += taps[k];
+        }
+        for (int k = 0; k < RESAMPLER_TAPS; k++)
+            rs->coefs[p * RESAMPLER_TAPS + k] = (short)lrint(taps[k] / sum * 32768.0);
+    }
+}
+
+static inline short resampler_sat16(int sample)
+{
+    if (sample > 32767)
+        return 32767;
+    if (sample < -32768)
+        return -32768;
+    return (short)sample;
+}
+
+static inline short resampler_dot(const short *x, const short *c)
+{
+    int acc = 1 << 14;
+    int k = 0;
+#if defined(__SSE2__)
+    __m128i sum = _mm_setzero_si128();
+    for (; k < RESAMPLER_TAPS; k += 8) {
+        __m128i vx = _mm_loadu_si128((const __m128i *)(x + k));
+        __m128i vc = _mm_loadu_si128((const __m128i *)(c + k));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(vx, vc));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    acc += _mm_cvtsi128_si32(sum);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    int32x4_t sum = vdupq_n_s32(0);
+    for (; k < RESAMPLER_TAPS; k += 8) {
+        int16x8_t vx = vld1q_s16(x + k);
+        int16x8_t vc = vld1q_s16(c + k);
+        sum = vmlal_s16(sum, vget_low_s16(vx), vget_low_s16(vc));
+        sum = vmlal_s16(sum, vget_high_s16(vx), vget_high_s16(vc));
+    }
+    int32x2_t sum2 = vadd_s32(vget_low_s32(sum), vget_high_s32(sum));
+    acc += vget_lane_s32(vpadd_s32(sum2, sum2), 0);
+#else
+    for (; k < RESAMPLER_TAPS; k++)
+        acc += x[k] * c[k];
+#endif
+    return resampler_sat16(acc >> 15);
+}
+
+resampler_handle_t resampler_create(int in_rate, int out_rate, int channels)
+{
+    if (in_rate <= 0 || out_rate <= 0 || channels <= 0 || channels > RESAMPLER_MAX_CHANNELS)
+        return NULL;
+    // window advances at most half of the taps per output frame
+    if (in_rate > out_rate * (RESAMPLER_TAPS / 2)) {
+        OS_LOGE(TAG, "Unsupported ratio: %d->%d", in_rate, out_rate);
+        return NULL;
+    }
+
+    struct resampler *rs = audio_calloc(1, sizeof(struct resampler));
+    if (rs == NULL)
+        return NULL;
+
+    int gcd = resampler_gcd(in_rate, out_rate);
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->channels = channels;
+    rs->step = in_rate / gcd;
+    rs->den = out_rate / gcd;
+    rs->phases = rs->den < RESAMPLER_MAX_PHASES ? rs->den : RESAMPLER_MAX_PHASES;
+    rs->coefs = audio_calloc(rs->phases * RESAMPLER_TAPS, sizeof(short));
+    if (rs->coefs == NULL)
+        goto create_fail;
+    resampler_build_coefs(rs);
+    if (resampler_reset(rs) != 0)
+        goto create_fail;
+
+    OS_LOGD(TAG, "Resampler created: %d->%d, channels:%d, phases:%d", in_rate, out_rate, channels, rs->phases);
+    return rs;
+
+create_fail:
+    resampler_destroy(rs);
+    return NULL;
+}
+
+int resampler_get_output_frames(resampler_handle_t handle, int in_frames)
+{
+    // history holds less than RESAMPLER_TAPS frames not yet consumed
+    long long frames = (long long)(in_frames + RESAMPLER_TAPS) * handle->den / handle->step + 1;
+    return (int)frames;
+}
+
+static int resampler_reserve(struct resampler *rs, int size)
+{
+    if (size <= rs->size)
+        return 0;
+    for (int ch = 0; ch < rs->channels; ch++) {
+        short *history = audio_realloc(rs->history[ch], size * sizeof(short));
+        if (history == NULL) {
+            OS_LOGE(TAG, "Failed to allocate history buffer");
+            return -1;
+        }
+        rs->history[ch] = history;
+    }
+    rs->size = size;
+    return 0;
+}
+
+// Filter the history into @out, outputs centered at or after input frame @end are not
+// produced, @end is beyond the history unless the tail is being flushed
+static int resampler_run(struct resampler *rs, short *out, int end)
+{
+    int channels = rs->channels;
+    int pos = 0, frac = rs->frac, out_frames = 0;
+
+    while (pos + RESAMPLER_TAPS <= rs->filled &&
+           (long long)(pos + RESAMPLER_TAPS/2 - 1 - end) * rs->den + frac < 0) {
+        int phase = rs->phases == rs->den ? frac : (int)((long long)frac * rs->phases / rs->den);
+        const short *coefs = rs->coefs + phase * RESAMPLER_TAPS;
+        for (int ch = 0; ch < channels; ch++)
+            out[out_frames*channels + ch] = resampler_dot(rs->history[ch] + pos, coefs);
+        out_frames++;
+        frac += rs->step;
+        pos += frac / rs->den;
+        frac %= rs->den;
+    }
+    rs->frac = frac;
+
+    if (pos > 0) {
+        int remain = rs->filled - pos;
+        for (int ch = 0; ch < channels; ch++)
+            memmove(rs->history[ch], rs->history[ch] + pos, remain * sizeof(short));
+        rs->filled = remain;
+    }
+    return out_frames;
+}
+
+int resampler_process(resampler_handle_t handle, const short *in, int in_frames, short *out)
+{
+    struct resampler *rs = handle;
+    int channels = rs->channels;
+
+    if (resampler_reserve(rs, rs->filled + in_frames) != 0)
+        return -1;
+
+    for (int ch = 0; ch < channels; ch++) {
+        short *history = rs->history[ch] + rs->filled;
+        for (int i = 0; i < in_frames; i++)
+            history[i] = in[i*channels + ch];
+    }
+    rs->filled += in_frames;
+
+    return resampler_run(rs, out, rs->filled + RESAMPLER_TAPS);
+}
+
+int resampler_flush(resampler_handle_t handle, short *out)
+{
+    struct resampler *rs = handle;
+    int end = rs->filled;
+    int tail = RESAMPLER_TAPS / 2; // zeros for the window of the last input frame
+
+    if (resampler_reserve(rs, rs->filled + tail) != 0)
+        return -1;
+    for (int ch = 0; ch < rs->channels; ch++)
+        memset(rs->history[ch] + rs->filled, 0x0, tail * sizeof(short));
+    rs->filled += tail;
+
+    int out_frames = resampler_run(rs, out, end);
+    if (resampler_reset(rs) != 0)
+        return -1;
+    return out_frames;
+}
+
+int resampler_reset(resampler_handle_t handle)
+{
+    struct resampler *rs = handle;
+    int prefill = RESAMPLER_TAPS / 2 - 1; // first output is aligned to the first input
+
+    rs->filled = 0;
+    rs->frac = 0;
+    if (resampler_reserve(rs, prefill) != 0)
+        return -1;
+    for (int ch = 0; ch < rs->channels; ch++)
+        memset(rs->history[ch], 0x0, prefill * sizeof(short));
+    rs->filled = prefill;
+    return 0;
+}
+
+void resampler_destroy(resampler_handle_t handle)
+{
+    if (handle == NULL)
+        return;
+    for (int ch = 0; ch < RESAMPLER_MAX_CHANNELS; ch++) {
+        if (handle->history[ch] != NULL)
+            audio_free(handle->history[ch]);
+    }
+    if (handle->coefs != NULL)
+        audio_free(handle->coefs);
+    audio_free(handle);
+}
@@ -0,0 +1,51 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _LITEPLAYER_RESAMPLER_H_
+#define _LITEPLAYER_RESAMPLER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct resampler *resampler_handle_t;
+
+/*
+ * Polyphase resampler for interleaved s16 pcm, windowed-sinc filter with Q15
+ * coefficients, the ratio in_rate/out_rate is kept exact. Filter tables are
+ * built on creating, processing is fixed-point only.
+ */
+resampler_handle_t resampler_create(int in_rate, int out_rate, int channels);
+
+// Max frames output for @in_frames input frames
+int resampler_get_output_frames(resampler_handle_t handle, int in_frames);
+
+// Consume all @in_frames, returns frames written to @out, or -1 if failed
+int resampler_process(resampler_handle_t handle, const short *in, int in_frames, short *out);
+
+// Output the tail held in the filter at the end of stream, at most
+// resampler_get_output_frames(handle, 0) frames, then reset for the next stream,
+// returns frames written to @out, or -1 if failed
+int resampler_flush(resampler_handle_t handle, short *out);
+
+// Drop the filter history, e.g. after seeking, returns -1 if failed
+int resampler_reset(resampler_handle_t handle);
+
+void resampler_destroy(resampler_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _LITEPLAYER_RESAMPLER_H_
@@ -0,0 +1,194 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "osal/os_thread.h"
+#include "cutils/log_helper.h"
+#include "cutils/ringbuf.h"
+#include "esp_adf/audio_common.h"
+
+#include "liteplayer_config.h"
+#include "liteplayer_sink.h"
+#include "liteplayer_trace_internal.h"
+
+#define TAG "[liteplayer]sink"
+
+struct media_sink_priv {
+    struct media_sink_info info;
+
+    media_sink_state_cb listener;
+    void *listener_priv;
+
+    os_thread tid;
+    bool stop;
+    os_mutex lock; // lock for stop
+};
+
+static void media_sink_cleanup(struct media_sink_priv *priv)
+{
+    if (priv->lock != NULL)
+        os_mutex_destroy(priv->lock);
+    audio_free(priv);
+}
+
+static bool media_sink_stopped(struct media_sink_priv *priv)
+{
+    os_mutex_lock(priv->lock);
+    bool stop = priv->stop;
+    os_mutex_unlock(priv->lock);
+    return stop;
+}
+
+static void *media_sink_thread(void *arg)
+{
+    struct media_sink_priv *priv = (struct media_sink_priv *)arg;
+    ringbuf_handle rb = priv->info.in_ringbuf;
+    int bytes_want = priv->info.prefill_size > priv->info.chunk_size ?
+                     priv->info.prefill_size : priv->info.chunk_size;
+    char *pcm = NULL;
+    bool starved = true; // not counted as underrun before the first write
+
+    OS_LOGD(TAG, "Media sink thread enter, prefill:%d, chunk:%d", bytes_want, priv->info.chunk_size);
+
+    while (!media_sink_stopped(priv)) {
+        // ringbuf is drained while playing, decoder can't keep up
+        if (!starved && rb_bytes_filled(rb) < bytes_want && !rb_is_done_write(rb)) {
+            media_stats_underrun(priv->info.stats);
+            starved = true;
+        }
+        // block until pcm arrives, media_sink_stop() unblocks it
+        LITEPLAYER_TRACE_BEGIN(wait);
+        int bytes_read = rb_acquire_read(rb, &pcm, bytes_want, 0);
+        LITEPLAYER_TRACE_END(wait, "ringbuf_read");
+        if (bytes_read == RB_TIMEOUT) {
+            continue;
+        } else if (bytes_read == RB_DONE) {
+            OS_LOGD(TAG, "Media sink drained");
+            if (priv->listener)
+                priv->listener(MEDIA_SINK_WRITE_DONE, 0, priv->listener_priv);
+            break;
+        } else if (bytes_read == RB_ABORT) {
+            break;
+        } else if (bytes_read <= 0) {
+            OS_LOGE(TAG, "Failed to read pcm ringbuf, ret:%d", bytes_read);
+            if (priv->listener)
+                priv->listener(MEDIA_SINK_WRITE_FAILED, 0, priv->listener_priv);
+            rb_done_read(rb);
+            break;
+        }
+
+        bytes_want = priv->info.chunk_size;
+        starved = false;
+        // scaled pcm is written out in full, it can't be left in ringbuf for the next read,
+        // which copies the wrapped head again from unscaled pcm
+        bool scaled = priv->info.volume != NULL &&
+                      volume_process(priv->info.volume, pcm, bytes_read) > 0;
+        bool failed = false;
+        do {
+            unsigned long long begin = media_stats_clock(priv->info.stats);
+            LITEPLAYER_TRACE_BEGIN(trace);
+            int bytes_written = priv->info.sink_ops->write(priv->info.sink_handle, pcm, bytes_read);
+            LITEPLAYER_TRACE_END(trace, "sink_write");
+            media_stats_sink_write(priv->info.stats, media_stats_clock(priv->info.stats) - begin,
+                                   bytes_written < bytes_read);
+            if (bytes_written < 0 || bytes_written > bytes_read) {
+                OS_LOGE(TAG, "Failed to write pcm, ret:%d", bytes_written);
+                if (priv->listener)
+                    priv->listener(MEDIA_SINK_WRITE_FAILED, 0, priv->listener_priv);
+                rb_done_read(rb); // unblock decoder
+                failed = true;
+                break;
+            }
+            rb_commit_read(rb, bytes_written);
+            if (priv->listener)
+                priv->listener(MEDIA_SINK_WRITE_SUCCEED, bytes_written, priv->listener_priv);
+            pcm += bytes_written;
+            bytes_read -= bytes_written;
+        } while (scaled && bytes_read > 0 && !media_sink_stopped(priv));
+        if (failed)
+            break;
+    }
+
+    OS_LOGD(TAG, "Media sink thread leave");
+    LITEPLAYER_TRACE_THREAD_EXIT();
+    return NULL;
+}
+
+media_sink_handle_t media_sink_start_async(struct media_sink_info *info,
+                                           media_sink_state_cb listener,
+                                           void *listener_priv)
+{
+    if (info == NULL || info->in_ringbuf == NULL || info->sink_ops == NULL ||
+        info->sink_handle == NULL || info->chunk_size <= 0)
+        return NULL;
+
+    struct media_sink_priv *priv = audio_calloc(1, sizeof(struct media_sink_priv));
+    if (priv == NULL)
+        return NULL;
+
+    memcpy(&priv->info, info, sizeof(struct media_sink_info));
+    priv->listener = listener;
+    priv->listener_priv = listener_priv;
+    priv->lock = os_mutex_create();
+    if (priv->lock == NULL)
+        goto start_failed;
+
+    struct os_thread_attr attr = {
+        .name = "ael-sink",
+        .priority = DEFAULT_MEDIA_SINK_TASK_PRIO,
+        .stacksize = DEFAULT_MEDIA_SINK_TASK_STACKSIZE,
+        .joinable = true,
+    };
+    priv->tid = os_thread_create(&attr, media_sink_thread, priv);
+    if (priv->tid == NULL)
+        goto start_failed;
+
+    return priv;
+
+start_failed:
+    media_sink_cleanup(priv);
+    return NULL;
+}
+
+void media_sink_stop(media_sink_handle_t handle)
+{
+    struct media_sink_priv *priv = (struct media_sink_priv *)handle;
+    if (priv == NULL)
+        return;
+
+    {
+        os_mutex_lock(priv->lock);
+        priv->stop = true;
+        os_mutex_unlock(priv->lock);
+    }
+    // wake up the thread waiting for pcm, ringbuf isn't aborted as it's kept for next start
+    rb_unblock_reader(priv->info.in_ringbuf);
+
+    os_thread_join(priv->tid, NULL);
+    media_sink_cleanup(priv);
+}
+
+void media_sink_drain(media_sink_handle_t handle)
+{
+    struct media_sink_priv *priv = (struct media_sink_priv *)handle;
+    if (priv == NULL)
+        return;
+
+    rb_done_write(priv->info.in_ringbuf);
+
+    os_thread_join(priv->tid, NULL);
+    media_sink_cleanup(priv);
+}
@@ -0,0 +1,67 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _LITEPLAYER_MEDIASINK_H_
+#define _LITEPLAYER_MEDIASINK_H_
+
+#include "cutils/ringbuf.h"
+#include "liteplayer_adapter.h"
+#include "liteplayer_stats.h"
+#include "liteplayer_volume.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum media_sink_state {
+    MEDIA_SINK_WRITE_SUCCEED,
+    MEDIA_SINK_WRITE_FAILED,
+    MEDIA_SINK_WRITE_DONE,
+};
+
+// @bytes: pcm bytes written to sink if MEDIA_SINK_WRITE_SUCCEED
+typedef void (*media_sink_state_cb)(enum media_sink_state state, int bytes, void *priv);
+
+struct media_sink_info {
+    sink_handle_t sink_handle;
+    struct sink_wrapper *sink_ops;
+    ringbuf_handle in_ringbuf;
+    int chunk_size;   // bytes written to sink each time, multiple of frame size
+    int prefill_size; // bytes buffered before the first write, to absorb decoding jitter
+    media_stats_handle_t stats; // optional, counts sink write latency, underruns and xruns
+    volume_handle_t volume; // optional, applied to pcm right before it's written to sink
+};
+
+typedef void *media_sink_handle_t;
+
+/*
+ * Start a thread that moves pcm from in_ringbuf to the sink, decoder only writes
+ * into the ringbuf, so a slow sink doesn't stall decoding, and a slow frame doesn't
+ * starve the sink as long as the ringbuf isn't drained.
+ */
+media_sink_handle_t media_sink_start_async(struct media_sink_info *info,
+                                           media_sink_state_cb listener,
+                                           void *listener_priv);
+
+// Stop and join the sink thread, pcm left in ringbuf is kept for the next start
+void media_sink_stop(media_sink_handle_t handle);
+
+// Mark ringbuf write done, wait all pcm is written to sink, then join the sink thread
+void media_sink_drain(media_sink_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _LITEPLAYER_MEDIASINK_H_
@@ -16,24 +16,29 @@
 #include <string.h>
 
 #include "osal/os_thread.h"
+#include "osal/os_time.h"
 #include "cutils/log_helper.h"
 #include "cutils/ringbuf.h"
-#include "cutils/list.h"
 #include "esp_adf/audio_common.h"
 
 #include "liteplayer_config.h"
 #include "liteplayer_source.h"
+#include "liteplayer_m3u.h"
+#include "liteplayer_prefetch.h"
+#include "liteplayer_trace_internal.h"
 
 #define TAG "[liteplayer]source"
 
 #define DEFAULT_MEDIA_SOURCE_BUFFER_SIZE ( 1024*8+1 )
 
-#define DEFAULT_M3U_BUFFER_SIZE    ( 1024*16 )
 #define DEFAULT_M3U_FILL_THRESHOLD ( 1024*32 )
+#define DEFAULT_M3U_RELOAD_RETRY   ( 3 )
 
 struct media_source_priv {
     struct media_source_info info;
-    struct listnode m3u_list;
+    struct source_wrapper source_ops; // copied, source thread may outlive the player adapter
+    struct m3u_playlist m3u;
+    segment_prefetch_handle_t prefetch; // segments of m3u downloading in the background
 
     media_source_state_cb listener;
     void *listener_priv;
@@ -43,203 +48,58 @@ struct media_source_priv {
     os_cond cond;  // wait stop to exit mediasource thread
 };
 
-struct m3u_node {
-    const char *url;
-    struct listnode listnode;
-};
-
 static void media_source_cleanup(struct media_source_priv *priv);
 
-static void m3u_list_clear(struct listnode *list)
+/*
+ * Waits for free space without holding priv->lock, so media_source_stop() never
+ * blocks behind a full ringbuf. The copy and commit are done under priv->lock,
+ * nothing gets into the ringbuf once stop is set, the caller may reset it safely.
+ */
+static int media_source_write(struct media_source_priv *priv, char *buffer, int size)
 {
-    struct listnode *item, *tmp;
-    list_for_each_safe(item, tmp, list) {
-        struct m3u_node *node = listnode_to_item(item, struct m3u_node, listnode);
-        list_remove(item);
-        audio_free(node->url);
-        audio_free(node);
-    }
-}
-
-static int m3u_list_insert(struct listnode *list, const char *url)
-{
-    struct m3u_node *node = audio_malloc(sizeof(struct m3u_node));
-    if (node == NULL)
-        return -1;
-    node->url = audio_strdup(url);
-    if (node->url == NULL) {
-        audio_free(node);
-        return -1;
-    }
-    list_add_tail(list, &node->listnode);
-    return 0;
-}
-
-static char *m3u_parser_get_line(char *buffer, int *index, int *remain)
-{
-    char c, *out = NULL;
-    if (*remain > 0) {
-        bool line_end = false;
-        out = buffer + *index;
-        int idx = *index;
-        while ((c = buffer[idx]) != 0) {
-            if (c == '\r' || c == '\n') {
-                buffer[idx] = 0;
-                line_end = true;
-            } else if (line_end) {
-                *remain -= idx - *index;
-                *index = idx;
-                return out;
-            }
-            idx++;
-            if (idx == (*index + *remain)) {
-                *remain = 0;
-                return out;
-            }
-        }
-    }
-    return NULL;
-}
-
-static int m3u_parser_process_line(struct media_source_priv *priv, char *line)
-{
-    char temp[256];
-    int ret = -1;
-    if (strstr(line, "http") == line) { // full uri
-        ret = m3u_list_insert(&priv->m3u_list, line);
-    } else if (strstr(line, "//") == line) { //schemeless uri
-        if (strstr(priv->info.url, "https") == priv->info.url)
-            snprintf(temp, sizeof(temp), "https:%s", line);
-        else
-            snprintf(temp, sizeof(temp), "http:%s", line);
-        ret = m3u_list_insert(&priv->m3u_list, temp);
-    } else if (strstr(line, "/") == line) { // Root uri
-        char *dup_url = audio_strdup(priv->info.url);
-        if (dup_url == NULL) {
-            return -1;
-        }
-        char *host = strstr(dup_url, "//");
-        if (host == NULL) {
-            audio_free(dup_url);
-            return -1;
-        }
-        host += 2;
-        char *path = strstr(host, "/");
-        if (path == NULL) {
-            audio_free(dup_url);
-            return -1;
-        }
-        path[0] = 0;
-        snprintf(temp, sizeof(temp), "%s%s", dup_url, line);
-        audio_free(dup_url);
-        ret = m3u_list_insert(&priv->m3u_list, temp);
-    } else { // Relative URI
-        char *dup_url = audio_strdup(priv->info.url);
-        if (dup_url == NULL) {
-            return -1;
-        }
-        char *pos = strrchr(dup_url, '/'); // Search for last "/"
-        if (pos == NULL) {
-            audio_free(dup_url);
-            return -1;
-        }
-        pos[1] = '\0';
-        snprintf(temp, sizeof(temp), "%s%s", dup_url, line);
-        audio_free(dup_url);
-        ret = m3u_list_insert(&priv->m3u_list, temp);
+    char *span = NULL;
+    unsigned long long begin = media_stats_clock(priv->info.stats);
+    LITEPLAYER_TRACE_BEGIN(trace);
+    int ret = rb_acquire_write(priv->info.out_ringbuf, &span, size, AUDIO_MAX_DELAY);
+    LITEPLAYER_TRACE_END(trace, "ringbuf_write");
+    if (ret <= 0)
+        return ret;
+
+    os_mutex_lock(priv->lock);
+    if (!priv->stop) {
+        memcpy(span, buffer, ret);
+        rb_commit_write(priv->info.out_ringbuf, ret);
+        // stats belong to the player, which may be gone once stop is set
+        media_stats_ringbuf_write(priv->info.stats, media_stats_clock(priv->info.stats) - begin);
+        media_stats_source_read(priv->info.stats, ret);
+    } else {
+        ret = RB_ABORT;
     }
+    os_mutex_unlock(priv->lock);
     return ret;
 }
 
-static int m3u_parser_resolve(struct media_source_priv *priv)
+// Add reconnects of prefetch workers to stats, which are only touched by this thread
+static void m3u_source_count_reconnects(struct media_source_priv *priv, segment_prefetch_handle_t prefetch)
 {
-    int ret = -1;
-    source_handle_t http = NULL;
-    char *content = audio_malloc(DEFAULT_M3U_BUFFER_SIZE);
-    if (content == NULL)
-        goto resolve_done;
-
-    http = priv->info.source_ops->open(priv->info.url, 0, priv->info.source_ops->priv_data);
-    if (http == NULL) {
-        OS_LOGE(TAG, "Failed to connect m3u url");
-        goto resolve_done;
-    }
-
-    int bytes_read = priv->info.source_ops->read(http, content, DEFAULT_M3U_BUFFER_SIZE);
-    if (bytes_read <= 0) {
-        OS_LOGE(TAG, "Failed to read m3u content");
-        goto resolve_done;
-    }
-    OS_LOGV(TAG, "Succeed to read m3u content:\n%s", content);
-
-    int index = 0, remain = bytes_read;
-    char *line = NULL;
-    bool is_valid_m3u = false;
-    bool is_valid_url = false;
-    while ((line = m3u_parser_get_line(content, &index, &remain)) != NULL) {
-        if (!is_valid_m3u && strcmp(line, "#EXTM3U") == 0) {
-            is_valid_m3u = true;
-            continue;
-        }
-        if (strstr(line, "http") == line) {
-            m3u_parser_process_line(priv, line);
-            is_valid_m3u = true;
-            continue;
-        }
-        if (!is_valid_m3u) {
-            break;
-        }
-        if (!is_valid_url && strstr(line, "#EXTINF") == line) {
-            is_valid_url = true;
-            continue;
-        } else if (!is_valid_url && strstr(line, "#EXT-X-STREAM-INF") == line) {
-            /**
-             * As these are stream URIs we need to fetch thse periodically to keep live streaming.
-             * For now we handle it same as normal uri and exit.
-             */
-            is_valid_url = true;
-            continue;
-        } else if (strncmp(line, "#", 1) == 0) {
-            /**
-             * Some other playlist field we don't support.
-             * Simply treat this as a comment and continue to find next line.
-             */
-            continue;
-        }
-        if (!is_valid_url) {
-            continue;
-        }
-        is_valid_url = false;
-        m3u_parser_process_line(priv, line);
-    }
-
-    if (!list_empty(&priv->m3u_list))
-        ret = 0;
-
-#if defined(SYSUTILS_HAVE_VERBOSE_LOG_ENABLED)
-    struct listnode *item;
-    int i = 0;
-    list_for_each(item, &priv->m3u_list) {
-        struct m3u_node *node = listnode_to_item(item, struct m3u_node, listnode);
-        OS_LOGV(TAG, "-->m3ulist: url[%d]=[%s]", i++, node->url);
-    }
-#endif
-
-resolve_done:
-    if (http != NULL)
-        priv->info.source_ops->close(http);
-    if (content != NULL)
-        audio_free(content);
-    return ret;
+    int reconnects = segment_prefetch_reconnects(prefetch);
+    if (reconnects == 0)
+        return;
+    os_mutex_lock(priv->lock);
+    for (; reconnects > 0 && !priv->stop; reconnects--)
+        media_stats_source_reconnect(priv->info.stats);
+    os_mutex_unlock(priv->lock);
 }
 
 static void *m3u_source_thread(void *arg)
 {
     struct media_source_priv *priv = (struct media_source_priv *)arg;
     enum media_source_state state = MEDIA_SOURCE_READ_FAILED;
-    source_handle_t http = NULL;
+    segment_prefetch_handle_t prefetch = NULL;
     char *buffer = NULL;
     long long pos = priv->info.content_pos;
+    unsigned long long reload_usec = 0; // 0 if not live
+    int reload_failures = 0;
     int ret = 0;
 
     buffer = audio_malloc(DEFAULT_MEDIA_SOURCE_BUFFER_SIZE);
@@ -248,17 +108,88 @@ static void *m3u_source_thread(void *arg)
         goto thread_exit;
     }
 
+    prefetch = segment_prefetch_create(priv->info.source_ops,
+            priv->info.prefetch_segments, priv->info.prefetch_cache_size);
+    if (prefetch == NULL) {
+        OS_LOGE(TAG, "Failed to create segment prefetch");
+        goto thread_exit;
+    }
+    os_mutex_lock(priv->lock);
+    priv->prefetch = prefetch; // aborted by media_source_stop(), destroyed with priv
+    if (priv->stop)
+        segment_prefetch_abort(prefetch);
+    os_mutex_unlock(priv->lock);
+
 resolve_m3u:
     if (priv->stop)
         goto thread_exit;
-    ret = m3u_parser_resolve(priv);
-    if (ret != 0) {
+    ret = m3u_playlist_resolve(&priv->m3u);
+resolved_m3u:
+    if (priv->m3u.hls && !priv->m3u.endlist && (ret >= 0 || reload_failures++ < DEFAULT_M3U_RELOAD_RETRY)) {
+        // live, reload after a target duration, or half of it if nothing new, see rfc8216 6.3.4
+        int wait_ms = priv->m3u.target_duration*1000;
+        if (ret <= 0)
+            wait_ms /= 2;
+        if (ret >= 0)
+            reload_failures = 0;
+        reload_usec = os_monotonic_usec() + wait_ms*1000ULL;
+        OS_LOGV(TAG, "Live playlist: %d new segments, next sequence:%lld, reload in %dms",
+                ret, priv->m3u.next_sequence, wait_ms);
+    } else if (ret <= 0 && m3u_list_empty(&priv->m3u.list) && segment_prefetch_pending(prefetch) == 0) {
         OS_LOGE(TAG, "Failed to parse m3u url");
         goto thread_exit;
+    } else {
+        reload_usec = 0;
     }
 
 dequeue_url:
-    if (list_empty(&priv->m3u_list)) {
+    m3u_source_count_reconnects(priv, prefetch);
+    // keep the following segments downloading while the first one is fed
+    while (!m3u_list_empty(&priv->m3u.list) && segment_prefetch_vacancy(prefetch) > 0) {
+        long long sequence = 0;
+        const char *url = m3u_list_front(&priv->m3u.list, &sequence);
+        if (priv->m3u.variant >= 0) {
+            int bandwidth = segment_prefetch_bandwidth(prefetch);
+            int variant = m3u_variant_select(&priv->m3u, bandwidth, sequence);
+            bool switched = variant != priv->m3u.variant;
+            if (switched) {
+                ret = m3u_variant_switch(&priv->m3u, variant, sequence);
+                switched = ret >= 0;
+            }
+            os_mutex_lock(priv->lock);
+            if (!priv->stop)
+                media_stats_hls_bandwidth(priv->info.stats, bandwidth, switched);
+            os_mutex_unlock(priv->lock);
+            if (switched)
+                goto resolved_m3u; // the switched playlist is reloaded as the playing one
+            priv->m3u.variant_segments++;
+        }
+        if (segment_prefetch_queue(prefetch, url, pos) != 0) {
+            OS_LOGE(TAG, "Failed to queue url, request next url");
+            state = MEDIA_SOURCE_READ_FAILED;
+        }
+        pos = 0;
+        m3u_list_pop(&priv->m3u.list);
+    }
+
+    if (segment_prefetch_pending(prefetch) == 0 && priv->m3u.hls) {
+        if (reload_usec == 0) {
+            OS_LOGD(TAG, "All segments played, end of list");
+            goto thread_exit;
+        }
+        // live, sleep till the playlist is reloaded, woken up by media_source_stop()
+        os_mutex_lock(priv->lock);
+        while (!priv->stop) {
+            unsigned long long now = os_monotonic_usec();
+            if (now >= reload_usec)
+                break;
+            os_cond_timedwait(priv->cond, priv->lock, (unsigned long)(reload_usec - now));
+        }
+        os_mutex_unlock(priv->lock);
+        goto resolve_m3u;
+    }
+
+    if (segment_prefetch_pending(prefetch) == 0) {
         int fill_size = 0;
         while (!priv->stop) {
             os_mutex_lock(priv->lock);
@@ -278,29 +209,15 @@ dequeue_url:
         goto resolve_m3u;
     }
 
-    if (http != NULL) {
-        pos = 0;
-        priv->info.source_ops->close(http);
-    }
-
-    struct listnode *front = list_head(&priv->m3u_list);
-    struct m3u_node *node = listnode_to_item(front, struct m3u_node, listnode);
-    http = priv->info.source_ops->open(node->url, pos, priv->info.source_ops->priv_data);
-
-    list_remove(front);
-    audio_free(node->url);
-    audio_free(node);
-
-    if (http == NULL) {
-        OS_LOGE(TAG, "Connect failed, request next url");
-        state = MEDIA_SOURCE_READ_FAILED;
-        goto dequeue_url;
-    }
-
     int bytes_read = 0, bytes_written = 0;
     while (!priv->stop) {
-        if (http != NULL)
-            bytes_read = priv->info.source_ops->read(http, buffer, DEFAULT_MEDIA_SOURCE_BUFFER_SIZE);
+        // reload live playlist in time, segments in flight are kept
+        if (reload_usec != 0 && os_monotonic_usec() >= reload_usec)
+            goto resolve_m3u;
+
+        LITEPLAYER_TRACE_BEGIN(trace);
+        bytes_read = segment_prefetch_read(prefetch, buffer, DEFAULT_MEDIA_SOURCE_BUFFER_SIZE);
+        LITEPLAYER_TRACE_END(trace, "source_read");
         if (bytes_read < 0) {
             OS_LOGE(TAG, "Read failed, request next url");
             state = MEDIA_SOURCE_READ_FAILED;
@@ -313,10 +230,7 @@ dequeue_url:
 
         bytes_written = 0;
         do {
-            os_mutex_lock(priv->lock);
-            if (!priv->stop)
-                ret = rb_write(priv->info.out_ringbuf, &buffer[bytes_written], bytes_read, AUDIO_MAX_DELAY);
-            os_mutex_unlock(priv->lock);
+            ret = media_source_write(priv, &buffer[bytes_written], bytes_read);
 
             if (ret > 0) {
                 bytes_read -= ret;
@@ -335,8 +249,10 @@ dequeue_url:
     }
 
 thread_exit:
-    if (http != NULL)
-        priv->info.source_ops->close(http);
+    if (prefetch != NULL) {
+        m3u_source_count_reconnects(priv, prefetch);
+        segment_prefetch_abort(prefetch);
+    }
     if (buffer != NULL)
         audio_free(buffer);
 
@@ -361,39 +277,24 @@ thread_exit:
 
     media_source_cleanup(priv);
     OS_LOGD(TAG, "M3U source task leave");
+    LITEPLAYER_TRACE_THREAD_EXIT();
     return NULL;
 }
 
-int m3u_get_first_url(struct media_source_info *info, char *buf, int buf_size)
+// First uri of playlist @url resolved, @variant tells if it's a variant of master playlist
+static char *m3u_get_first_uri(struct media_source_info *info, const char *url, bool *variant)
 {
-    if (info == NULL || info->url == NULL || buf == NULL || buf_size <=0)
-        return -1;
-
-    int ret = -1;
-    source_handle_t http = NULL;
-    char *content = audio_malloc(DEFAULT_M3U_BUFFER_SIZE);
-    if (content == NULL)
-        goto resolve_done;
-
-    http = info->source_ops->open(info->url, 0, info->source_ops->priv_data);
-    if (http == NULL) {
-        OS_LOGE(TAG, "Failed to connect m3u url");
-        goto resolve_done;
-    }
-
-    int bytes_read = info->source_ops->read(http, content, DEFAULT_M3U_BUFFER_SIZE);
-    if (bytes_read <= 0) {
-        OS_LOGE(TAG, "Failed to read m3u content");
-        goto resolve_done;
-    }
-    OS_LOGV(TAG, "Succeed to read m3u content:\n%s", content);
+    char *uri = NULL;
+    struct m3u_reader *reader = m3u_reader_open(info->source_ops, url);
+    if (reader == NULL)
+        return NULL;
 
-    int index = 0, remain = bytes_read;
     char *line = NULL;
     char *url_line = NULL;
     bool is_valid_m3u = false;
     bool is_valid_url = false;
-    while ((line = m3u_parser_get_line(content, &index, &remain)) != NULL) {
+    *variant = false;
+    while ((line = m3u_reader_get_line(reader)) != NULL) {
         if (!is_valid_m3u && strcmp(line, "#EXTM3U") == 0) {
             is_valid_m3u = true;
             continue;
@@ -409,10 +310,7 @@ int m3u_get_first_url(struct media_source_info *info, char *buf, int buf_size)
             is_valid_url = true;
             continue;
         } else if (!is_valid_url && strstr(line, "#EXT-X-STREAM-INF") == line) {
-            /**
-             * As these are stream URIs we need to fetch thse periodically to keep live streaming.
-             * For now we handle it same as normal uri and exit.
-             */
+            *variant = true;
             is_valid_url = true;
             continue;
         } else if (strncmp(line, "#", 1) == 0) {
@@ -429,59 +327,28 @@ int m3u_get_first_url(struct media_source_info *info, char *buf, int buf_size)
         break;
     }
 
-    if (url_line != NULL) {
-        if (strstr(url_line, "http") == url_line) { // full uri
-            snprintf(buf, buf_size, "%s", url_line);
-            ret = 0;
-        } else if (strstr(url_line, "//") == url_line) { //schemeless uri
-            if (strstr(info->url, "https") == info->url)
-                snprintf(buf, buf_size, "https:%s", url_line);
-            else
-                snprintf(buf, buf_size, "http:%s", url_line);
-            ret = 0;
-        } else if (strstr(url_line, "/") == url_line) { // Root uri
-            char *dup_url = audio_strdup(info->url);
-            if (dup_url == NULL) {
-                goto resolve_done;
-            }
-            char *host = strstr(dup_url, "//");
-            if (host == NULL) {
-                audio_free(dup_url);
-                goto resolve_done;
-            }
-            host += 2;
-            char *path = strstr(host, "/");
-            if (path == NULL) {
-                audio_free(dup_url);
-                goto resolve_done;
-            }
-            path[0] = 0;
-            snprintf(buf, buf_size, "%s%s", dup_url, url_line);
-            audio_free(dup_url);
-            ret = 0;
-        } else { // Relative URI
-            char *dup_url = audio_strdup(info->url);
-            if (dup_url == NULL) {
-                goto resolve_done;
-            }
-            char *pos = strrchr(dup_url, '/'); // Search for last "/"
-            if (pos == NULL) {
-                audio_free(dup_url);
-                goto resolve_done;
-            }
-            pos[1] = '\0';
-            snprintf(buf, buf_size, "%s%s", dup_url, url_line);
-            audio_free(dup_url);
-            ret = 0;
-        }
-    }
+    if (url_line != NULL && m3u_reader_truncated(reader))
+        OS_LOGE(TAG, "First uri is too long:%.64s", url_line);
+    else if (url_line != NULL)
+        uri = m3u_parser_resolve_uri(url, url_line);
+    m3u_reader_close(reader);
+    return uri;
+}
 
-resolve_done:
-    if (http != NULL)
-        info->source_ops->close(http);
-    if (content != NULL)
-        audio_free(content);
-    return ret;
+char *m3u_get_first_url(struct media_source_info *info)
+{
+    if (info == NULL || info->url == NULL)
+        return NULL;
+
+    bool variant = false;
+    char *uri = m3u_get_first_uri(info, info->url, &variant);
+    if (uri != NULL && variant) {
+        // master playlist, the first variant is played first, see m3u_playlist_resolve()
+        char *playlist = uri;
+        uri = m3u_get_first_uri(info, playlist, &variant);
+        audio_free(playlist);
+    }
+    return uri;
 }
 
 static void media_source_cleanup(struct media_source_priv *priv)
@@ -492,7 +359,9 @@ static void media_source_cleanup(struct media_source_priv *priv)
         os_cond_destroy(priv->cond);
     if (priv->info.url != NULL)
         audio_free(priv->info.url);
-    m3u_list_clear(&priv->m3u_list);
+    m3u_playlist_clear(&priv->m3u);
+    segment_prefetch_destroy(priv->prefetch);
+    media_arena_release(priv->info.arena);
     audio_free(priv);
 }
 
@@ -515,12 +384,18 @@ static void *media_source_thread(void *arg)
             state = MEDIA_SOURCE_READ_FAILED;
             goto thread_exit;
         }
+        os_mutex_lock(priv->lock);
+        if (!priv->stop)
+            media_stats_source_reconnect(priv->info.stats);
+        os_mutex_unlock(priv->lock);
     }
 
     int bytes_read = 0, bytes_written = 0;
     int ret = 0;
     while (!priv->stop) {
+        LITEPLAYER_TRACE_BEGIN(trace);
         bytes_read = priv->info.source_ops->read(priv->info.source_handle, buffer, DEFAULT_MEDIA_SOURCE_BUFFER_SIZE);
+        LITEPLAYER_TRACE_END(trace, "source_read");
         if (bytes_read < 0) {
             OS_LOGE(TAG, "Media source read failed");
             state = MEDIA_SOURCE_READ_FAILED;
@@ -533,10 +408,7 @@ static void *media_source_thread(void *arg)
 
         bytes_written = 0;
         do {
-            os_mutex_lock(priv->lock);
-            if (!priv->stop)
-                ret = rb_write(priv->info.out_ringbuf, &buffer[bytes_written], bytes_read, AUDIO_MAX_DELAY);
-            os_mutex_unlock(priv->lock);
+            ret = media_source_write(priv, &buffer[bytes_written], bytes_read);
 
             if (ret > 0) {
                 bytes_read -= ret;
@@ -583,6 +455,7 @@ thread_exit:
 
     media_source_cleanup(priv);
     OS_LOGD(TAG, "Media source task leave");
+    LITEPLAYER_TRACE_THREAD_EXIT();
     return NULL;
 }
 
@@ -598,12 +471,15 @@ media_source_handle_t media_source_start_async(struct media_source_info *info,
         return NULL;
 
     memcpy(&priv->info, info, sizeof(struct media_source_info));
+    memcpy(&priv->source_ops, info->source_ops, sizeof(struct source_wrapper));
+    priv->info.source_ops = &priv->source_ops;
+    media_arena_hold(priv->info.arena);
     priv->listener = listener;
     priv->listener_priv = listener_priv;
     priv->lock = os_mutex_create();
     priv->cond = os_cond_create();
     priv->info.url = audio_strdup(info->url);
-    list_init(&priv->m3u_list);
+    m3u_playlist_init(&priv->m3u, priv->info.source_ops, priv->info.url);
     if (priv->lock == NULL || priv->cond == NULL || priv->info.url == NULL)
         goto start_failed;
 
@@ -649,6 +525,8 @@ void media_source_stop(media_source_handle_t handle)
     {
         os_mutex_lock(priv->lock);
         priv->stop = true;
+        if (priv->prefetch != NULL)
+            segment_prefetch_abort(priv->prefetch);
         os_cond_signal(priv->cond);
         os_mutex_unlock(priv->lock);
     }
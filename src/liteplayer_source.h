@@ -17,6 +17,8 @@
 
 #include "cutils/ringbuf.h"
 #include "liteplayer_adapter.h"
+#include "liteplayer_stats.h"
+#include "liteplayer_arena.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -39,6 +41,11 @@ struct media_source_info {
     struct source_wrapper *source_ops;
     long long content_pos;
     ringbuf_handle out_ringbuf;
+    media_stats_handle_t stats; // optional, counts bytes read, reconnects and ringbuf blocking
+    media_arena_handle_t arena; // optional, track-scoped allocations, held by async threads
+    int prefetch_segments;      // m3u only, segments downloading at the same time, 0 for default
+    int prefetch_cache_size;    // m3u only, bytes of downloaded segments to feed, 0 for default
+    bool aac_plus;              // m4a only, HE-AAC is decoded at the SBR samplerate of the track
 };
 
 typedef void *media_source_handle_t;
@@ -49,7 +56,8 @@ media_source_handle_t media_source_start_async(struct media_source_info *info,
 
 void media_source_stop(media_source_handle_t handle);
 
-int m3u_get_first_url(struct media_source_info *info, char *buf, int buf_size);
+// First media url of playlist, of the first variant if it's a master playlist, freed by caller
+char *m3u_get_first_url(struct media_source_info *info);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,249 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "osal/os_time.h"
+#include "esp_adf/audio_common.h"
+#include "liteplayer_main.h"
+#include "liteplayer_stats.h"
+
+#if defined(__STDC_NO_ATOMICS__)
+// IMPORTANT:
+//   IF ATOMIC NOT SUPPORTED, COUNTERS MAY BE TORN OR LOST, THEY ARE STATS ONLY
+#define ATOMIC_DECLARE(obj)         int obj
+#define ATOMIC_DECLARE_LL(obj)      long long obj
+#define ATOMIC_LOAD(obj)            obj
+#define ATOMIC_STORE(obj, val)      obj = val
+#define ATOMIC_FETCH_ADD(obj, val)  (obj += val, obj - val)
+
+#else
+#include <stdatomic.h>
+#define ATOMIC_DECLARE(obj)         atomic_int obj
+#define ATOMIC_DECLARE_LL(obj)      atomic_llong obj
+#define ATOMIC_LOAD(obj)            atomic_load_explicit(&(obj), memory_order_relaxed)
+#define ATOMIC_STORE(obj, val)      atomic_store_explicit(&(obj), val, memory_order_relaxed)
+#define ATOMIC_FETCH_ADD(obj, val)  atomic_fetch_add_explicit(&(obj), val, memory_order_relaxed)
+#endif
+
+// Decode time histogram, 4 buckets per octave (~19% precision), up to 16s
+#define STATS_HIST_SUBBITS      ( 2 )
+#define STATS_HIST_BUCKETS      ( 96 )
+
+struct media_stats {
+    ATOMIC_DECLARE_LL(source_bytes);
+    ATOMIC_DECLARE(source_reconnects);
+    ATOMIC_DECLARE(hls_bandwidth);
+    ATOMIC_DECLARE(hls_variant_switches);
+
+    ATOMIC_DECLARE(ringbuf_fill_min);  // -1 if not sampled yet
+    ATOMIC_DECLARE(ringbuf_fill_max);
+    ATOMIC_DECLARE_LL(ringbuf_fill_sum);
+    ATOMIC_DECLARE(ringbuf_reads);
+    ATOMIC_DECLARE_LL(ringbuf_read_blocked_usec);
+    ATOMIC_DECLARE_LL(ringbuf_write_blocked_usec);
+
+    ATOMIC_DECLARE(decode_frames);
+    ATOMIC_DECLARE_LL(decode_usec);
+    ATOMIC_DECLARE_LL(decode_output_usec);
+    ATOMIC_DECLARE(decode_hist[STATS_HIST_BUCKETS]);
+
+    ATOMIC_DECLARE(sink_writes);
+    ATOMIC_DECLARE_LL(sink_write_usec);
+    ATOMIC_DECLARE(sink_write_usec_max);
+
+    ATOMIC_DECLARE(underruns);
+    ATOMIC_DECLARE(xruns);
+};
+
+static int media_stats_bucket(unsigned long long usec)
+{
+    if (usec < (1 << STATS_HIST_SUBBITS))
+        return (int)usec;
+    int msb = 63 - __builtin_clzll(usec);
+    int bucket = (msb - STATS_HIST_SUBBITS + 1) * (1 << STATS_HIST_SUBBITS) +
+                 (int)((usec >> (msb - STATS_HIST_SUBBITS)) & ((1 << STATS_HIST_SUBBITS) - 1));
+    return bucket < STATS_HIST_BUCKETS ? bucket : STATS_HIST_BUCKETS - 1;
+}
+
+// Upper bound of the bucket, so percentiles are never under-reported
+static int media_stats_bucket_usec(int bucket)
+{
+    if (bucket < (1 << STATS_HIST_SUBBITS))
+        return bucket;
+    int msb = bucket / (1 << STATS_HIST_SUBBITS) + STATS_HIST_SUBBITS - 1;
+    int mantissa = bucket % (1 << STATS_HIST_SUBBITS) + (1 << STATS_HIST_SUBBITS) + 1;
+    return (mantissa << (msb - STATS_HIST_SUBBITS)) - 1;
+}
+
+// Single writer per max/min counter, a plain compare and store is enough
+static inline void media_stats_update_max(ATOMIC_DECLARE(*max), int val)
+{
+    if (val > ATOMIC_LOAD(*max))
+        ATOMIC_STORE(*max, val);
+}
+
+media_stats_handle_t media_stats_create()
+{
+    struct media_stats *stats = audio_calloc(1, sizeof(struct media_stats));
+    if (stats != NULL)
+        media_stats_reset(stats);
+    return stats;
+}
+
+void media_stats_reset(media_stats_handle_t stats)
+{
+    if (stats == NULL)
+        return;
+    memset(stats, 0x0, sizeof(struct media_stats));
+    ATOMIC_STORE(stats->ringbuf_fill_min, -1);
+}
+
+unsigned long long media_stats_clock(media_stats_handle_t stats)
+{
+    return stats != NULL ? os_monotonic_usec() : 0;
+}
+
+void media_stats_source_read(media_stats_handle_t stats, int bytes)
+{
+    if (stats != NULL && bytes > 0)
+        ATOMIC_FETCH_ADD(stats->source_bytes, bytes);
+}
+
+void media_stats_source_reconnect(media_stats_handle_t stats)
+{
+    if (stats != NULL)
+        ATOMIC_FETCH_ADD(stats->source_reconnects, 1);
+}
+
+void media_stats_hls_bandwidth(media_stats_handle_t stats, int bandwidth, bool switched)
+{
+    if (stats == NULL)
+        return;
+    ATOMIC_STORE(stats->hls_bandwidth, bandwidth);
+    if (switched)
+        ATOMIC_FETCH_ADD(stats->hls_variant_switches, 1);
+}
+
+void media_stats_ringbuf_read(media_stats_handle_t stats, int filled, unsigned long long blocked_usec)
+{
+    if (stats == NULL)
+        return;
+    int min = ATOMIC_LOAD(stats->ringbuf_fill_min);
+    if (min < 0 || filled < min)
+        ATOMIC_STORE(stats->ringbuf_fill_min, filled);
+    media_stats_update_max(&stats->ringbuf_fill_max, filled);
+    ATOMIC_FETCH_ADD(stats->ringbuf_fill_sum, filled);
+    ATOMIC_FETCH_ADD(stats->ringbuf_reads, 1);
+    if (blocked_usec > 0)
+        ATOMIC_FETCH_ADD(stats->ringbuf_read_blocked_usec, (long long)blocked_usec);
+}
+
+void media_stats_ringbuf_write(media_stats_handle_t stats, unsigned long long blocked_usec)
+{
+    if (stats != NULL && blocked_usec > 0)
+        ATOMIC_FETCH_ADD(stats->ringbuf_write_blocked_usec, (long long)blocked_usec);
+}
+
+void media_stats_decode(media_stats_handle_t stats, unsigned long long usec)
+{
+    if (stats == NULL)
+        return;
+    ATOMIC_FETCH_ADD(stats->decode_frames, 1);
+    ATOMIC_FETCH_ADD(stats->decode_usec, (long long)usec);
+    ATOMIC_FETCH_ADD(stats->decode_hist[media_stats_bucket(usec)], 1);
+}
+
+void media_stats_decode_output(media_stats_handle_t stats, unsigned long long duration_usec)
+{
+    if (stats != NULL)
+        ATOMIC_FETCH_ADD(stats->decode_output_usec, (long long)duration_usec);
+}
+
+void media_stats_sink_write(media_stats_handle_t stats, unsigned long long usec, bool xrun)
+{
+    if (stats == NULL)
+        return;
+    ATOMIC_FETCH_ADD(stats->sink_writes, 1);
+    ATOMIC_FETCH_ADD(stats->sink_write_usec, (long long)usec);
+    media_stats_update_max(&stats->sink_write_usec_max, usec < 0x7FFFFFFF ? (int)usec : 0x7FFFFFFF);
+    if (xrun)
+        ATOMIC_FETCH_ADD(stats->xruns, 1);
+}
+
+void media_stats_underrun(media_stats_handle_t stats)
+{
+    if (stats != NULL)
+        ATOMIC_FETCH_ADD(stats->underruns, 1);
+}
+
+static int media_stats_percentile(media_stats_handle_t stats, int frames, int percent)
+{
+    long long rank = ((long long)frames * percent + 99) / 100;
+    long long count = 0;
+    for (int i = 0; i < STATS_HIST_BUCKETS; i++) {
+        count += ATOMIC_LOAD(stats->decode_hist[i]);
+        if (count >= rank)
+            return media_stats_bucket_usec(i);
+    }
+    return media_stats_bucket_usec(STATS_HIST_BUCKETS - 1);
+}
+
+void media_stats_get(media_stats_handle_t stats, struct liteplayer_stats *out)
+{
+    memset(out, 0x0, sizeof(struct liteplayer_stats));
+    if (stats == NULL)
+        return;
+
+    out->source_bytes = ATOMIC_LOAD(stats->source_bytes);
+    out->source_reconnects = ATOMIC_LOAD(stats->source_reconnects);
+    out->hls_bandwidth = ATOMIC_LOAD(stats->hls_bandwidth);
+    out->hls_variant_switches = ATOMIC_LOAD(stats->hls_variant_switches);
+
+    int reads = ATOMIC_LOAD(stats->ringbuf_reads);
+    if (reads > 0) {
+        out->ringbuf_fill_min = ATOMIC_LOAD(stats->ringbuf_fill_min);
+        out->ringbuf_fill_max = ATOMIC_LOAD(stats->ringbuf_fill_max);
+        out->ringbuf_fill_avg = (int)(ATOMIC_LOAD(stats->ringbuf_fill_sum) / reads);
+    }
+    out->ringbuf_read_blocked_usec = ATOMIC_LOAD(stats->ringbuf_read_blocked_usec);
+    out->ringbuf_write_blocked_usec = ATOMIC_LOAD(stats->ringbuf_write_blocked_usec);
+
+    int frames = ATOMIC_LOAD(stats->decode_frames);
+    if (frames > 0) {
+        out->decode_frames = frames;
+        out->decode_usec_p50 = media_stats_percentile(stats, frames, 50);
+        out->decode_usec_p99 = media_stats_percentile(stats, frames, 99);
+        long long output_usec = ATOMIC_LOAD(stats->decode_output_usec);
+        if (output_usec > 0)
+            out->realtime_factor = (float)ATOMIC_LOAD(stats->decode_usec) / output_usec;
+    }
+
+    int writes = ATOMIC_LOAD(stats->sink_writes);
+    if (writes > 0) {
+        out->sink_writes = writes;
+        out->sink_write_usec_avg = (int)(ATOMIC_LOAD(stats->sink_write_usec) / writes);
+        out->sink_write_usec_max = ATOMIC_LOAD(stats->sink_write_usec_max);
+    }
+
+    out->underruns = ATOMIC_LOAD(stats->underruns);
+    out->xruns = ATOMIC_LOAD(stats->xruns);
+}
+
+void media_stats_destroy(media_stats_handle_t stats)
+{
+    if (stats != NULL)
+        audio_free(stats);
+}
@@ -0,0 +1,76 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _LITEPLAYER_STATS_H_
+#define _LITEPLAYER_STATS_H_
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct liteplayer_stats;
+
+typedef struct media_stats *media_stats_handle_t;
+
+/*
+ * Runtime counters of a player, updated by the source, decoder and sink threads with
+ * relaxed atomics, no lock is taken on the data path. All update functions accept a
+ * NULL handle and do nothing, so the pipeline runs the same with stats detached.
+ */
+media_stats_handle_t media_stats_create();
+
+// Clear all counters, must not race with the updaters, e.g. before a new data source
+void media_stats_reset(media_stats_handle_t stats);
+
+// Monotonic timestamp for the updaters, 0 if @stats is NULL, so no clock is read then
+unsigned long long media_stats_clock(media_stats_handle_t stats);
+
+// @bytes read from source
+void media_stats_source_read(media_stats_handle_t stats, int bytes);
+
+// Source is reopened or seeked after the first open, e.g. http reconnects
+void media_stats_source_reconnect(media_stats_handle_t stats);
+
+// Throughput estimated by hls prefetch, and whether a variant of master playlist is switched to
+void media_stats_hls_bandwidth(media_stats_handle_t stats, int bandwidth, bool switched);
+
+// Decoder read source ringbuf holding @filled bytes, and waited @blocked_usec for it
+void media_stats_ringbuf_read(media_stats_handle_t stats, int filled, unsigned long long blocked_usec);
+
+// Writer waited @blocked_usec for free space of source ringbuf or pcm ringbuf
+void media_stats_ringbuf_write(media_stats_handle_t stats, unsigned long long blocked_usec);
+
+// A frame is decoded in @usec, input and output time excluded
+void media_stats_decode(media_stats_handle_t stats, unsigned long long usec);
+
+// Decoded pcm lasting @duration_usec, for the real-time factor
+void media_stats_decode_output(media_stats_handle_t stats, unsigned long long duration_usec);
+
+// Sink write returned after @usec, @xrun if it failed or took less than given
+void media_stats_sink_write(media_stats_handle_t stats, unsigned long long usec, bool xrun);
+
+// Decoder or sink found no data in time
+void media_stats_underrun(media_stats_handle_t stats);
+
+void media_stats_get(media_stats_handle_t stats, struct liteplayer_stats *out);
+
+void media_stats_destroy(media_stats_handle_t stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _LITEPLAYER_STATS_H_
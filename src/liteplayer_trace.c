@@ -0,0 +1,222 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "liteplayer_trace_internal.h"
+
+#if defined(LITEPLAYER_CONFIG_TRACE)
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "osal/os_time.h"
+#include "cutils/log_helper.h"
+#include "esp_adf/audio_common.h"
+#include "liteplayer_config.h"
+
+#define TAG "[liteplayer]trace"
+
+struct trace_event {
+    const char *name;
+    unsigned long long ts;
+    unsigned int dur;
+    unsigned int tid;
+};
+
+/*
+ * Ring of one thread at a time: only the owner writes events and publishes them by
+ * moving head with a release store, head never goes back. Head works as the sequence
+ * of a seqlock: the owner starts overwriting slot of event pos once head reaches
+ * pos + DEFAULT_TRACE_EVENTS_PER_THREAD, dump copies the event, then re-loads head
+ * after an acquire fence and drops the copy if head has got there.
+ * A ring is reused by a new thread once released, by LITEPLAYER_TRACE_THREAD_EXIT or else
+ * when its thread exits, so that threads not created by the player don't keep theirs.
+ */
+struct trace_ring {
+    atomic_int owned;
+    atomic_uint head;
+    struct trace_event *_Atomic events;
+};
+
+static struct trace_ring g_rings[DEFAULT_TRACE_THREADS];
+static atomic_int g_recording;
+static atomic_ullong g_since;
+static atomic_uint g_next_tid;
+static atomic_uint g_dropped;
+
+static __thread struct trace_ring *t_ring;
+static __thread unsigned int t_tid;
+
+static pthread_once_t g_ring_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_ring_key;
+static bool g_ring_key_valid;
+
+// Destructor of the thread specific ring, called at exit of a thread still owning one
+static void media_trace_ring_release(void *arg)
+{
+    struct trace_ring *ring = (struct trace_ring *)arg;
+    atomic_store(&ring->owned, 0);
+}
+
+static void media_trace_ring_key_create()
+{
+    g_ring_key_valid = pthread_key_create(&g_ring_key, media_trace_ring_release) == 0;
+    if (!g_ring_key_valid)
+        OS_LOGW(TAG, "Failed to create ring key, rings are released by LITEPLAYER_TRACE_THREAD_EXIT only");
+}
+
+static struct trace_ring *media_trace_ring()
+{
+    if (t_ring != NULL)
+        return t_ring;
+    if (t_tid == 0)
+        t_tid = atomic_fetch_add(&g_next_tid, 1) + 1;
+    pthread_once(&g_ring_key_once, media_trace_ring_key_create);
+
+    for (int i = 0; i < DEFAULT_TRACE_THREADS; i++) {
+        struct trace_ring *ring = &g_rings[i];
+        int expected = 0;
+        if (!atomic_compare_exchange_strong(&ring->owned, &expected, 1))
+            continue;
+        if (atomic_load_explicit(&ring->events, memory_order_acquire) == NULL) {
+            struct trace_event *events = audio_calloc(DEFAULT_TRACE_EVENTS_PER_THREAD, sizeof(struct trace_event));
+            if (events == NULL) {
+                atomic_store(&ring->owned, 0);
+                return NULL;
+            }
+            atomic_store_explicit(&ring->events, events, memory_order_release);
+        }
+        if (g_ring_key_valid)
+            pthread_setspecific(g_ring_key, ring);
+        t_ring = ring;
+        return ring;
+    }
+    return NULL;
+}
+
+unsigned long long media_trace_clock()
+{
+    if (!atomic_load_explicit(&g_recording, memory_order_relaxed))
+        return 0;
+    return os_monotonic_usec();
+}
+
+void media_trace_span(const char *name, unsigned long long begin)
+{
+    if (begin == 0)
+        return;
+    unsigned long long now = os_monotonic_usec();
+    struct trace_ring *ring = media_trace_ring();
+    if (ring == NULL) {
+        atomic_fetch_add_explicit(&g_dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    struct trace_event *event =
+        &atomic_load_explicit(&ring->events, memory_order_relaxed)[head % DEFAULT_TRACE_EVENTS_PER_THREAD];
+    // pairs with the fence in dump, a copy that sees the new event also sees the head
+    atomic_thread_fence(memory_order_release);
+    event->name = name;
+    event->ts = begin;
+    event->dur = (unsigned int)(now - begin);
+    event->tid = t_tid;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void media_trace_thread_exit()
+{
+    if (t_ring != NULL) {
+        if (g_ring_key_valid)
+            pthread_setspecific(g_ring_key, NULL);
+        atomic_store(&t_ring->owned, 0);
+        t_ring = NULL;
+    }
+}
+
+int liteplayer_trace_start()
+{
+    atomic_store(&g_since, os_monotonic_usec());
+    atomic_store(&g_dropped, 0);
+    atomic_store(&g_recording, 1);
+    OS_LOGI(TAG, "Trace started");
+    return 0;
+}
+
+int liteplayer_trace_stop()
+{
+    atomic_store(&g_recording, 0);
+    OS_LOGI(TAG, "Trace stopped");
+    return 0;
+}
+
+int liteplayer_trace_dump(liteplayer_trace_writer writer, void *priv)
+{
+    if (writer == NULL)
+        return -1;
+
+    char buf[256];
+    int len = snprintf(buf, sizeof(buf), "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    if (writer(buf, len, priv) != 0)
+        return -1;
+
+    unsigned long long since = atomic_load(&g_since);
+    bool first = true;
+    for (int i = 0; i < DEFAULT_TRACE_THREADS; i++) {
+        struct trace_ring *ring = &g_rings[i];
+        struct trace_event *events = atomic_load_explicit(&ring->events, memory_order_acquire);
+        if (events == NULL)
+            continue;
+        unsigned int head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        unsigned int tail = head > DEFAULT_TRACE_EVENTS_PER_THREAD ? head - DEFAULT_TRACE_EVENTS_PER_THREAD : 0;
+        for (unsigned int pos = tail; pos != head; pos++) {
+            struct trace_event event = events[pos % DEFAULT_TRACE_EVENTS_PER_THREAD];
+            // drop the event if the owner may have started overwriting it while copying
+            atomic_thread_fence(memory_order_acquire);
+            unsigned int now_head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+            if (now_head - pos >= DEFAULT_TRACE_EVENTS_PER_THREAD || event.ts < since)
+                continue;
+            len = snprintf(buf, sizeof(buf),
+                           "%s{\"name\":\"%s\",\"cat\":\"liteplayer\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"dur\":%u}",
+                           first ? "" : ",", event.name, event.tid, event.ts - since, event.dur);
+            first = false;
+            if (writer(buf, len, priv) != 0)
+                return -1;
+        }
+    }
+
+    len = snprintf(buf, sizeof(buf), "],\"otherData\":{\"dropped\":%u}}\n", atomic_load(&g_dropped));
+    return writer(buf, len, priv) != 0 ? -1 : 0;
+}
+
+#else
+
+int liteplayer_trace_start()
+{
+    return -1;
+}
+
+int liteplayer_trace_stop()
+{
+    return -1;
+}
+
+int liteplayer_trace_dump(liteplayer_trace_writer writer, void *priv)
+{
+    return -1;
+}
+
+#endif
@@ -0,0 +1,51 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _LITEPLAYER_TRACE_INTERNAL_H_
+#define _LITEPLAYER_TRACE_INTERNAL_H_
+
+#include "liteplayer_trace.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(LITEPLAYER_CONFIG_TRACE)
+
+// Timestamp to begin a span, 0 if recording is off
+unsigned long long media_trace_clock();
+
+// Record span @name (static string) from @begin to now, ignored if @begin is 0
+void media_trace_span(const char *name, unsigned long long begin);
+
+// Release the ring of current thread for threads created later, events are kept
+void media_trace_thread_exit();
+
+#define LITEPLAYER_TRACE_BEGIN(ts)          unsigned long long ts = media_trace_clock()
+#define LITEPLAYER_TRACE_END(ts, name)      media_trace_span(name, ts)
+#define LITEPLAYER_TRACE_THREAD_EXIT()      media_trace_thread_exit()
+
+#else
+
+#define LITEPLAYER_TRACE_BEGIN(ts)
+#define LITEPLAYER_TRACE_END(ts, name)
+#define LITEPLAYER_TRACE_THREAD_EXIT()
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _LITEPLAYER_TRACE_INTERNAL_H_
@@ -0,0 +1,257 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "osal/os_thread.h"
+#include "esp_adf/audio_common.h"
+#include "liteplayer_pcm.h"
+#include "liteplayer_volume.h"
+
+#if defined(__STDC_NO_ATOMICS__)
+// IMPORTANT:
+//   IF ATOMIC NOT SUPPORTED, A GAIN CHANGE MAY BE PICKED UP ONE BUFFER LATER
+#define ATOMIC_DECLARE(obj)         int obj
+#define ATOMIC_LOAD(obj)            obj
+#define ATOMIC_FETCH_ADD(obj, val)  (obj += val, obj - val)
+
+#else
+#include <stdatomic.h>
+#define ATOMIC_DECLARE(obj)         atomic_int obj
+#define ATOMIC_LOAD(obj)            atomic_load_explicit(&(obj), memory_order_relaxed)
+#define ATOMIC_FETCH_ADD(obj, val)  atomic_fetch_add_explicit(&(obj), val, memory_order_relaxed)
+#endif
+
+// samples converted to float at a time for ramps and 24/32 bits
+#define VOLUME_BLOCK_SAMPLES    ( 256 )
+#define VOLUME_MAX_CHANNELS     ( 8 )
+
+struct volume {
+    os_mutex lock;
+    os_cond cond;
+    ATOMIC_DECLARE(serial);     // bumped by setters, volume_process() takes the lock only if changed
+
+    // protected by lock
+    float gain;
+    bool muted;                 // faded out
+    bool silent;                // fade out is processed
+    bool jump;                  // go to gain without ramping
+    int ramp_ms;                // of the latest change
+
+    // owned by the processing thread
+    int seen;
+    int samplerate;
+    int channels;
+    int bits;
+    float current;
+    float target;
+    float step;                 // per frame
+    int ramp_frames;            // frames left to reach target
+    bool fading;                // ramping to silence, waiter is signaled at the end
+    float fbuf[VOLUME_BLOCK_SAMPLES];
+};
+
+volume_handle_t volume_create()
+{
+    struct volume *vol = audio_calloc(1, sizeof(struct volume));
+    if (vol == NULL)
+        return NULL;
+    vol->lock = os_mutex_create();
+    vol->cond = os_cond_create();
+    if (vol->lock == NULL || vol->cond == NULL) {
+        volume_destroy(vol);
+        return NULL;
+    }
+    vol->gain = 1.0f;
+    vol->current = 1.0f;
+    vol->target = 1.0f;
+    return vol;
+}
+
+void volume_set_format(volume_handle_t handle, int samplerate, int channels, int bits)
+{
+    handle->samplerate = samplerate;
+    handle->channels = channels;
+    handle->bits = bits;
+}
+
+void volume_set_gain(volume_handle_t handle, float gain, int ramp_ms)
+{
+    os_mutex_lock(handle->lock);
+    handle->gain = gain;
+    if (!handle->muted) {
+        handle->ramp_ms = ramp_ms;
+        ATOMIC_FETCH_ADD(handle->serial, 1);
+    }
+    os_mutex_unlock(handle->lock);
+}
+
+void volume_fade_out(volume_handle_t handle, int ramp_ms)
+{
+    os_mutex_lock(handle->lock);
+    handle->muted = true;
+    handle->silent = false;
+    handle->ramp_ms = ramp_ms;
+    ATOMIC_FETCH_ADD(handle->serial, 1);
+    os_mutex_unlock(handle->lock);
+}
+
+void volume_fade_in(volume_handle_t handle, int ramp_ms)
+{
+    os_mutex_lock(handle->lock);
+    if (handle->muted) {
+        handle->muted = false;
+        handle->silent = false;
+        handle->ramp_ms = ramp_ms;
+        ATOMIC_FETCH_ADD(handle->serial, 1);
+    }
+    os_mutex_unlock(handle->lock);
+}
+
+bool volume_wait_silent(volume_handle_t handle, int timeout_ms)
+{
+    os_mutex_lock(handle->lock);
+    while (handle->muted && !handle->silent) {
+        if (os_cond_timedwait(handle->cond, handle->lock, timeout_ms*1000) != 0)
+            break;
+    }
+    bool silent = handle->silent;
+    os_mutex_unlock(handle->lock);
+    return silent;
+}
+
+void volume_reset(volume_handle_t handle)
+{
+    os_mutex_lock(handle->lock);
+    handle->muted = false;
+    handle->silent = false;
+    handle->jump = true;
+    ATOMIC_FETCH_ADD(handle->serial, 1);
+    os_mutex_unlock(handle->lock);
+}
+
+static void volume_update(struct volume *vol, int serial)
+{
+    os_mutex_lock(vol->lock);
+    float target = vol->muted ? 0.0f : vol->gain;
+    bool jump = vol->jump;
+    int ramp_ms = vol->ramp_ms;
+    vol->fading = vol->muted;
+    vol->jump = false;
+    vol->seen = serial;
+    os_mutex_unlock(vol->lock);
+
+    long long frames = jump ? 0 : (long long)vol->samplerate * ramp_ms / 1000;
+    vol->target = target;
+    if (frames <= 0 || vol->current == target) {
+        vol->current = target;
+        vol->ramp_frames = 0;
+    } else {
+        // a ramp in progress is restarted from the current gain
+        vol->ramp_frames = (int)frames;
+        vol->step = (target - vol->current) / (float)frames;
+    }
+}
+
+static void volume_signal_silent(struct volume *vol)
+{
+    os_mutex_lock(vol->lock);
+    // fading in or out again since, leave it to the next update
+    if (vol->seen == ATOMIC_LOAD(vol->serial)) {
+        vol->silent = true;
+        os_cond_broadcast(vol->cond);
+    }
+    os_mutex_unlock(vol->lock);
+    vol->fading = false;
+}
+
+static void volume_ramp(struct volume *vol, char *pcm, int frames)
+{
+    int frame_size = vol->channels * vol->bits / 8;
+    int block = VOLUME_BLOCK_SAMPLES / vol->channels;
+    while (frames > 0) {
+        int n = frames < block ? frames : block;
+        pcm_to_f32(pcm, vol->bits, vol->fbuf, n * vol->channels);
+        pcm_ramp_f32(vol->fbuf, n, vol->channels, vol->current + vol->step, vol->step);
+        pcm_from_f32(vol->fbuf, pcm, vol->bits, n * vol->channels, NULL);
+        vol->current += vol->step * n;
+        vol->ramp_frames -= n;
+        pcm += n * frame_size;
+        frames -= n;
+    }
+    if (vol->ramp_frames == 0)
+        vol->current = vol->target;
+}
+
+static void volume_scale(struct volume *vol, char *pcm, int frames)
+{
+    int samples = frames * vol->channels;
+    if (vol->current == 0.0f) {
+        memset(pcm, 0x0, samples * vol->bits / 8);
+        return;
+    }
+    if (vol->bits == 16) {
+        int gain_q15 = (int)lrintf(vol->current * 32768.0f);
+        pcm_gain_s16((short *)pcm, samples, gain_q15 > 32767 ? 32767 : gain_q15);
+        return;
+    }
+
+    int sample_size = vol->bits / 8;
+    int block = VOLUME_BLOCK_SAMPLES - VOLUME_BLOCK_SAMPLES % vol->channels;
+    while (samples > 0) {
+        int n = samples < block ? samples : block;
+        pcm_to_f32(pcm, vol->bits, vol->fbuf, n);
+        pcm_gain_f32(vol->fbuf, n, vol->current);
+        pcm_from_f32(vol->fbuf, pcm, vol->bits, n, NULL);
+        pcm += n * sample_size;
+        samples -= n;
+    }
+}
+
+int volume_process(volume_handle_t handle, char *pcm, int bytes)
+{
+    struct volume *vol = handle;
+    int serial = ATOMIC_LOAD(vol->serial);
+    if (serial != vol->seen)
+        volume_update(vol, serial);
+    if (vol->ramp_frames == 0 && vol->current == 1.0f)
+        return 0;
+    if (vol->channels <= 0 || vol->channels > VOLUME_MAX_CHANNELS || pcm_sample_bytes(vol->bits) == 0)
+        return 0;
+
+    int frame_size = vol->channels * vol->bits / 8;
+    int frames = bytes / frame_size;
+    int ramped = frames < vol->ramp_frames ? frames : vol->ramp_frames;
+    if (ramped > 0)
+        volume_ramp(vol, pcm, ramped);
+    if (frames > ramped)
+        volume_scale(vol, pcm + ramped * frame_size, frames - ramped);
+    if (vol->fading && vol->ramp_frames == 0)
+        volume_signal_silent(vol);
+    return frames * frame_size;
+}
+
+void volume_destroy(volume_handle_t handle)
+{
+    if (handle == NULL)
+        return;
+    if (handle->lock != NULL)
+        os_mutex_destroy(handle->lock);
+    if (handle->cond != NULL)
+        os_cond_destroy(handle->cond);
+    audio_free(handle);
+}
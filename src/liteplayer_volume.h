@@ -0,0 +1,63 @@
+// Copyright (c) 2019-2022 Qinglong<sysu.zqlong@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef _LITEPLAYER_VOLUME_H_
+#define _LITEPLAYER_VOLUME_H_
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct volume *volume_handle_t;
+
+/*
+ * Software volume of interleaved 16/24/32 bits pcm, applied in place before pcm
+ * is written to sink. Gain changes are ramped linearly per frame to avoid clicks.
+ * Steady s16 is scaled in Q15 fixed-point, ramps and 24/32 bits are scaled in
+ * float, unity gain leaves pcm untouched.
+ * Setters may be called from any thread, volume_process() from one thread at a time.
+ */
+volume_handle_t volume_create();
+
+// Format of pcm passed to volume_process(), must not race with it
+void volume_set_format(volume_handle_t handle, int samplerate, int channels, int bits);
+
+// Ramp to @gain in [0.0, 1.0] within @ramp_ms, it's deferred until fading in if faded out
+void volume_set_gain(volume_handle_t handle, float gain, int ramp_ms);
+
+// Ramp to silence, e.g. before pcm is cut by pausing, volume_fade_in() ramps back to gain
+void volume_fade_out(volume_handle_t handle, int ramp_ms);
+
+// No-op if not faded out
+void volume_fade_in(volume_handle_t handle, int ramp_ms);
+
+// Wait until the fade out is processed, returns false if timeout
+bool volume_wait_silent(volume_handle_t handle, int timeout_ms);
+
+// Jump to gain without ramping and cancel fading out, e.g. after stopping
+void volume_reset(volume_handle_t handle);
+
+// Returns bytes of whole frames scaled, 0 if pcm is left untouched
+int volume_process(volume_handle_t handle, char *pcm, int bytes);
+
+void volume_destroy(volume_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _LITEPLAYER_VOLUME_H_
@@ -525,6 +525,15 @@ Int get_adts_header(
 
 #ifdef LITEPLAYER_CONFIG_AAC_PLUS
 
+        /*
+         *  Default as the audio specific config does, so that implicit signalling
+         *  is disabled after the first frame if it has no sbr content
+         */
+        if (pVars->bno == 0)
+        {
+            pVars->mc_info.ExtendedAudioObjectType = pVars->mc_info.audioObjectType;
+        }
+
         /*
          *  For implicit signalling, no hint that sbr or ps is used, so we need to
          *  check the sampling frequency of the aac content, if lesser or equal to
@@ -284,6 +284,12 @@ OSCL_EXPORT_REF Int PVMP4AudioDecoderInitLibrary(
     pVars->current_program = -1;
     pVars->mc_info.sampling_rate_idx = Fs_44; /* Fs_44 = 4, 44.1kHz */
 
+    /*
+     * Default to regular AAC, ADTS streams don't go through the audio specific
+     * config that sets it, and would otherwise be left without any output
+     */
+    pVars->mc_info.upsamplingFactor = 1;
+
     /*
      * In the future, the frame length will change with MP4 file format.
      * Presently this variable is used to simply the unit test for
@@ -12,6 +12,7 @@ LOCAL_SRC_FILES := \
     ${TOP_DIR}/osal/unix/os_timer.c \
     ${TOP_DIR}/osal/unix/os_misc.c \
     ${TOP_DIR}/source/cutils/memdbg.c \
+    ${TOP_DIR}/source/cutils/executor.c \
     ${TOP_DIR}/source/cutils/mlooper.c \
     ${TOP_DIR}/source/cutils/mqueue.c \
     ${TOP_DIR}/source/cutils/ringbuf.c \
@@ -50,6 +50,14 @@
 #define mlooper_remove_message_if      SYSUTILS_CUTILS_NAMESPACE(mlooper_remove_message_if)
 #define mlooper_clear_message          SYSUTILS_CUTILS_NAMESPACE(mlooper_clear_message)
 
+// executor.h
+#define executor_create                SYSUTILS_CUTILS_NAMESPACE(executor_create)
+#define executor_destroy               SYSUTILS_CUTILS_NAMESPACE(executor_destroy)
+#define executor_submit                SYSUTILS_CUTILS_NAMESPACE(executor_submit)
+#define executor_submit_delayed        SYSUTILS_CUTILS_NAMESPACE(executor_submit_delayed)
+#define executor_worker_count          SYSUTILS_CUTILS_NAMESPACE(executor_worker_count)
+#define executor_task_count            SYSUTILS_CUTILS_NAMESPACE(executor_task_count)
+
 // mqueue.h
 #define mqueue_create                  SYSUTILS_CUTILS_NAMESPACE(mqueue_create)
 #define mqueue_destroy                 SYSUTILS_CUTILS_NAMESPACE(mqueue_destroy)
@@ -66,6 +74,9 @@
 
 // ringbuf.h
 #define rb_create                      SYSUTILS_CUTILS_NAMESPACE(rb_create)
+#define rb_create_with_span            SYSUTILS_CUTILS_NAMESPACE(rb_create_with_span)
+#define rb_create_spsc                 SYSUTILS_CUTILS_NAMESPACE(rb_create_spsc)
+#define rb_create_spsc_static          SYSUTILS_CUTILS_NAMESPACE(rb_create_spsc_static)
 #define rb_destroy                     SYSUTILS_CUTILS_NAMESPACE(rb_destroy)
 #define rb_abort                       SYSUTILS_CUTILS_NAMESPACE(rb_abort)
 #define rb_reset                       SYSUTILS_CUTILS_NAMESPACE(rb_reset)
@@ -76,6 +87,10 @@
 #define rb_write                       SYSUTILS_CUTILS_NAMESPACE(rb_write)
 #define rb_read_chunk                  SYSUTILS_CUTILS_NAMESPACE(rb_read_chunk)
 #define rb_write_chunk                 SYSUTILS_CUTILS_NAMESPACE(rb_write_chunk)
+#define rb_acquire_read                SYSUTILS_CUTILS_NAMESPACE(rb_acquire_read)
+#define rb_commit_read                 SYSUTILS_CUTILS_NAMESPACE(rb_commit_read)
+#define rb_acquire_write               SYSUTILS_CUTILS_NAMESPACE(rb_acquire_write)
+#define rb_commit_write                SYSUTILS_CUTILS_NAMESPACE(rb_commit_write)
 #define rb_done_write                  SYSUTILS_CUTILS_NAMESPACE(rb_done_write)
 #define rb_done_read                   SYSUTILS_CUTILS_NAMESPACE(rb_done_read)
 #define rb_unblock_reader              SYSUTILS_CUTILS_NAMESPACE(rb_unblock_reader)
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2018-2022 Qinglong<sysu.zqlong@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SYSUTILS_EXECUTOR_H__
+#define __SYSUTILS_EXECUTOR_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "osal/os_thread.h"
+#include "cutil_namespace.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct executor *executor_handle;
+typedef void (*executor_task_cb)(void *arg);
+
+// executor_create:
+//   Create a fixed pool of worker threads, each worker owns a task queue and steals
+//   from the others when its own queue is empty.
+//   If @workers is 0, the pool is sized to the cpu count.
+//   Tasks must not block for long, a long running job should do a slice of work
+//   and submit itself again, so that other tasks get their turn.
+executor_handle executor_create(struct os_thread_attr *attr, unsigned int workers);
+
+// executor_destroy:
+//   Stop and join all workers, pending tasks are discarded
+void executor_destroy(executor_handle executor);
+
+// executor_submit:
+//   Queue a task, a task submitted from a worker is queued on that worker
+int executor_submit(executor_handle executor, executor_task_cb task, void *arg);
+
+// executor_submit_delayed:
+//   Queue a task after @delay_ms, e.g. to retry a task that found no data instead
+//   of spinning a worker on it
+int executor_submit_delayed(executor_handle executor, executor_task_cb task, void *arg, unsigned long delay_ms);
+
+unsigned int executor_worker_count(executor_handle executor);
+
+// executor_task_count:
+//   Tasks queued but not taken by workers yet
+unsigned int executor_task_count(executor_handle executor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SYSUTILS_EXECUTOR_H__ */
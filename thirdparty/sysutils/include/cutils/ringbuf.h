@@ -53,6 +53,49 @@ typedef struct ringbuf *ringbuf_handle;
  */
 ringbuf_handle rb_create(int size);
 
+/**
+ * @brief      Create ringbuffer with a contiguous view area
+ *
+ *             `span` extra bytes are allocated behind the buffer, rb_acquire_read() mirrors
+ *             the wrapped head there, so any span up to `span` bytes is returned contiguously
+ *             even if it wraps around the end of the buffer.
+ *
+ * @param[in]  size   Size of ringbuffer
+ * @param[in]  span   Size of contiguous view area
+ *
+ * @return     ringbuf_handle
+ */
+ringbuf_handle rb_create_with_span(int size, int span);
+
+/**
+ * @brief      Create single-producer/single-consumer ringbuffer with a contiguous view area
+ *
+ *             Only one thread may read and only one thread may write. The data path is
+ *             lock-free, the lock is taken only when a peer has to block, or when a blocked
+ *             peer has to be woken up because what it's waiting for becomes available.
+ *             Falls back to rb_create_with_span() if atomics are not supported.
+ *
+ * @param[in]  size   Size of ringbuffer
+ * @param[in]  span   Size of contiguous view area
+ *
+ * @return     ringbuf_handle
+ */
+ringbuf_handle rb_create_spsc(int size, int span);
+
+/**
+ * @brief      Create single-producer/single-consumer ringbuffer on a buffer owned by caller
+ *
+ *             Same as rb_create_spsc(), but data is kept in @buffer, that must hold
+ *             size+span bytes and outlive the ringbuffer, rb_destroy() doesn't free it.
+ *
+ * @param[in]  buffer Memory of ringbuffer data
+ * @param[in]  size   Size of ringbuffer
+ * @param[in]  span   Size of contiguous view area
+ *
+ * @return     ringbuf_handle
+ */
+ringbuf_handle rb_create_spsc_static(char *buffer, int size, int span);
+
 /**
  * @brief      Cleanup and free all memory created by ringbuf_handle
  *
@@ -151,6 +194,56 @@ int rb_read_chunk(ringbuf_handle rb, char *buf, int size, unsigned int timeout_m
  */
 int rb_write_chunk(ringbuf_handle rb, char *buf, int size, unsigned int timeout_ms);
 
+/**
+ * @brief      Acquire a readable span of `size` bytes in place, without copying it out.
+ *             Wait the same way as rb_read_chunk(), the read pointer isn't moved until
+ *             rb_commit_read() is called, so acquiring again returns the same data.
+ *             If the span wraps around and its head doesn't fit the contiguous view area,
+ *             only the bytes up to the end of the buffer are returned.
+ *
+ * @param[in]  rb             The Ringbuffer handle
+ * @param[out] buf            The pointer to the readable span
+ * @param[in]  size           The length request
+ * @param[in]  timeout_ms     The time to wait, if zero, wait forever
+ *
+ * @return     Number of bytes in the span
+ */
+int rb_acquire_read(ringbuf_handle rb, char **buf, int size, unsigned int timeout_ms);
+
+/**
+ * @brief      Release `size` bytes from the span acquired by rb_acquire_read()
+ *
+ * @param[in]  rb             The Ringbuffer handle
+ * @param[in]  size           The length consumed
+ *
+ * @return     RB_OK or RB_FAIL
+ */
+int rb_commit_read(ringbuf_handle rb, int size);
+
+/**
+ * @brief      Acquire a writable span in place, wait the same way as rb_write().
+ *             The span never wraps, so it may be shorter than `size` near the end
+ *             of the buffer, the writer should acquire again for the rest.
+ *
+ * @param[in]  rb             The Ringbuffer handle
+ * @param[out] buf            The pointer to the writable span
+ * @param[in]  size           The length request
+ * @param[in]  timeout_ms     The time to wait, if zero, wait forever
+ *
+ * @return     Number of bytes in the span
+ */
+int rb_acquire_write(ringbuf_handle rb, char **buf, int size, unsigned int timeout_ms);
+
+/**
+ * @brief      Publish `size` bytes written to the span acquired by rb_acquire_write()
+ *
+ * @param[in]  rb             The Ringbuffer handle
+ * @param[in]  size           The length written
+ *
+ * @return     RB_OK or RB_FAIL
+ */
+int rb_commit_write(ringbuf_handle rb, int size);
+
 /**
  * @brief      Set status of writing to ringbuffer is done
  *
@@ -166,7 +259,7 @@ void rb_done_write(ringbuf_handle rb);
 void rb_done_read(ringbuf_handle rb);
 
 /**
- * @brief      Unblock from rb_read
+ * @brief      Unblock from rb_read, the reader waiting or next to wait returns RB_TIMEOUT once
  *
  * @param[in]  rb    The Ringbuffer handle
  */
@@ -78,6 +78,9 @@ typedef enum {
  * @}
  */
 
+/** @brief   Max length of the host name, including the NULL-terminating char. */
+#define HTTPCLIENT_MAX_HOST_LEN    64
+
 /** @defgroup httpclient_struct Struct
   * @{
   */
@@ -100,6 +103,9 @@ typedef struct {
     int client_pk_len;              /**< Client private key lenght, client_pk buffer size. */
     void *ssl;                      /**< Ssl content. */
 //#endif
+    char host[HTTPCLIENT_MAX_HOST_LEN]; /**< Host connected to, key of the connection pool with scheme and port. */
+    bool keep_alive;                /**< Server keeps the connection open after the last response. */
+    bool reused;                    /**< Connection is taken from the connection pool. */
 } httpclient_t;
 
 /** @brief   This structure defines the HTTP data structure.  */
@@ -246,6 +252,18 @@ HTTPCLIENT_RESULT httpclient_delete(httpclient_t *client, char *url, httpclient_
  */
 HTTPCLIENT_RESULT httpclient_connect(httpclient_t *client, char *url);
 
+/**
+ * @brief            This function takes an idle keep-alive connection to the same scheme, host and port
+ *                   from the connection pool, or establishes a new one as #httpclient_connect() if none.
+ *                   A pooled https connection keeps its TLS session, so no handshake is done again.
+ *                   Clients with certifications set never share connections.
+ * @param[in]        client is a pointer to the #httpclient_t, client->reused tells if the connection is pooled.
+ *                   A pooled connection may still be closed by server racily, retry with #httpclient_connect() then.
+ * @param[in]        url is the URL to run the request.
+ * @return           Please refer to #HTTPCLIENT_RESULT.
+ */
+HTTPCLIENT_RESULT httpclient_connect_pooled(httpclient_t *client, char *url);
+
 /**
  * @brief            This function sends an HTTP(GET or POST) request to the given URL.
  * @param[in]        client is a pointer to the #httpclient_t.
@@ -270,6 +288,27 @@ HTTPCLIENT_RESULT httpclient_recv_response(httpclient_t *client, httpclient_data
  */
 void httpclient_close(httpclient_t *client);
 
+/**
+ * @brief            This function returns the connection to the connection pool for the next request,
+ *                   if the last response is received completely and server keeps the connection alive,
+ *                   otherwise closes the connection as #httpclient_close().
+ * @param[in]        client is a pointer to the #httpclient_t.
+ * @param[in]        client_data is a pointer to the #httpclient_data_t instance of the last request.
+ */
+void httpclient_release(httpclient_t *client, httpclient_data_t *client_data);
+
+/**
+ * @brief            This function gets the counters of the connection pool.
+ * @param[out]       hits is the count of connections taken from the pool, may be NULL.
+ * @param[out]       misses is the count of new connections as no pooled one is idle, may be NULL.
+ */
+void httpclient_pool_stats(int *hits, int *misses);
+
+/**
+ * @brief            This function closes all idle connections in the connection pool.
+ */
+void httpclient_pool_flush();
+
 /**
  * @brief            This function gets the HTTP response code assigned to the last request.
  * @param[in]        client is a pointer to the #httpclient_t.
@@ -33,9 +33,13 @@
 #define httpclient_put                         SYSUTILS_HTTPCLIENT_NAMESPACE(httpclient_put)
 #define httpclient_delete                      SYSUTILS_HTTPCLIENT_NAMESPACE(httpclient_delete)
 #define httpclient_connect                     SYSUTILS_HTTPCLIENT_NAMESPACE(httpclient_connect)
+#define httpclient_connect_pooled              SYSUTILS_HTTPCLIENT_NAMESPACE(httpclient_connect_pooled)
 #define httpclient_send_request                SYSUTILS_HTTPCLIENT_NAMESPACE(httpclient_send_request)
 #define httpclient_recv_response               SYSUTILS_HTTPCLIENT_NAMESPACE(httpclient_recv_response)
 #define httpclient_close                       SYSUTILS_HTTPCLIENT_NAMESPACE(httpclient_close)
+#define httpclient_release                     SYSUTILS_HTTPCLIENT_NAMESPACE(httpclient_release)
+#define httpclient_pool_stats                  SYSUTILS_HTTPCLIENT_NAMESPACE(httpclient_pool_stats)
+#define httpclient_pool_flush                  SYSUTILS_HTTPCLIENT_NAMESPACE(httpclient_pool_flush)
 #define httpclient_get_response_code           SYSUTILS_HTTPCLIENT_NAMESPACE(httpclient_get_response_code)
 #define httpclient_get_response_header_value   SYSUTILS_HTTPCLIENT_NAMESPACE(httpclient_get_response_header_value)
 #define httpclient_set_custom_header           SYSUTILS_HTTPCLIENT_NAMESPACE(httpclient_set_custom_header)
@@ -36,6 +36,20 @@ void os_free(void *ptr);
 
 char *os_strdup(const char *str);
 
+/*
+ * Allocator behind the functions above, e.g. to count heap usage in benchmarks.
+ * Must be set before anything is allocated and not changed after, since memory
+ * is freed by the allocator it came from. NULL restores the system allocator.
+ */
+struct os_memory_hooks {
+    void *(*malloc)(unsigned int size);
+    void *(*calloc)(unsigned int n, unsigned int size);
+    void *(*realloc)(void *ptr, unsigned int size);
+    void (*free)(void *ptr);
+};
+
+void os_memory_set_hooks(const struct os_memory_hooks *hooks);
+
 #ifdef __cplusplus
 }
 #endif
@@ -68,6 +68,10 @@ void os_cond_destroy(os_cond cond);
 void os_thread_sleep_usec(unsigned long usec);
 void os_thread_sleep_msec(unsigned long msec);
 
+// os_cpu_count:
+//   Number of online cpu cores, at least 1
+unsigned int os_cpu_count();
+
 #ifdef __cplusplus
 }
 #endif
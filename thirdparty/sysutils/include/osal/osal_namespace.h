@@ -41,6 +41,7 @@
 #define os_realloc                     SYSUTILS_OSAL_NAMESPACE(os_realloc)
 #define os_free                        SYSUTILS_OSAL_NAMESPACE(os_free)
 #define os_strdup                      SYSUTILS_OSAL_NAMESPACE(os_strdup)
+#define os_memory_set_hooks            SYSUTILS_OSAL_NAMESPACE(os_memory_set_hooks)
 
 // os_misc.h
 #define os_random                      SYSUTILS_OSAL_NAMESPACE(os_random)
@@ -64,6 +65,7 @@
 #define os_cond_destroy                SYSUTILS_OSAL_NAMESPACE(os_cond_destroy)
 #define os_thread_sleep_usec           SYSUTILS_OSAL_NAMESPACE(os_thread_sleep_usec)
 #define os_thread_sleep_msec           SYSUTILS_OSAL_NAMESPACE(os_thread_sleep_msec)
+#define os_cpu_count                   SYSUTILS_OSAL_NAMESPACE(os_cpu_count)
 
 // os_time.h
 #define os_realtime_to_walltime        SYSUTILS_OSAL_NAMESPACE(os_realtime_to_walltime)
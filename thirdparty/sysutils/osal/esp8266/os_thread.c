@@ -24,6 +24,10 @@
 #include "esp_pthread.h"
 #endif
 
+#if defined(OS_FREERTOS_ESP32)
+#include "freertos/FreeRTOS.h"
+#endif
+
 #if defined(OS_LINUX) || defined(OS_ANDROID)
 #include <sys/prctl.h>
 #endif
@@ -282,3 +286,12 @@ void os_thread_sleep_msec(unsigned long msec)
 {
     usleep(msec * 1000);
 }
+
+unsigned int os_cpu_count()
+{
+#if defined(OS_FREERTOS_ESP32)
+    return portNUM_PROCESSORS;
+#else
+    return 1;
+#endif
+}
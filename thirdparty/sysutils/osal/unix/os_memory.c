@@ -17,27 +17,50 @@
 #include <string.h>
 #include "osal/os_memory.h"
 
+static const struct os_memory_hooks *g_memory_hooks = NULL;
+
+void os_memory_set_hooks(const struct os_memory_hooks *hooks)
+{
+    g_memory_hooks = hooks;
+}
+
 void *os_malloc(unsigned int size)
 {
+    if (g_memory_hooks != NULL)
+        return g_memory_hooks->malloc(size);
     return malloc(size);
 }
 
 void *os_calloc(unsigned int n, unsigned int size)
 {
+    if (g_memory_hooks != NULL)
+        return g_memory_hooks->calloc(n, size);
     return calloc(n, size);
 }
 
 void *os_realloc(void *ptr, unsigned int size)
 {
+    if (g_memory_hooks != NULL)
+        return g_memory_hooks->realloc(ptr, size);
     return realloc(ptr, size);
 }
 
 void os_free(void *ptr)
 {
-    free(ptr);
+    if (g_memory_hooks != NULL)
+        g_memory_hooks->free(ptr);
+    else
+        free(ptr);
 }
 
 char *os_strdup(const char *str)
 {
+    if (g_memory_hooks != NULL) {
+        unsigned int size = strlen(str) + 1;
+        char *dup = g_memory_hooks->malloc(size);
+        if (dup != NULL)
+            memcpy(dup, str, size);
+        return dup;
+    }
     return strdup(str);
 }
@@ -238,3 +238,9 @@ void os_thread_sleep_msec(unsigned long msec)
 {
     usleep(msec * 1000);
 }
+
+unsigned int os_cpu_count()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (unsigned int)count : 1;
+}
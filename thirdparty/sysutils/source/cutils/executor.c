@@ -0,0 +1,425 @@
+/*
+ * Copyright (c) 2018-2022 Qinglong<sysu.zqlong@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "osal/os_thread.h"
+#include "osal/os_time.h"
+#include "cutils/memory_helper.h"
+#include "cutils/log_helper.h"
+#include "cutils/executor.h"
+
+#define LOG_TAG "executor"
+
+#define DEFAULT_QUEUE_SIZE 16
+
+#if defined(__STDC_NO_ATOMICS__)
+// IMPORTANT:
+//   IF ATOMIC NOT SUPPORTED, GCC BUILTINS ARE USED FOR THE COUNTERS, THE DUE TIME MAY BE
+//   TORN ON 32-BIT CPUS, IT'S ONLY A HINT THAT IS CHECKED AGAIN UNDER task_mutex
+#define ATOMIC_DECLARE(obj)         int obj
+#define ATOMIC_DECLARE_ULL(obj)     unsigned long long obj
+#define ATOMIC_INIT(obj, val)       obj = val
+#define ATOMIC_LOAD(obj)            __sync_fetch_and_add(&(obj), 0)
+#define ATOMIC_STORE(obj, val)      (void)__sync_lock_test_and_set(&(obj), val)
+#define ATOMIC_FETCH_ADD(obj, val)  __sync_fetch_and_add(&(obj), val)
+#define ATOMIC_FETCH_SUB(obj, val)  __sync_fetch_and_sub(&(obj), val)
+#define ATOMIC_LOAD_ULL(obj)        (obj)
+#define ATOMIC_STORE_ULL(obj, val)  obj = val
+#else
+#include <stdatomic.h>
+#define ATOMIC_DECLARE(obj)         atomic_int obj
+#define ATOMIC_DECLARE_ULL(obj)     atomic_ullong obj
+#define ATOMIC_INIT(obj, val)       atomic_init(&(obj), val)
+#define ATOMIC_LOAD(obj)            atomic_load(&(obj))
+#define ATOMIC_STORE(obj, val)      atomic_store(&(obj), val)
+#define ATOMIC_FETCH_ADD(obj, val)  atomic_fetch_add(&(obj), val)
+#define ATOMIC_FETCH_SUB(obj, val)  atomic_fetch_sub(&(obj), val)
+#define ATOMIC_LOAD_ULL(obj)        atomic_load(&(obj))
+#define ATOMIC_STORE_ULL(obj, val)  atomic_store(&(obj), val)
+#endif
+
+struct executor_task {
+    executor_task_cb cb;
+    void *arg;
+};
+
+struct executor_delayed {
+    struct executor_task task;
+    unsigned long long due_usec;
+    struct executor_delayed *next;
+};
+
+struct executor_worker {
+    struct executor *executor;
+    unsigned int index;
+    os_thread thread_id;
+
+    // ring of tasks, owner takes from head, thieves take from tail
+    struct executor_task *queue;
+    unsigned int queue_head;
+    unsigned int queue_count;
+    unsigned int queue_size;
+    os_mutex queue_mutex;
+};
+
+/*
+ * Tasks are pushed and taken under the lock of each queue only. task_mutex is taken
+ * to park an idle worker, to wake it up, and for the delayed list. A submitter raises
+ * task_count before reading idle_count, a parking worker raises idle_count before
+ * reading task_count, so that either the worker sees the task or the submitter sees
+ * the worker and signals it.
+ */
+struct executor {
+    struct executor_worker *workers;
+    unsigned int worker_count;
+    ATOMIC_DECLARE(next_worker);
+
+    // tasks queued in all workers, raised before pushing, dropped after taking
+    ATOMIC_DECLARE(task_count);
+    // workers waiting on task_cond
+    ATOMIC_DECLARE(idle_count);
+    // tasks waiting for their due time, sorted by it, moved into a queue once due
+    struct executor_delayed *delayed;
+    // due time of the first delayed task, 0 if none, checked by busy workers without lock
+    ATOMIC_DECLARE_ULL(delayed_due);
+    os_mutex task_mutex;
+    os_cond task_cond;
+    ATOMIC_DECLARE(exit);
+};
+
+static int executor_queue_push(struct executor_worker *worker, struct executor_task *task)
+{
+    os_mutex_lock(worker->queue_mutex);
+
+    if (worker->queue_count == worker->queue_size) {
+        unsigned int size = worker->queue_size > 0 ? worker->queue_size*2 : DEFAULT_QUEUE_SIZE;
+        struct executor_task *queue = OS_MALLOC(size * sizeof(struct executor_task));
+        if (queue == NULL) {
+            os_mutex_unlock(worker->queue_mutex);
+            OS_LOGE(LOG_TAG, "Failed to allocate task queue");
+            return -1;
+        }
+        for (unsigned int i = 0; i < worker->queue_count; i++)
+            queue[i] = worker->queue[(worker->queue_head + i) % worker->queue_size];
+        OS_FREE(worker->queue);
+        worker->queue = queue;
+        worker->queue_head = 0;
+        worker->queue_size = size;
+    }
+
+    worker->queue[(worker->queue_head + worker->queue_count) % worker->queue_size] = *task;
+    worker->queue_count++;
+
+    os_mutex_unlock(worker->queue_mutex);
+    return 0;
+}
+
+static bool executor_queue_pop(struct executor_worker *worker, struct executor_task *task, bool steal)
+{
+    bool found = false;
+
+    os_mutex_lock(worker->queue_mutex);
+    if (worker->queue_count > 0) {
+        if (steal) {
+            *task = worker->queue[(worker->queue_head + worker->queue_count - 1) % worker->queue_size];
+        } else {
+            *task = worker->queue[worker->queue_head];
+            worker->queue_head = (worker->queue_head + 1) % worker->queue_size;
+        }
+        worker->queue_count--;
+        found = true;
+    }
+    os_mutex_unlock(worker->queue_mutex);
+
+    return found;
+}
+
+// Push a task counted in task_count, so that a parking worker doesn't miss it
+static int executor_push(struct executor *executor, struct executor_worker *worker, struct executor_task *task)
+{
+    ATOMIC_FETCH_ADD(executor->task_count, 1);
+    if (executor_queue_push(worker, task) != 0) {
+        ATOMIC_FETCH_SUB(executor->task_count, 1);
+        return -1;
+    }
+    return 0;
+}
+
+// Look at own queue first and then steal from the others
+static bool executor_take(struct executor *executor, struct executor_worker *worker, struct executor_task *task)
+{
+    if (ATOMIC_LOAD(executor->task_count) <= 0)
+        return false;
+    for (unsigned int i = 0; i < executor->worker_count; i++) {
+        struct executor_worker *victim =
+            &executor->workers[(worker->index + i) % executor->worker_count];
+        if (executor_queue_pop(victim, task, victim != worker)) {
+            ATOMIC_FETCH_SUB(executor->task_count, 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Wake up one idle worker if any, the lock is taken only if a worker is parked
+static void executor_wake_idle(struct executor *executor)
+{
+    if (ATOMIC_LOAD(executor->idle_count) > 0) {
+        os_mutex_lock(executor->task_mutex);
+        os_cond_signal(executor->task_cond);
+        os_mutex_unlock(executor->task_mutex);
+    }
+}
+
+// Returns the worker running on current thread, or NULL if called from outside the pool
+static struct executor_worker *executor_current_worker(struct executor *executor)
+{
+    os_thread self = os_thread_self();
+    for (unsigned int i = 0; i < executor->worker_count; i++) {
+        if (executor->workers[i].thread_id == self)
+            return &executor->workers[i];
+    }
+    return NULL;
+}
+
+// Move the due delayed tasks into @worker's queue, returns tasks moved
+static int executor_promote_delayed(struct executor *executor, struct executor_worker *worker)
+{
+    unsigned long long due = ATOMIC_LOAD_ULL(executor->delayed_due);
+    if (due == 0 || due > os_monotonic_usec())
+        return 0;
+
+    int moved = 0;
+    os_mutex_lock(executor->task_mutex);
+    unsigned long long now = os_monotonic_usec();
+    while (executor->delayed != NULL && executor->delayed->due_usec <= now) {
+        struct executor_delayed *delayed = executor->delayed;
+        if (executor_push(executor, worker, &delayed->task) != 0)
+            break; // try again on next wakeup
+        executor->delayed = delayed->next;
+        OS_FREE(delayed);
+        moved++;
+    }
+    ATOMIC_STORE_ULL(executor->delayed_due, executor->delayed != NULL ? executor->delayed->due_usec : 0);
+    os_mutex_unlock(executor->task_mutex);
+    return moved;
+}
+
+// Wait for a task to be submitted or the first delayed task to be due
+static void executor_park(struct executor *executor)
+{
+    os_mutex_lock(executor->task_mutex);
+    ATOMIC_FETCH_ADD(executor->idle_count, 1);
+    if (!ATOMIC_LOAD(executor->exit) && ATOMIC_LOAD(executor->task_count) <= 0) {
+        if (executor->delayed != NULL) {
+            unsigned long long now = os_monotonic_usec();
+            unsigned long long due = executor->delayed->due_usec;
+            if (due > now)
+                os_cond_timedwait(executor->task_cond, executor->task_mutex, (unsigned long)(due - now));
+        } else {
+            os_cond_wait(executor->task_cond, executor->task_mutex);
+        }
+    }
+    ATOMIC_FETCH_SUB(executor->idle_count, 1);
+    os_mutex_unlock(executor->task_mutex);
+}
+
+static void *executor_worker_entry(void *arg)
+{
+    struct executor_worker *worker = (struct executor_worker *)arg;
+    struct executor *executor = worker->executor;
+    struct executor_task task;
+
+    while (!ATOMIC_LOAD(executor->exit)) {
+        // leave the other due tasks to idle workers
+        if (executor_promote_delayed(executor, worker) > 1)
+            executor_wake_idle(executor);
+
+        if (!executor_take(executor, worker, &task)) {
+            executor_park(executor);
+            continue;
+        }
+        // leave the other queued tasks to idle workers
+        if (ATOMIC_LOAD(executor->task_count) > 0)
+            executor_wake_idle(executor);
+
+        task.cb(task.arg);
+    }
+
+    return NULL;
+}
+
+executor_handle executor_create(struct os_thread_attr *attr, unsigned int workers)
+{
+    struct executor *executor = OS_CALLOC(1, sizeof(struct executor));
+    if (executor == NULL) {
+        OS_LOGE(LOG_TAG, "Failed to allocate executor");
+        return NULL;
+    }
+    ATOMIC_INIT(executor->next_worker, 0);
+    ATOMIC_INIT(executor->task_count, 0);
+    ATOMIC_INIT(executor->idle_count, 0);
+    ATOMIC_INIT(executor->delayed_due, 0);
+    ATOMIC_INIT(executor->exit, 0);
+
+    if (workers == 0)
+        workers = os_cpu_count();
+
+    executor->task_mutex = os_mutex_create();
+    executor->task_cond = os_cond_create();
+    executor->workers = OS_CALLOC(workers, sizeof(struct executor_worker));
+    if (executor->task_mutex == NULL || executor->task_cond == NULL || executor->workers == NULL) {
+        OS_LOGE(LOG_TAG, "Failed to allocate executor resources");
+        goto fail_create;
+    }
+
+    struct os_thread_attr tattr = {
+        .name = "executor",
+        .priority = OS_THREAD_PRIO_NORMAL,
+        .stacksize = os_thread_default_stacksize(),
+        .joinable = true,
+    };
+    if (attr != NULL) {
+        tattr = *attr;
+        tattr.joinable = true;
+    }
+
+    for (unsigned int i = 0; i < workers; i++) {
+        struct executor_worker *worker = &executor->workers[i];
+        worker->executor = executor;
+        worker->index = i;
+        worker->queue_mutex = os_mutex_create();
+        if (worker->queue_mutex == NULL) {
+            OS_LOGE(LOG_TAG, "Failed to create queue_mutex");
+            goto fail_create;
+        }
+        worker->thread_id = os_thread_create(&tattr, executor_worker_entry, worker);
+        if (worker->thread_id == NULL) {
+            OS_LOGE(LOG_TAG, "Failed to create worker thread");
+            os_mutex_destroy(worker->queue_mutex);
+            worker->queue_mutex = NULL;
+            goto fail_create;
+        }
+        executor->worker_count++;
+    }
+
+    return executor;
+
+fail_create:
+    executor_destroy(executor);
+    return NULL;
+}
+
+void executor_destroy(executor_handle executor)
+{
+    if (executor == NULL)
+        return;
+
+    if (executor->task_mutex != NULL && executor->task_cond != NULL) {
+        os_mutex_lock(executor->task_mutex);
+        ATOMIC_STORE(executor->exit, 1);
+        os_cond_broadcast(executor->task_cond);
+        os_mutex_unlock(executor->task_mutex);
+    }
+
+    for (unsigned int i = 0; i < executor->worker_count; i++) {
+        struct executor_worker *worker = &executor->workers[i];
+        os_thread_join(worker->thread_id, NULL);
+        if (worker->queue_count > 0)
+            OS_LOGW(LOG_TAG, "Discard %u tasks of worker[%u]", worker->queue_count, i);
+        OS_FREE(worker->queue);
+        os_mutex_destroy(worker->queue_mutex);
+    }
+
+    while (executor->delayed != NULL) {
+        struct executor_delayed *delayed = executor->delayed;
+        executor->delayed = delayed->next;
+        OS_FREE(delayed);
+    }
+
+    OS_FREE(executor->workers);
+    if (executor->task_cond != NULL)
+        os_cond_destroy(executor->task_cond);
+    if (executor->task_mutex != NULL)
+        os_mutex_destroy(executor->task_mutex);
+    OS_FREE(executor);
+}
+
+int executor_submit(executor_handle executor, executor_task_cb cb, void *arg)
+{
+    if (executor == NULL || cb == NULL)
+        return -1;
+
+    struct executor_task task = {
+        .cb = cb,
+        .arg = arg,
+    };
+
+    // A task submitted by a running task stays on the same worker, it's likely to
+    // touch the same data, idle workers steal it if this worker is busy.
+    struct executor_worker *worker = executor_current_worker(executor);
+    if (worker == NULL) {
+        unsigned int next = (unsigned int)ATOMIC_FETCH_ADD(executor->next_worker, 1);
+        worker = &executor->workers[next % executor->worker_count];
+    }
+
+    if (executor_push(executor, worker, &task) != 0)
+        return -1;
+
+    executor_wake_idle(executor);
+    return 0;
+}
+
+int executor_submit_delayed(executor_handle executor, executor_task_cb cb, void *arg, unsigned long delay_ms)
+{
+    if (delay_ms == 0)
+        return executor_submit(executor, cb, arg);
+    if (executor == NULL || cb == NULL)
+        return -1;
+
+    struct executor_delayed *delayed = OS_MALLOC(sizeof(struct executor_delayed));
+    if (delayed == NULL) {
+        OS_LOGE(LOG_TAG, "Failed to allocate delayed task");
+        return -1;
+    }
+    delayed->task.cb = cb;
+    delayed->task.arg = arg;
+    delayed->due_usec = os_monotonic_usec() + (unsigned long long)delay_ms*1000;
+
+    os_mutex_lock(executor->task_mutex);
+    struct executor_delayed **pos = &executor->delayed;
+    while (*pos != NULL && (*pos)->due_usec <= delayed->due_usec)
+        pos = &(*pos)->next;
+    delayed->next = *pos;
+    *pos = delayed;
+    ATOMIC_STORE_ULL(executor->delayed_due, executor->delayed->due_usec);
+    // an idle worker re-arms its wait for the earliest due time, busy ones see delayed_due
+    if (ATOMIC_LOAD(executor->idle_count) > 0)
+        os_cond_signal(executor->task_cond);
+    os_mutex_unlock(executor->task_mutex);
+    return 0;
+}
+
+unsigned int executor_worker_count(executor_handle executor)
+{
+    return executor != NULL ? executor->worker_count : 0;
+}
+
+unsigned int executor_task_count(executor_handle executor)
+{
+    int count = executor != NULL ? ATOMIC_LOAD(executor->task_count) : 0;
+    return count > 0 ? (unsigned int)count : 0;
+}
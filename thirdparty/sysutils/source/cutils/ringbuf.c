@@ -34,13 +34,34 @@
 
 #define LOG_TAG "ringbuf"
 
+#if defined(__STDC_NO_ATOMICS__)
+// IMPORTANT:
+//   IF ATOMIC NOT SUPPORTED, SPSC MODE FALLS BACK TO THE LOCKED RINGBUF
+#define ATOMIC_DECLARE(obj)         int obj
+#define ATOMIC_INIT(obj, val)       obj = val
+#define ATOMIC_LOAD(obj)            obj
+#define ATOMIC_STORE(obj, val)      obj = val
+#define ATOMIC_FETCH_ADD(obj, val)  (obj += val, obj - val)
+#define ATOMIC_FETCH_SUB(obj, val)  (obj -= val, obj + val)
+
+#else
+#include <stdatomic.h>
+#define ATOMIC_DECLARE(obj)         atomic_int obj
+#define ATOMIC_INIT(obj, val)       atomic_init(&(obj), val)
+#define ATOMIC_LOAD(obj)            atomic_load(&(obj))
+#define ATOMIC_STORE(obj, val)      atomic_store(&(obj), val)
+#define ATOMIC_FETCH_ADD(obj, val)  atomic_fetch_add(&(obj), val)
+#define ATOMIC_FETCH_SUB(obj, val)  atomic_fetch_sub(&(obj), val)
+#endif
+
 struct ringbuf {
     char *p_o;                   /**< Original pointer */
     char *volatile p_r;          /**< Read pointer */
     char *volatile p_w;          /**< Write pointer */
-    int  fill_cnt;               /**< Number of filled slots */
+    ATOMIC_DECLARE(fill_cnt);    /**< Number of filled slots */
     int  threshold_cnt;          /**< Number of threshold slots */
     int  size;                   /**< Buffer size */
+    int  span;                   /**< Size of contiguous view area behind the buffer */
     os_cond can_read;
     os_cond can_write;
     os_mutex lock;
@@ -48,29 +69,49 @@ struct ringbuf {
     bool abort_write;
     bool is_done_write;          /**< To signal that we are done writing */
     bool unblock_reader_flag;    /**< To unblock instantly from rb_read */
-    bool is_reach_threshold;
+    ATOMIC_DECLARE(is_reach_threshold); /**< Read without lock by spsc reader, only goes from 0 to 1 */
+    bool spsc;                   /**< Single producer and single consumer, data path is lock-free */
+    bool static_buf;             /**< Data buffer is owned by caller, not freed on destroy */
+    ATOMIC_DECLARE(read_wait);   /**< Bytes that blocked reader is waiting for, spsc only */
+    ATOMIC_DECLARE(write_wait);  /**< Space that blocked writer is waiting for, spsc only */
 };
 
 ringbuf_handle rb_create(int size)
+{
+    return rb_create_with_span(size, 0);
+}
+
+static ringbuf_handle rb_create_internal(char *buffer, int size, int span)
 {
     ringbuf_handle rb;
-    char *buf = NULL;
+    char *buf = buffer;
+    if (span < 0)
+        span = 0;
     bool _success =
         (
             (rb             = OS_CALLOC(1, sizeof(struct ringbuf))) &&
-            (buf            = OS_CALLOC(1, size)) &&
+            (buf != NULL || (buf = OS_CALLOC(1, size + span))) &&
             (rb->lock       = os_mutex_create()) &&
             (rb->can_read   = os_cond_create()) &&
             (rb->can_write  = os_cond_create())
         );
 
+    if (rb != NULL)
+        rb->static_buf = buffer != NULL;
     if (!_success) {
+        if (rb != NULL)
+            rb->p_o = buf;
         rb_destroy(rb);
         return NULL;
     }
 
     rb->p_o = rb->p_r = rb->p_w = buf;
     rb->size = size;
+    rb->span = span;
+    ATOMIC_INIT(rb->fill_cnt, 0);
+    ATOMIC_INIT(rb->read_wait, 0);
+    ATOMIC_INIT(rb->write_wait, 0);
+    ATOMIC_INIT(rb->is_reach_threshold, 0);
     rb->is_done_write = false;
     rb->unblock_reader_flag = false;
     rb->abort_read = false;
@@ -78,11 +119,38 @@ ringbuf_handle rb_create(int size)
     return rb;
 }
 
+ringbuf_handle rb_create_with_span(int size, int span)
+{
+    return rb_create_internal(NULL, size, span);
+}
+
+ringbuf_handle rb_create_spsc(int size, int span)
+{
+    ringbuf_handle rb = rb_create_with_span(size, span);
+#if !defined(__STDC_NO_ATOMICS__)
+    if (rb != NULL)
+        rb->spsc = true;
+#endif
+    return rb;
+}
+
+ringbuf_handle rb_create_spsc_static(char *buffer, int size, int span)
+{
+    if (buffer == NULL)
+        return NULL;
+    ringbuf_handle rb = rb_create_internal(buffer, size, span);
+#if !defined(__STDC_NO_ATOMICS__)
+    if (rb != NULL)
+        rb->spsc = true;
+#endif
+    return rb;
+}
+
 void rb_destroy(ringbuf_handle rb)
 {
     if (rb == NULL)
         return;
-    if (rb->p_o)
+    if (rb->p_o && !rb->static_buf)
         OS_FREE(rb->p_o);
     if (rb->can_read)
         os_cond_destroy(rb->can_read);
@@ -97,7 +165,7 @@ void rb_reset(ringbuf_handle rb)
 {
     os_mutex_lock(rb->lock);
     rb->p_r = rb->p_w = rb->p_o;
-    rb->fill_cnt = 0;
+    ATOMIC_STORE(rb->fill_cnt, 0);
     rb->is_done_write = false;
     rb->unblock_reader_flag = false;
     rb->abort_read = false;
@@ -108,12 +176,222 @@ void rb_reset(ringbuf_handle rb)
 
 int rb_bytes_available(ringbuf_handle rb)
 {
-    return (rb->size - rb->fill_cnt);
+    return (rb->size - ATOMIC_LOAD(rb->fill_cnt));
 }
 
 int rb_bytes_filled(ringbuf_handle rb)
 {
-    return rb->fill_cnt;
+    return ATOMIC_LOAD(rb->fill_cnt);
+}
+
+/*
+ * SPSC mode: the reader owns p_r and the writer owns p_w, fill_cnt is the only
+ * shared counter. The lock is taken only to block or to wake the peer up, and a
+ * peer is woken up only when it's blocked and what it's waiting for is there.
+ */
+
+// returns bytes readable, or RB_DONE/RB_ABORT/RB_TIMEOUT/RB_FAIL
+static int rb_spsc_wait_read(ringbuf_handle rb, int size, bool chunk, unsigned int timeout_ms)
+{
+    int need = chunk ? size : 1;
+    int filled = ATOMIC_LOAD(rb->fill_cnt);
+    int ret_val = 0;
+
+    if (filled >= need && ATOMIC_LOAD(rb->is_reach_threshold))
+        return filled;
+
+    os_mutex_lock(rb->lock);
+    while (1) {
+        ATOMIC_STORE(rb->read_wait, need);
+        filled = ATOMIC_LOAD(rb->fill_cnt);
+        if (filled >= need && ATOMIC_LOAD(rb->is_reach_threshold)) {
+            ret_val = filled;
+            break;
+        }
+        if (rb->is_done_write) {
+            ret_val = (filled > 0 && ATOMIC_LOAD(rb->is_reach_threshold)) ? filled : RB_DONE;
+            break;
+        }
+        if (rb->abort_read) {
+            ret_val = RB_ABORT;
+            break;
+        }
+        if (rb->unblock_reader_flag) {
+            //reader_unblock is nothing but forced timeout, it wakes up the reader once
+            rb->unblock_reader_flag = false;
+            ret_val = RB_TIMEOUT;
+            break;
+        }
+        if (size > rb->size && chunk) {
+            ret_val = RB_FAIL;
+            break;
+        }
+        //wait till some data available to read
+        if (timeout_ms == 0)
+            ret_val = os_cond_wait(rb->can_read, rb->lock);
+        else
+            ret_val = os_cond_timedwait(rb->can_read, rb->lock, timeout_ms*1000);
+        if (ret_val != 0) {
+            ret_val = RB_TIMEOUT;
+            break;
+        }
+    }
+    ATOMIC_STORE(rb->read_wait, 0);
+    os_mutex_unlock(rb->lock);
+    return ret_val;
+}
+
+// returns bytes writable, or RB_DONE/RB_ABORT/RB_TIMEOUT/RB_FAIL
+static int rb_spsc_wait_write(ringbuf_handle rb, int size, bool chunk, unsigned int timeout_ms)
+{
+    int need = chunk ? size : 1;
+    int available = rb->size - ATOMIC_LOAD(rb->fill_cnt);
+    int ret_val = 0;
+
+    if (available >= need)
+        return available;
+
+    os_mutex_lock(rb->lock);
+    while (1) {
+        ATOMIC_STORE(rb->write_wait, need);
+        available = rb->size - ATOMIC_LOAD(rb->fill_cnt);
+        if (available >= need) {
+            ret_val = available;
+            break;
+        }
+        if (rb->is_done_write) {
+            ret_val = (available > 0 && chunk) ? available : RB_DONE;
+            ATOMIC_STORE(rb->is_reach_threshold, 1);
+            break;
+        }
+        if (rb->abort_write) {
+            ret_val = RB_ABORT;
+            ATOMIC_STORE(rb->is_reach_threshold, 1);
+            break;
+        }
+        if (size > rb->size && chunk) {
+            ret_val = RB_FAIL;
+            ATOMIC_STORE(rb->is_reach_threshold, 1);
+            break;
+        }
+        //wait till we have some empty space to write
+        if (timeout_ms == 0)
+            ret_val = os_cond_wait(rb->can_write, rb->lock);
+        else
+            ret_val = os_cond_timedwait(rb->can_write, rb->lock, timeout_ms*1000);
+        if (ret_val != 0) {
+            ret_val = RB_TIMEOUT;
+            break;
+        }
+    }
+    ATOMIC_STORE(rb->write_wait, 0);
+    if (ATOMIC_LOAD(rb->is_reach_threshold))
+        os_cond_signal(rb->can_read);
+    os_mutex_unlock(rb->lock);
+    return ret_val;
+}
+
+static void rb_spsc_publish_read(ringbuf_handle rb, int size)
+{
+    if ((rb->p_r + size) >= (rb->p_o + rb->size))
+        rb->p_r = rb->p_r + size - rb->size;
+    else
+        rb->p_r = rb->p_r + size;
+
+    int filled = ATOMIC_FETCH_SUB(rb->fill_cnt, size) - size;
+    int waiting = ATOMIC_LOAD(rb->write_wait);
+    if (waiting > 0 && rb->size - filled >= waiting) {
+        os_mutex_lock(rb->lock);
+        os_cond_signal(rb->can_write);
+        os_mutex_unlock(rb->lock);
+    }
+}
+
+static void rb_spsc_publish_write(ringbuf_handle rb, int size)
+{
+    if ((rb->p_w + size) >= (rb->p_o + rb->size))
+        rb->p_w = rb->p_w + size - rb->size;
+    else
+        rb->p_w = rb->p_w + size;
+
+    int filled = ATOMIC_FETCH_ADD(rb->fill_cnt, size) + size;
+    bool reach_threshold = !ATOMIC_LOAD(rb->is_reach_threshold) && filled >= rb->threshold_cnt;
+    int waiting = ATOMIC_LOAD(rb->read_wait);
+    if (reach_threshold || (waiting > 0 && filled >= waiting)) {
+        os_mutex_lock(rb->lock);
+        if (reach_threshold)
+            ATOMIC_STORE(rb->is_reach_threshold, 1);
+        os_cond_signal(rb->can_read);
+        os_mutex_unlock(rb->lock);
+    }
+}
+
+static void rb_spsc_copy_out(ringbuf_handle rb, char *buf, int size)
+{
+    if ((rb->p_r + size) > (rb->p_o + rb->size)) {
+        int rlen1 = rb->p_o + rb->size - rb->p_r;
+        int rlen2 = size - rlen1;
+        memcpy(buf, rb->p_r, rlen1);
+        memcpy(buf + rlen1, rb->p_o, rlen2);
+    } else {
+        memcpy(buf, rb->p_r, size);
+    }
+    rb_spsc_publish_read(rb, size);
+}
+
+static void rb_spsc_copy_in(ringbuf_handle rb, char *buf, int size)
+{
+    if ((rb->p_w + size) > (rb->p_o + rb->size)) {
+        int wlen1 = rb->p_o + rb->size - rb->p_w;
+        int wlen2 = size - wlen1;
+        memcpy(rb->p_w, buf, wlen1);
+        memcpy(rb->p_o, buf + wlen1, wlen2);
+    } else {
+        memcpy(rb->p_w, buf, size);
+    }
+    rb_spsc_publish_write(rb, size);
+}
+
+static int rb_spsc_read(ringbuf_handle rb, char *buf, int buf_len, unsigned int timeout_ms)
+{
+    int total_read_size = 0;
+    int ret_val = 0;
+
+    while (buf_len > 0) {
+        ret_val = rb_spsc_wait_read(rb, buf_len, false, timeout_ms);
+        if (ret_val <= 0)
+            break;
+        int read_size = ret_val < buf_len ? ret_val : buf_len;
+        rb_spsc_copy_out(rb, buf, read_size);
+        buf_len -= read_size;
+        total_read_size += read_size;
+        buf += read_size;
+    }
+
+    if ((ret_val == RB_FAIL) || (ret_val == RB_ABORT))
+        total_read_size = ret_val;
+    return total_read_size > 0 ? total_read_size : ret_val;
+}
+
+static int rb_spsc_write(ringbuf_handle rb, char *buf, int buf_len, unsigned int timeout_ms)
+{
+    int total_write_size = 0;
+    int ret_val = 0;
+
+    while (buf_len > 0) {
+        ret_val = rb_spsc_wait_write(rb, buf_len, false, timeout_ms);
+        if (ret_val <= 0)
+            break;
+        int write_size = ret_val < buf_len ? ret_val : buf_len;
+        rb_spsc_copy_in(rb, buf, write_size);
+        buf_len -= write_size;
+        total_write_size += write_size;
+        buf += write_size;
+    }
+
+    if ((ret_val == RB_FAIL) || (ret_val == RB_ABORT))
+        total_write_size = ret_val;
+    return total_write_size > 0 ? total_write_size : ret_val;
 }
 
 int rb_read(ringbuf_handle rb, char *buf, int buf_len, unsigned int timeout_ms)
@@ -122,6 +400,9 @@ int rb_read(ringbuf_handle rb, char *buf, int buf_len, unsigned int timeout_ms)
     int total_read_size = 0;
     int ret_val = 0;
 
+    if (rb->spsc)
+        return rb_spsc_read(rb, buf, buf_len, timeout_ms);
+
     //take buffer lock
     os_mutex_lock(rb->lock);
 
@@ -141,7 +422,7 @@ int rb_read(ringbuf_handle rb, char *buf, int buf_len, unsigned int timeout_ms)
             read_size = buf_len;
         }
 
-        if (read_size == 0 || !rb->is_reach_threshold) {
+        if (read_size == 0 || !ATOMIC_LOAD(rb->is_reach_threshold)) {
             if (rb->is_done_write) {
                 ret_val = RB_DONE;
                 goto read_err;
@@ -151,7 +432,8 @@ int rb_read(ringbuf_handle rb, char *buf, int buf_len, unsigned int timeout_ms)
                 goto read_err;
             }
             if (rb->unblock_reader_flag) {
-                //reader_unblock is nothing but forced timeout
+                //reader_unblock is nothing but forced timeout, it wakes up the reader once
+                rb->unblock_reader_flag = false;
                 ret_val = RB_TIMEOUT;
                 goto read_err;
             }
@@ -202,6 +484,9 @@ int rb_write(ringbuf_handle rb, char *buf, int buf_len, unsigned int timeout_ms)
     int total_write_size = 0;
     int ret_val = 0;
 
+    if (rb->spsc)
+        return rb_spsc_write(rb, buf, buf_len, timeout_ms);
+
     //take buffer lock
     os_mutex_lock(rb->lock);
 
@@ -214,12 +499,12 @@ int rb_write(ringbuf_handle rb, char *buf, int buf_len, unsigned int timeout_ms)
         if (write_size == 0) {
             if (rb->is_done_write) {
                 ret_val = RB_DONE;
-                rb->is_reach_threshold = true;
+                ATOMIC_STORE(rb->is_reach_threshold, 1);
                 goto write_err;
             }
             if (rb->abort_write) {
                 ret_val = RB_ABORT;
-                rb->is_reach_threshold = true;
+                ATOMIC_STORE(rb->is_reach_threshold, 1);
                 goto write_err;
             }
             os_cond_signal(rb->can_read);
@@ -251,12 +536,12 @@ int rb_write(ringbuf_handle rb, char *buf, int buf_len, unsigned int timeout_ms)
         total_write_size += write_size;
         buf += write_size;
 
-        if (!rb->is_reach_threshold && rb->fill_cnt >= rb->threshold_cnt)
-            rb->is_reach_threshold = true;
+        if (!ATOMIC_LOAD(rb->is_reach_threshold) && rb->fill_cnt >= rb->threshold_cnt)
+            ATOMIC_STORE(rb->is_reach_threshold, 1);
     }
 
 write_err:
-    if (rb->is_reach_threshold && total_write_size > 0) {
+    if (ATOMIC_LOAD(rb->is_reach_threshold) && total_write_size > 0) {
         os_cond_signal(rb->can_read);
     }
     os_mutex_unlock(rb->lock);
@@ -272,6 +557,15 @@ int rb_read_chunk(ringbuf_handle rb, char *buf, int size, unsigned int timeout_m
     int total_read_size = 0;
     int ret_val = 0;
 
+    if (rb->spsc) {
+        ret_val = rb_spsc_wait_read(rb, size, true, timeout_ms);
+        if (ret_val <= 0)
+            return ret_val;
+        read_size = ret_val < size ? ret_val : size;
+        rb_spsc_copy_out(rb, buf, read_size);
+        return read_size;
+    }
+
     //take buffer lock
     os_mutex_lock(rb->lock);
 
@@ -285,7 +579,7 @@ wait_filled:
         read_size = size;
     }
 
-    if (read_size == 0 || !rb->is_reach_threshold) {
+    if (read_size == 0 || !ATOMIC_LOAD(rb->is_reach_threshold)) {
         if (rb->is_done_write) {
             ret_val = RB_DONE;
             goto read_done;
@@ -295,7 +589,8 @@ wait_filled:
             goto read_done;
         }
         if (rb->unblock_reader_flag) {
-            //reader_unblock is nothing but forced timeout
+            //reader_unblock is nothing but forced timeout, it wakes up the reader once
+            rb->unblock_reader_flag = false;
             ret_val = RB_TIMEOUT;
             goto read_done;
         }
@@ -346,6 +641,15 @@ int rb_write_chunk(ringbuf_handle rb, char *buf, int size, unsigned int timeout_
     int total_write_size = 0;
     int ret_val = 0;
 
+    if (rb->spsc) {
+        ret_val = rb_spsc_wait_write(rb, size, true, timeout_ms);
+        if (ret_val <= 0)
+            return ret_val;
+        write_size = ret_val < size ? ret_val : size;
+        rb_spsc_copy_in(rb, buf, write_size);
+        return write_size;
+    }
+
     //take buffer lock
     os_mutex_lock(rb->lock);
 
@@ -362,17 +666,17 @@ wait_available:
     if (write_size == 0) {
         if (rb->is_done_write) {
             ret_val = RB_DONE;
-            rb->is_reach_threshold = true;
+            ATOMIC_STORE(rb->is_reach_threshold, 1);
             goto write_done;
         }
         if (rb->abort_write) {
             ret_val = RB_ABORT;
-            rb->is_reach_threshold = true;
+            ATOMIC_STORE(rb->is_reach_threshold, 1);
             goto write_done;
         }
         if (size > rb->size) {
             ret_val = RB_FAIL;
-            rb->is_reach_threshold = true;
+            ATOMIC_STORE(rb->is_reach_threshold, 1);
             goto write_done;
         }
         os_cond_signal(rb->can_read);
@@ -401,11 +705,11 @@ wait_available:
     rb->fill_cnt += write_size;
     total_write_size += write_size;
 
-    if (!rb->is_reach_threshold && rb->fill_cnt >= rb->threshold_cnt)
-        rb->is_reach_threshold = true;
+    if (!ATOMIC_LOAD(rb->is_reach_threshold) && rb->fill_cnt >= rb->threshold_cnt)
+        ATOMIC_STORE(rb->is_reach_threshold, 1);
 
 write_done:
-    if (rb->is_reach_threshold && total_write_size > 0) {
+    if (ATOMIC_LOAD(rb->is_reach_threshold) && total_write_size > 0) {
         os_cond_signal(rb->can_read);
     }
     os_mutex_unlock(rb->lock);
@@ -415,6 +719,211 @@ write_done:
     return total_write_size > 0 ? total_write_size : ret_val;
 }
 
+static int rb_acquire_view(ringbuf_handle rb, char **buf, int read_size)
+{
+    if ((rb->p_r + read_size) > (rb->p_o + rb->size)) {
+        int rlen1 = rb->p_o + rb->size - rb->p_r;
+        int rlen2 = read_size - rlen1;
+        if (rlen2 <= rb->span) {
+            // mirror the wrapped head behind the buffer, the writer never touches
+            // this area, and the head bytes are filled so they are stable too
+            memcpy(rb->p_o + rb->size, rb->p_o, rlen2);
+        } else {
+            read_size = rlen1;
+        }
+    }
+    *buf = rb->p_r;
+    return read_size;
+}
+
+int rb_acquire_read(ringbuf_handle rb, char **buf, int size, unsigned int timeout_ms)
+{
+    int read_size = size;
+    int ret_val = 0;
+
+    if (rb->spsc) {
+        ret_val = rb_spsc_wait_read(rb, size, true, timeout_ms);
+        if (ret_val <= 0)
+            return ret_val;
+        return rb_acquire_view(rb, buf, ret_val < size ? ret_val : size);
+    }
+
+    //take buffer lock
+    os_mutex_lock(rb->lock);
+
+wait_filled:
+    if (rb->fill_cnt < size) {
+        if (rb->is_done_write)
+            read_size = rb->fill_cnt;
+        else
+            read_size = 0;
+    } else {
+        read_size = size;
+    }
+
+    if (read_size == 0 || !ATOMIC_LOAD(rb->is_reach_threshold)) {
+        if (rb->is_done_write) {
+            ret_val = RB_DONE;
+            goto acquire_done;
+        }
+        if (rb->abort_read) {
+            ret_val = RB_ABORT;
+            goto acquire_done;
+        }
+        if (rb->unblock_reader_flag) {
+            //reader_unblock is nothing but forced timeout, it wakes up the reader once
+            rb->unblock_reader_flag = false;
+            ret_val = RB_TIMEOUT;
+            goto acquire_done;
+        }
+        if (size > rb->size) {
+            ret_val = RB_FAIL;
+            goto acquire_done;
+        }
+        os_cond_signal(rb->can_write);
+        //wait till some data available to read
+        if (timeout_ms == 0)
+            ret_val = os_cond_wait(rb->can_read, rb->lock);
+        else
+            ret_val = os_cond_timedwait(rb->can_read, rb->lock, timeout_ms*1000);
+        if (ret_val != 0) {
+            ret_val = RB_TIMEOUT;
+            goto acquire_done;
+        }
+        goto wait_filled;
+    }
+
+    ret_val = rb_acquire_view(rb, buf, read_size);
+
+acquire_done:
+    os_mutex_unlock(rb->lock);
+    return ret_val;
+}
+
+int rb_commit_read(ringbuf_handle rb, int size)
+{
+    if (size <= 0)
+        return RB_OK;
+
+    if (rb->spsc) {
+        if (size > ATOMIC_LOAD(rb->fill_cnt)) {
+            OS_LOGE(LOG_TAG, "Commit read overflow: %d/%d", size, ATOMIC_LOAD(rb->fill_cnt));
+            return RB_FAIL;
+        }
+        rb_spsc_publish_read(rb, size);
+        return RB_OK;
+    }
+
+    os_mutex_lock(rb->lock);
+    if (size > rb->fill_cnt) {
+        OS_LOGE(LOG_TAG, "Commit read overflow: %d/%d", size, rb->fill_cnt);
+        os_mutex_unlock(rb->lock);
+        return RB_FAIL;
+    }
+    if ((rb->p_r + size) >= (rb->p_o + rb->size))
+        rb->p_r = rb->p_r + size - rb->size;
+    else
+        rb->p_r = rb->p_r + size;
+    rb->fill_cnt -= size;
+    os_cond_signal(rb->can_write);
+    os_mutex_unlock(rb->lock);
+    return RB_OK;
+}
+
+int rb_acquire_write(ringbuf_handle rb, char **buf, int size, unsigned int timeout_ms)
+{
+    int write_size = 0;
+    int ret_val = 0;
+
+    if (rb->spsc) {
+        ret_val = rb_spsc_wait_write(rb, size, false, timeout_ms);
+        if (ret_val <= 0)
+            return ret_val;
+        write_size = ret_val < size ? ret_val : size;
+        if ((rb->p_w + write_size) > (rb->p_o + rb->size))
+            write_size = rb->p_o + rb->size - rb->p_w;
+        *buf = rb->p_w;
+        return write_size;
+    }
+
+    //take buffer lock
+    os_mutex_lock(rb->lock);
+
+    while (1) {
+        write_size = rb_bytes_available(rb);
+        if (size < write_size)
+            write_size = size;
+
+        if (write_size > 0)
+            break;
+
+        if (rb->is_done_write) {
+            ret_val = RB_DONE;
+            ATOMIC_STORE(rb->is_reach_threshold, 1);
+            goto acquire_done;
+        }
+        if (rb->abort_write) {
+            ret_val = RB_ABORT;
+            ATOMIC_STORE(rb->is_reach_threshold, 1);
+            goto acquire_done;
+        }
+        os_cond_signal(rb->can_read);
+        //wait till we have some empty space to write
+        if (timeout_ms == 0)
+            ret_val = os_cond_wait(rb->can_write, rb->lock);
+        else
+            ret_val = os_cond_timedwait(rb->can_write, rb->lock, timeout_ms*1000);
+        if (ret_val != 0) {
+            ret_val = RB_TIMEOUT;
+            goto acquire_done;
+        }
+    }
+
+    // writer never wraps into the view area, the tail is returned first
+    if ((rb->p_w + write_size) > (rb->p_o + rb->size))
+        write_size = rb->p_o + rb->size - rb->p_w;
+    *buf = rb->p_w;
+    ret_val = write_size;
+
+acquire_done:
+    os_mutex_unlock(rb->lock);
+    return ret_val;
+}
+
+int rb_commit_write(ringbuf_handle rb, int size)
+{
+    if (size <= 0)
+        return RB_OK;
+
+    if (rb->spsc) {
+        if (size > rb_bytes_available(rb)) {
+            OS_LOGE(LOG_TAG, "Commit write overflow: %d/%d", size, rb_bytes_available(rb));
+            return RB_FAIL;
+        }
+        rb_spsc_publish_write(rb, size);
+        return RB_OK;
+    }
+
+    os_mutex_lock(rb->lock);
+    if (size > rb_bytes_available(rb)) {
+        OS_LOGE(LOG_TAG, "Commit write overflow: %d/%d", size, rb_bytes_available(rb));
+        os_mutex_unlock(rb->lock);
+        return RB_FAIL;
+    }
+    if ((rb->p_w + size) >= (rb->p_o + rb->size))
+        rb->p_w = rb->p_w + size - rb->size;
+    else
+        rb->p_w = rb->p_w + size;
+    rb->fill_cnt += size;
+
+    if (!ATOMIC_LOAD(rb->is_reach_threshold) && rb->fill_cnt >= rb->threshold_cnt)
+        ATOMIC_STORE(rb->is_reach_threshold, 1);
+    if (ATOMIC_LOAD(rb->is_reach_threshold))
+        os_cond_signal(rb->can_read);
+    os_mutex_unlock(rb->lock);
+    return RB_OK;
+}
+
 static void rb_abort_read(ringbuf_handle rb)
 {
     os_mutex_lock(rb->lock);
@@ -439,7 +948,7 @@ void rb_abort(ringbuf_handle rb)
 
 bool rb_is_full(ringbuf_handle rb)
 {
-    return (rb->size == rb->fill_cnt);
+    return (rb->size == ATOMIC_LOAD(rb->fill_cnt));
 }
 
 void rb_done_write(ringbuf_handle rb)
@@ -490,5 +999,5 @@ int rb_get_threshold(ringbuf_handle rb)
 
 bool rb_reach_threshold(ringbuf_handle rb)
 {
-    return rb->is_reach_threshold;
+    return ATOMIC_LOAD(rb->is_reach_threshold) != 0;
 }
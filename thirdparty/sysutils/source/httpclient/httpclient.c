@@ -20,7 +20,10 @@
 
 #include <stdint.h>
 #include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
 #include "osal/os_thread.h"
+#include "osal/os_time.h"
 #include "cutils/memory_helper.h"
 #include "cutils/log_helper.h"
 #include "httpclient/httpclient.h"
@@ -67,10 +70,13 @@
 #define HTTPCLIENT_CHUNK_SIZE_STR_LEN 6 //1234\r\n means chunk size is 0x1234
 #define HTTPCLIENT_HEADER_BUF_SIZE 1024
 #define HTTPCLIENT_SEND_BUF_SIZE   1024
-#define HTTPCLIENT_MAX_HOST_LEN    64
 #define HTTPCLIENT_MAX_URL_LEN     512
 #define HTTPCLIENT_REDIRECT_MAX    5
 #define HTTPCLIENT_TIMEOUT_SEC     3
+#define HTTPCLIENT_POOL_SIZE       4
+#ifndef HTTPCLIENT_POOL_IDLE_SEC
+#define HTTPCLIENT_POOL_IDLE_SEC   30 // overridden by httpclient_test to see connections expire
+#endif
 
 #ifdef SYSUTILS_HAVE_MBEDTLS_ENABLED
 #include "mbedtls/debug.h"
@@ -463,9 +469,149 @@ static void httpclient_ssl_close(httpclient_t *client)
     mbedtls_ctr_drbg_free(&ssl->ctr_drbg);
     mbedtls_entropy_free(&ssl->entropy);
     OS_FREE(ssl);
+    client->ssl = NULL;
 }
 #endif
 
+/*
+ * Keep-alive connection pool, idle connections are keyed by scheme, host and port and taken
+ * by the next request to the same server, e.g. sequential segments of HLS, so neither tcp
+ * connect nor TLS handshake is repeated. A connection is checked to be alive before reused.
+ */
+struct httpclient_pool_entry {
+    bool used;
+    bool is_https;
+    int remote_port;
+    char host[HTTPCLIENT_MAX_HOST_LEN];
+    int socket;
+    void *ssl;
+    unsigned long long idle_usec;
+};
+
+static struct httpclient_pool_entry g_pool[HTTPCLIENT_POOL_SIZE];
+static _Atomic(os_mutex) g_pool_lock;
+static int g_pool_hits;
+static int g_pool_misses;
+
+static os_mutex httpclient_pool_lock()
+{
+    os_mutex lock = atomic_load(&g_pool_lock);
+    if (lock == NULL) {
+        os_mutex expected = NULL;
+        lock = os_mutex_create();
+        if (lock == NULL)
+            return NULL;
+        if (!atomic_compare_exchange_strong(&g_pool_lock, &expected, lock)) {
+            os_mutex_destroy(lock);
+            lock = expected;
+        }
+    }
+    os_mutex_lock(lock);
+    return lock;
+}
+
+static void httpclient_pool_close(struct httpclient_pool_entry *entry)
+{
+    httpclient_t client;
+    memset(&client, 0, sizeof(client));
+    client.is_https = entry->is_https;
+    client.socket = entry->socket;
+    client.ssl = entry->ssl;
+    httpclient_close(&client);
+}
+
+static bool httpclient_pool_alive(struct httpclient_pool_entry *entry, unsigned long long now)
+{
+    if (now - entry->idle_usec > HTTPCLIENT_POOL_IDLE_SEC*1000000ULL)
+        return false;
+#ifdef SYSUTILS_HAVE_MBEDTLS_ENABLED
+    if (entry->is_https &&
+        mbedtls_ssl_get_bytes_avail(&((httpclient_ssl_t *)entry->ssl)->ssl_ctx) > 0)
+        return false;
+#endif
+    // eof or unexpected data (e.g. close notify) means server has dropped the connection
+    char c;
+    int ret = recv(entry->socket, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+static bool httpclient_pool_take(httpclient_t *client)
+{
+    struct httpclient_pool_entry stale[HTTPCLIENT_POOL_SIZE];
+    int stale_count = 0;
+    bool found = false;
+    os_mutex lock = httpclient_pool_lock();
+    if (lock == NULL)
+        return false;
+
+    unsigned long long now = os_monotonic_usec();
+    for (int i = 0; i < HTTPCLIENT_POOL_SIZE && !found; i++) {
+        struct httpclient_pool_entry *entry = &g_pool[i];
+        if (!entry->used || entry->is_https != client->is_https ||
+            entry->remote_port != client->remote_port || strcmp(entry->host, client->host) != 0)
+            continue;
+        entry->used = false;
+        if (httpclient_pool_alive(entry, now)) {
+            client->socket = entry->socket;
+            client->ssl = entry->ssl;
+            found = true;
+        } else {
+            stale[stale_count++] = *entry;
+        }
+    }
+    if (found)
+        g_pool_hits++;
+    else
+        g_pool_misses++;
+
+    os_mutex_unlock(lock);
+
+    for (int i = 0; i < stale_count; i++)
+        httpclient_pool_close(&stale[i]);
+    return found;
+}
+
+static void httpclient_pool_put(httpclient_t *client)
+{
+    struct httpclient_pool_entry evicted;
+    struct httpclient_pool_entry *entry = NULL;
+    bool evict = false;
+    os_mutex lock = httpclient_pool_lock();
+    if (lock == NULL) {
+        httpclient_close(client);
+        return;
+    }
+
+    // evict the longest idle connection if pool is full
+    for (int i = 0; i < HTTPCLIENT_POOL_SIZE; i++) {
+        if (!g_pool[i].used) {
+            entry = &g_pool[i];
+            break;
+        }
+        if (entry == NULL || g_pool[i].idle_usec < entry->idle_usec)
+            entry = &g_pool[i];
+    }
+    if (entry->used) {
+        evicted = *entry;
+        evict = true;
+    }
+
+    entry->used = true;
+    entry->is_https = client->is_https;
+    entry->remote_port = client->remote_port;
+    memcpy(entry->host, client->host, sizeof(entry->host));
+    entry->socket = client->socket;
+    entry->ssl = client->ssl;
+    entry->idle_usec = os_monotonic_usec();
+
+    os_mutex_unlock(lock);
+
+    client->socket = -1;
+    client->ssl = NULL;
+    if (evict)
+        httpclient_pool_close(&evicted);
+}
+
 static int httpclient_get_info(httpclient_t *client, char *send_buf, int *send_idx, char *buf, size_t len)   /* 0 on success, err code on failure */
 {
     int ret = 0;
@@ -947,6 +1093,7 @@ static int httpclient_response_parse(httpclient_t *client, int len, httpclient_d
     int crlf_pos;
     int header_buf_len = client_data->header_buf_len;
     int read_result;
+    int major = 0, minor = 0;
     char *data = client_data->header_buf;
 
     client_data->response_content_len = -1;
@@ -960,7 +1107,7 @@ static int httpclient_response_parse(httpclient_t *client, int len, httpclient_d
     data[crlf_pos] = '\0';
 
     /* Parse HTTP response */
-    if (sscanf(data, "HTTP/%*d.%*d %d %*[^\r\n]", &(client->response_code)) != 1) {
+    if (sscanf(data, "HTTP/%d.%d %d %*[^\r\n]", &major, &minor, &(client->response_code)) != 3) {
         /* Cannot match string, error */
         ERR("not a correct HTTP answer : %s", data);
         return HTTPCLIENT_ERROR_PRTCL;
@@ -973,6 +1120,9 @@ static int httpclient_response_parse(httpclient_t *client, int len, httpclient_d
 
     VERBOSE("reading headers: %s", data);
 
+    /* HTTP/1.1 keeps the connection alive unless "Connection: close" */
+    client->keep_alive = major > 1 || (major == 1 && minor >= 1);
+
     memmove(data, &data[crlf_pos + 2], len - (crlf_pos + 2) + 1); /* Be sure to move NULL-terminating char as well */
     len -= (crlf_pos + 2);
     client_data->is_chunked = false;
@@ -1034,6 +1184,12 @@ static int httpclient_response_parse(httpclient_t *client, int len, httpclient_d
                     client_data->response_content_len = 0;
                     client_data->retrieve_len = 0;
                 }
+            } else if (0 == strncasecmp(key_ptr, "Connection", key_len)) {
+                if (0 == strncasecmp(value_ptr, "close", value_len)) {
+                    client->keep_alive = false;
+                } else if (0 == strncasecmp(value_ptr, "keep-alive", value_len)) {
+                    client->keep_alive = true;
+                }
             } else if (0 == strncasecmp(key_ptr, "Location", key_len)) {
                 char location[HTTPCLIENT_MAX_HOST_LEN + HTTPCLIENT_MAX_URL_LEN];
                 memset(location, 0x0, sizeof(location));
@@ -1054,18 +1210,17 @@ static int httpclient_response_parse(httpclient_t *client, int len, httpclient_d
 }
 
 
-HTTPCLIENT_RESULT httpclient_connect(httpclient_t *client, char *url)
+static int httpclient_parse_target(httpclient_t *client, char *url)
 {
-    char host[HTTPCLIENT_MAX_HOST_LEN] = {0};
     char path[HTTPCLIENT_MAX_URL_LEN] = {0};
     char scheme[8] = {0};
     int ret = HTTPCLIENT_ERROR_CONN;
 
     /* First we need to parse the url (http[s]://host[:port][/[path]]) */
-    ret = httpclient_parse_url(url, scheme, sizeof(scheme), host, sizeof(host), &(client->remote_port), path, sizeof(path));
+    ret = httpclient_parse_url(url, scheme, sizeof(scheme), client->host, sizeof(client->host), &(client->remote_port), path, sizeof(path));
     if (ret != HTTPCLIENT_OK) {
         ERR("httpclient_parse_url failed: %d", ret);
-        return (HTTPCLIENT_RESULT)ret;
+        return ret;
     }
 
     // http or https
@@ -1084,13 +1239,23 @@ HTTPCLIENT_RESULT httpclient_connect(httpclient_t *client, char *url)
         }
     }
 
-    VERBOSE("is_https?: %d, port: %d, host: %s", client->is_https, client->remote_port, host);
+    VERBOSE("is_https?: %d, port: %d, host: %s", client->is_https, client->remote_port, client->host);
+    return HTTPCLIENT_OK;
+}
+
+HTTPCLIENT_RESULT httpclient_connect(httpclient_t *client, char *url)
+{
+    int ret = httpclient_parse_target(client, url);
+    if (ret != HTTPCLIENT_OK)
+        return (HTTPCLIENT_RESULT)ret;
 
     ret = HTTPCLIENT_ERROR_CONN;
     client->socket = -1;
+    client->keep_alive = false;
+    client->reused = false;
     if (client->is_https) {
 #ifdef SYSUTILS_HAVE_MBEDTLS_ENABLED
-        ret = httpclient_ssl_conn(client, host);
+        ret = httpclient_ssl_conn(client, client->host);
         if (ret == 0) {
             httpclient_ssl_t *ssl = (httpclient_ssl_t *)client->ssl;
             client->socket = ssl->net_ctx.fd;
@@ -1099,19 +1264,36 @@ HTTPCLIENT_RESULT httpclient_connect(httpclient_t *client, char *url)
         ERR("https not supported, please set C_FLAGS with SYSUTILS_HAVE_MBEDTLS_ENABLED");
 #endif
     } else {
-        ret = httpclient_conn(client, host);
+        ret = httpclient_conn(client, client->host);
     }
 
     INFO("httpclient_connect() result: %d, client: %p", ret, client);
     return (HTTPCLIENT_RESULT)ret;
 }
 
+HTTPCLIENT_RESULT httpclient_connect_pooled(httpclient_t *client, char *url)
+{
+    int ret = httpclient_parse_target(client, url);
+    if (ret != HTTPCLIENT_OK)
+        return (HTTPCLIENT_RESULT)ret;
+
+    if (client->server_cert == NULL && client->client_cert == NULL &&
+        httpclient_pool_take(client)) {
+        client->keep_alive = false;
+        client->reused = true;
+        DBG("httpclient_connect_pooled() reused, client: %p", client);
+        return HTTPCLIENT_OK;
+    }
+    return httpclient_connect(client, url);
+}
+
 HTTPCLIENT_RESULT httpclient_send_request(httpclient_t *client, char *url, int method, httpclient_data_t *client_data)
 {
     int ret = HTTPCLIENT_ERROR_CONN;
     if (client->socket < 0) {
         return (HTTPCLIENT_RESULT)ret;
     }
+    client->keep_alive = false;
     ret = httpclient_send_header(client, url, method, client_data);
     if (ret != 0) {
         return (HTTPCLIENT_RESULT)ret;
@@ -1186,6 +1368,53 @@ void httpclient_close(httpclient_t *client)
     INFO("httpclient_close() client: %p", client);
 }
 
+void httpclient_release(httpclient_t *client, httpclient_data_t *client_data)
+{
+    /*
+     * Only a content-length response which is received completely leaves the connection
+     * at the next response boundary, the chunked trailer isn't consumed by retrieving
+     */
+    if (client->socket >= 0 && client->keep_alive &&
+        client->server_cert == NULL && client->client_cert == NULL &&
+        client_data != NULL && !client_data->is_chunked &&
+        client_data->response_content_len >= 0 && client_data->retrieve_len == 0) {
+        httpclient_pool_put(client);
+        DBG("httpclient_release() pooled, client: %p", client);
+        return;
+    }
+    httpclient_close(client);
+}
+
+void httpclient_pool_stats(int *hits, int *misses)
+{
+    os_mutex lock = httpclient_pool_lock();
+    if (hits != NULL)
+        *hits = g_pool_hits;
+    if (misses != NULL)
+        *misses = g_pool_misses;
+    if (lock != NULL)
+        os_mutex_unlock(lock);
+}
+
+void httpclient_pool_flush()
+{
+    struct httpclient_pool_entry idle[HTTPCLIENT_POOL_SIZE];
+    int idle_count = 0;
+    os_mutex lock = httpclient_pool_lock();
+    if (lock == NULL)
+        return;
+    for (int i = 0; i < HTTPCLIENT_POOL_SIZE; i++) {
+        if (g_pool[i].used) {
+            idle[idle_count++] = g_pool[i];
+            g_pool[i].used = false;
+        }
+    }
+    os_mutex_unlock(lock);
+
+    for (int i = 0; i < idle_count; i++)
+        httpclient_pool_close(&idle[i]);
+}
+
 int httpclient_get_response_code(httpclient_t *client)
 {
     return client->response_code;
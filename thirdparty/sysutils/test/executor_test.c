@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <string.h>
+#include "osal/os_thread.h"
+#include "osal/os_time.h"
+#include "cutils/memory_helper.h"
+#include "cutils/log_helper.h"
+#include "cutils/executor.h"
+
+#define LOG_TAG "executor_test"
+
+#define JOB_COUNT           64
+#define JOB_SLICES          100
+#define DELAYED_COUNT       3
+#define WAKE_ROUNDS         50
+
+struct executor_job {
+    executor_handle executor;
+    os_mutex lock;
+    os_cond cond;
+    int *done;
+    int slices;
+};
+
+static void executor_job_run(void *arg)
+{
+    struct executor_job *job = (struct executor_job *)arg;
+
+    // a long job does one slice each time and submits itself again
+    job->slices++;
+    if (job->slices < JOB_SLICES) {
+        if (executor_submit(job->executor, executor_job_run, job) == 0)
+            return;
+        OS_LOGE(LOG_TAG, "Failed to resubmit job");
+    }
+
+    os_mutex_lock(job->lock);
+    (*job->done)++;
+    os_cond_signal(job->cond);
+    os_mutex_unlock(job->lock);
+}
+
+struct executor_delayed_job {
+    unsigned long delay_ms;
+    unsigned long long submit_usec;
+    unsigned long long run_usec;
+    int order;
+    os_mutex lock;
+    os_cond cond;
+    int *done;
+};
+
+static void executor_delayed_job_run(void *arg)
+{
+    struct executor_delayed_job *job = (struct executor_delayed_job *)arg;
+
+    os_mutex_lock(job->lock);
+    job->run_usec = os_monotonic_usec();
+    job->order = (*job->done)++;
+    os_cond_signal(job->cond);
+    os_mutex_unlock(job->lock);
+}
+
+static int executor_delayed_test(executor_handle executor, os_mutex lock, os_cond cond)
+{
+    // submitted out of order, must run by due time and not before it
+    static const unsigned long delays[DELAYED_COUNT] = { 60, 20, 40 };
+    static const int orders[DELAYED_COUNT] = { 2, 0, 1 };
+    struct executor_delayed_job jobs[DELAYED_COUNT];
+    int done = 0;
+
+    for (int i = 0; i < DELAYED_COUNT; i++) {
+        jobs[i].delay_ms = delays[i];
+        jobs[i].lock = lock;
+        jobs[i].cond = cond;
+        jobs[i].done = &done;
+        jobs[i].submit_usec = os_monotonic_usec();
+        if (executor_submit_delayed(executor, executor_delayed_job_run, &jobs[i], delays[i]) != 0) {
+            OS_LOGE(LOG_TAG, "Failed to submit delayed job");
+            return -1;
+        }
+    }
+
+    os_mutex_lock(lock);
+    while (done < DELAYED_COUNT) {
+        if (os_cond_timedwait(cond, lock, 10*1000*1000) != 0)
+            break;
+    }
+    os_mutex_unlock(lock);
+
+    if (done != DELAYED_COUNT) {
+        OS_LOGE(LOG_TAG, "Finished %d/%d delayed jobs", done, DELAYED_COUNT);
+        return -1;
+    }
+    for (int i = 0; i < DELAYED_COUNT; i++) {
+        unsigned long long waited = jobs[i].run_usec - jobs[i].submit_usec;
+        if (waited < jobs[i].delay_ms*1000 || jobs[i].order != orders[i]) {
+            OS_LOGE(LOG_TAG, "Delayed job[%d] ran as %d after %llu usec, expected %d after %lu msec",
+                    i, jobs[i].order, waited, orders[i], jobs[i].delay_ms);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void executor_wake_job_run(void *arg)
+{
+    struct executor_job *job = (struct executor_job *)arg;
+
+    os_mutex_lock(job->lock);
+    (*job->done)++;
+    os_cond_signal(job->cond);
+    os_mutex_unlock(job->lock);
+}
+
+static int executor_wake_test(executor_handle executor, os_mutex lock, os_cond cond)
+{
+    // every worker is parked before each submission, it must not be missed
+    struct executor_job job = {
+        .executor = executor,
+        .lock = lock,
+        .cond = cond,
+    };
+    int done = 0;
+    job.done = &done;
+
+    for (int i = 0; i < WAKE_ROUNDS; i++) {
+        os_thread_sleep_msec(i % 5);
+        if (executor_submit(executor, executor_wake_job_run, &job) != 0) {
+            OS_LOGE(LOG_TAG, "Failed to submit wake job");
+            return -1;
+        }
+        os_mutex_lock(lock);
+        while (done <= i) {
+            if (os_cond_timedwait(cond, lock, 1000*1000) != 0)
+                break;
+        }
+        os_mutex_unlock(lock);
+        if (done <= i) {
+            OS_LOGE(LOG_TAG, "Wake job[%d] not run by idle workers", i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main()
+{
+    struct executor_job jobs[JOB_COUNT];
+    os_mutex lock = os_mutex_create();
+    os_cond cond = os_cond_create();
+    int done = 0, ret = -1;
+
+    executor_handle executor = executor_create(NULL, 4);
+    if (executor == NULL) {
+        OS_LOGE(LOG_TAG, "Failed to create executor");
+        goto test_out;
+    }
+    OS_LOGI(LOG_TAG, "Executor created with %u workers", executor_worker_count(executor));
+
+    for (int i = 0; i < JOB_COUNT; i++) {
+        jobs[i].executor = executor;
+        jobs[i].lock = lock;
+        jobs[i].cond = cond;
+        jobs[i].done = &done;
+        jobs[i].slices = 0;
+        if (executor_submit(executor, executor_job_run, &jobs[i]) != 0) {
+            OS_LOGE(LOG_TAG, "Failed to submit job");
+            goto test_out;
+        }
+    }
+
+    os_mutex_lock(lock);
+    while (done < JOB_COUNT) {
+        if (os_cond_timedwait(cond, lock, 10*1000*1000) != 0)
+            break;
+    }
+    os_mutex_unlock(lock);
+
+    if (done != JOB_COUNT) {
+        OS_LOGE(LOG_TAG, "Finished %d/%d jobs", done, JOB_COUNT);
+        goto test_out;
+    }
+    for (int i = 0; i < JOB_COUNT; i++) {
+        if (jobs[i].slices != JOB_SLICES) {
+            OS_LOGE(LOG_TAG, "Job[%d] ran %d/%d slices", i, jobs[i].slices, JOB_SLICES);
+            goto test_out;
+        }
+    }
+    if (executor_task_count(executor) != 0) {
+        OS_LOGE(LOG_TAG, "Tasks left in executor: %u", executor_task_count(executor));
+        goto test_out;
+    }
+
+    OS_LOGI(LOG_TAG, "Succeed to run %d jobs with %d slices", JOB_COUNT, JOB_SLICES);
+
+    if (executor_delayed_test(executor, lock, cond) != 0)
+        goto test_out;
+    OS_LOGI(LOG_TAG, "Succeed to run %d delayed jobs", DELAYED_COUNT);
+
+    if (executor_wake_test(executor, lock, cond) != 0)
+        goto test_out;
+    OS_LOGI(LOG_TAG, "Succeed to wake idle workers %d times", WAKE_ROUNDS);
+    ret = 0;
+
+test_out:
+    executor_destroy(executor);
+    os_cond_destroy(cond);
+    os_mutex_destroy(lock);
+    return ret;
+}
@@ -0,0 +1,453 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "osal/os_thread.h"
+#include "cutils/memory_helper.h"
+#include "cutils/log_helper.h"
+#include "httpclient/httpclient.h"
+
+#define LOG_TAG "httpclient_test"
+
+// built with HTTPCLIENT_POOL_IDLE_SEC of 1 second, the pool holds 4 connections
+#define POOL_SIZE           4
+#define POOL_IDLE_MS        1000
+#define SERVER_COUNT        2
+#define BIG_CONTENT_LEN     (64 * 1024)
+#define WAIT_MS             2000
+
+/*
+ * Loopback server, every connection is served by its own thread until the client closes it:
+ *   /keep  keep-alive response, the body is the id of the connection
+ *   /big   keep-alive response of BIG_CONTENT_LEN bytes
+ *   /old   HTTP/1.0 response
+ *   /drop  keep-alive response, then the connection is closed by server
+ */
+struct test_server {
+    int fd;
+    int port;
+};
+
+struct test_conn {
+    int fd;
+    int id;
+};
+
+static struct test_server g_servers[SERVER_COUNT];
+static os_mutex g_lock;
+static int g_accepted;
+static int g_closed;
+static int g_last_closed_id;
+
+static int server_send(int fd, const char *data, int len)
+{
+    while (len > 0) {
+        int ret = send(fd, data, len, MSG_NOSIGNAL);
+        if (ret <= 0)
+            return -1;
+        data += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+static int server_respond(struct test_conn *conn, const char *path)
+{
+    static char big[BIG_CONTENT_LEN];
+    char buf[256];
+    int len;
+
+    if (strcmp(path, "/big") == 0) {
+        len = snprintf(buf, sizeof(buf), "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n", BIG_CONTENT_LEN);
+        if (server_send(conn->fd, buf, len) != 0)
+            return -1;
+        memset(big, 'x', sizeof(big));
+        return server_send(conn->fd, big, sizeof(big));
+    }
+
+    const char *version = strcmp(path, "/old") == 0 ? "1.0" : "1.1";
+    len = snprintf(buf, sizeof(buf), "HTTP/%s 200 OK\r\nContent-Length: 8\r\n\r\n%08d", version, conn->id);
+    if (server_send(conn->fd, buf, len) != 0)
+        return -1;
+    return strcmp(path, "/keep") == 0 ? 0 : -1;
+}
+
+static void *server_conn_thread(void *arg)
+{
+    struct test_conn *conn = (struct test_conn *)arg;
+    char request[1024];
+    int len = 0;
+
+    while (1) {
+        int ret = recv(conn->fd, request + len, sizeof(request) - 1 - len, 0);
+        if (ret <= 0)
+            break;
+        len += ret;
+        request[len] = '\0';
+        char *end = strstr(request, "\r\n\r\n");
+        if (end == NULL) {
+            if (len == sizeof(request) - 1)
+                break;
+            continue;
+        }
+        char path[64] = {0};
+        if (sscanf(request, "GET %63s HTTP/1.1", path) != 1 || server_respond(conn, path) != 0)
+            break;
+        end += 4;
+        len -= end - request;
+        memmove(request, end, len);
+    }
+
+    close(conn->fd);
+    os_mutex_lock(g_lock);
+    g_closed++;
+    g_last_closed_id = conn->id;
+    os_mutex_unlock(g_lock);
+    OS_FREE(conn);
+    return NULL;
+}
+
+static void *server_accept_thread(void *arg)
+{
+    struct test_server *server = (struct test_server *)arg;
+    struct os_thread_attr attr = {
+        .name = "httpclient_test_conn",
+        .priority = OS_THREAD_PRIO_NORMAL,
+        .stacksize = os_thread_default_stacksize(),
+        .joinable = false,
+    };
+
+    while (1) {
+        int fd = accept(server->fd, NULL, NULL);
+        if (fd < 0)
+            break;
+        struct test_conn *conn = OS_CALLOC(1, sizeof(struct test_conn));
+        if (conn == NULL) {
+            close(fd);
+            continue;
+        }
+        conn->fd = fd;
+        os_mutex_lock(g_lock);
+        conn->id = ++g_accepted;
+        os_mutex_unlock(g_lock);
+        if (os_thread_create(&attr, server_conn_thread, conn) == NULL) {
+            close(fd);
+            OS_FREE(conn);
+        }
+    }
+    return NULL;
+}
+
+static int server_start(struct test_server *server)
+{
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    server->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server->fd < 0 ||
+        bind(server->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(server->fd, 16) != 0 ||
+        getsockname(server->fd, (struct sockaddr *)&addr, &addrlen) != 0) {
+        OS_LOGE(LOG_TAG, "Failed to listen on loopback");
+        return -1;
+    }
+    server->port = ntohs(addr.sin_port);
+
+    struct os_thread_attr attr = {
+        .name = "httpclient_test_server",
+        .priority = OS_THREAD_PRIO_NORMAL,
+        .stacksize = os_thread_default_stacksize(),
+        .joinable = false,
+    };
+    if (os_thread_create(&attr, server_accept_thread, server) == NULL)
+        return -1;
+    return 0;
+}
+
+// Wait for server to see @count connections closed in all
+static bool server_wait_closed(int count)
+{
+    for (int i = 0; i < WAIT_MS / 10; i++) {
+        os_mutex_lock(g_lock);
+        bool done = g_closed >= count;
+        os_mutex_unlock(g_lock);
+        if (done)
+            return true;
+        os_thread_sleep_msec(10);
+    }
+    OS_LOGE(LOG_TAG, "Server has %d connections closed, %d expected", g_closed, count);
+    return false;
+}
+
+// Wait for all connections to be closed, returns count of connections closed
+static int server_closed()
+{
+    os_mutex_lock(g_lock);
+    int accepted = g_accepted;
+    os_mutex_unlock(g_lock);
+    server_wait_closed(accepted);
+    os_mutex_lock(g_lock);
+    int closed = g_closed;
+    os_mutex_unlock(g_lock);
+    return closed;
+}
+
+struct test_client {
+    httpclient_t client;
+    httpclient_data_t data;
+    char header[512];
+    char body[1024];
+};
+
+// Send a GET request through the pool and receive a single buffer of the response
+static int client_get(struct test_client *c, const char *host, int port, const char *path)
+{
+    char url[128];
+    snprintf(url, sizeof(url), "http://%s:%d%s", host, port, path);
+    memset(c, 0, sizeof(struct test_client));
+    c->data.header_buf = c->header;
+    c->data.header_buf_len = sizeof(c->header);
+    c->data.response_buf = c->body;
+    c->data.response_buf_len = sizeof(c->body) - 1;
+
+    if (httpclient_connect_pooled(&c->client, url) != HTTPCLIENT_OK) {
+        OS_LOGE(LOG_TAG, "Failed to connect %s", url);
+        return -1;
+    }
+    int ret = httpclient_send_request(&c->client, url, HTTPCLIENT_GET, &c->data);
+    if (ret >= 0)
+        ret = httpclient_recv_response(&c->client, &c->data);
+    if (ret < 0) {
+        OS_LOGE(LOG_TAG, "Failed to get %s, ret=%d", url, ret);
+        httpclient_close(&c->client);
+        return -1;
+    }
+    return 0;
+}
+
+// Id of the connection served the /keep response
+static int client_conn_id(struct test_client *c)
+{
+    int id = -1;
+    c->body[sizeof(c->body) - 1] = '\0';
+    if (sscanf(c->body, "%08d", &id) != 1)
+        return -1;
+    return id;
+}
+
+static bool pool_expect(int hits, int misses, const char *what)
+{
+    static int last_hits = 0, last_misses = 0;
+    int now_hits = 0, now_misses = 0;
+    httpclient_pool_stats(&now_hits, &now_misses);
+    bool ok = now_hits - last_hits == hits && now_misses - last_misses == misses;
+    if (!ok) {
+        OS_LOGE(LOG_TAG, "%s: %d hits and %d misses, %d and %d expected", what,
+                now_hits - last_hits, now_misses - last_misses, hits, misses);
+    }
+    last_hits = now_hits;
+    last_misses = now_misses;
+    return ok;
+}
+
+// Sequential requests share one connection
+static int pool_reuse_test()
+{
+    struct test_client c;
+    int ids[3];
+    for (int i = 0; i < 3; i++) {
+        if (client_get(&c, "127.0.0.1", g_servers[0].port, "/keep") != 0)
+            return -1;
+        ids[i] = client_conn_id(&c);
+        if (c.client.reused != (i > 0) || ids[i] < 0 || ids[i] != ids[0]) {
+            OS_LOGE(LOG_TAG, "Request %d on connection %d, reused=%d", i, ids[i], c.client.reused);
+            return -1;
+        }
+        httpclient_release(&c.client, &c.data);
+    }
+    if (!pool_expect(2, 1, "reuse"))
+        return -1;
+    httpclient_pool_flush();
+    return 0;
+}
+
+// Connections are pooled by scheme, host and port
+static int pool_key_test()
+{
+    struct test_client c;
+    if (client_get(&c, "127.0.0.1", g_servers[0].port, "/keep") != 0)
+        return -1;
+    httpclient_release(&c.client, &c.data);
+    if (!pool_expect(0, 1, "key first"))
+        return -1;
+
+    // other port, then other host name of the same address
+    if (client_get(&c, "127.0.0.1", g_servers[1].port, "/keep") != 0)
+        return -1;
+    httpclient_release(&c.client, &c.data);
+    if (client_get(&c, "localhost", g_servers[0].port, "/keep") != 0)
+        return -1;
+    httpclient_release(&c.client, &c.data);
+    if (!pool_expect(0, 2, "key other"))
+        return -1;
+
+    // each of them is taken by its own key
+    if (client_get(&c, "127.0.0.1", g_servers[0].port, "/keep") != 0)
+        return -1;
+    httpclient_release(&c.client, &c.data);
+    if (client_get(&c, "127.0.0.1", g_servers[1].port, "/keep") != 0)
+        return -1;
+    httpclient_release(&c.client, &c.data);
+    if (client_get(&c, "localhost", g_servers[0].port, "/keep") != 0)
+        return -1;
+    httpclient_release(&c.client, &c.data);
+    if (!pool_expect(3, 0, "key same"))
+        return -1;
+    httpclient_pool_flush();
+    return 0;
+}
+
+// The longest idle connection is evicted from a full pool
+static int pool_evict_test()
+{
+    static struct test_client c[POOL_SIZE + 1];
+    int ids[POOL_SIZE + 1];
+    int closed = server_closed();
+    for (int i = 0; i <= POOL_SIZE; i++) {
+        if (client_get(&c[i], "127.0.0.1", g_servers[0].port, "/keep") != 0)
+            return -1;
+        ids[i] = client_conn_id(&c[i]);
+    }
+    if (!pool_expect(0, POOL_SIZE + 1, "evict connect"))
+        return -1;
+
+    for (int i = 0; i <= POOL_SIZE; i++) {
+        httpclient_release(&c[i].client, &c[i].data);
+        os_thread_sleep_msec(2);
+    }
+    if (!server_wait_closed(closed + 1))
+        return -1;
+    os_mutex_lock(g_lock);
+    int evicted = g_last_closed_id;
+    os_mutex_unlock(g_lock);
+    if (evicted != ids[0]) {
+        OS_LOGE(LOG_TAG, "Connection %d evicted, %d expected", evicted, ids[0]);
+        return -1;
+    }
+
+    bool taken[POOL_SIZE + 1] = { false };
+    for (int i = 0; i < POOL_SIZE; i++) {
+        if (client_get(&c[i], "127.0.0.1", g_servers[0].port, "/keep") != 0)
+            return -1;
+        int id = client_conn_id(&c[i]);
+        for (int j = 1; j <= POOL_SIZE; j++) {
+            if (id == ids[j] && !taken[j]) {
+                taken[j] = true;
+                id = -1;
+            }
+        }
+        if (id != -1) {
+            OS_LOGE(LOG_TAG, "Connection %d taken isn't pooled", id);
+            return -1;
+        }
+    }
+    if (!pool_expect(POOL_SIZE, 0, "evict take"))
+        return -1;
+    for (int i = 0; i < POOL_SIZE; i++)
+        httpclient_release(&c[i].client, &c[i].data);
+    httpclient_pool_flush();
+    return 0;
+}
+
+// Idle connections expire, the one closed by server is never taken
+static int pool_expire_test()
+{
+    struct test_client c;
+    int closed = server_closed();
+    if (client_get(&c, "127.0.0.1", g_servers[0].port, "/keep") != 0)
+        return -1;
+    httpclient_release(&c.client, &c.data);
+    os_thread_sleep_msec(POOL_IDLE_MS + 200);
+    if (client_get(&c, "127.0.0.1", g_servers[0].port, "/keep") != 0)
+        return -1;
+    if (c.client.reused || !pool_expect(0, 2, "expire") || !server_wait_closed(closed + 1))
+        return -1;
+    httpclient_close(&c.client);
+    if (!server_wait_closed(closed + 2))
+        return -1;
+
+    if (client_get(&c, "127.0.0.1", g_servers[0].port, "/drop") != 0)
+        return -1;
+    httpclient_release(&c.client, &c.data);
+    if (!server_wait_closed(closed + 3))
+        return -1;
+    if (client_get(&c, "127.0.0.1", g_servers[0].port, "/keep") != 0)
+        return -1;
+    if (c.client.reused || !pool_expect(0, 2, "drop"))
+        return -1;
+    httpclient_close(&c.client);
+    return 0;
+}
+
+// A response isn't pooled unless it's received completely over a keep-alive connection
+static int pool_partial_test()
+{
+    struct test_client c;
+    int closed = server_closed();
+    if (client_get(&c, "127.0.0.1", g_servers[0].port, "/big") != 0)
+        return -1;
+    if (!c.data.is_more || c.data.retrieve_len <= 0) {
+        OS_LOGE(LOG_TAG, "Response of /big is received at once");
+        return -1;
+    }
+    httpclient_release(&c.client, &c.data);
+    if (!server_wait_closed(closed + 1))
+        return -1;
+
+    if (client_get(&c, "127.0.0.1", g_servers[0].port, "/old") != 0)
+        return -1;
+    httpclient_release(&c.client, &c.data);
+    if (!server_wait_closed(closed + 2))
+        return -1;
+
+    if (client_get(&c, "127.0.0.1", g_servers[0].port, "/keep") != 0)
+        return -1;
+    if (c.client.reused || !pool_expect(0, 3, "partial"))
+        return -1;
+    httpclient_close(&c.client);
+    return 0;
+}
+
+int main()
+{
+    int (*tests[])() = {
+        pool_reuse_test, pool_key_test, pool_evict_test, pool_expire_test, pool_partial_test,
+    };
+    int ret = 0;
+
+    g_lock = os_mutex_create();
+    for (int i = 0; i < SERVER_COUNT; i++) {
+        if (server_start(&g_servers[i]) != 0)
+            return -1;
+    }
+
+    for (int i = 0; i < (int)(sizeof(tests)/sizeof(tests[0])) && ret == 0; i++)
+        ret = tests[i]();
+    httpclient_pool_flush();
+
+    if (ret == 0) {
+        int hits = 0, misses = 0;
+        httpclient_pool_stats(&hits, &misses);
+        OS_LOGI(LOG_TAG, "Httpclient pool test passed, %d hits, %d misses", hits, misses);
+    } else {
+        OS_LOGE(LOG_TAG, "Httpclient pool test failed");
+    }
+    return ret;
+}
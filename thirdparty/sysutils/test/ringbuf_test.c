@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <string.h>
+#include "osal/os_thread.h"
+#include "cutils/memory_helper.h"
+#include "cutils/log_helper.h"
+#include "cutils/ringbuf.h"
+
+#define LOG_TAG "ringbuf_test"
+
+#define RINGBUF_SIZE        1000
+#define RINGBUF_SPAN        256
+#define TOTAL_BYTES         (1024 * 1024)
+
+static void *ringbuf_write_thread(void *arg)
+{
+    ringbuf_handle rb = (ringbuf_handle)arg;
+    unsigned char seq = 0;
+    int total = 0;
+
+    while (total < TOTAL_BYTES) {
+        char *span = NULL;
+        int want = (total % 7 == 0) ? 1 : 300;
+        if (want > TOTAL_BYTES - total)
+            want = TOTAL_BYTES - total;
+        int ret = rb_acquire_write(rb, &span, want, 0);
+        if (ret <= 0) {
+            OS_LOGE(LOG_TAG, "Failed to acquire write span: %d", ret);
+            break;
+        }
+        for (int i = 0; i < ret; i++)
+            span[i] = (char)seq++;
+        rb_commit_write(rb, ret);
+        total += ret;
+    }
+    rb_done_write(rb);
+    return NULL;
+}
+
+static int ringbuf_span_test(ringbuf_handle rb)
+{
+    os_thread tid = os_thread_create(NULL, ringbuf_write_thread, rb);
+
+    unsigned char seq = 0;
+    int total = 0, wrapped = 0, ret = 0;
+    while (1) {
+        char *span = NULL;
+        int want = 1 + (total % RINGBUF_SPAN);
+        ret = rb_acquire_read(rb, &span, want, 0);
+        if (ret == RB_DONE)
+            break;
+        if (ret <= 0) {
+            OS_LOGE(LOG_TAG, "Failed to acquire read span: %d", ret);
+            goto test_done;
+        }
+        if (ret != want && total + ret != TOTAL_BYTES) {
+            OS_LOGE(LOG_TAG, "Insufficient read span: %d/%d", ret, want);
+            goto test_done;
+        }
+        for (int i = 0; i < ret; i++) {
+            if ((unsigned char)span[i] != seq++) {
+                OS_LOGE(LOG_TAG, "Data mismatch at %d", total + i);
+                goto test_done;
+            }
+        }
+        // commit a part of span, the rest must be returned again
+        int commit = ret > 1 ? ret/2 : ret;
+        seq -= ret - commit;
+        if (rb_commit_read(rb, commit) != RB_OK) {
+            OS_LOGE(LOG_TAG, "Failed to commit read span");
+            goto test_done;
+        }
+        if ((total % RINGBUF_SIZE) + ret > RINGBUF_SIZE)
+            wrapped++;
+        total += commit;
+    }
+
+    if (total == TOTAL_BYTES)
+        OS_LOGI(LOG_TAG, "Succeed to read %d bytes through spans, wrapped %d times", total, wrapped);
+    else
+        OS_LOGE(LOG_TAG, "Read %d/%d bytes", total, TOTAL_BYTES);
+
+test_done:
+    rb_abort(rb);
+    os_thread_join(tid, NULL);
+    return total == TOTAL_BYTES ? 0 : -1;
+}
+
+int main()
+{
+    ringbuf_handle rb = rb_create_with_span(RINGBUF_SIZE, RINGBUF_SPAN);
+    ringbuf_handle rb_spsc = rb_create_spsc(RINGBUF_SIZE, RINGBUF_SPAN);
+    char *static_buf = OS_MALLOC(RINGBUF_SIZE + RINGBUF_SPAN);
+    ringbuf_handle rb_static = rb_create_spsc_static(static_buf, RINGBUF_SIZE, RINGBUF_SPAN);
+    int ret = -1;
+    if (rb == NULL || rb_spsc == NULL || rb_static == NULL) {
+        OS_LOGE(LOG_TAG, "Failed to create ringbuf");
+        goto test_out;
+    }
+
+    OS_LOGI(LOG_TAG, "Testing locked ringbuf");
+    ret = ringbuf_span_test(rb);
+    if (ret != 0)
+        goto test_out;
+
+    OS_LOGI(LOG_TAG, "Testing spsc ringbuf");
+    ret = ringbuf_span_test(rb_spsc);
+    if (ret != 0)
+        goto test_out;
+
+    OS_LOGI(LOG_TAG, "Testing spsc ringbuf on static buffer");
+    ret = ringbuf_span_test(rb_static);
+
+test_out:
+    if (rb != NULL)
+        rb_destroy(rb);
+    if (rb_spsc != NULL)
+        rb_destroy(rb_spsc);
+    if (rb_static != NULL)
+        rb_destroy(rb_static);
+    if (static_buf != NULL)
+        OS_FREE(static_buf);
+    return ret;
+}